@@ -0,0 +1,190 @@
+#include "motor/assets/archive.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/assets/lz4.h"
+
+namespace motor::assets
+{
+namespace
+{
+bool EntryLess(uint64_t lhs_hash, std::string_view lhs_path, uint64_t rhs_hash,
+               std::string_view rhs_path)
+{
+  if (lhs_hash != rhs_hash) return lhs_hash < rhs_hash;
+  return lhs_path < rhs_path;
+}
+}  // namespace
+
+uint64_t HashAssetPath(std::string_view path)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (char c : path)
+  {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+std::unique_ptr<Archive> Archive::Open(const std::string& path)
+{
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0)
+  {
+    PLOG(ERROR) << "Couldn't open " << path;
+    if (fd >= 0) close(fd);
+    return nullptr;
+  }
+  const size_t size = st.st_size;
+  if (size < sizeof(ArchiveHeader))
+  {
+    LOG(ERROR) << path << " is too small to be an archive";
+    close(fd);
+    return nullptr;
+  }
+  void* base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  // Mapping stays valid without the descriptor.
+  close(fd);
+  if (base == MAP_FAILED)
+  {
+    PLOG(ERROR) << "Couldn't map " << path;
+    return nullptr;
+  }
+  std::unique_ptr<Archive> archive(
+      new Archive(path, static_cast<const std::byte*>(base), size));
+
+  ArchiveHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  if (header.magic_ != kArchiveMagic || header.version_ != kArchiveVersion)
+  {
+    LOG(ERROR) << path << " isn't an archive of version " << kArchiveVersion;
+    return nullptr;
+  }
+  const uint64_t toc_size =
+      sizeof(ArchiveHeader) +
+      uint64_t{header.num_entries_} * sizeof(ArchiveEntry) + header.paths_size_;
+  if (header.data_offset_ < toc_size || header.data_offset_ > size)
+  {
+    LOG(ERROR) << path << " has a truncated table of contents";
+    return nullptr;
+  }
+  archive->entries_ = reinterpret_cast<const ArchiveEntry*>(
+      archive->base_ + sizeof(ArchiveHeader));
+  archive->num_entries_ = header.num_entries_;
+  archive->paths_ = reinterpret_cast<const char*>(
+      archive->entries_ + archive->num_entries_);
+
+  // Everything below is trusted from here on, lookups rely on the order.
+  for (size_t i = 0; i < archive->num_entries_; ++i)
+  {
+    const ArchiveEntry& entry = archive->entries_[i];
+    const bool valid =
+        uint64_t{entry.path_offset_} + entry.path_size_ <= header.paths_size_ &&
+        entry.offset_ >= header.data_offset_ && entry.offset_ <= size &&
+        entry.offset_ % kArchiveAlignment == 0 &&
+        entry.stored_size_ <= size - entry.offset_ &&
+        ((entry.flags_ & kArchiveEntryLz4) != 0 ||
+         entry.stored_size_ == entry.size_);
+    if (!valid)
+    {
+      LOG(ERROR) << path << " has a corrupt entry " << i;
+      return nullptr;
+    }
+    const std::string_view entry_path = archive->EntryPath(entry);
+    if (entry.hash_ != HashAssetPath(entry_path) ||
+        (i > 0 && !EntryLess(archive->entries_[i - 1].hash_,
+                             archive->EntryPath(archive->entries_[i - 1]),
+                             entry.hash_, entry_path)))
+    {
+      LOG(ERROR) << path << " has a corrupt table of contents at " << i;
+      return nullptr;
+    }
+  }
+  VLOG(1) << "Mapped " << path << " with " << archive->num_entries_
+          << " entries";
+  return archive;
+}
+
+Archive::Archive(std::string path, const std::byte* base, size_t size)
+    : path_(std::move(path)), base_(base), size_(size)
+{
+}
+
+Archive::~Archive()
+{
+  munmap(const_cast<std::byte*>(base_), size_);
+}
+
+const ArchiveEntry* Archive::Find(std::string_view path) const
+{
+  const uint64_t hash = HashAssetPath(path);
+  const ArchiveEntry* end = entries_ + num_entries_;
+  const ArchiveEntry* it = std::lower_bound(
+      entries_, end, hash,
+      [](const ArchiveEntry& entry, uint64_t h) { return entry.hash_ < h; });
+  // Colliding entries are next to each other.
+  for (; it != end && it->hash_ == hash; ++it)
+  {
+    if (EntryPath(*it) == path) return it;
+  }
+  return nullptr;
+}
+
+std::string_view Archive::EntryPath(const ArchiveEntry& entry) const
+{
+  return std::string_view(paths_ + entry.path_offset_, entry.path_size_);
+}
+
+ByteSpan Archive::View(const ArchiveEntry& entry) const
+{
+  if ((entry.flags_ & kArchiveEntryLz4) != 0) return ByteSpan();
+  ByteSpan span;
+  span.data_ = base_ + entry.offset_;
+  span.size_ = entry.size_;
+  return span;
+}
+
+bool Archive::Read(const ArchiveEntry& entry,
+                   std::vector<std::byte>* data) const
+{
+  const std::byte* blob = base_ + entry.offset_;
+  if ((entry.flags_ & kArchiveEntryLz4) == 0)
+  {
+    data->assign(blob, blob + entry.size_);
+    return true;
+  }
+  data->resize(entry.size_);
+  if (!Lz4Decompress(blob, entry.stored_size_, data->data(), data->size()))
+  {
+    LOG(ERROR) << "Corrupt entry " << EntryPath(entry) << " in " << path_;
+    data->clear();
+    return false;
+  }
+  return true;
+}
+
+void Archive::Prefetch(const ArchiveEntry& entry) const
+{
+  if (entry.stored_size_ == 0) return;
+  // Blob alignment is a multiple of the page size, as madvise requires.
+  madvise(const_cast<std::byte*>(base_) + entry.offset_, entry.stored_size_,
+          MADV_WILLNEED);
+}
+
+}  // namespace motor::assets
@@ -0,0 +1,116 @@
+#ifndef _MOTOR_ASSETS_ARCHIVE_H_
+#define _MOTOR_ASSETS_ARCHIVE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace motor::assets
+{
+// Read-only view of contiguous bytes owned by someone else.
+struct ByteSpan
+{
+  const std::byte* data_ = nullptr;
+  size_t size_ = 0;
+
+  const std::byte* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const std::byte* begin() const { return data_; }
+  const std::byte* end() const { return data_ + size_; }
+};
+
+// On disk layout of an archive, all integers are little endian:
+//   ArchiveHeader
+//   ArchiveEntry[num_entries_], sorted by (hash_, path)
+//   Paths of the entries, without terminators
+//   Blobs, each starting at a multiple of kArchiveAlignment
+// Table of contents fits in the first few pages, so that opening an archive
+// only touches those. Alignment lets blobs be mapped, or read with O_DIRECT,
+// without straddling more pages than needed.
+constexpr uint32_t kArchiveMagic = 0x4b41504d;  // "MPAK"
+constexpr uint32_t kArchiveVersion = 1;
+constexpr uint64_t kArchiveAlignment = 64 << 10;
+
+enum ArchiveEntryFlags : uint32_t
+{
+  // Blob is a single LZ4 block.
+  kArchiveEntryLz4 = 1 << 0,
+};
+
+struct ArchiveHeader
+{
+  uint32_t magic_ = kArchiveMagic;
+  uint32_t version_ = kArchiveVersion;
+  uint32_t num_entries_ = 0;
+  uint32_t paths_size_ = 0;
+  // Offset of the first blob, i.e. size of everything above.
+  uint64_t data_offset_ = 0;
+  uint64_t reserved_ = 0;
+};
+static_assert(sizeof(ArchiveHeader) == 32);
+
+struct ArchiveEntry
+{
+  uint64_t hash_ = 0;
+  uint64_t offset_ = 0;
+  // Size of the blob, differs from size_ for compressed entries.
+  uint64_t stored_size_ = 0;
+  uint64_t size_ = 0;
+  // Relative to the start of the paths.
+  uint32_t path_offset_ = 0;
+  uint32_t path_size_ = 0;
+  uint32_t flags_ = 0;
+  uint32_t reserved_ = 0;
+};
+static_assert(sizeof(ArchiveEntry) == 48);
+
+// FNV-1a of the path, entries are looked up by it.
+uint64_t HashAssetPath(std::string_view path);
+
+// Memory maps an archive, contents of uncompressed entries are handed out
+// without copying and are valid as long as the archive. Pages are read on
+// first access, see Prefetch. Thread safe.
+class Archive
+{
+ public:
+  // Returns null if |path| can't be opened or isn't a valid archive.
+  static std::unique_ptr<Archive> Open(const std::string& path);
+  Archive(const Archive&) = delete;
+  Archive& operator=(const Archive&) = delete;
+  ~Archive();
+
+  // Returns null if there is no entry for |path|.
+  const ArchiveEntry* Find(std::string_view path) const;
+  const ArchiveEntry& Entry(size_t idx) const { return entries_[idx]; }
+  size_t NumEntries() const { return num_entries_; }
+  std::string_view EntryPath(const ArchiveEntry& entry) const;
+
+  // Contents of an uncompressed entry, empty for compressed ones.
+  ByteSpan View(const ArchiveEntry& entry) const;
+  // Copies, or decompresses, the contents of the entry into |data|. Returns
+  // false if the entry is corrupt.
+  bool Read(const ArchiveEntry& entry, std::vector<std::byte>* data) const;
+  // Starts reading the blob into the page cache in the background, so that
+  // accessing it later doesn't block on I/O.
+  void Prefetch(const ArchiveEntry& entry) const;
+
+  const std::string& Path() const { return path_; }
+
+ private:
+  Archive(std::string path, const std::byte* base, size_t size);
+
+  const std::string path_;
+  const std::byte* const base_;
+  const size_t size_;
+  const ArchiveEntry* entries_ = nullptr;
+  size_t num_entries_ = 0;
+  const char* paths_ = nullptr;
+};
+
+}  // namespace motor::assets
+
+#endif
@@ -0,0 +1,241 @@
+// Compares startup costs of loose files against archives cooked from them.
+// Prints the time to locate every asset, i.e. open and stat each file against
+// mapping the archive and looking up its entries, and the time to also read
+// all of their contents, cold and with the page cache warm.
+//   bazel run -c opt //motor/assets:archive_benchmark -- [dir]
+//
+// Without a directory, a mix of compressible and incompressible files is
+// generated into a temporary one. Archives are written next to the files.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "motor/assets/archive.h"
+#include "motor/assets/archive_writer.h"
+
+namespace motor::assets
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kNumGeneratedFiles = 4000;
+constexpr size_t kMinFileBytes = 1 << 10;
+constexpr size_t kMaxFileBytes = 128 << 10;
+// Contents are touched at this stride when they are mapped.
+constexpr size_t kPageBytes = 4 << 10;
+
+std::vector<std::string> GenerateFiles(const std::string& dir)
+{
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<size_t> size_dist(kMinFileBytes,
+                                                  kMaxFileBytes);
+  std::vector<char> random(kMaxFileBytes);
+  for (char& c : random) c = static_cast<char>(rng());
+  // Text like, compresses about as well as meshes and scripts do.
+  std::vector<char> repetitive(kMaxFileBytes);
+  for (size_t i = 0; i < repetitive.size(); ++i)
+  {
+    repetitive[i] = "abcdefgh"[(i / 3 + rng() % 2) % 8];
+  }
+  std::vector<std::string> names;
+  for (size_t i = 0; i < kNumGeneratedFiles; ++i)
+  {
+    names.push_back("asset_" + std::to_string(i));
+    FILE* file = std::fopen((dir + '/' + names.back()).c_str(), "wb");
+    const std::vector<char>& contents = i % 2 == 0 ? random : repetitive;
+    std::fwrite(contents.data(), 1, size_dist(rng), file);
+    std::fclose(file);
+  }
+  sync();
+  return names;
+}
+
+std::vector<std::string> ListFiles(const std::string& dir)
+{
+  std::vector<std::string> names;
+  DIR* d = opendir(dir.c_str());
+  if (d == nullptr) return names;
+  while (const dirent* entry = readdir(d))
+  {
+    if (entry->d_type == DT_REG) names.push_back(entry->d_name);
+  }
+  closedir(d);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+void DropPageCache(const std::string& path)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+}
+
+double Millis(Clock::duration duration)
+{
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+struct Timing
+{
+  Clock::duration locate_;
+  Clock::duration load_;
+  // Keeps the reads from being optimized out.
+  uint64_t checksum_ = 0;
+};
+
+Timing LoadLoose(const std::string& dir, const std::vector<std::string>& names)
+{
+  Timing timing;
+  const Clock::time_point start = Clock::now();
+  std::vector<int> fds;
+  std::vector<size_t> sizes;
+  for (const std::string& name : names)
+  {
+    const int fd = open((dir + '/' + name).c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) std::abort();
+    fds.push_back(fd);
+    sizes.push_back(st.st_size);
+  }
+  timing.locate_ = Clock::now() - start;
+
+  std::vector<char> data;
+  for (size_t i = 0; i < fds.size(); ++i)
+  {
+    data.resize(sizes[i]);
+    if (read(fds[i], data.data(), data.size()) !=
+        static_cast<ssize_t>(data.size()))
+    {
+      std::abort();
+    }
+    timing.checksum_ += data.empty() ? 0 : data.back();
+    close(fds[i]);
+  }
+  timing.load_ = Clock::now() - start;
+  return timing;
+}
+
+Timing LoadArchive(const std::string& path,
+                   const std::vector<std::string>& names)
+{
+  Timing timing;
+  const Clock::time_point start = Clock::now();
+  const std::unique_ptr<Archive> archive = Archive::Open(path);
+  if (archive == nullptr) std::abort();
+  std::vector<const ArchiveEntry*> entries;
+  for (const std::string& name : names)
+  {
+    const ArchiveEntry* entry = archive->Find(name);
+    if (entry == nullptr) std::abort();
+    entries.push_back(entry);
+  }
+  timing.locate_ = Clock::now() - start;
+
+  for (const ArchiveEntry* entry : entries) archive->Prefetch(*entry);
+  std::vector<std::byte> data;
+  for (const ArchiveEntry* entry : entries)
+  {
+    ByteSpan view = archive->View(*entry);
+    if (view.empty() && entry->size_ > 0)
+    {
+      if (!archive->Read(*entry, &data)) std::abort();
+      view.data_ = data.data();
+      view.size_ = data.size();
+    }
+    for (size_t i = 0; i < view.size(); i += kPageBytes)
+    {
+      timing.checksum_ += static_cast<uint8_t>(view.data()[i]);
+    }
+  }
+  timing.load_ = Clock::now() - start;
+  return timing;
+}
+
+void Print(const char* name, bool cold, const Timing& timing, size_t count)
+{
+  std::printf("%-12s %-5s locate %8.2f ms (%6.2f us/asset)  load %8.2f ms\n",
+              name, cold ? "cold" : "warm", Millis(timing.locate_),
+              Millis(timing.locate_) * 1000 / count, Millis(timing.load_));
+}
+
+void Run(int argc, char** argv)
+{
+  std::string dir;
+  std::vector<std::string> names;
+  bool generated = false;
+  if (argc > 1)
+  {
+    dir = argv[1];
+    names = ListFiles(dir);
+  }
+  else
+  {
+    char tmpl[] = "/tmp/motor_archive_XXXXXX";
+    dir = mkdtemp(tmpl);
+    names = GenerateFiles(dir);
+    generated = true;
+  }
+  if (names.empty()) return;
+
+  const std::string raw_path = dir + "/.benchmark_raw.pak";
+  const std::string lz4_path = dir + "/.benchmark_lz4.pak";
+  for (bool compress : {false, true})
+  {
+    ArchiveWriter writer(compress);
+    for (const std::string& name : names)
+    {
+      writer.AddFile(name, dir + '/' + name);
+    }
+    ArchiveWriterStats stats;
+    if (!writer.Write(compress ? lz4_path : raw_path, &stats)) std::abort();
+    std::printf("%s archive: %llu entries, %llu compressed, %.1f MB of files, "
+                "%.1f MB stored, %.1f MB on disk\n",
+                compress ? "LZ4" : "Raw",
+                static_cast<unsigned long long>(stats.entries_),
+                static_cast<unsigned long long>(stats.compressed_entries_),
+                stats.bytes_ / 1e6, stats.stored_bytes_ / 1e6,
+                stats.archive_bytes_ / 1e6);
+  }
+  sync();
+  std::printf("Loading %zu assets from %s\n", names.size(), dir.c_str());
+
+  for (bool cold : {true, false})
+  {
+    if (cold)
+    {
+      for (const std::string& name : names) DropPageCache(dir + '/' + name);
+    }
+    Print("loose", cold, LoadLoose(dir, names), names.size());
+    if (cold) DropPageCache(raw_path);
+    Print("archive", cold, LoadArchive(raw_path, names), names.size());
+    if (cold) DropPageCache(lz4_path);
+    Print("archive lz4", cold, LoadArchive(lz4_path, names), names.size());
+  }
+
+  unlink(raw_path.c_str());
+  unlink(lz4_path.c_str());
+  if (!generated) return;
+  for (const std::string& name : names) unlink((dir + '/' + name).c_str());
+  rmdir(dir.c_str());
+}
+
+}  // namespace
+}  // namespace motor::assets
+
+int main(int argc, char** argv) { motor::assets::Run(argc, argv); }
@@ -0,0 +1,204 @@
+#include "motor/assets/archive_writer.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/assets/archive.h"
+#include "motor/assets/lz4.h"
+
+namespace motor::assets
+{
+namespace
+{
+// Compressed entries must be at least this much smaller, as a fraction of
+// their size, otherwise they are stored as is and can be mapped directly.
+constexpr uint64_t kMinSavingsDivisor = 8;
+
+uint64_t AlignUp(uint64_t value)
+{
+  return (value + kArchiveAlignment - 1) / kArchiveAlignment *
+         kArchiveAlignment;
+}
+
+bool ReadFile(const std::string& path, std::vector<std::byte>* data)
+{
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0)
+  {
+    PLOG(ERROR) << "Couldn't open " << path;
+    if (fd >= 0) close(fd);
+    return false;
+  }
+  data->resize(st.st_size);
+  size_t done = 0;
+  while (done < data->size())
+  {
+    const ssize_t n = read(fd, data->data() + done, data->size() - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0)
+    {
+      PLOG(ERROR) << "Couldn't read " << path;
+    }
+    else if (n == 0)
+    {
+      LOG(ERROR) << path << " changed while being read";
+    }
+    if (n <= 0)
+    {
+      close(fd);
+      return false;
+    }
+    done += n;
+  }
+  close(fd);
+  return true;
+}
+
+bool WriteAt(int fd, const void* data, size_t size, uint64_t offset)
+{
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0)
+  {
+    const ssize_t n = pwrite(fd, bytes, size, offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return false;
+    bytes += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+}  // namespace
+
+void ArchiveWriter::AddFile(std::string_view path, std::string file_path)
+{
+  Source source;
+  source.path_ = std::string(path);
+  source.file_path_ = std::move(file_path);
+  sources_.push_back(std::move(source));
+}
+
+bool ArchiveWriter::Write(const std::string& path, ArchiveWriterStats* stats)
+{
+  // Blobs are laid out by path, so that assets of the same directory, which
+  // tend to be loaded together, are close to each other.
+  std::sort(sources_.begin(), sources_.end(),
+            [](const Source& lhs, const Source& rhs) {
+              return lhs.path_ < rhs.path_;
+            });
+  std::vector<ArchiveEntry> entries(sources_.size());
+  std::string paths;
+  for (size_t i = 0; i < sources_.size(); ++i)
+  {
+    const std::string& source_path = sources_[i].path_;
+    if (i > 0 && sources_[i - 1].path_ == source_path)
+    {
+      LOG(ERROR) << source_path << " was added more than once";
+      return false;
+    }
+    entries[i].hash_ = HashAssetPath(source_path);
+    entries[i].path_offset_ = paths.size();
+    entries[i].path_size_ = source_path.size();
+    paths += source_path;
+  }
+
+  ArchiveHeader header;
+  header.num_entries_ = entries.size();
+  header.paths_size_ = paths.size();
+  header.data_offset_ = AlignUp(sizeof(ArchiveHeader) +
+                                entries.size() * sizeof(ArchiveEntry) +
+                                paths.size());
+
+  // Written next to the destination and moved over it once complete, so that
+  // a failed cook never leaves a truncated archive behind.
+  const std::string tmp_path = path + ".tmp";
+  const int fd =
+      open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+  {
+    PLOG(ERROR) << "Couldn't create " << tmp_path;
+    return false;
+  }
+  auto fail = [&] {
+    close(fd);
+    unlink(tmp_path.c_str());
+    return false;
+  };
+
+  ArchiveWriterStats totals;
+  uint64_t offset = header.data_offset_;
+  std::vector<std::byte> data;
+  std::vector<std::byte> compressed;
+  for (size_t i = 0; i < sources_.size(); ++i)
+  {
+    if (!ReadFile(sources_[i].file_path_, &data)) return fail();
+    ArchiveEntry& entry = entries[i];
+    entry.offset_ = offset;
+    entry.size_ = data.size();
+    const std::vector<std::byte>* blob = &data;
+    if (compress_ && !data.empty())
+    {
+      compressed.clear();
+      Lz4Compress(data.data(), data.size(), &compressed);
+      if (compressed.size() <= data.size() - data.size() / kMinSavingsDivisor)
+      {
+        entry.flags_ |= kArchiveEntryLz4;
+        blob = &compressed;
+        ++totals.compressed_entries_;
+      }
+    }
+    entry.stored_size_ = blob->size();
+    if (!WriteAt(fd, blob->data(), blob->size(), offset))
+    {
+      PLOG(ERROR) << "Couldn't write " << tmp_path;
+      return fail();
+    }
+    offset = AlignUp(offset + blob->size());
+    ++totals.entries_;
+    totals.bytes_ += entry.size_;
+    totals.stored_bytes_ += entry.stored_size_;
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [&paths](const ArchiveEntry& lhs, const ArchiveEntry& rhs) {
+              if (lhs.hash_ != rhs.hash_) return lhs.hash_ < rhs.hash_;
+              return paths.compare(lhs.path_offset_, lhs.path_size_, paths,
+                                   rhs.path_offset_, rhs.path_size_) < 0;
+            });
+  // Archive size is a multiple of the alignment too, which keeps the offset
+  // of empty entries at the end in bounds.
+  if (!WriteAt(fd, &header, sizeof(header), 0) ||
+      !WriteAt(fd, entries.data(), entries.size() * sizeof(ArchiveEntry),
+               sizeof(header)) ||
+      !WriteAt(fd, paths.data(), paths.size(),
+               sizeof(header) + entries.size() * sizeof(ArchiveEntry)) ||
+      ftruncate(fd, offset) != 0)
+  {
+    PLOG(ERROR) << "Couldn't write " << tmp_path;
+    return fail();
+  }
+  if (close(fd) != 0 || rename(tmp_path.c_str(), path.c_str()) != 0)
+  {
+    PLOG(ERROR) << "Couldn't write " << path;
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  totals.archive_bytes_ = offset;
+  if (stats != nullptr) *stats = totals;
+  return true;
+}
+
+}  // namespace motor::assets
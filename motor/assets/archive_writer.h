@@ -0,0 +1,53 @@
+#ifndef _MOTOR_ASSETS_ARCHIVE_WRITER_H_
+#define _MOTOR_ASSETS_ARCHIVE_WRITER_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace motor::assets
+{
+struct ArchiveWriterStats
+{
+  uint64_t entries_ = 0;
+  uint64_t compressed_entries_ = 0;
+  // Sum of the sizes of the files.
+  uint64_t bytes_ = 0;
+  // Sum of the sizes of the blobs, after compression.
+  uint64_t stored_bytes_ = 0;
+  uint64_t archive_bytes_ = 0;
+};
+
+// Builds an archive, see archive.h for the layout. Files are only read while
+// writing, one at a time.
+class ArchiveWriter
+{
+ public:
+  // Entries are compressed with LZ4 if |compress| is set and doing so saves
+  // enough to be worth decompressing.
+  explicit ArchiveWriter(bool compress) : compress_(compress) {}
+
+  // Adds the contents of |file_path| as |path|, which is what the archive is
+  // searched with.
+  void AddFile(std::string_view path, std::string file_path);
+
+  // Writes the archive to |path|. Returns false, after logging, if a file
+  // couldn't be read, a path was added twice, or the archive couldn't be
+  // written.
+  bool Write(const std::string& path, ArchiveWriterStats* stats = nullptr);
+
+ private:
+  struct Source
+  {
+    std::string path_;
+    std::string file_path_;
+  };
+
+  const bool compress_;
+  std::vector<Source> sources_;
+};
+
+}  // namespace motor::assets
+
+#endif
@@ -0,0 +1,453 @@
+#include "motor/assets/asset_streamer.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/assets/file_reader.h"
+#include "motor/profiler/profiler.h"
+
+namespace motor::assets
+{
+namespace
+{
+// Returns true if this dropped the last reference.
+bool Unref(internal::Asset* asset)
+{
+  return asset->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+// Takes a reference unless the asset is already being destroyed.
+bool TryRef(internal::Asset* asset)
+{
+  uint32_t refs = asset->refs_.load(std::memory_order_relaxed);
+  while (refs != 0)
+  {
+    if (asset->refs_.compare_exchange_weak(refs, refs + 1,
+                                           std::memory_order_relaxed))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+AssetHandle::AssetHandle(const AssetHandle& other) : asset_(other.asset_)
+{
+  if (asset_ != nullptr) asset_->refs_.fetch_add(1, std::memory_order_relaxed);
+}
+
+AssetHandle& AssetHandle::operator=(const AssetHandle& other)
+{
+  AssetHandle copy(other);
+  std::swap(asset_, copy.asset_);
+  return *this;
+}
+
+AssetHandle& AssetHandle::operator=(AssetHandle&& other) noexcept
+{
+  AssetHandle moved(std::move(other));
+  std::swap(asset_, moved.asset_);
+  return *this;
+}
+
+AssetHandle::~AssetHandle()
+{
+  if (asset_ != nullptr) asset_->streamer_->Release(asset_);
+}
+
+AssetState AssetHandle::State() const
+{
+  return asset_->state_.load(std::memory_order_acquire);
+}
+
+const std::string& AssetHandle::Path() const { return asset_->path_; }
+
+uint64_t AssetHandle::Id() const { return asset_->id_; }
+
+ByteSpan AssetHandle::Data() const
+{
+  DCHECK(State() == AssetState::kLoaded) << asset_->path_ << " isn't loaded";
+  return asset_->view_;
+}
+
+uint32_t AssetHandle::UseCount() const
+{
+  return asset_->refs_.load(std::memory_order_relaxed);
+}
+
+AssetStreamer::AssetStreamer(StreamerOptions opts) : opts_(std::move(opts))
+{
+  CHECK(opts_.num_io_threads_ > 0) << "Need at least one I/O thread";
+  for (size_t i = 0; i < opts_.num_io_threads_; ++i)
+  {
+    io_threads_.emplace_back(&AssetStreamer::IoThreadMain, this);
+  }
+}
+
+AssetStreamer::~AssetStreamer()
+{
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& thread : io_threads_) thread.join();
+
+  std::lock_guard<std::mutex> lock(mu_);
+  std::vector<internal::Asset*> owned = std::move(completed_);
+  for (std::deque<internal::Asset*>& queue : queues_)
+  {
+    owned.insert(owned.end(), queue.begin(), queue.end());
+  }
+  for (internal::Asset* asset : owned)
+  {
+    if (Unref(asset))
+    {
+      assets_.erase(asset->path_);
+      delete asset;
+    }
+  }
+  LOG_IF(WARNING, !assets_.empty())
+      << assets_.size() << " assets still referenced";
+}
+
+AssetHandle AssetStreamer::Load(std::string_view path, AssetPriority priority,
+                                LoadCallback on_loaded)
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  internal::Asset*& slot = assets_[std::string(path)];
+  // An asset losing its last reference stays in the map until it is
+  // destroyed, such an asset is replaced rather than revived.
+  if (slot != nullptr && TryRef(slot))
+  {
+    internal::Asset* asset = slot;
+    const AssetState state = asset->state_.load(std::memory_order_acquire);
+    if (state == AssetState::kQueued && priority < asset->priority_)
+    {
+      Enqueue(asset, priority);
+    }
+    if (on_loaded != nullptr)
+    {
+      asset->callbacks_.push_back(std::move(on_loaded));
+      if (state == AssetState::kLoaded || state == AssetState::kFailed)
+      {
+        asset->refs_.fetch_add(1, std::memory_order_relaxed);
+        completed_.push_back(asset);
+      }
+    }
+    return AssetHandle(asset);
+  }
+
+  internal::Asset* asset = new internal::Asset();
+  asset->streamer_ = this;
+  asset->path_ = std::string(path);
+  asset->id_ = next_id_++;
+  asset->refs_ = 1;
+  if (on_loaded != nullptr) asset->callbacks_.push_back(std::move(on_loaded));
+  slot = asset;
+  Enqueue(asset, priority);
+  return AssetHandle(asset);
+}
+
+void AssetStreamer::SetPriority(const AssetHandle& handle,
+                                AssetPriority priority)
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  internal::Asset* asset = handle.asset_;
+  if (asset->state_.load(std::memory_order_relaxed) != AssetState::kQueued ||
+      asset->priority_ == priority)
+  {
+    return;
+  }
+  Enqueue(asset, priority);
+}
+
+void AssetStreamer::Mount(std::unique_ptr<Archive> archive)
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  CHECK(next_id_ == 0) << "Archives must be mounted before loading";
+  VLOG(1) << "Mounted " << archive->Path();
+  archives_.push_back(std::move(archive));
+}
+
+size_t AssetStreamer::DeliverCompletions()
+{
+  std::vector<internal::Asset*> completed;
+  std::vector<std::vector<LoadCallback>> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    completed.swap(completed_);
+    for (internal::Asset* asset : completed)
+    {
+      callbacks.push_back(std::move(asset->callbacks_));
+      asset->callbacks_.clear();
+    }
+  }
+
+  size_t count = 0;
+  for (size_t i = 0; i < completed.size(); ++i)
+  {
+    // Takes over the reference held by completed_.
+    const AssetHandle handle(completed[i]);
+    for (const LoadCallback& callback : callbacks[i])
+    {
+      callback(handle);
+      ++count;
+    }
+  }
+  return count;
+}
+
+StreamerStats AssetStreamer::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  return stats_;
+}
+
+void AssetStreamer::Release(internal::Asset* asset)
+{
+  if (!Unref(asset)) return;
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = assets_.find(asset->path_);
+  if (it != assets_.end() && it->second == asset) assets_.erase(it);
+  delete asset;
+}
+
+void AssetStreamer::Enqueue(internal::Asset* asset, AssetPriority priority)
+{
+  asset->priority_ = priority;
+  asset->refs_.fetch_add(1, std::memory_order_relaxed);
+  queues_[static_cast<size_t>(priority)].push_back(asset);
+  cv_.notify_one();
+}
+
+bool AssetStreamer::NextBatch(size_t max_count,
+                              std::vector<internal::Asset*>* batch)
+{
+  batch->clear();
+  std::vector<internal::Asset*> dropped;
+  {
+    std::unique_lock<std::mutex> lock(mu_);
+    while (batch->empty())
+    {
+      cv_.wait(lock, [this] {
+        if (stopping_) return true;
+        for (const std::deque<internal::Asset*>& queue : queues_)
+        {
+          if (!queue.empty()) return true;
+        }
+        return false;
+      });
+      if (stopping_) break;
+
+      for (size_t priority = 0;
+           priority < kNumPriorities && batch->size() < max_count; ++priority)
+      {
+        std::deque<internal::Asset*>& queue = queues_[priority];
+        while (!queue.empty() && batch->size() < max_count)
+        {
+          internal::Asset* asset = queue.front();
+          queue.pop_front();
+          const bool stale =
+              asset->state_.load(std::memory_order_relaxed) !=
+                  AssetState::kQueued ||
+              static_cast<size_t>(asset->priority_) != priority;
+          // Only the queue references it, nobody wants it anymore.
+          const bool canceled =
+              !stale && asset->refs_.load(std::memory_order_relaxed) == 1;
+          if (stale || canceled)
+          {
+            if (canceled)
+            {
+              ++stats_.canceled_;
+              asset->state_.store(AssetState::kFailed,
+                                  std::memory_order_relaxed);
+              // The queue reference is only dropped once the lock is
+              // released, a Load in between must not revive the canceled
+              // asset but start a fresh one.
+              auto it = assets_.find(asset->path_);
+              if (it != assets_.end() && it->second == asset) assets_.erase(it);
+            }
+            dropped.push_back(asset);
+            continue;
+          }
+          asset->state_.store(AssetState::kLoading, std::memory_order_relaxed);
+          batch->push_back(asset);
+        }
+      }
+    }
+  }
+  // Might drop the last references, which takes the lock again.
+  for (internal::Asset* asset : dropped) Release(asset);
+  return !batch->empty();
+}
+
+void AssetStreamer::IoThreadMain()
+{
+  profiler::Profiler::Get().SetThreadName("AssetIO");
+  const std::unique_ptr<FileReader> reader =
+      CreateFileReader(opts_.queue_depth_, opts_.use_io_uring_);
+  VLOG(1) << "Asset I/O thread reading with " << reader->Name();
+
+  std::vector<internal::Asset*> batch;
+  std::vector<int> fds;
+  std::vector<ReadRequest> requests;
+  // Index into batch of each request.
+  std::vector<size_t> request_assets;
+  std::vector<int64_t> results;
+  while (NextBatch(opts_.queue_depth_, &batch))
+  {
+    MOTOR_PROFILE_SCOPE("AssetStreamer::LoadBatch");
+    fds.assign(batch.size(), -1);
+    requests.clear();
+    request_assets.clear();
+    std::vector<bool> loaded(batch.size(), false);
+    uint64_t bytes_read = 0;
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+      internal::Asset* asset = batch[i];
+      bool archive_loaded = false;
+      if (LoadFromArchive(asset, &archive_loaded, &bytes_read))
+      {
+        loaded[i] = archive_loaded;
+        continue;
+      }
+      const int fd = open(Resolve(asset->path_).c_str(), O_RDONLY | O_CLOEXEC);
+      struct stat st;
+      if (fd < 0 || fstat(fd, &st) != 0)
+      {
+        PLOG(WARNING) << "Couldn't open " << asset->path_;
+        if (fd >= 0) close(fd);
+        continue;
+      }
+      fds[i] = fd;
+      asset->data_.resize(st.st_size);
+      ReadRequest request;
+      request.fd_ = fd;
+      request.dst_ = asset->data_.data();
+      request.size_ = asset->data_.size();
+      requests.push_back(request);
+      request_assets.push_back(i);
+    }
+    results.resize(requests.size());
+    reader->Read(requests.data(), requests.size(), results.data());
+
+    for (size_t r = 0; r < requests.size(); ++r)
+    {
+      internal::Asset* asset = batch[request_assets[r]];
+      if (results[r] < 0)
+      {
+        LOG(WARNING) << "Couldn't read " << asset->path_ << ": "
+                     << std::strerror(-results[r]);
+        continue;
+      }
+      bytes_read += results[r];
+      if (static_cast<size_t>(results[r]) != requests[r].size_)
+      {
+        LOG(WARNING) << asset->path_ << " changed while being read";
+        continue;
+      }
+      loaded[request_assets[r]] =
+          opts_.decoder_ == nullptr || opts_.decoder_(asset->path_,
+                                                      &asset->data_);
+    }
+    for (int fd : fds)
+    {
+      if (fd >= 0) close(fd);
+    }
+
+    std::vector<internal::Asset*> dropped;
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      stats_.bytes_read_ += bytes_read;
+      for (size_t i = 0; i < batch.size(); ++i)
+      {
+        internal::Asset* asset = batch[i];
+        if (loaded[i])
+        {
+          ++stats_.loaded_;
+          if (asset->view_.data_ == nullptr)
+          {
+            asset->view_.data_ = asset->data_.data();
+            asset->view_.size_ = asset->data_.size();
+          }
+        }
+        else
+        {
+          ++stats_.failed_;
+          asset->data_ = std::vector<std::byte>();
+          asset->view_ = ByteSpan();
+        }
+        asset->state_.store(
+            loaded[i] ? AssetState::kLoaded : AssetState::kFailed,
+            std::memory_order_release);
+        // Hands the queue's reference over to completed_.
+        if (!asset->callbacks_.empty())
+        {
+          completed_.push_back(asset);
+        }
+        else
+        {
+          dropped.push_back(asset);
+        }
+      }
+    }
+    for (internal::Asset* asset : dropped) Release(asset);
+  }
+}
+
+bool AssetStreamer::LoadFromArchive(internal::Asset* asset, bool* loaded,
+                                    uint64_t* bytes_read) const
+{
+  for (auto it = archives_.rbegin(); it != archives_.rend(); ++it)
+  {
+    const Archive& archive = **it;
+    const ArchiveEntry* entry = archive.Find(asset->path_);
+    if (entry == nullptr) continue;
+    *bytes_read += entry->stored_size_;
+    const ByteSpan view = archive.View(*entry);
+    if (opts_.decoder_ == nullptr && !view.empty())
+    {
+      // Handed out as mapped, reading ahead keeps the I/O on this thread
+      // rather than faulting on the first access from the main thread.
+      archive.Prefetch(*entry);
+      asset->view_ = view;
+      *loaded = true;
+      return true;
+    }
+    *loaded = archive.Read(*entry, &asset->data_) &&
+              (opts_.decoder_ == nullptr ||
+               opts_.decoder_(asset->path_, &asset->data_));
+    return true;
+  }
+  return false;
+}
+
+std::string AssetStreamer::Resolve(std::string_view path) const
+{
+  if (opts_.root_.empty() || (!path.empty() && path.front() == '/'))
+  {
+    return std::string(path);
+  }
+  std::string result = opts_.root_;
+  result += '/';
+  result += path;
+  return result;
+}
+
+}  // namespace motor::assets
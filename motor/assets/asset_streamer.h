@@ -0,0 +1,203 @@
+#ifndef _MOTOR_ASSETS_ASSET_STREAMER_H_
+#define _MOTOR_ASSETS_ASSET_STREAMER_H_
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "motor/assets/archive.h"
+
+namespace motor::assets
+{
+// Queued assets are loaded in this order, e.g. whatever is on screen first.
+enum class AssetPriority : uint8_t
+{
+  kVisible = 0,
+  kNearby,
+  kBackground,
+};
+constexpr size_t kNumPriorities = 3;
+
+enum class AssetState : uint8_t
+{
+  kQueued,
+  kLoading,
+  kLoaded,
+  kFailed,
+};
+
+class AssetStreamer;
+
+namespace internal
+{
+struct Asset;
+}  // namespace internal
+
+// Reference counted handle to an asset, the asset is unloaded, or its load is
+// canceled, once the last handle is gone. Copies are cheap and thread safe.
+class AssetHandle
+{
+ public:
+  AssetHandle() = default;
+  AssetHandle(const AssetHandle& other);
+  AssetHandle& operator=(const AssetHandle& other);
+  AssetHandle(AssetHandle&& other) noexcept : asset_(other.asset_)
+  {
+    other.asset_ = nullptr;
+  }
+  AssetHandle& operator=(AssetHandle&& other) noexcept;
+  ~AssetHandle();
+
+  bool IsValid() const { return asset_ != nullptr; }
+  AssetState State() const;
+  const std::string& Path() const;
+  // Unique among the assets alive at the same time.
+  uint64_t Id() const;
+  // Decoded contents, only valid once the state is kLoaded. Points into the
+  // mapped archive for assets stored uncompressed in one.
+  ByteSpan Data() const;
+  // Number of handles to the asset, including this one.
+  uint32_t UseCount() const;
+
+ private:
+  friend class AssetStreamer;
+  // Takes over a reference that is already accounted for.
+  explicit AssetHandle(internal::Asset* asset) : asset_(asset) {}
+
+  internal::Asset* asset_ = nullptr;
+};
+
+struct StreamerOptions
+{
+  // Relative paths are resolved against this directory.
+  std::string root_;
+  size_t num_io_threads_ = 2;
+  // Reads each I/O thread keeps in flight, also the maximum number of assets
+  // it picks up at once.
+  unsigned queue_depth_ = 32;
+  // Falls back to pread if io_uring isn't available.
+  bool use_io_uring_ = true;
+  // Turns file contents into the data handed out by AssetHandle::Data, e.g.
+  // by decompressing them. Runs on the I/O threads, returning false fails the
+  // load. Data is handed out as is when null, which allows handing out
+  // contents of archives without copying them.
+  std::function<bool(std::string_view path, std::vector<std::byte>* data)>
+      decoder_;
+};
+
+struct StreamerStats
+{
+  uint64_t loaded_ = 0;
+  uint64_t failed_ = 0;
+  // Loads whose last handle was released while they were still queued.
+  uint64_t canceled_ = 0;
+  uint64_t bytes_read_ = 0;
+};
+
+// Loads files on a small pool of I/O threads, each batching reads of many
+// assets through a FileReader. Requests are served by priority, then in the
+// order they were made. Completion callbacks are only run from
+// DeliverCompletions, which the engine calls once per frame on the main
+// thread, so that they never race with the simulation.
+//
+// Thread safe, except for DeliverCompletions.
+class AssetStreamer
+{
+ public:
+  // Receives a handle to the asset, which is either loaded or failed.
+  using LoadCallback = std::function<void(const AssetHandle& asset)>;
+
+  explicit AssetStreamer(StreamerOptions opts);
+  AssetStreamer(const AssetStreamer&) = delete;
+  AssetStreamer& operator=(const AssetStreamer&) = delete;
+  // All handles must be released before destruction. Pending callbacks are
+  // dropped.
+  ~AssetStreamer();
+
+  // Returns the already known asset for |path| if there is one, raising its
+  // priority if needed. |on_loaded| is run by the next DeliverCompletions
+  // after the load finishes, even if it already has. Loads are canceled and
+  // their callbacks dropped if all handles are released while still queued.
+  AssetHandle Load(std::string_view path, AssetPriority priority,
+                   LoadCallback on_loaded = nullptr);
+  // Moves a queued asset to another priority, e.g. once it becomes visible.
+  void SetPriority(const AssetHandle& asset, AssetPriority priority);
+  // Serves the assets in |archive| from it rather than from loose files,
+  // archives mounted later take precedence. Must be called before the first
+  // Load.
+  void Mount(std::unique_ptr<Archive> archive);
+
+  // Runs callbacks of loads finished since the previous call, returns the
+  // number of callbacks run.
+  size_t DeliverCompletions();
+
+  StreamerStats GetStats() const;
+
+ private:
+  friend class AssetHandle;
+
+  void Release(internal::Asset* asset);
+  // Must be called with mu_ held, takes a reference for the queue.
+  void Enqueue(internal::Asset* asset, AssetPriority priority);
+  void IoThreadMain();
+  // Returns false if none of the archives has |asset|, otherwise whether it
+  // loaded in |loaded|.
+  bool LoadFromArchive(internal::Asset* asset, bool* loaded,
+                       uint64_t* bytes_read) const;
+  // Pops up to |max_count| queued assets into |batch|, blocking until there is
+  // at least one. Returns false when stopping.
+  bool NextBatch(size_t max_count, std::vector<internal::Asset*>* batch);
+  std::string Resolve(std::string_view path) const;
+
+  const StreamerOptions opts_;
+  // Only changes before the first load, hence read without the lock.
+  std::vector<std::unique_ptr<Archive>> archives_;
+
+  mutable std::mutex mu_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+  std::unordered_map<std::string, internal::Asset*> assets_;
+  uint64_t next_id_ = 0;
+  // Every entry holds a reference. Entries of assets that changed priority or
+  // were picked up through another queue are skipped.
+  std::array<std::deque<internal::Asset*>, kNumPriorities> queues_;
+  // Finished loads that have callbacks to run, each holds a reference.
+  std::vector<internal::Asset*> completed_;
+  StreamerStats stats_;
+
+  std::vector<std::thread> io_threads_;
+};
+
+namespace internal
+{
+struct Asset
+{
+  AssetStreamer* streamer_ = nullptr;
+  std::string path_;
+  uint64_t id_ = 0;
+  std::atomic<uint32_t> refs_ = 0;
+  std::atomic<AssetState> state_ = AssetState::kQueued;
+  // Guarded by the streamer's mutex.
+  AssetPriority priority_ = AssetPriority::kBackground;
+  std::vector<AssetStreamer::LoadCallback> callbacks_;
+  // Written by the I/O thread before state_ becomes kLoaded. view_ points
+  // either into data_ or into an archive.
+  std::vector<std::byte> data_;
+  ByteSpan view_;
+};
+}  // namespace internal
+
+}  // namespace motor::assets
+
+#endif
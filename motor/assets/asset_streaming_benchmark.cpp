@@ -0,0 +1,189 @@
+// Streams a few thousand files through the AssetStreamer, once with pread and
+// once with io_uring, while a fake main loop requests them and delivers the
+// completions. Prints read throughput, time spent on the main thread and
+// load latency by priority.
+//   bazel run -c opt //motor/assets:asset_streaming_benchmark -- [dir]
+//
+// Without a directory, files are generated into a temporary one. Page cache
+// of the files is dropped before each run, which only works for files that
+// aren't dirty, hence the first run over freshly generated files might read
+// from the cache.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "motor/assets/asset_streamer.h"
+
+namespace motor::assets
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kNumGeneratedFiles = 4000;
+constexpr size_t kMinFileBytes = 4 << 10;
+constexpr size_t kMaxFileBytes = 256 << 10;
+// Loads requested by the main loop per frame.
+constexpr size_t kRequestsPerFrame = 256;
+// Stands in for the rest of the frame.
+constexpr std::chrono::microseconds kFrameWork(1000);
+
+std::vector<std::string> GenerateFiles(const std::string& dir)
+{
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<size_t> size_dist(kMinFileBytes,
+                                                  kMaxFileBytes);
+  std::vector<char> contents(kMaxFileBytes);
+  for (char& c : contents) c = static_cast<char>(rng());
+  std::vector<std::string> names;
+  for (size_t i = 0; i < kNumGeneratedFiles; ++i)
+  {
+    names.push_back("asset_" + std::to_string(i));
+    FILE* file = std::fopen((dir + '/' + names.back()).c_str(), "wb");
+    std::fwrite(contents.data(), 1, size_dist(rng), file);
+    std::fclose(file);
+  }
+  // Written back so that the page cache can be dropped.
+  sync();
+  return names;
+}
+
+std::vector<std::string> ListFiles(const std::string& dir)
+{
+  std::vector<std::string> names;
+  DIR* d = opendir(dir.c_str());
+  if (d == nullptr) return names;
+  while (const dirent* entry = readdir(d))
+  {
+    if (entry->d_type == DT_REG) names.push_back(entry->d_name);
+  }
+  closedir(d);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+void DropPageCache(const std::string& dir,
+                   const std::vector<std::string>& names)
+{
+  for (const std::string& name : names)
+  {
+    const int fd = open((dir + '/' + name).c_str(), O_RDONLY);
+    if (fd < 0) continue;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+double Micros(Clock::duration duration)
+{
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+void RunOne(const std::string& dir, const std::vector<std::string>& names,
+            bool use_io_uring)
+{
+  DropPageCache(dir, names);
+  StreamerOptions opts;
+  opts.root_ = dir;
+  opts.use_io_uring_ = use_io_uring;
+  AssetStreamer streamer(opts);
+
+  std::vector<AssetHandle> handles;
+  handles.reserve(names.size());
+  size_t num_done = 0;
+  // Load latency per priority, in the order of AssetPriority.
+  double latency_us[kNumPriorities] = {};
+  size_t latency_count[kNumPriorities] = {};
+  Clock::duration main_thread(0);
+  Clock::duration max_frame_stall(0);
+  size_t frames = 0;
+
+  const Clock::time_point start = Clock::now();
+  while (num_done < names.size())
+  {
+    const Clock::time_point frame_start = Clock::now();
+    for (size_t i = 0; i < kRequestsPerFrame && handles.size() < names.size();
+         ++i)
+    {
+      const size_t idx = handles.size();
+      // A few of the assets in each batch are on screen.
+      const AssetPriority priority =
+          idx % 8 == 0 ? AssetPriority::kVisible : AssetPriority::kBackground;
+      const Clock::time_point requested = Clock::now();
+      handles.push_back(streamer.Load(
+          names[idx], priority,
+          [&, priority, requested](const AssetHandle& /*asset*/) {
+            const size_t p = static_cast<size_t>(priority);
+            latency_us[p] += Micros(Clock::now() - requested);
+            ++latency_count[p];
+            ++num_done;
+          }));
+    }
+    streamer.DeliverCompletions();
+    const Clock::duration stall = Clock::now() - frame_start;
+    main_thread += stall;
+    max_frame_stall = std::max(max_frame_stall, stall);
+    ++frames;
+    std::this_thread::sleep_for(kFrameWork);
+  }
+  const double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  const StreamerStats stats = streamer.GetStats();
+  std::printf(
+      "%-9s %8.1f MB/s %8.0f files/s  main thread %7.1f us/frame, max %7.1f "
+      "us  latency visible %7.0f us background %7.0f us  failed %llu\n",
+      use_io_uring ? "io_uring" : "pread", stats.bytes_read_ / seconds / 1e6,
+      stats.loaded_ / seconds, Micros(main_thread) / frames,
+      Micros(max_frame_stall),
+      latency_us[0] / std::max<size_t>(1, latency_count[0]),
+      latency_us[2] / std::max<size_t>(1, latency_count[2]),
+      static_cast<unsigned long long>(stats.failed_));
+  handles.clear();
+}
+
+void Run(int argc, char** argv)
+{
+  std::string dir;
+  std::vector<std::string> names;
+  bool generated = false;
+  if (argc > 1)
+  {
+    dir = argv[1];
+    names = ListFiles(dir);
+  }
+  else
+  {
+    char tmpl[] = "/tmp/motor_assets_XXXXXX";
+    dir = mkdtemp(tmpl);
+    names = GenerateFiles(dir);
+    generated = true;
+  }
+  std::printf("Streaming %zu files from %s\n", names.size(), dir.c_str());
+  if (!names.empty())
+  {
+    RunOne(dir, names, /*use_io_uring=*/false);
+    RunOne(dir, names, /*use_io_uring=*/true);
+  }
+
+  if (!generated) return;
+  for (const std::string& name : names) unlink((dir + '/' + name).c_str());
+  rmdir(dir.c_str());
+}
+
+}  // namespace
+}  // namespace motor::assets
+
+int main(int argc, char** argv) { motor::assets::Run(argc, argv); }
@@ -0,0 +1,294 @@
+#include "motor/assets/file_reader.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace motor::assets
+{
+namespace
+{
+class PreadReader : public FileReader
+{
+ public:
+  void Read(const ReadRequest* requests, size_t count,
+            int64_t* results) override
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      const ReadRequest& request = requests[i];
+      char* dst = static_cast<char*>(request.dst_);
+      size_t done = 0;
+      results[i] = 0;
+      while (done < request.size_)
+      {
+        const ssize_t res = pread(request.fd_, dst + done,
+                                  request.size_ - done, request.offset_ + done);
+        if (res < 0 && errno == EINTR) continue;
+        if (res < 0)
+        {
+          results[i] = -errno;
+          break;
+        }
+        // End of file.
+        if (res == 0) break;
+        done += res;
+        results[i] = done;
+      }
+    }
+  }
+
+  std::string_view Name() const override { return "pread"; }
+};
+
+// Talks to the kernel through the raw syscalls and the shared rings, see
+// io_uring(7). Each read is a single IORING_OP_READV, short reads are
+// resubmitted for the remainder.
+class IoUringReader : public FileReader
+{
+ public:
+  // Returns nullptr if io_uring isn't available, e.g. on old kernels or when
+  // blocked by seccomp.
+  static std::unique_ptr<IoUringReader> Create(unsigned queue_depth)
+  {
+    std::unique_ptr<IoUringReader> reader(new IoUringReader());
+    if (!reader->Setup(queue_depth)) return nullptr;
+    return reader;
+  }
+
+  ~IoUringReader() final
+  {
+    if (sqes_ != nullptr) munmap(sqes_, sqes_size_);
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_)
+    {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != nullptr) munmap(sq_ring_, sq_ring_size_);
+    if (ring_fd_ >= 0) close(ring_fd_);
+  }
+
+  void Read(const ReadRequest* requests, size_t count,
+            int64_t* results) override
+  {
+    std::fill(results, results + count, 0);
+    // Requests that still have bytes to read, in reverse order of submission.
+    pending_.clear();
+    for (size_t i = count; i > 0; --i) pending_.push_back(i - 1);
+    size_t in_flight = 0;
+    while (!pending_.empty() || in_flight > 0)
+    {
+      while (!pending_.empty() && !free_slots_.empty())
+      {
+        const size_t idx = pending_.back();
+        pending_.pop_back();
+        const size_t slot = free_slots_.back();
+        free_slots_.pop_back();
+        Prepare(requests[idx], results[idx], idx, slot);
+        ++in_flight;
+      }
+
+      const int res = Enter(/*min_complete=*/1);
+      if (res < 0 && res != -EINTR && res != -EAGAIN && res != -EBUSY)
+      {
+        LOG(FATAL) << "io_uring_enter failed: " << std::strerror(-res);
+      }
+      in_flight -= Reap(requests, results);
+    }
+  }
+
+  std::string_view Name() const override { return "io_uring"; }
+
+ private:
+  IoUringReader() = default;
+
+  bool Setup(unsigned queue_depth)
+  {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring_fd_ = syscall(__NR_io_uring_setup, queue_depth, &params);
+    if (ring_fd_ < 0)
+    {
+      LOG(INFO) << "io_uring unavailable: " << std::strerror(errno);
+      return false;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    // Both rings live in a single mapping on newer kernels.
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+    {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = Map(sq_ring_size_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == nullptr) return false;
+    cq_ring_ =
+        single_mmap ? sq_ring_ : Map(cq_ring_size_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == nullptr) return false;
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(Map(sqes_size_, IORING_OFF_SQES));
+    if (sqes_ == nullptr) return false;
+
+    char* sq = static_cast<char*>(sq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // Never more reads in flight than completion entries.
+    const unsigned num_slots = std::min(params.sq_entries, params.cq_entries);
+    slots_.resize(num_slots);
+    for (unsigned slot = 0; slot < num_slots; ++slot)
+    {
+      free_slots_.push_back(slot);
+    }
+    return true;
+  }
+
+  void* Map(size_t size, off_t offset)
+  {
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+    if (ptr == MAP_FAILED)
+    {
+      LOG(INFO) << "Couldn't map io_uring: " << std::strerror(errno);
+      return nullptr;
+    }
+    return ptr;
+  }
+
+  // Queues a read for the part of |request| that hasn't been read yet.
+  void Prepare(const ReadRequest& request, int64_t done, size_t idx,
+               size_t slot)
+  {
+    Slot& s = slots_[slot];
+    s.request_ = idx;
+    s.iov_.iov_base = static_cast<char*>(request.dst_) + done;
+    s.iov_.iov_len = request.size_ - done;
+
+    // Only this thread writes the tail.
+    const unsigned tail = *sq_tail_;
+    const unsigned sqe_idx = tail & sq_mask_;
+    io_uring_sqe& sqe = sqes_[sqe_idx];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = request.fd_;
+    sqe.off = request.offset_ + done;
+    sqe.addr = reinterpret_cast<uint64_t>(&s.iov_);
+    sqe.len = 1;
+    sqe.user_data = slot;
+    sq_array_[sqe_idx] = sqe_idx;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++unsubmitted_;
+  }
+
+  // Submits the queued reads and waits for |min_complete| completions.
+  // Returns -errno on failure.
+  int Enter(unsigned min_complete)
+  {
+    const int res = syscall(__NR_io_uring_enter, ring_fd_, unsubmitted_,
+                            min_complete, IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (res < 0) return -errno;
+    unsubmitted_ -= res;
+    return res;
+  }
+
+  // Returns the number of slots freed up. Reads that came back short are put
+  // back into pending_.
+  size_t Reap(const ReadRequest* requests, int64_t* results)
+  {
+    size_t freed = 0;
+    unsigned head = *cq_head_;
+    while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+    {
+      const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+      const size_t slot = cqe.user_data;
+      const size_t idx = slots_[slot].request_;
+      if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+      {
+        pending_.push_back(idx);
+      }
+      else if (cqe.res < 0)
+      {
+        results[idx] = cqe.res;
+      }
+      else if (cqe.res > 0)
+      {
+        results[idx] += cqe.res;
+        if (static_cast<size_t>(results[idx]) < requests[idx].size_)
+        {
+          pending_.push_back(idx);
+        }
+      }
+      // Zero means end of file, the read is done.
+      free_slots_.push_back(slot);
+      ++freed;
+      ++head;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return freed;
+  }
+
+  // A read in flight.
+  struct Slot
+  {
+    size_t request_ = 0;
+    // Has to stay alive until the read completes.
+    iovec iov_;
+  };
+
+  int ring_fd_ = -1;
+  void* sq_ring_ = nullptr;
+  void* cq_ring_ = nullptr;
+  size_t sq_ring_size_ = 0;
+  size_t cq_ring_size_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+  unsigned* sq_tail_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  // Prepared but not yet handed to the kernel.
+  unsigned unsubmitted_ = 0;
+
+  std::vector<Slot> slots_;
+  std::vector<size_t> free_slots_;
+  std::vector<size_t> pending_;
+};
+
+}  // namespace
+
+std::unique_ptr<FileReader> CreateFileReader(unsigned queue_depth,
+                                             bool use_io_uring)
+{
+  if (use_io_uring)
+  {
+    std::unique_ptr<FileReader> reader = IoUringReader::Create(queue_depth);
+    if (reader != nullptr) return reader;
+    LOG(INFO) << "Falling back to pread";
+  }
+  return std::make_unique<PreadReader>();
+}
+
+}  // namespace motor::assets
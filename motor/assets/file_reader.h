@@ -0,0 +1,43 @@
+#ifndef _MOTOR_ASSETS_FILE_READER_H_
+#define _MOTOR_ASSETS_FILE_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace motor::assets
+{
+struct ReadRequest
+{
+  int fd_ = -1;
+  uint64_t offset_ = 0;
+  void* dst_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Reads batches of file ranges. Implementations keep as many reads in flight
+// as they can, a single instance must only be used by one thread at a time.
+class FileReader
+{
+ public:
+  virtual ~FileReader() = default;
+
+  // Reads all of |requests| and sets results[i] to the number of bytes read
+  // for requests[i], which is less than size_ only at the end of the file, or
+  // to -errno on failure.
+  virtual void Read(const ReadRequest* requests, size_t count,
+                    int64_t* results) = 0;
+
+  virtual std::string_view Name() const = 0;
+};
+
+// Returns an io_uring based reader keeping up to |queue_depth| reads in flight
+// if |use_io_uring| is set and the kernel allows it, otherwise one issuing
+// blocking preads.
+std::unique_ptr<FileReader> CreateFileReader(unsigned queue_depth,
+                                             bool use_io_uring);
+
+}  // namespace motor::assets
+
+#endif
@@ -0,0 +1,165 @@
+#include "motor/assets/lz4.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace motor::assets
+{
+namespace
+{
+constexpr size_t kMinMatch = 4;
+// Format requires the last 5 bytes to be literals and the last match to start
+// at least 12 bytes before the end.
+constexpr size_t kLastLiterals = 5;
+constexpr size_t kMatchLimit = 12;
+constexpr size_t kMaxOffset = 65535;
+constexpr int kHashBits = 12;
+
+uint32_t Load32(const std::byte* ptr)
+{
+  uint32_t value;
+  std::memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+uint32_t Hash(uint32_t value)
+{
+  return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+// Writes the 255 byte continuation of a length whose first 4 bits are in the
+// token.
+void PutLength(size_t length, std::vector<std::byte>* dst)
+{
+  for (; length >= 255; length -= 255) dst->push_back(std::byte{255});
+  dst->push_back(static_cast<std::byte>(length));
+}
+
+void PutSequence(const std::byte* literals, size_t num_literals,
+                 size_t offset, size_t match_length,
+                 std::vector<std::byte>* dst)
+{
+  const size_t literal_token = num_literals < 15 ? num_literals : 15;
+  // No match in the last sequence.
+  const size_t match_token =
+      match_length == 0
+          ? 0
+          : (match_length - kMinMatch < 15 ? match_length - kMinMatch : 15);
+  dst->push_back(static_cast<std::byte>(literal_token << 4 | match_token));
+  if (literal_token == 15) PutLength(num_literals - 15, dst);
+  dst->insert(dst->end(), literals, literals + num_literals);
+  if (match_length == 0) return;
+  dst->push_back(static_cast<std::byte>(offset & 0xff));
+  dst->push_back(static_cast<std::byte>(offset >> 8));
+  if (match_token == 15) PutLength(match_length - kMinMatch - 15, dst);
+}
+
+// Reads a length continuation, returns false if it runs past |end|.
+bool GetLength(const std::byte** src, const std::byte* end, size_t* length)
+{
+  while (true)
+  {
+    if (*src == end) return false;
+    const uint8_t byte = static_cast<uint8_t>(*(*src)++);
+    *length += byte;
+    if (byte != 255) return true;
+  }
+}
+}  // namespace
+
+void Lz4Compress(const std::byte* src, size_t size,
+                 std::vector<std::byte>* dst)
+{
+  // Positions of the last occurrence of each hashed 4 byte sequence.
+  std::vector<uint32_t> table(size_t{1} << kHashBits, 0);
+  size_t anchor = 0;
+  size_t pos = 0;
+  if (size > kMatchLimit)
+  {
+    const size_t match_limit = size - kMatchLimit;
+    const size_t match_end_limit = size - kLastLiterals;
+    // Position 0 is never a candidate, so a zero entry means none.
+    pos = 1;
+    while (pos < match_limit)
+    {
+      const uint32_t sequence = Load32(src + pos);
+      uint32_t& entry = table[Hash(sequence)];
+      const size_t candidate = entry;
+      entry = static_cast<uint32_t>(pos);
+      if (candidate == 0 || pos - candidate > kMaxOffset ||
+          Load32(src + candidate) != sequence)
+      {
+        ++pos;
+        continue;
+      }
+      size_t length = kMinMatch;
+      while (pos + length < match_end_limit &&
+             src[candidate + length] == src[pos + length])
+      {
+        ++length;
+      }
+      PutSequence(src + anchor, pos - anchor, pos - candidate, length, dst);
+      pos += length;
+      anchor = pos;
+    }
+  }
+  PutSequence(src + anchor, size - anchor, /*offset=*/0, /*match_length=*/0,
+              dst);
+}
+
+bool Lz4Decompress(const std::byte* src, size_t src_size, std::byte* dst,
+                   size_t dst_size)
+{
+  const std::byte* src_end = src + src_size;
+  size_t out = 0;
+  while (src != src_end)
+  {
+    const uint8_t token = static_cast<uint8_t>(*src++);
+    size_t num_literals = token >> 4;
+    if (num_literals == 15 && !GetLength(&src, src_end, &num_literals))
+    {
+      return false;
+    }
+    if (num_literals > static_cast<size_t>(src_end - src) ||
+        num_literals > dst_size - out)
+    {
+      return false;
+    }
+    // Empty outputs may come without a buffer.
+    if (num_literals != 0) std::memcpy(dst + out, src, num_literals);
+    src += num_literals;
+    out += num_literals;
+    // Last sequence has no match.
+    if (src == src_end) break;
+
+    if (src_end - src < 2) return false;
+    const size_t offset = static_cast<size_t>(src[0]) |
+                          static_cast<size_t>(src[1]) << 8;
+    src += 2;
+    size_t length = token & 0xf;
+    if (length == 15 && !GetLength(&src, src_end, &length)) return false;
+    length += kMinMatch;
+    if (offset == 0 || offset > out || length > dst_size - out) return false;
+    // Matches may overlap their own output, e.g. runs, hence copied in steps
+    // of at most |offset| bytes, each of which is already written.
+    const std::byte* match = dst + out - offset;
+    if (offset == 1)
+    {
+      std::memset(dst + out, static_cast<int>(*match), length);
+    }
+    else
+    {
+      for (size_t i = 0; i < length; i += offset)
+      {
+        std::memcpy(dst + out + i, match + i, std::min(offset, length - i));
+      }
+    }
+    out += length;
+  }
+  return out == dst_size;
+}
+
+}  // namespace motor::assets
@@ -0,0 +1,23 @@
+#ifndef _MOTOR_ASSETS_LZ4_H_
+#define _MOTOR_ASSETS_LZ4_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace motor::assets
+{
+// Compresses |size| bytes from |src| in the LZ4 block format, without any
+// framing, and appends them to |dst|. Favors speed over ratio, like the
+// default LZ4 level.
+void Lz4Compress(const std::byte* src, size_t size,
+                 std::vector<std::byte>* dst);
+
+// Decompresses an LZ4 block into exactly |dst_size| bytes. Returns false if
+// the block is malformed or doesn't decompress to |dst_size| bytes, never
+// reads or writes out of bounds.
+bool Lz4Decompress(const std::byte* src, size_t src_size, std::byte* dst,
+                   size_t dst_size);
+
+}  // namespace motor::assets
+
+#endif
@@ -0,0 +1,153 @@
+#include "motor/ecs/archetype.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include "motor/ecs/component.h"
+#include "motor/ecs/entity.h"
+
+namespace motor::ecs
+{
+namespace
+{
+constexpr size_t kMinCapacity = 16;
+
+std::byte* AllocateColumn(const ComponentInfo& info, size_t capacity)
+{
+  return static_cast<std::byte*>(::operator new(
+      info.size_ * capacity, std::align_val_t(info.alignment_)));
+}
+
+void FreeColumn(const ComponentInfo& info, std::byte* data)
+{
+  ::operator delete(data, std::align_val_t(info.alignment_));
+}
+
+}  // namespace
+
+Archetype::Archetype(ComponentMask mask) : mask_(mask)
+{
+  for (size_t id = 0; id < kMaxComponents; ++id)
+  {
+    if (!Has(id)) continue;
+    column_of_[id] = columns_.size();
+    ColumnData column;
+    column.id_ = id;
+    column.info_ = ComponentRegistry::GetInfo(id);
+    columns_.push_back(column);
+  }
+}
+
+Archetype::~Archetype()
+{
+  for (ColumnData& column : columns_)
+  {
+    if (!column.info_.trivial_)
+    {
+      for (size_t row = 0; row < Size(); ++row)
+      {
+        column.info_.destroy_(column.data_ + row * column.info_.size_);
+      }
+    }
+    if (column.data_ != nullptr) FreeColumn(column.info_, column.data_);
+  }
+}
+
+uint32_t Archetype::AddRow(Entity entity)
+{
+  if (Size() == capacity_) Grow();
+  entities_.push_back(entity);
+  return entities_.size() - 1;
+}
+
+void Archetype::RemoveRow(uint32_t row, Entity* moved)
+{
+  for (ColumnData& column : columns_)
+  {
+    if (column.info_.trivial_) continue;
+    column.info_.destroy_(column.data_ + row * column.info_.size_);
+  }
+  FillHole(row, moved);
+}
+
+uint32_t Archetype::MoveRow(uint32_t row, Archetype* dst, Entity* moved)
+{
+  const uint32_t dst_row = dst->AddRow(entities_[row]);
+  for (ColumnData& column : columns_)
+  {
+    std::byte* src = column.data_ + row * column.info_.size_;
+    if (!dst->Has(column.id_))
+    {
+      if (!column.info_.trivial_) column.info_.destroy_(src);
+    }
+    else if (column.info_.trivial_)
+    {
+      std::memcpy(dst->At(column.id_, dst_row), src, column.info_.size_);
+    }
+    else
+    {
+      column.info_.relocate_(dst->At(column.id_, dst_row), src);
+    }
+  }
+  FillHole(row, moved);
+  return dst_row;
+}
+
+void Archetype::Grow()
+{
+  const size_t capacity = std::max(kMinCapacity, capacity_ * 2);
+  for (ColumnData& column : columns_)
+  {
+    std::byte* data = AllocateColumn(column.info_, capacity);
+    if (column.data_ != nullptr)
+    {
+      const size_t size = column.info_.size_;
+      if (column.info_.trivial_)
+      {
+        std::memcpy(data, column.data_, Size() * size);
+      }
+      else
+      {
+        for (size_t row = 0; row < Size(); ++row)
+        {
+          column.info_.relocate_(data + row * size,
+                                 column.data_ + row * size);
+        }
+      }
+      FreeColumn(column.info_, column.data_);
+    }
+    column.data_ = data;
+  }
+  capacity_ = capacity;
+}
+
+void Archetype::FillHole(uint32_t row, Entity* moved)
+{
+  const uint32_t last = entities_.size() - 1;
+  *moved = Entity();
+  if (row != last)
+  {
+    for (ColumnData& column : columns_)
+    {
+      const size_t size = column.info_.size_;
+      if (column.info_.trivial_)
+      {
+        std::memcpy(column.data_ + row * size, column.data_ + last * size,
+                    size);
+      }
+      else
+      {
+        column.info_.relocate_(column.data_ + row * size,
+                               column.data_ + last * size);
+      }
+    }
+    entities_[row] = entities_[last];
+    *moved = entities_[row];
+  }
+  entities_.pop_back();
+}
+
+}  // namespace motor::ecs
@@ -0,0 +1,94 @@
+#ifndef _MOTOR_ECS_ARCHETYPE_H_
+#define _MOTOR_ECS_ARCHETYPE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "motor/ecs/component.h"
+#include "motor/ecs/entity.h"
+
+namespace motor::ecs
+{
+// Table of all the entities with exactly the same set of components. Each
+// component is stored in its own contiguous column, row i of every column
+// belongs to the i-th entity, so that systems touching a few components only
+// stream through those. Rows are kept dense, removals move the last row into
+// the hole.
+class Archetype
+{
+ public:
+  explicit Archetype(ComponentMask mask);
+  Archetype(const Archetype&) = delete;
+  Archetype& operator=(const Archetype&) = delete;
+  // Destroys components of all the rows.
+  ~Archetype();
+
+  ComponentMask Mask() const { return mask_; }
+  bool Has(size_t component_id) const
+  {
+    return (mask_ >> component_id) & 1;
+  }
+  size_t Size() const { return entities_.size(); }
+  const std::vector<Entity>& Entities() const { return entities_; }
+
+  // Component must be part of the archetype.
+  template <typename T>
+  T* Column()
+  {
+    const size_t id = ComponentRegistry::GetId<T>();
+    return static_cast<T*>(static_cast<void*>(
+        columns_[column_of_[id]].data_));
+  }
+  void* At(size_t component_id, uint32_t row)
+  {
+    const ColumnData& column = columns_[column_of_[component_id]];
+    return column.data_ + row * column.info_.size_;
+  }
+
+  // Appends a row for |entity|, its components are left uninitialized and
+  // must be constructed by the caller.
+  uint32_t AddRow(Entity entity);
+  // Destroys components of |row| and fills it with the last row. |moved| is
+  // set to the entity that now lives in |row|, invalid if there is none.
+  void RemoveRow(uint32_t row, Entity* moved);
+  // Relocates components of |row| that are part of |dst| into a new row of
+  // |dst| and destroys the rest, then fills |row| as RemoveRow does. Returns
+  // the new row, components of |dst| missing in this archetype are left
+  // uninitialized.
+  uint32_t MoveRow(uint32_t row, Archetype* dst, Entity* moved);
+
+  // Cached transitions to the archetypes with one more or one less component,
+  // null until first used.
+  Archetype*& AddEdge(size_t component_id) { return add_edges_[component_id]; }
+  Archetype*& RemoveEdge(size_t component_id)
+  {
+    return remove_edges_[component_id];
+  }
+
+ private:
+  struct ColumnData
+  {
+    size_t id_ = 0;
+    ComponentInfo info_;
+    std::byte* data_ = nullptr;
+  };
+
+  void Grow();
+  // Relocates the last row into |row|, which must not hold live components.
+  void FillHole(uint32_t row, Entity* moved);
+
+  const ComponentMask mask_;
+  std::vector<ColumnData> columns_;
+  // Index into columns_ for every component id of the archetype.
+  std::array<uint8_t, kMaxComponents> column_of_{};
+  std::vector<Entity> entities_;
+  size_t capacity_ = 0;
+  std::array<Archetype*, kMaxComponents> add_edges_{};
+  std::array<Archetype*, kMaxComponents> remove_edges_{};
+};
+
+}  // namespace motor::ecs
+
+#endif
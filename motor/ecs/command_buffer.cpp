@@ -0,0 +1,44 @@
+#include "motor/ecs/command_buffer.h"
+
+#include <cstddef>
+#include <memory>
+
+#include "motor/ecs/world.h"
+
+namespace motor::ecs
+{
+void CommandBuffer::Apply(World* world)
+{
+  for (const Command& command : commands_)
+  {
+    command.apply_(world, command.payload_);
+  }
+  Clear();
+}
+
+void* CommandBuffer::AllocatePayload(size_t size, size_t alignment)
+{
+  offset_ = (offset_ + alignment - 1) & ~(alignment - 1);
+  if (blocks_.empty() || offset_ + size > kBlockBytes)
+  {
+    if (!blocks_.empty()) ++block_;
+    if (block_ == blocks_.size())
+    {
+      blocks_.push_back(std::make_unique<std::byte[]>(kBlockBytes));
+    }
+    offset_ = 0;
+  }
+  void* ptr = blocks_[block_].get() + offset_;
+  offset_ += size;
+  return ptr;
+}
+
+void CommandBuffer::Clear()
+{
+  for (const Command& command : commands_) command.destroy_(command.payload_);
+  commands_.clear();
+  block_ = 0;
+  offset_ = 0;
+}
+
+}  // namespace motor::ecs
@@ -0,0 +1,133 @@
+#ifndef _MOTOR_ECS_COMMAND_BUFFER_H_
+#define _MOTOR_ECS_COMMAND_BUFFER_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "motor/ecs/entity.h"
+#include "motor/ecs/world.h"
+
+namespace motor::ecs
+{
+// Records structural changes to be applied to a World later, e.g. from within
+// systems that are iterating the world. Commands are stored in reusable
+// blocks, recording doesn't allocate once the buffer has warmed up. Not
+// thread-safe, each system gets its own buffer.
+class CommandBuffer
+{
+ public:
+  CommandBuffer() = default;
+  CommandBuffer(const CommandBuffer&) = delete;
+  CommandBuffer& operator=(const CommandBuffer&) = delete;
+  CommandBuffer(CommandBuffer&&) = default;
+  CommandBuffer& operator=(CommandBuffer&&) = default;
+  // Pending commands are dropped.
+  ~CommandBuffer() { Clear(); }
+
+  template <typename... Ts>
+  void Create(Ts... components)
+  {
+    Push(CreateCommand<Ts...>{std::make_tuple(std::move(components)...)});
+  }
+  void Destroy(Entity entity) { Push(DestroyCommand{entity}); }
+  template <typename T>
+  void Add(Entity entity, T component)
+  {
+    Push(AddCommand<T>{entity, std::move(component)});
+  }
+  template <typename T>
+  void Remove(Entity entity)
+  {
+    Push(RemoveCommand<T>{entity});
+  }
+
+  // Applies the commands in the order they were recorded and clears the
+  // buffer. Commands on entities that are no longer alive are skipped.
+  void Apply(World* world);
+  bool Empty() const { return commands_.empty(); }
+
+ private:
+  static constexpr size_t kBlockBytes = 16 << 10;
+
+  struct Command
+  {
+    void (*apply_)(World* world, void* payload) = nullptr;
+    void (*destroy_)(void* payload) = nullptr;
+    void* payload_ = nullptr;
+  };
+
+  template <typename... Ts>
+  struct CreateCommand
+  {
+    std::tuple<Ts...> components_;
+    void Apply(World* world)
+    {
+      std::apply(
+          [world](Ts&... components) {
+            world->Create(std::move(components)...);
+          },
+          components_);
+    }
+  };
+  struct DestroyCommand
+  {
+    Entity entity_;
+    void Apply(World* world)
+    {
+      if (world->IsAlive(entity_)) world->Destroy(entity_);
+    }
+  };
+  template <typename T>
+  struct AddCommand
+  {
+    Entity entity_;
+    T component_;
+    void Apply(World* world)
+    {
+      if (world->IsAlive(entity_)) world->Add(entity_, std::move(component_));
+    }
+  };
+  template <typename T>
+  struct RemoveCommand
+  {
+    Entity entity_;
+    void Apply(World* world)
+    {
+      if (world->IsAlive(entity_)) world->Remove<T>(entity_);
+    }
+  };
+
+  template <typename P>
+  void Push(P payload)
+  {
+    static_assert(sizeof(P) <= kBlockBytes, "Component is too large");
+    static_assert(alignof(P) <= alignof(std::max_align_t),
+                  "Overaligned components are not supported");
+    Command command;
+    command.payload_ = new (AllocatePayload(sizeof(P), alignof(P)))
+        P(std::move(payload));
+    command.apply_ = [](World* world, void* ptr) {
+      static_cast<P*>(ptr)->Apply(world);
+    };
+    command.destroy_ = [](void* ptr) { static_cast<P*>(ptr)->~P(); };
+    commands_.push_back(command);
+  }
+
+  void* AllocatePayload(size_t size, size_t alignment);
+  // Destroys pending commands, keeping the blocks for reuse.
+  void Clear();
+
+  std::vector<Command> commands_;
+  std::vector<std::unique_ptr<std::byte[]>> blocks_;
+  // Block currently allocated from and the offset within it.
+  size_t block_ = 0;
+  size_t offset_ = 0;
+};
+
+}  // namespace motor::ecs
+
+#endif
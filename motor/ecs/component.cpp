@@ -0,0 +1,34 @@
+#include "motor/ecs/component.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+#include "glog/logging.h"
+
+namespace motor::ecs
+{
+namespace
+{
+std::array<ComponentInfo, kMaxComponents> infos;
+std::atomic<size_t> num_components{0};
+
+}  // namespace
+
+size_t ComponentRegistry::Register(const ComponentInfo& info)
+{
+  const size_t id = num_components.fetch_add(1, std::memory_order_relaxed);
+  CHECK(id < kMaxComponents) << "Increase ecs::kMaxComponents";
+  // Ids are handed out through function local statics, which publish the info
+  // to other threads along with the id.
+  infos[id] = info;
+  return id;
+}
+
+const ComponentInfo& ComponentRegistry::GetInfo(size_t id)
+{
+  DCHECK(id < num_components.load(std::memory_order_relaxed));
+  return infos[id];
+}
+
+}  // namespace motor::ecs
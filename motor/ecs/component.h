@@ -0,0 +1,82 @@
+#ifndef _MOTOR_ECS_COMPONENT_H_
+#define _MOTOR_ECS_COMPONENT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace motor::ecs
+{
+// Upper bound on the number of distinct component types within a binary, so
+// that a set of components fits into a ComponentMask.
+constexpr size_t kMaxComponents = 64;
+// Bit i is set if the component with id i is in the set.
+using ComponentMask = uint64_t;
+
+// Type erased operations on a component type.
+struct ComponentInfo
+{
+  size_t size_ = 0;
+  size_t alignment_ = 0;
+  // Trivially copyable components are relocated with memcpy.
+  bool trivial_ = false;
+  // Move constructs into |dst| and destroys |src|.
+  void (*relocate_)(void* dst, void* src) = nullptr;
+  void (*destroy_)(void* ptr) = nullptr;
+};
+
+class ComponentRegistry
+{
+ public:
+  // Returns a dense id in the range [0, kMaxComponents) for T, assigned on
+  // first use. Ids are stable for the lifetime of the process, but might
+  // change from run to run.
+  template <typename T>
+  static size_t GetId()
+  {
+    return Id<std::remove_cv_t<T>>();
+  }
+
+  static const ComponentInfo& GetInfo(size_t id);
+
+ private:
+  // Separate from GetId so that const and non-const T share the same id.
+  template <typename T>
+  static size_t Id()
+  {
+    static_assert(std::is_nothrow_move_constructible<T>::value,
+                  "Components must be nothrow move constructible");
+    static const size_t id = Register(MakeInfo<T>());
+    return id;
+  }
+  template <typename T>
+  static ComponentInfo MakeInfo()
+  {
+    ComponentInfo info;
+    info.size_ = sizeof(T);
+    info.alignment_ = alignof(T);
+    info.trivial_ = std::is_trivially_copyable<T>::value;
+    info.relocate_ = [](void* dst, void* src) {
+      T* src_component = static_cast<T*>(src);
+      new (dst) T(std::move(*src_component));
+      src_component->~T();
+    };
+    info.destroy_ = [](void* ptr) { static_cast<T*>(ptr)->~T(); };
+    return info;
+  }
+
+  static size_t Register(const ComponentInfo& info);
+};
+
+template <typename... Ts>
+ComponentMask MaskOf()
+{
+  return (ComponentMask{0} | ... |
+          (ComponentMask{1} << ComponentRegistry::GetId<Ts>()));
+}
+
+}  // namespace motor::ecs
+
+#endif
@@ -0,0 +1,162 @@
+// Iterates 1M entities sequentially and on the job system, churns components
+// and entities through command buffers and runs a small set of systems
+// through the scheduler, printing the time per frame of each.
+//   bazel run -c opt //motor/ecs:ecs_benchmark
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "motor/ecs/command_buffer.h"
+#include "motor/ecs/entity.h"
+#include "motor/ecs/scheduler.h"
+#include "motor/ecs/world.h"
+#include "motor/jobs/job_system.h"
+
+namespace motor::ecs
+{
+namespace
+{
+constexpr size_t kNumEntities = 1'000'000;
+constexpr size_t kNumFrames = 20;
+// Entities changed per churn frame.
+constexpr size_t kChurn = 10'000;
+constexpr float kDt = 1.f / 60.f;
+
+struct Position
+{
+  float x_ = 0, y_ = 0, z_ = 0;
+};
+struct Velocity
+{
+  float x_ = 1, y_ = 2, z_ = 3;
+};
+struct Health
+{
+  float value_ = 100;
+};
+struct Tag
+{
+};
+
+void Integrate(Position& position, const Velocity& velocity)
+{
+  position.x_ += velocity.x_ * kDt;
+  position.y_ += velocity.y_ * kDt;
+  position.z_ += velocity.z_ * kDt;
+}
+
+template <typename Fn>
+double MillisPerFrame(Fn&& fn)
+{
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t frame = 0; frame < kNumFrames; ++frame) fn();
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         kNumFrames;
+}
+
+void Run()
+{
+  const size_t num_threads =
+      std::max<size_t>(1, std::thread::hardware_concurrency());
+  jobs::JobSystem job_system(num_threads - 1);
+
+  World world;
+  std::vector<Entity> entities;
+  entities.reserve(kNumEntities);
+  const auto create_start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kNumEntities; ++i)
+  {
+    // Half of the entities in a second archetype.
+    entities.push_back(i % 2 == 0
+                           ? world.Create(Position(), Velocity())
+                           : world.Create(Position(), Velocity(), Health()));
+  }
+  std::printf("%-28s %10.3f ms\n", "create 1M",
+              std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - create_start)
+                  .count());
+
+  Query<Position, const Velocity> movement(&world);
+  std::printf("%-28s %10.3f ms\n", "iterate 1M",
+              MillisPerFrame([&movement] { movement.ForEach(Integrate); }));
+  std::printf("%-28s %10.3f ms (%zu threads)\n", "iterate 1M parallel",
+              MillisPerFrame([&movement, &job_system] {
+                movement.ParallelForEach(&job_system, 16 << 10, Integrate);
+              }),
+              num_threads);
+
+  std::mt19937 rng(42);
+  CommandBuffer commands;
+  std::printf(
+      "%-28s %10.3f ms\n", "add/remove 10k tags",
+      MillisPerFrame([&] {
+        for (size_t i = 0; i < kChurn; ++i)
+        {
+          const Entity entity = entities[rng() % entities.size()];
+          if (world.Get<Tag>(entity) == nullptr)
+          {
+            commands.Add(entity, Tag());
+          }
+          else
+          {
+            commands.Remove<Tag>(entity);
+          }
+        }
+        commands.Apply(&world);
+      }));
+  std::printf("%-28s %10.3f ms\n", "destroy/create 10k",
+              MillisPerFrame([&] {
+                for (size_t i = 0; i < kChurn; ++i)
+                {
+                  Entity& entity = entities[rng() % entities.size()];
+                  commands.Destroy(entity);
+                  commands.Create(Position(), Velocity());
+                  entity = Entity();
+                }
+                commands.Apply(&world);
+                // Refill handles from a query, as created entities are only
+                // known once applied.
+                size_t next = 0;
+                Query<const Position>(&world).ForEachEntity(
+                    [&entities, &next](Entity entity, const Position&) {
+                      if (next < entities.size()) entities[next++] = entity;
+                    });
+              }));
+
+  Scheduler scheduler(&job_system);
+  Query<Position, const Velocity> move_query(&world);
+  Query<Health> health_query(&world);
+  Query<const Position> bounds_query(&world);
+  scheduler.Add("Movement", SystemAccess::Of<Position, const Velocity>(),
+                [&move_query](World&, CommandBuffer&) {
+                  move_query.ForEach(Integrate);
+                });
+  scheduler.Add("Decay", SystemAccess::Of<Health>(),
+                [&health_query](World&, CommandBuffer&) {
+                  health_query.ForEach(
+                      [](Health& health) { health.value_ *= .999f; });
+                });
+  scheduler.Add("Bounds", SystemAccess::Of<const Position>(),
+                [&bounds_query](World&, CommandBuffer& cmds) {
+                  bounds_query.ForEachEntity(
+                      [&cmds](Entity entity, const Position& position) {
+                        if (position.x_ > 1e6f) cmds.Destroy(entity);
+                      });
+                });
+  std::printf("%-28s %10.3f ms (%zu stages)\n", "scheduler 3 systems",
+              MillisPerFrame([&] { scheduler.Run(&world); }),
+              scheduler.NumStages());
+  std::printf("%zu entities left\n", world.NumEntities());
+}
+
+}  // namespace
+}  // namespace motor::ecs
+
+int main() { motor::ecs::Run(); }
@@ -0,0 +1,27 @@
+#ifndef _MOTOR_ECS_ENTITY_H_
+#define _MOTOR_ECS_ENTITY_H_
+
+#include <cstdint>
+
+namespace motor::ecs
+{
+// Handle to an entity of a World. Indices are reused once entities are
+// destroyed, the generation tells handles of different incarnations apart.
+struct Entity
+{
+  uint32_t index_ = 0;
+  // Live entities never have generation zero, hence default constructed
+  // handles are invalid.
+  uint32_t generation_ = 0;
+
+  bool IsValid() const { return generation_ != 0; }
+  bool operator==(const Entity& other) const
+  {
+    return index_ == other.index_ && generation_ == other.generation_;
+  }
+  bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+}  // namespace motor::ecs
+
+#endif
@@ -0,0 +1,68 @@
+#include "motor/ecs/scheduler.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "motor/ecs/command_buffer.h"
+#include "motor/ecs/world.h"
+#include "motor/jobs/job_system.h"
+#include "motor/profiler/profiler.h"
+
+namespace motor::ecs
+{
+Scheduler::Scheduler(jobs::JobSystem* job_system) : job_system_(job_system) {}
+
+void Scheduler::Add(const char* name, SystemAccess access, SystemFn fn)
+{
+  size_t stage = 0;
+  for (const System& other : systems_)
+  {
+    if (access.ConflictsWith(other.access_))
+    {
+      stage = std::max(stage, other.stage_ + 1);
+    }
+  }
+  System system;
+  system.name_ = name;
+  system.access_ = access;
+  system.fn_ = std::move(fn);
+  system.stage_ = stage;
+  if (stage == stages_.size()) stages_.emplace_back();
+  stages_[stage].push_back(systems_.size());
+  systems_.push_back(std::move(system));
+}
+
+void Scheduler::Run(World* world)
+{
+  for (const std::vector<size_t>& stage : stages_)
+  {
+    if (job_system_ == nullptr || stage.size() == 1)
+    {
+      for (size_t idx : stage) RunSystem(world, &systems_[idx]);
+      continue;
+    }
+    jobs::Counter counter;
+    // Calling thread runs the first one.
+    for (size_t i = 1; i < stage.size(); ++i)
+    {
+      System* system = &systems_[stage[i]];
+      job_system_->Run([this, world, system] { RunSystem(world, system); },
+                       &counter);
+    }
+    RunSystem(world, &systems_[stage.front()]);
+    job_system_->Wait(counter);
+  }
+
+  MOTOR_PROFILE_SCOPE("Scheduler::ApplyCommands");
+  for (System& system : systems_) system.commands_.Apply(world);
+}
+
+void Scheduler::RunSystem(World* world, System* system)
+{
+  MOTOR_PROFILE_SCOPE(system->name_);
+  system->fn_(*world, system->commands_);
+}
+
+}  // namespace motor::ecs
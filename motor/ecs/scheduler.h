@@ -0,0 +1,82 @@
+#ifndef _MOTOR_ECS_SCHEDULER_H_
+#define _MOTOR_ECS_SCHEDULER_H_
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "motor/ecs/command_buffer.h"
+#include "motor/ecs/component.h"
+#include "motor/ecs/world.h"
+#include "motor/jobs/job_system.h"
+
+namespace motor::ecs
+{
+// Components a system reads and writes.
+struct SystemAccess
+{
+  ComponentMask reads_ = 0;
+  ComponentMask writes_ = 0;
+
+  // Const components are read, the rest are written, i.e. the same as the
+  // Query the system iterates with.
+  template <typename... Ts>
+  static SystemAccess Of()
+  {
+    SystemAccess access;
+    (((std::is_const<Ts>::value ? access.reads_ : access.writes_) |=
+      MaskOf<Ts>()),
+     ...);
+    return access;
+  }
+
+  bool ConflictsWith(const SystemAccess& other) const
+  {
+    return (writes_ & (other.reads_ | other.writes_)) != 0 ||
+           (reads_ & other.writes_) != 0;
+  }
+};
+
+// Runs systems in the order they were added, except that systems with
+// non-conflicting accesses run in parallel. Systems are grouped into stages,
+// a system is placed in the stage right after the last earlier system it
+// conflicts with. Structural changes recorded by systems are applied once all
+// of them have finished, in the order the systems were added.
+class Scheduler
+{
+ public:
+  // World must only be read and written as declared through the access, and
+  // structurally changed only through the command buffer.
+  using SystemFn = std::function<void(World& world, CommandBuffer& commands)>;
+
+  // Runs everything on the calling thread if |job_system| is null.
+  explicit Scheduler(jobs::JobSystem* job_system);
+
+  // |name| must be a string literal, it is used for profiling zones.
+  void Add(const char* name, SystemAccess access, SystemFn fn);
+  void Run(World* world);
+
+  size_t NumStages() const { return stages_.size(); }
+
+ private:
+  struct System
+  {
+    const char* name_;
+    SystemAccess access_;
+    SystemFn fn_;
+    CommandBuffer commands_;
+    size_t stage_ = 0;
+  };
+
+  void RunSystem(World* world, System* system);
+
+  jobs::JobSystem* const job_system_;
+  std::vector<System> systems_;
+  // Indices into systems_.
+  std::vector<std::vector<size_t>> stages_;
+};
+
+}  // namespace motor::ecs
+
+#endif
@@ -0,0 +1,78 @@
+#include "motor/ecs/world.h"
+
+#include <cstdint>
+#include <memory>
+
+#include "glog/logging.h"
+#include "motor/ecs/archetype.h"
+#include "motor/ecs/component.h"
+#include "motor/ecs/entity.h"
+
+namespace motor::ecs
+{
+World::World() { empty_ = GetArchetype(0); }
+
+World::~World() = default;
+
+Entity World::Create()
+{
+  const Entity entity = AllocateEntity();
+  Record& record = records_[entity.index_];
+  record.archetype_ = empty_;
+  record.row_ = empty_->AddRow(entity);
+  return entity;
+}
+
+void World::Destroy(Entity entity)
+{
+  CHECK(IsAlive(entity)) << "Entity " << entity.index_ << " is not alive";
+  Record& record = records_[entity.index_];
+  Entity moved;
+  record.archetype_->RemoveRow(record.row_, &moved);
+  if (moved.IsValid()) records_[moved.index_].row_ = record.row_;
+  record.archetype_ = nullptr;
+  // Zero is reserved for invalid handles.
+  if (++record.generation_ == 0) record.generation_ = 1;
+  free_.push_back(entity.index_);
+}
+
+Entity World::AllocateEntity()
+{
+  Entity entity;
+  if (free_.empty())
+  {
+    CHECK(records_.size() < UINT32_MAX) << "Out of entity indices";
+    entity.index_ = records_.size();
+    records_.emplace_back();
+  }
+  else
+  {
+    entity.index_ = free_.back();
+    free_.pop_back();
+  }
+  entity.generation_ = records_[entity.index_].generation_;
+  return entity;
+}
+
+Archetype* World::GetArchetype(ComponentMask mask)
+{
+  auto it = archetype_index_.find(mask);
+  if (it != archetype_index_.end()) return it->second;
+  archetypes_.push_back(std::make_unique<Archetype>(mask));
+  Archetype* archetype = archetypes_.back().get();
+  archetype_index_.emplace(mask, archetype);
+  return archetype;
+}
+
+uint32_t World::Move(Entity entity, Archetype* dst)
+{
+  Record& record = records_[entity.index_];
+  Entity moved;
+  const uint32_t row = record.archetype_->MoveRow(record.row_, dst, &moved);
+  if (moved.IsValid()) records_[moved.index_].row_ = record.row_;
+  record.archetype_ = dst;
+  record.row_ = row;
+  return row;
+}
+
+}  // namespace motor::ecs
@@ -0,0 +1,234 @@
+#ifndef _MOTOR_ECS_WORLD_H_
+#define _MOTOR_ECS_WORLD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/ecs/archetype.h"
+#include "motor/ecs/component.h"
+#include "motor/ecs/entity.h"
+#include "motor/jobs/job_system.h"
+
+namespace motor::ecs
+{
+// Owns all entities and their components, grouped into archetypes. Structural
+// changes, i.e. creating and destroying entities or adding and removing
+// components, move rows between archetypes and must not happen while the
+// world is iterated, e.g. by systems. Those should record the changes into a
+// CommandBuffer instead.
+class World
+{
+ public:
+  World();
+  World(const World&) = delete;
+  World& operator=(const World&) = delete;
+  ~World();
+
+  Entity Create();
+  template <typename... Ts>
+  Entity Create(Ts... components)
+  {
+    const ComponentMask mask = MaskOf<Ts...>();
+    CHECK(__builtin_popcountll(mask) == sizeof...(Ts))
+        << "Duplicate component types";
+    Archetype* archetype = GetArchetype(mask);
+    const Entity entity = AllocateEntity();
+    const uint32_t row = archetype->AddRow(entity);
+    (new (archetype->At(ComponentRegistry::GetId<Ts>(), row))
+         Ts(std::move(components)),
+     ...);
+    Record& record = records_[entity.index_];
+    record.archetype_ = archetype;
+    record.row_ = row;
+    return entity;
+  }
+  void Destroy(Entity entity);
+  bool IsAlive(Entity entity) const
+  {
+    return entity.IsValid() && entity.index_ < records_.size() &&
+           records_[entity.index_].generation_ == entity.generation_;
+  }
+
+  // Replaces the component if the entity already has one.
+  template <typename T>
+  void Add(Entity entity, T component)
+  {
+    const size_t id = ComponentRegistry::GetId<T>();
+    const Record& record = GetRecord(entity);
+    if (record.archetype_->Has(id))
+    {
+      *static_cast<T*>(record.archetype_->At(id, record.row_)) =
+          std::move(component);
+      return;
+    }
+    Archetype*& edge = record.archetype_->AddEdge(id);
+    if (edge == nullptr)
+    {
+      edge = GetArchetype(record.archetype_->Mask() | (ComponentMask{1} << id));
+    }
+    const uint32_t row = Move(entity, edge);
+    new (edge->At(id, row)) T(std::move(component));
+  }
+  // No-op if the entity doesn't have the component.
+  template <typename T>
+  void Remove(Entity entity)
+  {
+    const size_t id = ComponentRegistry::GetId<T>();
+    const Record& record = GetRecord(entity);
+    if (!record.archetype_->Has(id)) return;
+    Archetype*& edge = record.archetype_->RemoveEdge(id);
+    if (edge == nullptr)
+    {
+      edge =
+          GetArchetype(record.archetype_->Mask() & ~(ComponentMask{1} << id));
+    }
+    Move(entity, edge);
+  }
+
+  // Returns nullptr if the entity doesn't have the component. Pointers are
+  // invalidated by structural changes.
+  template <typename T>
+  T* Get(Entity entity)
+  {
+    const size_t id = ComponentRegistry::GetId<T>();
+    const Record& record = GetRecord(entity);
+    if (!record.archetype_->Has(id)) return nullptr;
+    return static_cast<T*>(record.archetype_->At(id, record.row_));
+  }
+
+  size_t NumEntities() const { return records_.size() - free_.size(); }
+  // Archetypes are only ever appended, queries rely on this to pick up new
+  // ones incrementally.
+  const std::vector<std::unique_ptr<Archetype>>& GetArchetypes() const
+  {
+    return archetypes_;
+  }
+
+ private:
+  struct Record
+  {
+    Archetype* archetype_ = nullptr;
+    uint32_t row_ = 0;
+    uint32_t generation_ = 1;
+  };
+
+  const Record& GetRecord(Entity entity) const
+  {
+    CHECK(IsAlive(entity)) << "Entity " << entity.index_ << " is not alive";
+    return records_[entity.index_];
+  }
+  Entity AllocateEntity();
+  Archetype* GetArchetype(ComponentMask mask);
+  // Moves the entity into |dst| and returns its new row, components that are
+  // only in |dst| are left uninitialized.
+  uint32_t Move(Entity entity, Archetype* dst);
+
+  std::vector<Record> records_;
+  // Indices of destroyed entities, reused in LIFO order.
+  std::vector<uint32_t> free_;
+  std::unordered_map<ComponentMask, Archetype*> archetype_index_;
+  std::vector<std::unique_ptr<Archetype>> archetypes_;
+  Archetype* empty_ = nullptr;
+};
+
+// Iterates over all entities having at least the components Ts. Components
+// declared const are only read, see SystemAccess::Of. Matching archetypes are
+// cached, each call only checks archetypes created since the previous one.
+template <typename... Ts>
+class Query
+{
+ public:
+  explicit Query(World* world) : world_(world), mask_(MaskOf<Ts...>()) {}
+
+  // Calls |fn| with references to the components of each entity.
+  template <typename Fn>
+  void ForEach(Fn&& fn)
+  {
+    Refresh();
+    for (Archetype* archetype : matches_)
+    {
+      const size_t size = archetype->Size();
+      if (size == 0) continue;
+      const std::tuple<Ts*...> columns(archetype->Column<Ts>()...);
+      for (size_t row = 0; row < size; ++row)
+      {
+        fn(std::get<Ts*>(columns)[row]...);
+      }
+    }
+  }
+
+  // Same as ForEach, but |fn| receives the entity as the first argument.
+  template <typename Fn>
+  void ForEachEntity(Fn&& fn)
+  {
+    Refresh();
+    for (Archetype* archetype : matches_)
+    {
+      const size_t size = archetype->Size();
+      if (size == 0) continue;
+      const std::tuple<Ts*...> columns(archetype->Column<Ts>()...);
+      const std::vector<Entity>& entities = archetype->Entities();
+      for (size_t row = 0; row < size; ++row)
+      {
+        fn(entities[row], std::get<Ts*>(columns)[row]...);
+      }
+    }
+  }
+
+  // Splits every matching archetype into ranges of at most |grain| rows and
+  // calls |fn| on them in parallel, a |grain| of zero picks one based on the
+  // number of threads. |fn| must not make structural changes.
+  template <typename Fn>
+  void ParallelForEach(jobs::JobSystem* job_system, size_t grain, Fn&& fn)
+  {
+    Refresh();
+    for (Archetype* archetype : matches_)
+    {
+      const std::tuple<Ts*...> columns(archetype->Column<Ts>()...);
+      job_system->ParallelFor(
+          archetype->Size(), grain,
+          [&columns, &fn](size_t begin, size_t end) {
+            for (size_t row = begin; row < end; ++row)
+            {
+              fn(std::get<Ts*>(columns)[row]...);
+            }
+          });
+    }
+  }
+
+  size_t Count()
+  {
+    Refresh();
+    size_t count = 0;
+    for (Archetype* archetype : matches_) count += archetype->Size();
+    return count;
+  }
+
+ private:
+  void Refresh()
+  {
+    const std::vector<std::unique_ptr<Archetype>>& archetypes =
+        world_->GetArchetypes();
+    for (; num_seen_ < archetypes.size(); ++num_seen_)
+    {
+      Archetype* archetype = archetypes[num_seen_].get();
+      if ((archetype->Mask() & mask_) == mask_) matches_.push_back(archetype);
+    }
+  }
+
+  World* const world_;
+  const ComponentMask mask_;
+  std::vector<Archetype*> matches_;
+  size_t num_seen_ = 0;
+};
+
+}  // namespace motor::ecs
+
+#endif
@@ -1,37 +1,171 @@
 #include "engine.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include "event.h"
+#include "event_queue.h"
+#include "gflags/gflags.h"
 #include "glog/logging.h"
 #include "input/input.h"
+#include "motor/assets/archive.h"
+#include "motor/assets/asset_streamer.h"
 #include "motor/event.h"
+#include "motor/input/device.h"
+#include "motor/input/input_log.h"
+#include "motor/memory/frame_arena.h"
+#include "motor/profiler/profiler.h"
+#include "motor/render/latency_tracker.h"
+#include "motor/render/render_thread.h"
 #include "motor/render/renderer.h"
 #include "motor/window.h"
 #include "window.h"
 
+DEFINE_string(window_backend, "",
+              "Window plugin to use, overrides WindowOptions::backend_.");
+DEFINE_string(renderer_backend, "",
+              "Renderer plugin to use, overrides RendererOptions::backend_.");
+DEFINE_string(asset_archives, "",
+              "Comma separated archives to load assets from, see //tools:cook. "
+              "Later ones take precedence, loose files are used for assets "
+              "missing from all of them.");
+
 namespace motor
 {
 namespace
 {
-void InputStateHandler(const input::InputStateBroadcast& state)
+// Flags take precedence over the options set in code.
+const std::string& SelectBackend(const std::string& flag,
+                                 const std::string& option)
+{
+  return flag.empty() ? option : flag;
+}
+
+std::string JoinNames(const std::vector<std::string_view>& names)
 {
-  for (const input::KeyInput& key_inp : state.keys_)
+  std::string result;
+  for (std::string_view name : names)
   {
-    VLOG(1) << "Device " << key_inp.device_id_ << ", Key " << key_inp.id_
-            << " is_down: " << key_inp.is_down_;
+    if (!result.empty()) result += ", ";
+    result += name;
   }
-  for (const input::AxisInput& axis_inp : state.axes_)
+  return result;
+}
+
+void InputStateHandler(const input::InputStateBroadcast& broadcast)
+{
+  if (!VLOG_IS_ON(1)) return;
+  const input::InputFrame& current = broadcast.state_->Current();
+  const input::InputFrame& previous = broadcast.state_->Previous();
+  for (size_t device_id = 0; device_id < input::kMaxDevices; ++device_id)
   {
-    VLOG(1) << "Device " << axis_inp.device_id_ << ", Axis " << axis_inp.id_
-            << " value: " << axis_inp.value_;
+    const input::DeviceInputState& device = current.devices_[device_id];
+    device.pressed_.ForEach([device_id](size_t key) {
+      VLOG(1) << "Device " << device_id << ", Key " << key << " pressed";
+    });
+    device.released_.ForEach([device_id](size_t key) {
+      VLOG(1) << "Device " << device_id << ", Key " << key << " released";
+    });
+    for (size_t axis = 0; axis < input::kNumAxes; ++axis)
+    {
+      const float value = device.axes_[axis];
+      if (value == previous.devices_[device_id].axes_[axis]) continue;
+      VLOG(1) << "Device " << device_id << ", Axis " << axis
+              << " value: " << value;
+    }
   }
 }
 
+using Clock = std::chrono::steady_clock;
+
+// Below this threshold the pacer yields instead of sleeping, as sleeps tend to
+// overshoot by up to a scheduler tick.
+constexpr const std::chrono::microseconds kSpinThreshold(1500);
+
+// Overflowing allocations fall back to the heap, high water mark is logged
+// when MainLoop returns.
+constexpr const size_t kFrameArenaBytes = 4 << 20;
+// Current frame and the one the render thread might still be consuming.
+constexpr const size_t kFrameArenaBuffers = 2;
+
+void WaitUntil(Clock::time_point deadline)
+{
+  while (true)
+  {
+    const Clock::time_point now = Clock::now();
+    if (now >= deadline) return;
+    const Clock::duration remaining = deadline - now;
+    if (remaining > kSpinThreshold)
+    {
+      std::this_thread::sleep_for(remaining - kSpinThreshold);
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+double ToMillis(Clock::duration duration)
+{
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
 }  // namespace
 
+Engine::Engine() : frame_arena_(kFrameArenaBytes, kFrameArenaBuffers)
+{
+  // Calling thread participates in job execution, hence one less worker.
+  const size_t num_threads =
+      std::max<size_t>(1, std::thread::hardware_concurrency());
+  job_system_ = std::make_unique<jobs::JobSystem>(num_threads - 1);
+  assets_ = std::make_unique<assets::AssetStreamer>(assets::StreamerOptions());
+  std::string_view archives = FLAGS_asset_archives;
+  while (!archives.empty())
+  {
+    const size_t comma = archives.find(',');
+    const std::string path(archives.substr(0, comma));
+    archives = comma == std::string_view::npos ? std::string_view()
+                                               : archives.substr(comma + 1);
+    if (path.empty()) continue;
+    std::unique_ptr<assets::Archive> archive = assets::Archive::Open(path);
+    if (archive != nullptr) assets_->Mount(std::move(archive));
+  }
+}
+
 void Engine::InitializeWindow(WindowOptions opts)
 {
   is_running_ = true;
-  window_manager_ = WindowPlugin::Create();
+  std::string backend = SelectBackend(FLAGS_window_backend, opts.backend_);
+  if (backend.empty() && !opts.input_replay_path_.empty()) backend = "replay";
+  window_manager_ = WindowPlugin::Create(backend);
+  CHECK(window_manager_ != nullptr)
+      << "No usable window backend " << backend << ", linked in ones are: "
+      << JoinNames(WindowPlugin::Names());
+  if (!opts.input_record_path_.empty())
+  {
+    input_recorder_ =
+        std::make_unique<input::InputLogWriter>(opts.input_record_path_);
+    // Registered before the window is created to capture initially connected
+    // devices.
+    window_manager_->RegisterEventHandler(
+        static_cast<Event::Handler<input::DeviceConfigChange>>(
+            [this](const input::DeviceConfigChange& change) {
+              input_recorder_->Record(change);
+            }));
+    window_manager_->RegisterEventHandler(
+        static_cast<Event::Handler<input::InputStateBroadcast>>(
+            [this](const input::InputStateBroadcast& broadcast) {
+              input_recorder_->Record(broadcast);
+            }));
+  }
   window_manager_->SetOptions(std::move(opts));
   window_manager_->CreateWindow();
 
@@ -47,13 +181,209 @@ void Engine::InitializeWindow(WindowOptions opts)
           InputStateHandler));
 }
 
+void Engine::InitializeRenderer(RendererOptions opts)
+{
+  CHECK(window_manager_ != nullptr) << "Window isn't initialized";
+  const bool has_surface = window_manager_->CanCreateSurface();
+  if (!opts.offscreen_.has_value()) opts.offscreen_ = !has_surface;
+  CHECK(*opts.offscreen_ || has_surface)
+      << "Window can't provide a surface, renderer must run offscreen";
+  if (opts.job_system_ == nullptr) opts.job_system_ = job_system_.get();
+  if (opts.latency_tracker_ == nullptr)
+  {
+    opts.latency_tracker_ = &latency_tracker_;
+  }
+  const std::string backend =
+      SelectBackend(FLAGS_renderer_backend, opts.backend_);
+  renderer_ = RenderPlugin::Create(backend);
+  CHECK(renderer_ != nullptr)
+      << "No usable renderer backend " << backend << ", linked in ones are: "
+      << JoinNames(RenderPlugin::Names());
+  renderer_->SetOptions(std::move(opts));
+  renderer_->Initialize();
+}
+
+void Engine::UploadAsset(const assets::AssetHandle& asset)
+{
+  CHECK(renderer_ != nullptr) << "Renderer isn't initialized";
+  renderer_->UploadAsset(asset);
+}
+
+void Engine::SetLoopOptions(LoopOptions opts)
+{
+  CHECK(opts.fixed_step_.count() > 0) << "Fixed step must be positive";
+  CHECK(opts.max_steps_per_frame_ > 0) << "Need at least one step per frame";
+  loop_opts_ = opts;
+}
+
+void Engine::RegisterFixedUpdate(FixedUpdateHandler handler)
+{
+  fixed_update_handlers_.push_back(std::move(handler));
+}
+
+void Engine::SetActionMap(input::ActionMap action_map)
+{
+  action_map_ = std::move(action_map);
+}
+
+void Engine::RegisterRender(RenderHandler handler)
+{
+  render_handlers_.push_back(std::move(handler));
+}
+
+void Engine::RegisterFrameEnd(FrameEndHandler handler)
+{
+  frame_end_handlers_.push_back(std::move(handler));
+}
+
 void Engine::MainLoop()
 {
-  renderer_ = RenderPlugin::Create();
+  if (renderer_ == nullptr) InitializeRenderer(RendererOptions());
+
+  // Joined before leaving MainLoop, hence before renderer_ is destroyed.
+  std::unique_ptr<RenderThread> render_thread;
+  if (loop_opts_.threaded_rendering_)
+  {
+    render_thread = std::make_unique<RenderThread>(renderer_.get());
+  }
+
+  profiler::Profiler::Get().SetThreadName("Main");
+  if (!loop_opts_.trace_path_.empty())
+  {
+    profiler::Profiler::Get().Capture(loop_opts_.trace_skip_frames_,
+                                      loop_opts_.trace_num_frames_,
+                                      loop_opts_.trace_path_);
+  }
+
+  RenderPacket packet;
+  uint64_t frame = 0;
+  const Clock::duration step = loop_opts_.fixed_step_;
+  Clock::duration accumulator(0);
+  Clock::time_point previous_frame_start = Clock::now();
   while (is_running_)
   {
-    window_manager_->Update();
-    renderer_->Render();
+    MOTOR_PROFILE_FRAME();
+    frame_arena_.BeginFrame();
+    const Clock::time_point frame_start = Clock::now();
+    Clock::duration elapsed = frame_start - previous_frame_start;
+    previous_frame_start = frame_start;
+    if (elapsed > loop_opts_.max_frame_time_)
+    {
+      elapsed = loop_opts_.max_frame_time_;
+    }
+    accumulator += elapsed;
+
+    {
+      MOTOR_PROFILE_SCOPE("Window::Update");
+      window_manager_->Update();
+    }
+    {
+      MOTOR_PROFILE_SCOPE("Window::DispatchQueuedEvents");
+      // Queued events are delivered after the OS event pump has been drained
+      // and before the simulation is advanced.
+      const size_t queued_events = window_manager_->DispatchQueuedEvents();
+      VLOG(3) << "Dispatched " << queued_events << " queued events";
+    }
+    {
+      MOTOR_PROFILE_SCOPE("AssetStreamer::DeliverCompletions");
+      assets_->DeliverCompletions();
+    }
+    action_map_.Update(window_manager_->GetInputState());
+
+    size_t steps = 0;
+    while (accumulator >= step && steps < loop_opts_.max_steps_per_frame_)
+    {
+      MOTOR_PROFILE_SCOPE("Engine::FixedUpdate");
+      for (const FixedUpdateHandler& handler : fixed_update_handlers_)
+      {
+        handler(loop_opts_.fixed_step_);
+      }
+      accumulator -= step;
+      ++steps;
+    }
+    if (accumulator >= step)
+    {
+      accumulator %= step;
+      ++frame_stats_.dropped_frames_;
+    }
+
+    // Submitting to the render thread swaps in an older packet, hence every
+    // field is set from scratch.
+    packet.frame_ = ++frame;
+    packet.alpha_ = std::chrono::duration<double>(accumulator) / step;
+    packet.input_time_ = window_manager_->GetInputState().Current().input_time_;
+    packet.draws_.Clear();
+    packet.cull_objects_.clear();
+    packet.view_proj_ = Mat4{};
+    {
+      MOTOR_PROFILE_SCOPE("Engine::SubmitDraws");
+      for (const RenderHandler& handler : render_handlers_)
+      {
+        handler(&packet);
+      }
+    }
+    const Clock::time_point update_end = Clock::now();
+    latency_tracker_.Record(LatencyStage::kUpdate, packet.input_time_,
+                            update_end);
+    if (render_thread != nullptr)
+    {
+      MOTOR_PROFILE_SCOPE("RenderThread::Submit");
+      render_thread->Submit(&packet);
+    }
+    else
+    {
+      MOTOR_PROFILE_SCOPE("Renderer::Render");
+      renderer_->Render(packet);
+    }
+    const Clock::time_point render_end = Clock::now();
+
+    if (loop_opts_.target_frame_time_.count() > 0)
+    {
+      MOTOR_PROFILE_SCOPE("Engine::WaitUntil");
+      WaitUntil(frame_start + loop_opts_.target_frame_time_);
+    }
+    const Clock::time_point frame_end = Clock::now();
+
+    frame_stats_.frame_ms_ = ToMillis(frame_end - frame_start);
+    frame_stats_.update_ms_ = ToMillis(update_end - frame_start);
+    frame_stats_.render_ms_ = ToMillis(render_end - update_end);
+    frame_stats_.idle_ms_ = ToMillis(frame_end - render_end);
+    frame_stats_.steps_ = steps;
+    for (const FrameEndHandler& handler : frame_end_handlers_)
+    {
+      handler(frame_stats_);
+    }
+
+    if (loop_opts_.max_frames_ != 0 && frame >= loop_opts_.max_frames_)
+    {
+      is_running_ = false;
+    }
+  }
+  render_thread.reset();
+  // Writes whatever was captured if the loop ended within the trace window.
+  profiler::Profiler::Get().Stop();
+  if (const EventQueue* queue = window_manager_->GetEventQueue())
+  {
+    const EventQueueStats stats = queue->GetStats();
+    LOG(INFO) << "Event queue capacity: " << queue->Capacity()
+              << " peak events per frame: " << stats.peak_frame_events_
+              << " overflows: " << stats.overflows_;
+  }
+  latency_tracker_.Dump();
+  const memory::FrameArenaStats arena_stats = frame_arena_.GetStats();
+  LOG(INFO) << "Frame arena high water mark: " << arena_stats.high_water_bytes_
+            << " of " << kFrameArenaBytes << " bytes, overflows: "
+            << arena_stats.overflow_allocations_;
+  const assets::StreamerStats asset_stats = assets_->GetStats();
+  LOG(INFO) << "Assets loaded: " << asset_stats.loaded_
+            << " failed: " << asset_stats.failed_
+            << " canceled: " << asset_stats.canceled_
+            << " bytes read: " << asset_stats.bytes_read_;
+  const GpuStats gpu_stats = renderer_->GetGpuStats();
+  for (const GpuScopeTime& scope : gpu_stats.scopes_)
+  {
+    LOG(INFO) << "GPU " << scope.name_ << " of frame " << gpu_stats.frame_
+              << ": " << scope.ms_ << "ms";
   }
 }
 
@@ -2,27 +2,150 @@
 #define _MOTOR_ENGINE_H_
 
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
+#include "motor/assets/asset_streamer.h"
+#include "motor/input/action_map.h"
+#include "motor/input/input_log.h"
+#include "motor/jobs/job_system.h"
+#include "motor/memory/frame_arena.h"
+#include "motor/render/latency_tracker.h"
 #include "motor/render/renderer.h"
 #include "motor/window.h"
 
 namespace motor
 {
+struct LoopOptions
+{
+  // Simulation advances in steps of this size, independent of the frame rate.
+  std::chrono::nanoseconds fixed_step_ = std::chrono::nanoseconds(16'666'667);
+
+  // MainLoop sleeps at the end of each frame until this much time has passed
+  // since the frame started. Zero disables pacing.
+  std::chrono::nanoseconds target_frame_time_ = std::chrono::nanoseconds(0);
+
+  // Protects against the spiral of death, when a frame takes longer than
+  // max_frame_time_ or requires more than max_steps_per_frame_ simulation
+  // steps to catch up, the remaining time is dropped and simulation runs
+  // slower than real time instead.
+  std::chrono::nanoseconds max_frame_time_ = std::chrono::milliseconds(250);
+  size_t max_steps_per_frame_ = 8;
+
+  // Runs the renderer on a dedicated thread, decoupling simulation and input
+  // from GPU submission and present.
+  bool threaded_rendering_ = false;
+
+  // MainLoop returns after this many frames, zero means until the window is
+  // closed.
+  uint64_t max_frames_ = 0;
+
+  // When non-empty, a profiler trace of trace_num_frames_ frames, starting
+  // after the first trace_skip_frames_ frames, is written into this file in
+  // Chrome trace format.
+  std::string trace_path_;
+  size_t trace_skip_frames_ = 0;
+  size_t trace_num_frames_ = 100;
+};
+
+// Timings of the last completed frame.
+struct FrameStats
+{
+  // Wall time of the whole frame, including pacing.
+  double frame_ms_ = 0;
+  // Window update, queued event dispatch, fixed simulation steps and draw
+  // submission.
+  double update_ms_ = 0;
+  // Only covers handing over the render packet with threaded rendering.
+  double render_ms_ = 0;
+  // Time spent sleeping in the frame pacer.
+  double idle_ms_ = 0;
+  // Number of fixed steps run in the frame.
+  size_t steps_ = 0;
+  // Total number of frames in which simulation time had to be dropped.
+  size_t dropped_frames_ = 0;
+};
+
 class Engine
 {
  public:
-  Engine() = default;
+  Engine();
   Engine(const Engine&) = delete;
   Engine& operator=(const Engine&) = delete;
   Engine(Engine&&) = delete;
   ~Engine() = default;
 
   void InitializeWindow(WindowOptions opts);
+  // Must be called after InitializeWindow. MainLoop initializes a renderer
+  // with default options if this wasn't called. Rendering is offscreen if the
+  // window can't provide a surface, asking otherwise check-fails.
+  void InitializeRenderer(RendererOptions opts);
+  void SetLoopOptions(LoopOptions opts);
   void MainLoop();
 
+  // Handlers are run on the main loop thread once per fixed step.
+  using FixedUpdateHandler = std::function<void(std::chrono::nanoseconds)>;
+  void RegisterFixedUpdate(FixedUpdateHandler handler);
+  // Handlers are run on the main loop thread once per frame, after the fixed
+  // steps, to submit the draws and cull objects of the frame into |packet|.
+  // Its frame_, alpha_ and input_time_ are already set.
+  using RenderHandler = std::function<void(RenderPacket* packet)>;
+  void RegisterRender(RenderHandler handler);
+  // Handlers are run on the main loop thread at the end of every frame.
+  using FrameEndHandler = std::function<void(const FrameStats&)>;
+  void RegisterFrameEnd(FrameEndHandler handler);
+
+  // Must be called from the main loop thread, e.g. within handlers.
+  const FrameStats& GetFrameStats() const { return frame_stats_; }
+
+  // Actions are evaluated once per frame, after the window update and before
+  // the fixed steps.
+  void SetActionMap(input::ActionMap action_map);
+  // Must be called from the main loop thread, e.g. within handlers.
+  const input::ActionMap& GetActions() const { return action_map_; }
+
+  // Shared by all subsystems, the thread calling MainLoop must be the one that
+  // constructed the Engine as it takes part in executing jobs.
+  jobs::JobSystem& GetJobSystem() { return *job_system_; }
+
+  // Input latencies of recent frames, can be queried from any thread. Dumped
+  // to the log when MainLoop returns.
+  const LatencyTracker& GetLatencyTracker() const { return latency_tracker_; }
+
+  // Transient allocations of the current frame, reset at the start of each
+  // frame. Memory stays valid until the start of the next frame, so data can
+  // be handed to the render thread.
+  memory::FrameArena& GetFrameArena() { return frame_arena_; }
+
+  // Loads assets in the background, their callbacks are run on the main loop
+  // thread after the window events of a frame have been dispatched.
+  assets::AssetStreamer& GetAssets() { return *assets_; }
+  // Hands a loaded asset to the renderer, see Renderer::UploadAsset. Must be
+  // called after the renderer is initialized.
+  void UploadAsset(const assets::AssetHandle& asset);
+
  private:
+  // Declared first so that it outlives all the subsystems that schedule work.
+  std::unique_ptr<jobs::JobSystem> job_system_;
+  // Outlives the renderer and the handlers, which hold handles to assets.
+  std::unique_ptr<assets::AssetStreamer> assets_;
+  LatencyTracker latency_tracker_;
+  memory::FrameArena frame_arena_;
   std::atomic<bool> is_running_ = false;
+  LoopOptions loop_opts_;
+  FrameStats frame_stats_;
+  std::vector<FixedUpdateHandler> fixed_update_handlers_;
+  std::vector<RenderHandler> render_handlers_;
+  std::vector<FrameEndHandler> frame_end_handlers_;
+  input::ActionMap action_map_;
+  // Declared before window_manager_, as the window holds handlers that write
+  // into it.
+  std::unique_ptr<input::InputLogWriter> input_recorder_;
   std::unique_ptr<Window> window_manager_;
   // Rendered might depend on some state of window_manager_. Therefore we put it
   // after window_manager_.
@@ -1,10 +1,27 @@
 #include "event.h"
 
+#include <atomic>
 #include <cstddef>
+#include <memory>
 #include <mutex>
-#include <type_traits>
 
 namespace motor
 {
-size_t Event::event_count = 0;
+std::atomic<size_t> Event::event_count{0};
+
+void EventDispatcher::Publish(size_t event_id, Subscriber subscriber)
+{
+  CHECK_LT(event_id, Event::kMaxEventTypes);
+  auto next = std::make_unique<SubscriberList>();
+  if (const SubscriberList* current =
+          lists_[event_id].load(std::memory_order_relaxed))
+  {
+    next->subscribers_.reserve(current->subscribers_.size() + 1);
+    next->subscribers_ = current->subscribers_;
+  }
+  next->subscribers_.push_back(subscriber);
+  lists_[event_id].store(next.get(), std::memory_order_release);
+  snapshots_.push_back(std::move(next));
+}
+
 }  // namespace motor
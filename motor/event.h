@@ -1,9 +1,17 @@
 #ifndef _MOTOR_EVENT_H_
 #define _MOTOR_EVENT_H_
 
+#include <array>
+#include <atomic>
+#include <cstddef>
 #include <functional>
+#include <memory>
 #include <mutex>
-#include <unordered_map>
+#include <type_traits>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/profiler/profiler.h"
 
 namespace motor
 {
@@ -13,52 +21,114 @@ struct Event
   template <typename T>
   using Handler = std::function<void(const T&)>;
 
-  // Note that this only guarantees uniqueness of Id, they might still change
-  // from compilation to compilation. But they will be same within the same
-  // compilation.
+  // Upper bound on the number of distinct event types within a binary. Ids are
+  // used to index fixed size tables, so this must be at least the number of
+  // Event subclasses that are dispatched.
+  static constexpr size_t kMaxEventTypes = 64;
+
+  // Returns a dense id in the range [0, kMaxEventTypes) for T. Ids are assigned
+  // once per type on first use and are stable for the lifetime of the process,
+  // but they might change from run to run.
   template <typename T>
   static size_t GetEventId()
   {
-    const static size_t event_id = ++event_count;
+    const static size_t event_id =
+        event_count.fetch_add(1, std::memory_order_relaxed);
+    CHECK_LT(event_id, kMaxEventTypes) << "Increase Event::kMaxEventTypes";
     return event_id;
   }
 
  private:
-  static size_t event_count;
+  static std::atomic<size_t> event_count;
 };
 
 struct WindowClose : public Event
 {
 };
 
+// Delivers events to any number of subscribers per event type. Dispatch is
+// wait-free: subscriber lists are immutable snapshots that are swapped on
+// Subscribe, hence readers never take a lock. Subscribing is expected to be
+// rare (e.g. during initialization) and is serialized with a mutex. Replaced
+// snapshots are retained until the dispatcher is destroyed, so a concurrent
+// Dispatch can keep iterating over the list it has loaded.
 class EventDispatcher
 {
  public:
+  EventDispatcher() = default;
+  EventDispatcher(const EventDispatcher&) = delete;
+  EventDispatcher& operator=(const EventDispatcher&) = delete;
+  EventDispatcher(EventDispatcher&&) = delete;
+  ~EventDispatcher() = default;
+
   template <typename T>
-  void Set(Event::Handler<T> handler)
+  void Subscribe(Event::Handler<T> handler)
   {
     static_assert(std::is_base_of<Event, T>::value,
-                  "Set expects a class derived from motor::Event");
-    std::lock_guard<std::mutex> lock(handlers_mu_);
-    assert(handlers_.find(T::template GetEventId<T>()) == handlers_.end());
-    handlers_[T::template GetEventId<T>()] =
-        [handler{std::move(handler)}](const Event& event) {
-          handler(static_cast<const T&>(event));
-        };
+                  "Subscribe expects a class derived from motor::Event");
+    OwnedHandler owned(new Event::Handler<T>(std::move(handler)),
+                       [](void* ctx) {
+                         delete static_cast<Event::Handler<T>*>(ctx);
+                       });
+    Subscriber subscriber;
+    subscriber.ctx_ = owned.get();
+    subscriber.thunk_ = [](const void* ctx, const Event& event) {
+      (*static_cast<const Event::Handler<T>*>(ctx))(
+          static_cast<const T&>(event));
+    };
+
+    std::lock_guard<std::mutex> lock(subscribe_mu_);
+    handlers_.push_back(std::move(owned));
+    Publish(Event::GetEventId<T>(), subscriber);
   }
 
   template <typename T>
   void Dispatch(const T& e) const
   {
-    std::lock_guard<std::mutex> lock(handlers_mu_);
-    auto it = handlers_.find(T::template GetEventId<T>());
-    if (it == handlers_.end()) return;
-    it->second(e);
+    static_assert(std::is_base_of<Event, T>::value,
+                  "Dispatch expects a class derived from motor::Event");
+    MOTOR_PROFILE_SCOPE("EventDispatcher::Dispatch");
+    const SubscriberList* list =
+        lists_[Event::GetEventId<T>()].load(std::memory_order_acquire);
+    if (list == nullptr) return;
+    for (const Subscriber& subscriber : list->subscribers_)
+    {
+      subscriber.thunk_(subscriber.ctx_, e);
+    }
+  }
+
+  // Returns true if there is at least one subscriber for T.
+  template <typename T>
+  bool HasSubscribers() const
+  {
+    return lists_[Event::GetEventId<T>()].load(std::memory_order_acquire) !=
+           nullptr;
   }
 
  private:
-  mutable std::mutex handlers_mu_;
-  mutable std::unordered_map<size_t, Event::Handler<Event>> handlers_;
+  // Type erased handler, this avoids going through a second std::function
+  // layer on every call.
+  struct Subscriber
+  {
+    const void* ctx_ = nullptr;
+    void (*thunk_)(const void* ctx, const Event& event) = nullptr;
+  };
+  struct SubscriberList
+  {
+    std::vector<Subscriber> subscribers_;
+  };
+  using OwnedHandler = std::unique_ptr<void, void (*)(void*)>;
+
+  // Must be called with subscribe_mu_ held.
+  void Publish(size_t event_id, Subscriber subscriber);
+
+  std::array<std::atomic<const SubscriberList*>, Event::kMaxEventTypes>
+      lists_{};
+
+  std::mutex subscribe_mu_;
+  // Owns all the snapshots that were ever published.
+  std::vector<std::unique_ptr<const SubscriberList>> snapshots_;
+  std::vector<OwnedHandler> handlers_;
 };
 
 }  // namespace motor
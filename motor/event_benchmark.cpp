@@ -0,0 +1,111 @@
+// Measures the per event cost of EventDispatcher::Dispatch against the mutex
+// and hash map based dispatcher it replaced.
+//   bazel run -c opt //motor:event_benchmark
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "motor/event.h"
+
+namespace motor
+{
+namespace
+{
+constexpr size_t kIterations = 10'000'000;
+
+struct BenchEvent : public Event
+{
+  size_t value_ = 0;
+};
+
+// Copy of the previous implementation, kept here only as a baseline.
+class LegacyEventDispatcher
+{
+ public:
+  template <typename T>
+  void Set(Event::Handler<T> handler)
+  {
+    std::lock_guard<std::mutex> lock(handlers_mu_);
+    handlers_[Event::GetEventId<T>()] =
+        [handler{std::move(handler)}](const Event& event) {
+          handler(static_cast<const T&>(event));
+        };
+  }
+
+  template <typename T>
+  void Dispatch(const T& e) const
+  {
+    std::lock_guard<std::mutex> lock(handlers_mu_);
+    auto it = handlers_.find(Event::GetEventId<T>());
+    if (it == handlers_.end()) return;
+    it->second(e);
+  }
+
+ private:
+  mutable std::mutex handlers_mu_;
+  std::unordered_map<size_t, Event::Handler<Event>> handlers_;
+};
+
+template <typename Dispatcher>
+double NanosPerDispatch(const Dispatcher& dispatcher, size_t num_threads)
+{
+  const size_t per_thread = kIterations / num_threads;
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t)
+  {
+    threads.emplace_back([&dispatcher, per_thread] {
+      BenchEvent event;
+      for (size_t i = 0; i < per_thread; ++i)
+      {
+        event.value_ = i;
+        dispatcher.Dispatch(event);
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / static_cast<double>(per_thread);
+}
+
+void Run()
+{
+  std::atomic<size_t> sink{0};
+  Event::Handler<BenchEvent> handler = [&sink](const BenchEvent& e) {
+    sink.fetch_add(e.value_ & 1, std::memory_order_relaxed);
+  };
+
+  LegacyEventDispatcher legacy;
+  legacy.Set(handler);
+  EventDispatcher single;
+  single.Subscribe(handler);
+  EventDispatcher quad;
+  for (int i = 0; i < 4; ++i) quad.Subscribe(handler);
+
+  const size_t max_threads =
+      std::max<size_t>(1, std::thread::hardware_concurrency());
+  std::printf("%-8s %14s %14s %14s\n", "threads", "legacy ns", "lockfree ns",
+              "lockfree x4 ns");
+  for (size_t threads = 1; threads <= max_threads; threads *= 2)
+  {
+    std::printf("%-8zu %14.2f %14.2f %14.2f\n", threads,
+                NanosPerDispatch(legacy, threads),
+                NanosPerDispatch(single, threads),
+                NanosPerDispatch(quad, threads));
+  }
+  std::printf("(sink %zu)\n", sink.load());
+}
+
+}  // namespace
+}  // namespace motor
+
+int main() { motor::Run(); }
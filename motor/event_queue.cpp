@@ -0,0 +1,123 @@
+#include "event_queue.h"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "motor/event.h"
+
+namespace motor
+{
+namespace
+{
+size_t RoundUpToPowerOfTwo(size_t value)
+{
+  size_t result = 1;
+  while (result < value) result <<= 1;
+  return result;
+}
+}  // namespace
+
+EventQueue::EventQueue(size_t capacity)
+    : mask_(RoundUpToPowerOfTwo(capacity < 2 ? 2 : capacity) - 1),
+      slots_(new Slot[mask_ + 1])
+{
+  for (size_t i = 0; i <= mask_; ++i)
+  {
+    slots_[i].sequence_.store(i, std::memory_order_relaxed);
+  }
+  batch_.reserve(mask_ + 1);
+  sorted_.resize(mask_ + 1);
+}
+
+EventQueue::~EventQueue()
+{
+  // Destroy events that were never drained.
+  for (size_t pos = head_;; ++pos)
+  {
+    Slot& slot = slots_[pos & mask_];
+    if (slot.sequence_.load(std::memory_order_acquire) != pos + 1) break;
+    slot.event_->~Event();
+  }
+}
+
+EventQueue::Slot* EventQueue::Claim()
+{
+  size_t pos = tail_.load(std::memory_order_relaxed);
+  while (true)
+  {
+    Slot& slot = slots_[pos & mask_];
+    const size_t seq = slot.sequence_.load(std::memory_order_acquire);
+    const auto diff =
+        static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+    if (diff == 0)
+    {
+      if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        slot.claimed_pos_ = pos;
+        return &slot;
+      }
+    }
+    else if (diff < 0)
+    {
+      overflows_.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    else
+    {
+      pos = tail_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+size_t EventQueue::Drain(const EventDispatcher& dispatcher)
+{
+  batch_.clear();
+  for (size_t pos = head_; batch_.size() <= mask_; ++pos)
+  {
+    Slot& slot = slots_[pos & mask_];
+    if (slot.sequence_.load(std::memory_order_acquire) != pos + 1) break;
+    batch_.push_back(&slot);
+  }
+
+  // Stable counting sort on event ids, so that handlers of the same type run
+  // back to back while keeping the order within a type.
+  std::array<size_t, Event::kMaxEventTypes + 1> offsets{};
+  for (const Slot* slot : batch_) ++offsets[slot->event_id_ + 1];
+  for (size_t i = 1; i < offsets.size(); ++i) offsets[i] += offsets[i - 1];
+  for (Slot* slot : batch_) sorted_[offsets[slot->event_id_]++] = slot;
+
+  const size_t count = batch_.size();
+  for (size_t i = 0; i < count; ++i)
+  {
+    sorted_[i]->dispatch_(dispatcher, *sorted_[i]->event_);
+  }
+
+  // Release slots in queue order.
+  for (Slot* slot : batch_)
+  {
+    slot->event_->~Event();
+    slot->sequence_.store(head_ + mask_ + 1, std::memory_order_release);
+    ++head_;
+  }
+
+  frame_events_.store(count, std::memory_order_relaxed);
+  if (count > peak_frame_events_.load(std::memory_order_relaxed))
+  {
+    peak_frame_events_.store(count, std::memory_order_relaxed);
+  }
+  return count;
+}
+
+EventQueueStats EventQueue::GetStats() const
+{
+  EventQueueStats stats;
+  stats.frame_events_ = frame_events_.load(std::memory_order_relaxed);
+  stats.peak_frame_events_ = peak_frame_events_.load(std::memory_order_relaxed);
+  stats.overflows_ = overflows_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+}  // namespace motor
@@ -0,0 +1,107 @@
+#ifndef _MOTOR_EVENT_QUEUE_H_
+#define _MOTOR_EVENT_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "motor/event.h"
+
+namespace motor
+{
+struct EventQueueStats
+{
+  // Number of events dispatched by the last Drain.
+  size_t frame_events_ = 0;
+  // Maximum of frame_events_ seen so far.
+  size_t peak_frame_events_ = 0;
+  // Number of Push calls that failed because the queue was full.
+  size_t overflows_ = 0;
+};
+
+// Bounded multi-producer single-consumer queue of events. Events are
+// constructed in place into pre-allocated slots, so pushing never allocates.
+// Any thread can Push, but only a single thread (the one running
+// Engine::MainLoop) can Drain.
+//
+// Drain dispatches events grouped by their type, order of events is preserved
+// only among events of the same type.
+class EventQueue
+{
+ public:
+  // Upper bound for sizeof of an event that can be queued.
+  static constexpr size_t kMaxEventSize = 128;
+
+  // Capacity is rounded up to the next power of two.
+  explicit EventQueue(size_t capacity);
+  EventQueue(const EventQueue&) = delete;
+  EventQueue& operator=(const EventQueue&) = delete;
+  EventQueue(EventQueue&&) = delete;
+  ~EventQueue();
+
+  // Returns false if the queue is full, in which case |event| is left intact.
+  template <typename T>
+  bool Push(T&& event)
+  {
+    using EventT = std::decay_t<T>;
+    static_assert(std::is_base_of<Event, EventT>::value,
+                  "Push expects a class derived from motor::Event");
+    static_assert(sizeof(EventT) <= kMaxEventSize,
+                  "Event is too big, increase EventQueue::kMaxEventSize");
+    static_assert(alignof(EventT) <= alignof(std::max_align_t));
+
+    Slot* slot = Claim();
+    if (slot == nullptr) return false;
+    slot->event_id_ = Event::GetEventId<EventT>();
+    slot->event_ = new (slot->storage_) EventT(std::forward<T>(event));
+    slot->dispatch_ = [](const EventDispatcher& dispatcher,
+                         const Event& event) {
+      dispatcher.Dispatch(static_cast<const EventT&>(event));
+    };
+    slot->sequence_.store(slot->claimed_pos_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Dispatches all events pushed before the call and returns their count.
+  // Events pushed by handlers while draining are delivered on the next call.
+  size_t Drain(const EventDispatcher& dispatcher);
+
+  EventQueueStats GetStats() const;
+  size_t Capacity() const { return mask_ + 1; }
+
+ private:
+  struct Slot
+  {
+    std::atomic<size_t> sequence_;
+    size_t claimed_pos_ = 0;
+    size_t event_id_ = 0;
+    Event* event_ = nullptr;
+    void (*dispatch_)(const EventDispatcher&, const Event&) = nullptr;
+    alignas(std::max_align_t) unsigned char storage_[kMaxEventSize];
+  };
+
+  // Reserves the next free slot, returns nullptr if the queue is full.
+  Slot* Claim();
+
+  const size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  alignas(64) std::atomic<size_t> tail_{0};
+  alignas(64) size_t head_ = 0;
+
+  // Scratch space for Drain, sized once at construction.
+  std::vector<Slot*> batch_;
+  std::vector<Slot*> sorted_;
+
+  std::atomic<size_t> overflows_{0};
+  std::atomic<size_t> frame_events_{0};
+  std::atomic<size_t> peak_frame_events_{0};
+};
+
+}  // namespace motor
+
+#endif
@@ -0,0 +1,87 @@
+// Drives Engine::MainLoop with a headless window and an offscreen renderer,
+// then prints frame time percentiles.
+//   bazel run -c opt //motor:frame_benchmark -- [num_frames]
+// Replaying a recorded input session instead, the run ends with the log if it
+// has less than num_frames frames:
+//   bazel run -c opt //motor:replay_benchmark -- [num_frames] input_log
+// Simulation costs alone can be measured with --renderer_backend=null.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "motor/engine.h"
+#include "motor/render/renderer.h"
+#include "motor/window.h"
+
+namespace motor
+{
+namespace
+{
+constexpr const size_t kDefaultFrames = 1000;
+// First frames include pipeline and allocator warm up.
+constexpr const size_t kWarmupFrames = 10;
+
+double Percentile(const std::vector<double>& sorted, double p)
+{
+  const size_t idx = static_cast<size_t>(std::ceil(p * sorted.size()));
+  return sorted[std::min(sorted.size() - 1, idx == 0 ? 0 : idx - 1)];
+}
+
+void Run(size_t num_frames, const char* input_log)
+{
+  std::vector<double> frame_ms;
+  frame_ms.reserve(num_frames + kWarmupFrames);
+  {
+    Engine engine;
+    WindowOptions window_opts;
+    window_opts.title_ = "frame_benchmark";
+    window_opts.width_ = 800;
+    window_opts.height_ = 600;
+    if (input_log != nullptr) window_opts.input_replay_path_ = input_log;
+    engine.InitializeWindow(std::move(window_opts));
+
+    RendererOptions renderer_opts;
+    renderer_opts.offscreen_ = true;
+    engine.InitializeRenderer(std::move(renderer_opts));
+
+    LoopOptions loop_opts;
+    loop_opts.max_frames_ = num_frames + kWarmupFrames;
+    engine.SetLoopOptions(loop_opts);
+    engine.RegisterFrameEnd([&frame_ms](const FrameStats& stats) {
+      frame_ms.push_back(stats.frame_ms_);
+    });
+    engine.MainLoop();
+  }
+
+  frame_ms.erase(frame_ms.begin(),
+                 frame_ms.begin() + std::min(kWarmupFrames, frame_ms.size()));
+  if (frame_ms.empty()) return;
+  std::sort(frame_ms.begin(), frame_ms.end());
+  double total_ms = 0;
+  for (double ms : frame_ms) total_ms += ms;
+
+  std::printf("%zu frames, %.3f ms mean\n", frame_ms.size(),
+              total_ms / frame_ms.size());
+  std::printf("%-6s %10s\n", "", "ms");
+  std::printf("%-6s %10.3f\n", "p50", Percentile(frame_ms, .50));
+  std::printf("%-6s %10.3f\n", "p95", Percentile(frame_ms, .95));
+  std::printf("%-6s %10.3f\n", "p99", Percentile(frame_ms, .99));
+  std::printf("%-6s %10.3f\n", "max", frame_ms.back());
+}
+
+}  // namespace
+}  // namespace motor
+
+int main(int argc, char** argv)
+{
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+  const size_t num_frames =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : motor::kDefaultFrames;
+  motor::Run(num_frames, argc > 2 ? argv[2] : nullptr);
+}
@@ -0,0 +1,108 @@
+#include "action_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/input/input.h"
+
+namespace motor::input
+{
+namespace
+{
+float ApplyDeadZone(float value, float dead_zone)
+{
+  const float magnitude = std::abs(value);
+  if (magnitude <= dead_zone) return 0;
+  const float rescaled = (magnitude - dead_zone) / (1.f - dead_zone);
+  return std::copysign(std::min(rescaled, 1.f), value);
+}
+}  // namespace
+
+ActionMap::ActionMap(size_t num_actions,
+                     const std::vector<ActionBinding>& bindings)
+    : action_begin_(num_actions + 1, 0), states_(num_actions)
+{
+  // Counting sort by action, keeps the declaration order within an action.
+  for (const ActionBinding& binding : bindings)
+  {
+    CHECK_LT(binding.action_, num_actions);
+    CHECK_LT(binding.device_id_, kMaxDevices);
+    CHECK_LT(binding.id_, binding.is_axis_ ? kNumAxes : kNumKeys);
+    CHECK(binding.modifier_ == ActionBinding::kNoModifier ||
+          binding.modifier_ < kNumKeys);
+    CHECK(binding.dead_zone_ >= 0 && binding.dead_zone_ < 1)
+        << "Dead zone must be in [0, 1)";
+    ++action_begin_[binding.action_ + 1];
+  }
+  for (size_t i = 0; i < num_actions; ++i)
+  {
+    action_begin_[i + 1] += action_begin_[i];
+  }
+
+  std::vector<uint32_t> next(action_begin_.begin(), action_begin_.end() - 1);
+  bindings_.resize(bindings.size());
+  for (const ActionBinding& binding : bindings)
+  {
+    CompiledBinding& compiled = bindings_[next[binding.action_]++];
+    compiled.device_id_ = binding.device_id_;
+    compiled.id_ = binding.id_;
+    compiled.modifier_ = binding.modifier_ == ActionBinding::kNoModifier
+                             ? kNumKeys
+                             : binding.modifier_;
+    compiled.is_axis_ = binding.is_axis_;
+    compiled.dead_zone_ = binding.dead_zone_;
+    compiled.scale_ = binding.scale_;
+  }
+}
+
+void ActionMap::Update(const InputState& state)
+{
+  const InputFrame& frame = state.Current();
+  for (size_t action = 0; action < states_.size(); ++action)
+  {
+    float value = 0;
+    bool tapped = false;
+    for (uint32_t i = action_begin_[action]; i < action_begin_[action + 1];
+         ++i)
+    {
+      const CompiledBinding& binding = bindings_[i];
+      const DeviceInputState& device = frame.devices_[binding.device_id_];
+      if (binding.modifier_ != kNumKeys &&
+          !device.down_.Test(binding.modifier_))
+      {
+        continue;
+      }
+
+      float binding_value;
+      if (binding.is_axis_)
+      {
+        binding_value = ApplyDeadZone(device.axes_[binding.id_],
+                                      binding.dead_zone_);
+      }
+      else
+      {
+        const bool is_down = device.down_.Test(binding.id_);
+        tapped |= !is_down && device.pressed_.Test(binding.id_);
+        binding_value = is_down ? 1.f : 0.f;
+      }
+      binding_value *= binding.scale_;
+      if (std::abs(binding_value) > std::abs(value)) value = binding_value;
+    }
+
+    ActionState& action_state = states_[action];
+    const bool was_held = action_state.held_;
+    const bool held = value != 0;
+    // A tap only counts if the action wasn't held through other bindings.
+    const bool tap = tapped && !was_held && !held;
+    action_state.value_ = value;
+    action_state.held_ = held;
+    action_state.pressed_ = (held && !was_held) || tap;
+    action_state.released_ = (!held && was_held) || tap;
+  }
+}
+
+}  // namespace motor::input
@@ -0,0 +1,85 @@
+#ifndef _MOTOR_INPUT_ACTION_MAP_H_
+#define _MOTOR_INPUT_ACTION_MAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "motor/input/input.h"
+
+namespace motor::input
+{
+struct ActionBinding
+{
+  static constexpr size_t kNoModifier = std::numeric_limits<size_t>::max();
+
+  // Dense id of the action in the range [0, num_actions).
+  size_t action_ = 0;
+  size_t device_id_ = 0;
+  // Key or axis id, depending on is_axis_.
+  size_t id_ = 0;
+  bool is_axis_ = false;
+  // Key on the same device that must be held for the binding to be active,
+  // e.g. ctrl for ctrl+s.
+  size_t modifier_ = kNoModifier;
+  // Axis values with a magnitude below this are treated as zero, the rest is
+  // rescaled to start from zero at the edge of the dead zone.
+  float dead_zone_ = 0;
+  // Multiplied with the value of the binding, e.g. -1 to invert an axis or map
+  // a key to the negative side of an action.
+  float scale_ = 1;
+};
+
+struct ActionState
+{
+  // Value with the largest magnitude among the active bindings of the action,
+  // keys contribute their scale_ when held.
+  float value_ = 0;
+  // Whether value_ is non-zero.
+  bool held_ = false;
+  // Whether the action became held/released this frame. Both are set if a
+  // bound key was pressed and released within the frame while the action was
+  // otherwise idle.
+  bool pressed_ = false;
+  bool released_ = false;
+};
+
+// Maps raw input to game actions. Bindings are compiled once into a flat
+// array grouped by action, Update evaluates them against the input state once
+// per frame into a contiguous array of action states. Consumers then query
+// actions in O(1) without scanning input or tracking edges on their own.
+class ActionMap
+{
+ public:
+  ActionMap() = default;
+  ActionMap(size_t num_actions, const std::vector<ActionBinding>& bindings);
+
+  // Doesn't allocate.
+  void Update(const InputState& state);
+
+  const ActionState& Get(size_t action) const { return states_[action]; }
+  const std::vector<ActionState>& GetStates() const { return states_; }
+  size_t NumActions() const { return states_.size(); }
+
+ private:
+  struct CompiledBinding
+  {
+    uint16_t device_id_;
+    uint16_t id_;
+    // kNumKeys if there is no modifier.
+    uint16_t modifier_;
+    bool is_axis_;
+    float dead_zone_;
+    float scale_;
+  };
+
+  // Bindings of action i are in [action_begin_[i], action_begin_[i + 1]).
+  std::vector<CompiledBinding> bindings_;
+  std::vector<uint32_t> action_begin_;
+  std::vector<ActionState> states_;
+};
+
+}  // namespace motor::input
+
+#endif
@@ -1,7 +1,11 @@
 #ifndef _MOTOR_INPUT_DEVICE_H_
 #define _MOTOR_INPUT_DEVICE_H_
 
+#include <cstddef>
+#include <cstdint>
+
 #include "motor/event.h"
+#include "motor/input/input.h"
 
 namespace motor::input
 {
@@ -15,6 +19,39 @@ struct DeviceConfigChange : public Event
   } status_ = DISCONNECTED;
 };
 
+// Set of connected device ids, maintained from DeviceConfigChange events. Fits
+// into a single word so it can be copied around freely, e.g. through an
+// std::atomic.
+class DeviceSet
+{
+ public:
+  static_assert(kMaxDevices <= 64);
+
+  void Apply(const DeviceConfigChange& change)
+  {
+    const uint64_t bit = uint64_t{1} << change.device_id_;
+    mask_ = change.status_ == DeviceConfigChange::CONNECTED ? (mask_ | bit)
+                                                            : (mask_ & ~bit);
+  }
+  bool IsConnected(size_t device_id) const
+  {
+    return (mask_ >> device_id) & 1;
+  }
+  bool Empty() const { return mask_ == 0; }
+  // Calls |fn| with the id of every connected device in increasing order.
+  template <typename Fn>
+  void ForEach(Fn&& fn) const
+  {
+    for (uint64_t mask = mask_; mask != 0; mask &= mask - 1)
+    {
+      fn(static_cast<size_t>(__builtin_ctzll(mask)));
+    }
+  }
+
+ private:
+  uint64_t mask_ = 0;
+};
+
 }  // namespace motor::input
 
 #endif
@@ -1 +1,37 @@
 #include "input.h"
+
+#include <chrono>
+#include <cstddef>
+
+namespace motor::input
+{
+void InputState::BeginFrame()
+{
+  const InputFrame& previous = frames_[current_];
+  current_ ^= 1;
+  InputFrame& current = MutableCurrent();
+  for (size_t i = 0; i < kMaxDevices; ++i)
+  {
+    DeviceInputState& device = current.devices_[i];
+    device.down_ = previous.devices_[i].down_;
+    device.axes_ = previous.devices_[i].axes_;
+    device.pressed_ = KeyBits();
+    device.released_ = KeyBits();
+  }
+  current.cursor_ = previous.cursor_;
+  current.input_time_ = std::chrono::steady_clock::time_point();
+}
+
+void InputState::ResetDevice(size_t device_id)
+{
+  assert(device_id < kMaxDevices);
+  DeviceInputState& device = MutableCurrent().devices_[device_id];
+  for (size_t i = 0; i < KeyBits::kNumWords; ++i)
+  {
+    device.released_.words_[i] |= device.down_.words_[i];
+  }
+  device.down_ = KeyBits();
+  device.axes_ = {};
+}
+
+}  // namespace motor::input
@@ -1,7 +1,11 @@
 #ifndef _MOTOR_INPUT_INPUT_H_
 #define _MOTOR_INPUT_INPUT_H_
 
-#include <vector>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 
 #include "motor/event.h"
 
@@ -10,40 +14,157 @@ namespace motor::input
 // TODO(kadircet): the following should come from enums, once we have them...
 constexpr const size_t kNumKeys = 512;
 constexpr const size_t kNumAxes = 8;
+// Keyboard, mouse and up to 16 gamepads.
+constexpr const size_t kMaxDevices = 18;
 
-struct KeyInput
+struct CursorPosition
+{
+  // Relative to upper left corner of context.
+  double x_ = 0;
+  double y_ = 0;
+};
+
+// Fixed size bitset over key ids. Words are laid out contiguously and cache
+// line aligned, so whole set operations compile down to a few vector
+// instructions.
+struct alignas(64) KeyBits
 {
-  size_t device_id_ = 0;
-  // TODO(kadircet): Come up with an enum for these.
-  int id_ = 0;
-  bool is_down_ = false;
+  static constexpr size_t kNumWords = kNumKeys / 64;
+  static_assert(kNumKeys % 64 == 0);
+
+  bool Test(size_t key) const
+  {
+    return (words_[key / 64] >> (key % 64)) & 1;
+  }
+  void Set(size_t key, bool value)
+  {
+    const uint64_t mask = uint64_t{1} << (key % 64);
+    words_[key / 64] = value ? (words_[key / 64] | mask)
+                             : (words_[key / 64] & ~mask);
+  }
+  bool Any() const
+  {
+    uint64_t any = 0;
+    for (uint64_t word : words_) any |= word;
+    return any != 0;
+  }
+  // Calls |fn| with the id of every set key in increasing order.
+  template <typename Fn>
+  void ForEach(Fn&& fn) const
+  {
+    for (size_t i = 0; i < kNumWords; ++i)
+    {
+      for (uint64_t word = words_[i]; word != 0; word &= word - 1)
+      {
+        fn(i * 64 + __builtin_ctzll(word));
+      }
+    }
+  }
+
+  std::array<uint64_t, kNumWords> words_ = {};
 };
 
-struct AxisInput
+struct DeviceInputState
 {
-  size_t device_id_ = 0;
-  // TODO(kadircet): Come up with an enum for these.
-  int id_ = 0;
+  // Keys that are held down at the end of the frame.
+  KeyBits down_;
+  // Keys that went down or up at any point during the frame. These are
+  // accumulated rather than derived from down_, so that a key that is pressed
+  // and released within a single frame is still observed.
+  KeyBits pressed_;
+  KeyBits released_;
   // In the range [-1., 1]
-  float value_ = 0;
+  std::array<float, kNumAxes> axes_ = {};
 };
 
-struct CursorPosition
+struct InputFrame
 {
-  // Relative to upper left corner of context.
-  double x_ = 0;
-  double y_ = 0;
+  std::array<DeviceInputState, kMaxDevices> devices_;
+  CursorPosition cursor_;
+  // Time of the earliest input event received within the frame, default
+  // constructed if there were none. Used to trace input latency.
+  std::chrono::steady_clock::time_point input_time_;
+};
+
+// Fixed layout state of all input devices, double-buffered to compare the
+// current frame against the previous one. Updating and querying never
+// allocates. Written by the window during Window::Update, read by everyone
+// else afterwards.
+class InputState
+{
+ public:
+  // Starts a new frame: current state becomes the previous one and keys/axes
+  // carry over, per frame edges are cleared.
+  void BeginFrame();
+
+  void SetKey(size_t device_id, size_t key, bool is_down)
+  {
+    assert(device_id < kMaxDevices && key < kNumKeys);
+    DeviceInputState& device = MutableCurrent().devices_[device_id];
+    if (device.down_.Test(key) == is_down) return;
+    device.down_.Set(key, is_down);
+    (is_down ? device.pressed_ : device.released_).Set(key, true);
+  }
+  void SetAxis(size_t device_id, size_t axis, float value)
+  {
+    assert(device_id < kMaxDevices && axis < kNumAxes);
+    MutableCurrent().devices_[device_id].axes_[axis] = value;
+  }
+  // Marks the frame as containing input that happened at |time|.
+  void MarkInput(std::chrono::steady_clock::time_point time)
+  {
+    std::chrono::steady_clock::time_point& input_time =
+        MutableCurrent().input_time_;
+    if (input_time == std::chrono::steady_clock::time_point() ||
+        time < input_time)
+    {
+      input_time = time;
+    }
+  }
+  void SetCursor(const CursorPosition& cursor)
+  {
+    MutableCurrent().cursor_ = cursor;
+  }
+  // Releases all held keys of the device and centers its axes, e.g. once it
+  // is disconnected and nothing will report the releases anymore.
+  void ResetDevice(size_t device_id);
+
+  bool IsDown(size_t device_id, size_t key) const
+  {
+    return Current().devices_[device_id].down_.Test(key);
+  }
+  // Whether the key went down/up during the last frame.
+  bool WasPressed(size_t device_id, size_t key) const
+  {
+    return Current().devices_[device_id].pressed_.Test(key);
+  }
+  bool WasReleased(size_t device_id, size_t key) const
+  {
+    return Current().devices_[device_id].released_.Test(key);
+  }
+  float GetAxis(size_t device_id, size_t axis) const
+  {
+    return Current().devices_[device_id].axes_[axis];
+  }
+
+  // For producers that write whole frames at once, e.g. input replay.
+  void ReplaceCurrent(const InputFrame& frame) { MutableCurrent() = frame; }
+
+  const InputFrame& Current() const { return frames_[current_]; }
+  const InputFrame& Previous() const { return frames_[current_ ^ 1]; }
+
+ private:
+  InputFrame& MutableCurrent() { return frames_[current_]; }
+
+  std::array<InputFrame, 2> frames_;
+  size_t current_ = 0;
 };
 
-// This event contains information regarding current state of the input. It is
-// not an "on change" event. Senders can ignore inputs that hasn't change state.
-// If the receiver cares about "on change" events, it must handle the
-// bookkeeping on its own.
+// Sent once per frame after the window has updated its InputState. The state
+// is owned by the window and stays valid until the next Window::Update.
 struct InputStateBroadcast : public Event
 {
-  std::vector<KeyInput> keys_;
-  std::vector<AxisInput> axes_;
-  CursorPosition cursor_;
+  const InputState* state_ = nullptr;
 };
 
 }  // namespace motor::input
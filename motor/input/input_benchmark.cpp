@@ -0,0 +1,193 @@
+// Measures the per frame cost of producing and consuming input through the
+// fixed layout InputState against the vector based broadcast it replaced.
+//   bazel run -c opt //motor/input:input_benchmark
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "motor/event.h"
+#include "motor/input/input.h"
+
+namespace
+{
+size_t num_allocations = 0;
+}  // namespace
+
+void* operator new(size_t size)
+{
+  ++num_allocations;
+  if (void* ptr = std::malloc(size)) return ptr;
+  throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t /*size*/) noexcept { std::free(ptr); }
+
+namespace motor::input
+{
+namespace
+{
+constexpr size_t kFrames = 1'000'000;
+constexpr size_t kNumGamepads = 4;
+constexpr size_t kFirstGamepadId = 2;
+constexpr size_t kGamepadButtons = 15;
+constexpr size_t kGamepadAxes = 6;
+constexpr size_t kJumpKey = 32;
+
+// Copy of the previous event layout, kept here only as a baseline.
+struct LegacyKeyInput
+{
+  size_t device_id_ = 0;
+  int id_ = 0;
+  bool is_down_ = false;
+};
+
+struct LegacyAxisInput
+{
+  size_t device_id_ = 0;
+  int id_ = 0;
+  float value_ = 0;
+};
+
+struct LegacyInputStateBroadcast : public Event
+{
+  std::vector<LegacyKeyInput> keys_;
+  std::vector<LegacyAxisInput> axes_;
+  CursorPosition cursor_;
+};
+
+// Each frame the jump key toggles and all gamepads report their full state,
+// like the GLFW window does.
+bool JumpDown(size_t frame) { return frame % 2 == 0; }
+float AxisValue(size_t frame, size_t axis)
+{
+  return static_cast<float>((frame + axis) % 200) / 100.f - 1.f;
+}
+
+struct Result
+{
+  double ns_per_frame_ = 0;
+  double allocations_per_frame_ = 0;
+};
+
+Result RunLegacy(size_t* sink)
+{
+  EventDispatcher dispatcher;
+  // Consumer has to scan everything and keep its own "on change" state.
+  bool was_down = false;
+  dispatcher.Subscribe<LegacyInputStateBroadcast>(
+      [sink, &was_down](const LegacyInputStateBroadcast& broadcast) {
+        for (const LegacyKeyInput& key : broadcast.keys_)
+        {
+          if (key.device_id_ != 0 || key.id_ != kJumpKey) continue;
+          if (key.is_down_ && !was_down) ++*sink;
+          was_down = key.is_down_;
+        }
+        for (const LegacyAxisInput& axis : broadcast.axes_)
+        {
+          if (axis.value_ > .5f) ++*sink;
+        }
+      });
+
+  const size_t start_allocations = num_allocations;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t frame = 0; frame < kFrames; ++frame)
+  {
+    LegacyInputStateBroadcast broadcast;
+    broadcast.keys_.push_back({0, kJumpKey, JumpDown(frame)});
+    for (size_t pad = 0; pad < kNumGamepads; ++pad)
+    {
+      for (size_t button = 0; button < kGamepadButtons; ++button)
+      {
+        LegacyKeyInput& key = broadcast.keys_.emplace_back();
+        key.device_id_ = kFirstGamepadId + pad;
+        key.id_ = button;
+        key.is_down_ = false;
+      }
+      for (size_t axis = 0; axis < kGamepadAxes; ++axis)
+      {
+        LegacyAxisInput& axis_inp = broadcast.axes_.emplace_back();
+        axis_inp.device_id_ = kFirstGamepadId + pad;
+        axis_inp.id_ = axis;
+        axis_inp.value_ = AxisValue(frame, axis);
+      }
+    }
+    dispatcher.Dispatch(broadcast);
+  }
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return {elapsed.count() / kFrames,
+          static_cast<double>(num_allocations - start_allocations) / kFrames};
+}
+
+Result RunSnapshot(size_t* sink)
+{
+  EventDispatcher dispatcher;
+  dispatcher.Subscribe<InputStateBroadcast>(
+      [sink](const InputStateBroadcast& broadcast) {
+        const InputState& state = *broadcast.state_;
+        if (state.WasPressed(0, kJumpKey)) ++*sink;
+        for (size_t pad = 0; pad < kNumGamepads; ++pad)
+        {
+          for (size_t axis = 0; axis < kGamepadAxes; ++axis)
+          {
+            if (state.GetAxis(kFirstGamepadId + pad, axis) > .5f) ++*sink;
+          }
+        }
+      });
+
+  // Allocated up front, like the window owning it.
+  auto state = std::make_unique<InputState>();
+  const size_t start_allocations = num_allocations;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t frame = 0; frame < kFrames; ++frame)
+  {
+    state->BeginFrame();
+    state->SetKey(0, kJumpKey, JumpDown(frame));
+    for (size_t pad = 0; pad < kNumGamepads; ++pad)
+    {
+      for (size_t button = 0; button < kGamepadButtons; ++button)
+      {
+        state->SetKey(kFirstGamepadId + pad, button, false);
+      }
+      for (size_t axis = 0; axis < kGamepadAxes; ++axis)
+      {
+        state->SetAxis(kFirstGamepadId + pad, axis, AxisValue(frame, axis));
+      }
+    }
+    InputStateBroadcast broadcast;
+    broadcast.state_ = state.get();
+    dispatcher.Dispatch(broadcast);
+  }
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return {elapsed.count() / kFrames,
+          static_cast<double>(num_allocations - start_allocations) / kFrames};
+}
+
+void Run()
+{
+  size_t legacy_sink = 0;
+  size_t snapshot_sink = 0;
+  const Result legacy = RunLegacy(&legacy_sink);
+  const Result snapshot = RunSnapshot(&snapshot_sink);
+  std::printf("%zu gamepads, %zu frames\n", kNumGamepads, kFrames);
+  std::printf("%-10s %12s %14s\n", "", "ns/frame", "allocs/frame");
+  std::printf("%-10s %12.1f %14.2f\n", "broadcast", legacy.ns_per_frame_,
+              legacy.allocations_per_frame_);
+  std::printf("%-10s %12.1f %14.2f\n", "snapshot", snapshot.ns_per_frame_,
+              snapshot.allocations_per_frame_);
+  if (legacy_sink != snapshot_sink)
+  {
+    std::printf("Mismatch: %zu vs %zu\n", legacy_sink, snapshot_sink);
+  }
+}
+
+}  // namespace
+}  // namespace motor::input
+
+int main() { motor::input::Run(); }
@@ -0,0 +1,309 @@
+#include "input_log.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/input/device.h"
+#include "motor/input/input.h"
+
+namespace motor::input
+{
+namespace
+{
+constexpr const uint32_t kLogMagic = 0x5249544D;  // "MTIR"
+constexpr const uint32_t kLogVersion = 1;
+// Buffered records are written out once they exceed this size.
+constexpr const size_t kFlushThreshold = 64 << 10;
+
+enum RecordTag : uint8_t
+{
+  kDeviceConfigChangeTag = 0,
+  kFrameTag = 1,
+};
+
+struct LogHeader
+{
+  uint32_t magic_ = kLogMagic;
+  uint32_t version_ = kLogVersion;
+};
+
+// Bits of the per device change mask, each bit marks a word that follows the
+// mask, in the order of the bits.
+constexpr const size_t kDownShift = 0;
+constexpr const size_t kPressedShift = KeyBits::kNumWords;
+constexpr const size_t kReleasedShift = 2 * KeyBits::kNumWords;
+constexpr const size_t kAxesShift = 3 * KeyBits::kNumWords;
+static_assert(kAxesShift + kNumAxes <= 64);
+static_assert(kMaxDevices <= 256);
+
+void WriteVarint(uint64_t value, std::vector<uint8_t>* out)
+{
+  while (value >= 0x80)
+  {
+    out->push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+template <typename T>
+void WriteRaw(const T& value, std::vector<uint8_t>* out)
+{
+  const size_t offset = out->size();
+  out->resize(offset + sizeof(T));
+  std::memcpy(out->data() + offset, &value, sizeof(T));
+}
+}  // namespace
+
+InputLogWriter::InputLogWriter(const std::string& path)
+    : out_(path, std::ios::binary | std::ios::trunc),
+      start_(std::chrono::steady_clock::now())
+{
+  CHECK(out_) << "Couldn't open input log " << path;
+  buffer_.reserve(kFlushThreshold * 2);
+  WriteRaw(LogHeader(), &buffer_);
+  LOG(INFO) << "Recording input to " << path;
+}
+
+InputLogWriter::~InputLogWriter()
+{
+  Flush();
+  LOG(INFO) << "Recorded " << num_frames_ << " frames of input";
+}
+
+void InputLogWriter::Flush()
+{
+  out_.write(reinterpret_cast<const char*>(buffer_.data()), buffer_.size());
+  LOG_IF(WARNING, !out_) << "Couldn't write input log";
+  buffer_.clear();
+}
+
+void InputLogWriter::Record(const DeviceConfigChange& change)
+{
+  buffer_.push_back(kDeviceConfigChangeTag);
+  buffer_.push_back(static_cast<uint8_t>(change.device_id_));
+  buffer_.push_back(static_cast<uint8_t>(change.status_));
+}
+
+void InputLogWriter::Record(const InputStateBroadcast& broadcast)
+{
+  const InputFrame& current = broadcast.state_->Current();
+  const uint64_t timestamp_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start_)
+          .count();
+  buffer_.push_back(kFrameTag);
+  WriteVarint(timestamp_us - last_timestamp_us_, &buffer_);
+  last_timestamp_us_ = timestamp_us;
+
+  // Device count isn't known upfront, reserve a byte and patch it later.
+  // Count and the cursor flag always fit into a single byte varint.
+  static_assert(kMaxDevices * 2 + 1 < 0x80);
+  const size_t count_offset = buffer_.size();
+  buffer_.push_back(0);
+  size_t num_devices = 0;
+  for (size_t device_id = 0; device_id < kMaxDevices; ++device_id)
+  {
+    const DeviceInputState& device = current.devices_[device_id];
+    const DeviceInputState& previous = previous_.devices_[device_id];
+    uint64_t mask = 0;
+    for (size_t i = 0; i < KeyBits::kNumWords; ++i)
+    {
+      if (device.down_.words_[i] != previous.down_.words_[i])
+      {
+        mask |= uint64_t{1} << (kDownShift + i);
+      }
+      if (device.pressed_.words_[i] != 0)
+      {
+        mask |= uint64_t{1} << (kPressedShift + i);
+      }
+      if (device.released_.words_[i] != 0)
+      {
+        mask |= uint64_t{1} << (kReleasedShift + i);
+      }
+    }
+    for (size_t i = 0; i < kNumAxes; ++i)
+    {
+      if (device.axes_[i] != previous.axes_[i])
+      {
+        mask |= uint64_t{1} << (kAxesShift + i);
+      }
+    }
+    if (mask == 0) continue;
+
+    ++num_devices;
+    buffer_.push_back(static_cast<uint8_t>(device_id));
+    WriteVarint(mask, &buffer_);
+    for (size_t i = 0; i < KeyBits::kNumWords; ++i)
+    {
+      if (mask & (uint64_t{1} << (kDownShift + i)))
+      {
+        WriteRaw(device.down_.words_[i] ^ previous.down_.words_[i], &buffer_);
+      }
+    }
+    for (size_t i = 0; i < KeyBits::kNumWords; ++i)
+    {
+      if (mask & (uint64_t{1} << (kPressedShift + i)))
+      {
+        WriteRaw(device.pressed_.words_[i], &buffer_);
+      }
+    }
+    for (size_t i = 0; i < KeyBits::kNumWords; ++i)
+    {
+      if (mask & (uint64_t{1} << (kReleasedShift + i)))
+      {
+        WriteRaw(device.released_.words_[i], &buffer_);
+      }
+    }
+    for (size_t i = 0; i < kNumAxes; ++i)
+    {
+      if (mask & (uint64_t{1} << (kAxesShift + i)))
+      {
+        WriteRaw(device.axes_[i], &buffer_);
+      }
+    }
+  }
+
+  const bool cursor_changed = current.cursor_.x_ != previous_.cursor_.x_ ||
+                              current.cursor_.y_ != previous_.cursor_.y_;
+  buffer_[count_offset] = static_cast<uint8_t>(num_devices << 1) |
+                          static_cast<uint8_t>(cursor_changed);
+  if (cursor_changed)
+  {
+    WriteRaw(current.cursor_.x_, &buffer_);
+    WriteRaw(current.cursor_.y_, &buffer_);
+  }
+
+  previous_ = current;
+  ++num_frames_;
+  if (buffer_.size() >= kFlushThreshold) Flush();
+}
+
+InputLogReader::InputLogReader(const std::string& path)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  CHECK(fd >= 0) << "Couldn't open input log " << path;
+  struct stat file_stat;
+  CHECK(fstat(fd, &file_stat) == 0) << "Couldn't stat input log " << path;
+  size_ = file_stat.st_size;
+  CHECK(size_ >= sizeof(LogHeader)) << "Truncated input log " << path;
+  void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  CHECK(mapping != MAP_FAILED) << "Couldn't map input log " << path;
+  // Records are consumed front to back exactly once.
+  madvise(mapping, size_, MADV_SEQUENTIAL);
+  data_ = static_cast<const uint8_t*>(mapping);
+
+  const LogHeader header = ReadRaw<LogHeader>();
+  CHECK(header.magic_ == kLogMagic) << path << " is not an input log";
+  CHECK(header.version_ == kLogVersion)
+      << "Unsupported input log version " << header.version_;
+}
+
+InputLogReader::~InputLogReader()
+{
+  munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+uint8_t InputLogReader::ReadByte()
+{
+  CHECK(offset_ < size_) << "Truncated input log";
+  return data_[offset_++];
+}
+
+uint64_t InputLogReader::ReadVarint()
+{
+  uint64_t value = 0;
+  for (size_t shift = 0;; shift += 7)
+  {
+    const uint8_t byte = ReadByte();
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) return value;
+  }
+}
+
+template <typename T>
+T InputLogReader::ReadRaw()
+{
+  CHECK(offset_ + sizeof(T) <= size_) << "Truncated input log";
+  T value;
+  std::memcpy(&value, data_ + offset_, sizeof(T));
+  offset_ += sizeof(T);
+  return value;
+}
+
+InputLogReader::Record InputLogReader::Next(
+    DeviceConfigChange* change, InputFrame* frame,
+    std::chrono::microseconds* timestamp)
+{
+  if (offset_ == size_) return Record::kEnd;
+  const uint8_t tag = ReadByte();
+  if (tag == kDeviceConfigChangeTag)
+  {
+    change->device_id_ = ReadByte();
+    change->status_ = ReadByte() == DeviceConfigChange::CONNECTED
+                          ? DeviceConfigChange::CONNECTED
+                          : DeviceConfigChange::DISCONNECTED;
+    return Record::kDeviceConfigChange;
+  }
+  CHECK(tag == kFrameTag) << "Corrupt input log at " << offset_;
+
+  timestamp_us_ += ReadVarint();
+  *timestamp = std::chrono::microseconds(timestamp_us_);
+  const uint8_t count = ReadByte();
+  const size_t num_devices = count >> 1;
+  for (size_t n = 0; n < num_devices; ++n)
+  {
+    const uint8_t device_id = ReadByte();
+    CHECK(device_id < kMaxDevices) << "Corrupt input log at " << offset_;
+    DeviceInputState& device = frame->devices_[device_id];
+    const uint64_t mask = ReadVarint();
+    for (size_t i = 0; i < KeyBits::kNumWords; ++i)
+    {
+      if (mask & (uint64_t{1} << (kDownShift + i)))
+      {
+        device.down_.words_[i] ^= ReadRaw<uint64_t>();
+      }
+    }
+    for (size_t i = 0; i < KeyBits::kNumWords; ++i)
+    {
+      if (mask & (uint64_t{1} << (kPressedShift + i)))
+      {
+        device.pressed_.words_[i] = ReadRaw<uint64_t>();
+      }
+    }
+    for (size_t i = 0; i < KeyBits::kNumWords; ++i)
+    {
+      if (mask & (uint64_t{1} << (kReleasedShift + i)))
+      {
+        device.released_.words_[i] = ReadRaw<uint64_t>();
+      }
+    }
+    for (size_t i = 0; i < kNumAxes; ++i)
+    {
+      if (mask & (uint64_t{1} << (kAxesShift + i)))
+      {
+        device.axes_[i] = ReadRaw<float>();
+      }
+    }
+  }
+  if (count & 1)
+  {
+    frame->cursor_.x_ = ReadRaw<double>();
+    frame->cursor_.y_ = ReadRaw<double>();
+  }
+  return Record::kFrame;
+}
+
+}  // namespace motor::input
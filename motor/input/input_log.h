@@ -0,0 +1,88 @@
+#ifndef _MOTOR_INPUT_INPUT_LOG_H_
+#define _MOTOR_INPUT_INPUT_LOG_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "motor/input/device.h"
+#include "motor/input/input.h"
+
+namespace motor::input
+{
+// Records the input event stream into a compact binary log. Every
+// InputStateBroadcast becomes a frame record, frames only store what changed
+// since the previous frame: XOR of held keys, non-empty edge words, changed
+// axes and cursor. A frame without any input costs about five bytes at 60Hz,
+// three of them for the timestamp delta. Device config changes are stored in
+// between frames, in the order they were received.
+class InputLogWriter
+{
+ public:
+  // Check-fails if |path| can't be opened for writing.
+  explicit InputLogWriter(const std::string& path);
+  InputLogWriter(const InputLogWriter&) = delete;
+  InputLogWriter& operator=(const InputLogWriter&) = delete;
+  InputLogWriter(InputLogWriter&&) = delete;
+  // Flushes the remaining records.
+  ~InputLogWriter();
+
+  void Record(const DeviceConfigChange& change);
+  void Record(const InputStateBroadcast& broadcast);
+
+  size_t NumFrames() const { return num_frames_; }
+
+ private:
+  void Flush();
+
+  std::ofstream out_;
+  std::vector<uint8_t> buffer_;
+  InputFrame previous_;
+  std::chrono::steady_clock::time_point start_;
+  uint64_t last_timestamp_us_ = 0;
+  size_t num_frames_ = 0;
+};
+
+// Reads back a log written by InputLogWriter from a memory mapped file.
+class InputLogReader
+{
+ public:
+  enum class Record
+  {
+    kDeviceConfigChange,
+    kFrame,
+    kEnd,
+  };
+
+  // Check-fails if |path| can't be mapped or isn't an input log.
+  explicit InputLogReader(const std::string& path);
+  InputLogReader(const InputLogReader&) = delete;
+  InputLogReader& operator=(const InputLogReader&) = delete;
+  InputLogReader(InputLogReader&&) = delete;
+  ~InputLogReader();
+
+  // Decodes the next record. Device config changes are written into |change|.
+  // Frames are applied onto |frame|, which must contain the previously decoded
+  // frame with its edges cleared, as InputState::BeginFrame leaves it.
+  // |timestamp| is the time since the start of the recording.
+  Record Next(DeviceConfigChange* change, InputFrame* frame,
+              std::chrono::microseconds* timestamp);
+
+ private:
+  uint8_t ReadByte();
+  uint64_t ReadVarint();
+  template <typename T>
+  T ReadRaw();
+
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  size_t offset_ = 0;
+  uint64_t timestamp_us_ = 0;
+};
+
+}  // namespace motor::input
+
+#endif
@@ -0,0 +1,66 @@
+#include "input_poller.h"
+
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+
+#include "glog/logging.h"
+#include "motor/input/input.h"
+
+namespace motor::input
+{
+void ApplySample(const GamepadSample& sample, InputState* state)
+{
+  // Samples taken on the frame thread have no timestamps.
+  if (sample.timestamp_ != std::chrono::steady_clock::time_point())
+  {
+    state->MarkInput(sample.timestamp_);
+  }
+  for (size_t button = 0; button < 32; ++button)
+  {
+    state->SetKey(sample.device_id_, button, (sample.buttons_ >> button) & 1);
+  }
+  for (size_t axis = 0; axis < kNumAxes; ++axis)
+  {
+    state->SetAxis(sample.device_id_, axis, sample.axes_[axis]);
+  }
+}
+
+InputPoller::InputPoller(std::chrono::nanoseconds period, PollFn poll)
+    : period_(period),
+      poll_(std::move(poll)),
+      thread_(&InputPoller::ThreadMain, this)
+{
+  CHECK(period.count() > 0) << "Poll period must be positive";
+}
+
+InputPoller::~InputPoller()
+{
+  stopping_.store(true, std::memory_order_relaxed);
+  thread_.join();
+  LOG(INFO) << "Input poller stopped after " << NumPolls() << " polls";
+}
+
+void InputPoller::ThreadMain()
+{
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point next = Clock::now();
+  while (!stopping_.load(std::memory_order_relaxed))
+  {
+    poll_(next);
+    num_polls_.fetch_add(1, std::memory_order_relaxed);
+
+    next += period_;
+    const Clock::time_point now = Clock::now();
+    if (next < now)
+    {
+      // Fell behind, e.g. the thread got descheduled. Realign to the period
+      // instead of bursting.
+      next += (now - next) / period_ * period_ + period_;
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
+
+}  // namespace motor::input
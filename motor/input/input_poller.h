@@ -0,0 +1,70 @@
+#ifndef _MOTOR_INPUT_INPUT_POLLER_H_
+#define _MOTOR_INPUT_INPUT_POLLER_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include "motor/input/input.h"
+#include "motor/input/sample_ring.h"
+
+namespace motor::input
+{
+// State of a single gamepad at the time it was sampled.
+struct GamepadSample
+{
+  // Only set for samples taken by an InputPoller.
+  std::chrono::steady_clock::time_point timestamp_;
+  uint32_t device_id_ = 0;
+  // Bit i is set if button i is held.
+  uint32_t buttons_ = 0;
+  std::array<float, kNumAxes> axes_ = {};
+};
+
+// Enough for 4 gamepads that change state every sample at 1kHz, for a 250ms
+// frame.
+using GamepadSampleRing = SampleRing<GamepadSample, 1024>;
+
+// Applies a sample onto the current frame of |state|. Applying all samples
+// since the last frame, in order, keeps presses and releases that happened in
+// between frames.
+void ApplySample(const GamepadSample& sample, InputState* state);
+
+// Calls a polling function at a fixed rate on a dedicated thread, decoupling
+// input resolution from the frame rate. Sampled state is meant to be pushed
+// into a SampleRing and drained by the frame.
+class InputPoller
+{
+ public:
+  using PollFn = std::function<void(std::chrono::steady_clock::time_point)>;
+
+  // Starts polling immediately, |poll| receives the scheduled time of each
+  // poll. Missed polls are skipped rather than run back to back.
+  InputPoller(std::chrono::nanoseconds period, PollFn poll);
+  InputPoller(const InputPoller&) = delete;
+  InputPoller& operator=(const InputPoller&) = delete;
+  InputPoller(InputPoller&&) = delete;
+  // Stops after the poll in progress and joins the thread.
+  ~InputPoller();
+
+  size_t NumPolls() const { return num_polls_.load(std::memory_order_relaxed); }
+
+ private:
+  void ThreadMain();
+
+  const std::chrono::nanoseconds period_;
+  const PollFn poll_;
+  std::atomic<bool> stopping_{false};
+  std::atomic<size_t> num_polls_{0};
+
+  // Declared last so that everything above is initialized before it starts.
+  std::thread thread_;
+};
+
+}  // namespace motor::input
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _MOTOR_INPUT_SAMPLE_RING_H_
+#define _MOTOR_INPUT_SAMPLE_RING_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace motor::input
+{
+// Bounded single-producer single-consumer ring of input samples. Push and
+// Drain are wait-free, when the ring is full new samples are dropped rather
+// than overwriting the ones the consumer hasn't seen yet.
+template <typename T, size_t kCapacity>
+class SampleRing
+{
+  static_assert((kCapacity & (kCapacity - 1)) == 0,
+                "Capacity must be a power of two");
+  static_assert(std::is_trivially_copyable<T>::value);
+
+ public:
+  // Only called from the producer thread. Returns false if the ring is full.
+  bool Push(const T& sample)
+  {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == kCapacity)
+    {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    samples_[tail & (kCapacity - 1)] = sample;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Only called from the consumer thread. Calls |fn| with every sample pushed
+  // since the last Drain, in push order, and returns their count.
+  template <typename Fn>
+  size_t Drain(Fn&& fn)
+  {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    for (size_t i = head; i != tail; ++i)
+    {
+      fn(samples_[i & (kCapacity - 1)]);
+    }
+    head_.store(tail, std::memory_order_release);
+    return tail - head;
+  }
+
+  size_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  // Producer and consumer indices live on separate cache lines.
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+  std::atomic<size_t> dropped_{0};
+  std::array<T, kCapacity> samples_;
+};
+
+}  // namespace motor::input
+
+#endif
@@ -0,0 +1,274 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace motor::jobs
+{
+struct Job
+{
+  Task task_;
+  Counter* counter_ = nullptr;
+};
+
+namespace
+{
+// Identifies the JobSystem and queue owned by the current thread, if any.
+thread_local const JobSystem* tls_system = nullptr;
+thread_local size_t tls_queue_idx = 0;
+thread_local uint32_t tls_rng = 0;
+
+uint32_t NextRandom()
+{
+  // xorshift32, good enough for picking steal victims.
+  uint32_t x = tls_rng == 0 ? 0x9E3779B9u : tls_rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  tls_rng = x;
+  return x;
+}
+
+// Number of failed attempts to find a job before a worker goes to sleep.
+constexpr const size_t kSpinsBeforeSleep = 64;
+}  // namespace
+
+JobSystem::JobSystem(size_t num_workers)
+{
+  CHECK(tls_system == nullptr) << "Thread already owns a JobSystem";
+  for (size_t i = 0; i <= num_workers; ++i)
+  {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+  tls_system = this;
+  tls_queue_idx = 0;
+  for (size_t i = 1; i <= num_workers; ++i)
+  {
+    workers_.emplace_back(&JobSystem::WorkerMain, this, i);
+  }
+  LOG(INFO) << "JobSystem started with " << NumThreads() << " threads";
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleep_mu_);
+    stopping_ = true;
+  }
+  wake_cv_.notify_all();
+  for (std::thread& worker : workers_) worker.join();
+  if (tls_system == this) tls_system = nullptr;
+
+  for (auto& queue : queues_)
+  {
+    while (Job* job = queue->Steal()) delete job;
+  }
+  for (Job* job : injected_) delete job;
+}
+
+void JobSystem::Run(Task task, Counter* counter)
+{
+  if (counter != nullptr)
+  {
+    counter->pending_.fetch_add(1, std::memory_order_relaxed);
+  }
+  Schedule(new Job{std::move(task), counter});
+}
+
+void JobSystem::RunAfter(Counter* dependency, Task task, Counter* counter)
+{
+  if (counter != nullptr)
+  {
+    counter->pending_.fetch_add(1, std::memory_order_relaxed);
+  }
+  auto* job = new Job{std::move(task), counter};
+  {
+    // Execute takes the same lock after dropping the counter to zero, so the
+    // continuation is either seen by it or scheduled here.
+    std::lock_guard<std::mutex> lock(dependency->continuations_mu_);
+    if (!dependency->IsDone())
+    {
+      dependency->continuations_.push_back(job);
+      return;
+    }
+  }
+  Schedule(job);
+}
+
+void JobSystem::Wait(const Counter& counter)
+{
+  while (!counter.IsDone())
+  {
+    if (Job* job = FindJob())
+    {
+      Execute(job);
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+  // Synchronize with the job that made the counter done, see Execute.
+  std::lock_guard<std::mutex> lock(counter.continuations_mu_);
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain,
+                            const std::function<void(size_t, size_t)>& fn)
+{
+  if (count == 0) return;
+  if (grain == 0) grain = std::max<size_t>(1, count / (NumThreads() * 4));
+  if (count <= grain)
+  {
+    fn(0, count);
+    return;
+  }
+
+  Counter counter;
+  for (size_t begin = grain; begin < count; begin += grain)
+  {
+    const size_t end = std::min(count, begin + grain);
+    Run([&fn, begin, end] { fn(begin, end); }, &counter);
+  }
+  // Do the first chunk on the calling thread.
+  fn(0, grain);
+  Wait(counter);
+}
+
+void JobSystem::WorkerMain(size_t index)
+{
+  tls_system = this;
+  tls_queue_idx = index;
+  tls_rng = static_cast<uint32_t>(index * 2654435761u);
+
+  size_t failed_attempts = 0;
+  while (!stopping_.load(std::memory_order_relaxed))
+  {
+    if (Job* job = FindJob())
+    {
+      Execute(job);
+      failed_attempts = 0;
+      continue;
+    }
+    if (++failed_attempts < kSpinsBeforeSleep)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    Sleep();
+    failed_attempts = 0;
+  }
+}
+
+void JobSystem::Schedule(Job* job)
+{
+  queued_.fetch_add(1, std::memory_order_seq_cst);
+  if (tls_system == this)
+  {
+    if (!queues_[tls_queue_idx]->Push(job))
+    {
+      // Queue is full, execute the job right away instead of blocking.
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      Execute(job);
+      return;
+    }
+  }
+  else
+  {
+    std::lock_guard<std::mutex> lock(injected_mu_);
+    injected_.push_back(job);
+  }
+
+  if (num_sleeping_.load(std::memory_order_seq_cst) > 0)
+  {
+    // Taking the lock makes sure a worker that is about to sleep either sees
+    // the new job or receives the notification.
+    { std::lock_guard<std::mutex> lock(sleep_mu_); }
+    wake_cv_.notify_one();
+  }
+}
+
+void JobSystem::Execute(Job* job)
+{
+  job->task_();
+  Counter* counter = job->counter_;
+  delete job;
+  if (counter == nullptr) return;
+
+  size_t pending = counter->pending_.load(std::memory_order_relaxed);
+  while (pending > 1)
+  {
+    if (counter->pending_.compare_exchange_weak(pending, pending - 1,
+                                                std::memory_order_acq_rel))
+    {
+      return;
+    }
+  }
+
+  // Likely the last job of the counter. The final decrement happens under the
+  // lock, Wait acquires the same lock before returning so that the counter
+  // can't be destroyed while it is still in use here.
+  std::vector<Job*> continuations;
+  {
+    std::lock_guard<std::mutex> lock(counter->continuations_mu_);
+    if (counter->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      continuations.swap(counter->continuations_);
+    }
+  }
+  for (Job* continuation : continuations) Schedule(continuation);
+}
+
+Job* JobSystem::FindJob()
+{
+  Job* job = nullptr;
+  const bool owns_queue = tls_system == this;
+  if (owns_queue) job = queues_[tls_queue_idx]->Pop();
+
+  if (job == nullptr)
+  {
+    std::unique_lock<std::mutex> lock(injected_mu_, std::try_to_lock);
+    if (lock.owns_lock() && !injected_.empty())
+    {
+      job = injected_.front();
+      injected_.pop_front();
+    }
+  }
+
+  if (job == nullptr)
+  {
+    const size_t num_queues = queues_.size();
+    const size_t start = NextRandom() % num_queues;
+    for (size_t i = 0; i < num_queues && job == nullptr; ++i)
+    {
+      const size_t victim = (start + i) % num_queues;
+      if (owns_queue && victim == tls_queue_idx) continue;
+      job = queues_[victim]->Steal();
+    }
+  }
+
+  if (job != nullptr) queued_.fetch_sub(1, std::memory_order_relaxed);
+  return job;
+}
+
+void JobSystem::Sleep()
+{
+  std::unique_lock<std::mutex> lock(sleep_mu_);
+  num_sleeping_.fetch_add(1, std::memory_order_seq_cst);
+  wake_cv_.wait(lock, [this] {
+    return stopping_.load(std::memory_order_relaxed) ||
+           queued_.load(std::memory_order_seq_cst) > 0;
+  });
+  num_sleeping_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+}  // namespace motor::jobs
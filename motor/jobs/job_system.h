@@ -0,0 +1,103 @@
+#ifndef _MOTOR_JOBS_JOB_SYSTEM_H_
+#define _MOTOR_JOBS_JOB_SYSTEM_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "motor/jobs/work_stealing_deque.h"
+
+namespace motor::jobs
+{
+struct Job;
+
+// Tracks completion of a group of jobs. A counter is incremented when a job is
+// scheduled with it and decremented once that job finishes. Jobs scheduled
+// through JobSystem::RunAfter are started once the counter drops to zero.
+class Counter
+{
+ public:
+  Counter() = default;
+  Counter(const Counter&) = delete;
+  Counter& operator=(const Counter&) = delete;
+
+  bool IsDone() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+ private:
+  friend class JobSystem;
+
+  std::atomic<size_t> pending_{0};
+  mutable std::mutex continuations_mu_;
+  std::vector<Job*> continuations_;
+};
+
+using Task = std::function<void()>;
+
+// Work-stealing job scheduler. Every worker thread owns a Chase-Lev deque, it
+// pops its own jobs in LIFO order and steals from others in FIFO order when it
+// runs out of work. The thread that creates the JobSystem owns a deque as
+// well and executes jobs while it is blocked in Wait. Jobs scheduled from any
+// other thread go through a shared injection queue.
+class JobSystem
+{
+ public:
+  // Spawns |num_workers| threads in addition to the calling thread.
+  explicit JobSystem(size_t num_workers);
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+  JobSystem(JobSystem&&) = delete;
+  // Jobs that haven't started by the time of destruction are discarded.
+  ~JobSystem();
+
+  // Schedules |task|. If |counter| is not null, it is incremented before
+  // returning and decremented after |task| finishes.
+  void Run(Task task, Counter* counter = nullptr);
+  // Same as Run, but |task| is only scheduled once |dependency| is done.
+  void RunAfter(Counter* dependency, Task task, Counter* counter = nullptr);
+  // Executes pending jobs until |counter| is done.
+  void Wait(const Counter& counter);
+
+  // Calls |fn| on disjoint [begin, end) ranges covering [0, count) in parallel
+  // and returns once all of them are finished. Ranges have at most |grain|
+  // elements, a |grain| of zero picks one based on the number of threads.
+  void ParallelFor(size_t count, size_t grain,
+                   const std::function<void(size_t, size_t)>& fn);
+
+  // Number of threads executing jobs, including the owning thread.
+  size_t NumThreads() const { return queues_.size(); }
+
+ private:
+  static constexpr size_t kQueueCapacity = 4096;
+  using Queue = WorkStealingDeque<Job*, kQueueCapacity>;
+
+  void WorkerMain(size_t index);
+  void Schedule(Job* job);
+  void Execute(Job* job);
+  // Returns nullptr if no job could be found.
+  Job* FindJob();
+  void Sleep();
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+
+  std::mutex injected_mu_;
+  std::deque<Job*> injected_;
+
+  // Number of jobs that are scheduled but not yet picked up, used to put idle
+  // workers to sleep.
+  std::atomic<size_t> queued_{0};
+  std::atomic<size_t> num_sleeping_{0};
+  std::atomic<bool> stopping_{false};
+  std::mutex sleep_mu_;
+  std::condition_variable wake_cv_;
+};
+
+}  // namespace motor::jobs
+
+#endif
@@ -0,0 +1,112 @@
+// Runs a synthetic frame workload on JobSystems of increasing size and prints
+// the average frame time and speedup over a single thread.
+//   bazel run -c opt //motor/jobs:jobs_benchmark
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "motor/jobs/job_system.h"
+
+namespace motor::jobs
+{
+namespace
+{
+constexpr size_t kNumEntities = 200'000;
+constexpr size_t kNumFrames = 100;
+
+struct Entity
+{
+  float position_[3] = {0, 0, 0};
+  float velocity_[3] = {1, 2, 3};
+  float bounds_ = 1;
+  bool visible_ = false;
+};
+
+void Integrate(std::vector<Entity>& entities, size_t begin, size_t end)
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    Entity& e = entities[i];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      e.velocity_[axis] = std::sin(e.velocity_[axis]) * 0.99f + 0.01f;
+      e.position_[axis] += e.velocity_[axis] * (1.f / 60.f);
+    }
+  }
+}
+
+void Cull(std::vector<Entity>& entities, size_t begin, size_t end)
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    Entity& e = entities[i];
+    const float dist = std::sqrt(e.position_[0] * e.position_[0] +
+                                 e.position_[1] * e.position_[1] +
+                                 e.position_[2] * e.position_[2]);
+    e.visible_ = dist - e.bounds_ < 100.f;
+  }
+}
+
+// A frame is an integration pass, followed by an independent culling pass and
+// a dependent chain of small jobs, mimicking subsystems with dependencies.
+double MillisPerFrame(size_t num_threads)
+{
+  JobSystem jobs(num_threads - 1);
+  std::vector<Entity> entities(kNumEntities);
+  std::vector<float> chain(64, 1.f);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t frame = 0; frame < kNumFrames; ++frame)
+  {
+    jobs.ParallelFor(kNumEntities, 1024, [&entities](size_t begin, size_t end) {
+      Integrate(entities, begin, end);
+    });
+
+    Counter culled;
+    Counter chained[2];
+    jobs.Run(
+        [&] {
+          jobs.ParallelFor(kNumEntities, 1024,
+                           [&entities](size_t begin, size_t end) {
+                             Cull(entities, begin, end);
+                           });
+        },
+        &culled);
+    for (size_t i = 0; i < chain.size(); ++i)
+    {
+      Counter& prev = chained[i % 2];
+      Counter& next = chained[(i + 1) % 2];
+      jobs.RunAfter(
+          &prev, [&chain, i] { chain[i] = std::sqrt(chain[i] + 1.f); }, &next);
+      jobs.Wait(next);
+    }
+    jobs.Wait(culled);
+  }
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / kNumFrames;
+}
+
+void Run()
+{
+  const size_t max_threads =
+      std::max<size_t>(1, std::thread::hardware_concurrency());
+  std::printf("%-8s %12s %10s\n", "threads", "ms/frame", "speedup");
+  const double baseline = MillisPerFrame(1);
+  std::printf("%-8d %12.3f %10.2f\n", 1, baseline, 1.);
+  for (size_t threads = 2; threads <= max_threads; threads *= 2)
+  {
+    const double ms = MillisPerFrame(threads);
+    std::printf("%-8zu %12.3f %10.2f\n", threads, ms, baseline / ms);
+  }
+}
+
+}  // namespace
+}  // namespace motor::jobs
+
+int main() { motor::jobs::Run(); }
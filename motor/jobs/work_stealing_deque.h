@@ -0,0 +1,93 @@
+#ifndef _MOTOR_JOBS_WORK_STEALING_DEQUE_H_
+#define _MOTOR_JOBS_WORK_STEALING_DEQUE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace motor::jobs
+{
+// Fixed capacity Chase-Lev deque, as described in "Correct and Efficient
+// Work-Stealing for Weak Memory Models" (Le et al.). Owner thread pushes and
+// pops at the bottom, any other thread can steal from the top. nullptr is used
+// to signal an empty deque, hence T must be a pointer type.
+template <typename T, size_t kCapacity>
+class WorkStealingDeque
+{
+  static_assert(std::is_pointer<T>::value, "T must be a pointer");
+  static_assert((kCapacity & (kCapacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+ public:
+  WorkStealingDeque() = default;
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+  // Must only be called by the owner. Returns false if the deque is full.
+  bool Push(T item)
+  {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const int64_t top = top_.load(std::memory_order_acquire);
+    if (bottom - top >= static_cast<int64_t>(kCapacity)) return false;
+    buffer_[bottom & kMask].store(item, std::memory_order_relaxed);
+    // Publishes the item to thieves, pairs with the acquire load in Steal.
+    bottom_.store(bottom + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Must only be called by the owner.
+  T Pop()
+  {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    if (top > bottom)
+    {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    T item = buffer_[bottom & kMask].load(std::memory_order_relaxed);
+    if (top == bottom)
+    {
+      // Last item, race against thieves.
+      if (!top_.compare_exchange_strong(top, top + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed))
+      {
+        item = nullptr;
+      }
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  // Can be called from any thread.
+  T Steal()
+  {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom) return nullptr;
+    T item = buffer_[top & kMask].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed))
+    {
+      return nullptr;
+    }
+    return item;
+  }
+
+ private:
+  static constexpr int64_t kMask = kCapacity - 1;
+
+  alignas(64) std::atomic<int64_t> top_{0};
+  alignas(64) std::atomic<int64_t> bottom_{0};
+  alignas(64) std::array<std::atomic<T>, kCapacity> buffer_{};
+};
+
+}  // namespace motor::jobs
+
+#endif
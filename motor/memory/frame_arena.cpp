@@ -0,0 +1,147 @@
+#include "motor/memory/frame_arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include "glog/logging.h"
+
+namespace motor::memory
+{
+namespace
+{
+std::atomic<uint64_t> next_arena_id{1};
+
+// Block of the arena the calling thread last allocated from.
+struct ThreadBlock
+{
+  uint64_t arena_id_ = 0;
+  uint64_t frame_ = 0;
+  char* cur_ = nullptr;
+  char* end_ = nullptr;
+};
+thread_local ThreadBlock tls_block;
+
+char* AlignUp(char* ptr, size_t alignment)
+{
+  const uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+  return reinterpret_cast<char*>((addr + alignment - 1) & ~(alignment - 1));
+}
+
+}  // namespace
+
+FrameArena::FrameArena(size_t bytes_per_frame, size_t num_buffers)
+    : bytes_per_frame_(bytes_per_frame),
+      num_buffers_(num_buffers),
+      id_(next_arena_id.fetch_add(1, std::memory_order_relaxed)),
+      buffers_(std::make_unique<Buffer[]>(num_buffers))
+{
+  CHECK(num_buffers > 0) << "Need at least one buffer";
+  for (size_t i = 0; i < num_buffers_; ++i)
+  {
+    buffers_[i].data_ = std::make_unique<char[]>(bytes_per_frame_);
+  }
+}
+
+FrameArena::~FrameArena()
+{
+  for (size_t i = 0; i < num_buffers_; ++i)
+  {
+    for (const auto& [ptr, alignment] : buffers_[i].overflow_)
+    {
+      ::operator delete(ptr, std::align_val_t(alignment));
+    }
+  }
+}
+
+void FrameArena::BeginFrame()
+{
+  const uint64_t frame = frame_.load(std::memory_order_relaxed);
+  const size_t used = buffers_[frame % num_buffers_].offset_.load(
+      std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(stats_mu_);
+    stats_.last_frame_bytes_ = used;
+    stats_.high_water_bytes_ = std::max(stats_.high_water_bytes_, used);
+  }
+
+  Buffer& next = buffers_[(frame + 1) % num_buffers_];
+  {
+    std::lock_guard<std::mutex> lock(next.overflow_mu_);
+    for (const auto& [ptr, alignment] : next.overflow_)
+    {
+      ::operator delete(ptr, std::align_val_t(alignment));
+    }
+    next.overflow_.clear();
+  }
+  next.offset_.store(0, std::memory_order_relaxed);
+  // Invalidates thread blocks carved out of earlier frames.
+  frame_.store(frame + 1, std::memory_order_release);
+}
+
+void* FrameArena::Allocate(size_t bytes, size_t alignment)
+{
+  const uint64_t frame = frame_.load(std::memory_order_acquire);
+  Buffer* buffer = &buffers_[frame % num_buffers_];
+  if (bytes > kBlockBytes / 4 || alignment > kBlockBytes / 4)
+  {
+    char* ptr = AllocateShared(buffer, bytes, alignment);
+    return ptr != nullptr ? ptr : AllocateOverflow(buffer, bytes, alignment);
+  }
+
+  ThreadBlock& block = tls_block;
+  if (block.arena_id_ == id_ && block.frame_ == frame)
+  {
+    char* ptr = AlignUp(block.cur_, alignment);
+    if (ptr + bytes <= block.end_)
+    {
+      block.cur_ = ptr + bytes;
+      return ptr;
+    }
+  }
+  char* start = AllocateShared(buffer, kBlockBytes, alignof(std::max_align_t));
+  if (start == nullptr) return AllocateOverflow(buffer, bytes, alignment);
+  block.arena_id_ = id_;
+  block.frame_ = frame;
+  block.cur_ = AlignUp(start, alignment) + bytes;
+  block.end_ = start + kBlockBytes;
+  return AlignUp(start, alignment);
+}
+
+FrameArenaStats FrameArena::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(stats_mu_);
+  return stats_;
+}
+
+char* FrameArena::AllocateShared(Buffer* buffer, size_t bytes,
+                                 size_t alignment)
+{
+  // Padding for the worst case alignment, as the offset is claimed before
+  // the address is known.
+  const size_t size = bytes + alignment - 1;
+  const size_t offset =
+      buffer->offset_.fetch_add(size, std::memory_order_relaxed);
+  if (offset + size > bytes_per_frame_) return nullptr;
+  return AlignUp(buffer->data_.get() + offset, alignment);
+}
+
+void* FrameArena::AllocateOverflow(Buffer* buffer, size_t bytes,
+                                   size_t alignment)
+{
+  void* ptr = ::operator new(bytes, std::align_val_t(alignment));
+  {
+    std::lock_guard<std::mutex> lock(buffer->overflow_mu_);
+    buffer->overflow_.emplace_back(ptr, alignment);
+  }
+  std::lock_guard<std::mutex> lock(stats_mu_);
+  ++stats_.overflow_allocations_;
+  stats_.overflow_bytes_ += bytes;
+  return ptr;
+}
+
+}  // namespace motor::memory
@@ -0,0 +1,112 @@
+#ifndef _MOTOR_MEMORY_FRAME_ARENA_H_
+#define _MOTOR_MEMORY_FRAME_ARENA_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace motor::memory
+{
+struct FrameArenaStats
+{
+  // Bytes requested from the arena in the last completed frame, including
+  // unused tails of per thread blocks and allocations that overflowed.
+  size_t last_frame_bytes_ = 0;
+  size_t high_water_bytes_ = 0;
+  // Allocations that didn't fit into the arena and went to the heap instead,
+  // over the lifetime of the arena.
+  size_t overflow_allocations_ = 0;
+  size_t overflow_bytes_ = 0;
+};
+
+// Bump allocator for data that only lives for a few frames. Memory allocated
+// in frame N stays valid until the start of frame N + num_buffers, when its
+// buffer is reset as a whole. Deallocation is a no-op.
+//
+// Threads carve private blocks out of the shared buffer with a single atomic
+// add and bump allocate within them, so small allocations don't contend.
+// Allocations that don't fit fall back to the heap and are released with the
+// buffer, high_water_bytes_ tells how large the buffers should be.
+class FrameArena
+{
+ public:
+  // Size of the blocks threads allocate from, larger allocations go directly
+  // to the shared buffer.
+  static constexpr size_t kBlockBytes = 64 << 10;
+
+  FrameArena(size_t bytes_per_frame, size_t num_buffers);
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+  ~FrameArena();
+
+  // Resets the oldest buffer and makes it current. Must not race with
+  // allocations, e.g. called at the start of a frame before any jobs are
+  // scheduled.
+  void BeginFrame();
+
+  // Safe to call from any thread. |alignment| must be a power of two.
+  void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+  // For pmr containers, e.g. std::pmr::vector<int> v(arena.Resource()).
+  std::pmr::memory_resource* Resource() { return &resource_; }
+
+  FrameArenaStats GetStats() const;
+
+ private:
+  class ArenaResource : public std::pmr::memory_resource
+  {
+   public:
+    explicit ArenaResource(FrameArena* arena) : arena_(arena) {}
+
+   private:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+      return arena_->Allocate(bytes, alignment);
+    }
+    void do_deallocate(void* /*ptr*/, size_t /*bytes*/,
+                       size_t /*alignment*/) override
+    {
+    }
+    bool do_is_equal(const memory_resource& other) const noexcept override
+    {
+      return this == &other;
+    }
+
+    FrameArena* const arena_;
+  };
+
+  struct Buffer
+  {
+    std::unique_ptr<char[]> data_;
+    // Keeps growing past the capacity, so that the demand is known.
+    std::atomic<size_t> offset_{0};
+    // Heap allocations made once the buffer was full, with their alignments.
+    std::mutex overflow_mu_;
+    std::vector<std::pair<void*, size_t>> overflow_;
+  };
+
+  // Returns nullptr if |buffer| is full.
+  char* AllocateShared(Buffer* buffer, size_t bytes, size_t alignment);
+  void* AllocateOverflow(Buffer* buffer, size_t bytes, size_t alignment);
+
+  const size_t bytes_per_frame_;
+  const size_t num_buffers_;
+  // Distinguishes arenas in thread local caches, addresses might be reused.
+  const uint64_t id_;
+  std::unique_ptr<Buffer[]> buffers_;
+  // Current buffer is frame_ % num_buffers_.
+  std::atomic<uint64_t> frame_{0};
+  ArenaResource resource_{this};
+
+  mutable std::mutex stats_mu_;
+  FrameArenaStats stats_;
+};
+
+}  // namespace motor::memory
+
+#endif
@@ -1,5 +1,78 @@
 #include "plugin.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <numeric>
+#include <string_view>
+#include <vector>
+
+#include "glog/logging.h"
+
 namespace motor
 {
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ElapsedMs(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// Returns false if the probe fails, logs its duration.
+bool RunProbe(const PluginEntry& entry)
+{
+  const Clock::time_point start = Clock::now();
+  const bool available = entry.probe_();
+  LOG(INFO) << "Probed plugin " << entry.name_ << " in " << ElapsedMs(start)
+            << "ms: " << (available ? "available" : "unavailable");
+  return available;
+}
+
+}  // namespace
+
+size_t SelectPlugin(const std::vector<PluginEntry>& entries,
+                    std::string_view name)
+{
+  const Clock::time_point start = Clock::now();
+  if (!name.empty())
+  {
+    auto it = std::find_if(
+        entries.begin(), entries.end(),
+        [name](const PluginEntry& entry) { return entry.name_ == name; });
+    if (it == entries.end())
+    {
+      LOG(ERROR) << "No plugin named " << name << " is linked in";
+      return entries.size();
+    }
+    if (!RunProbe(*it))
+    {
+      LOG(ERROR) << "Requested plugin " << name << " can't run here";
+      return entries.size();
+    }
+    LOG(INFO) << "Selected plugin " << name << " in " << ElapsedMs(start)
+              << "ms";
+    return it - entries.begin();
+  }
+
+  // Probes are run from the highest priority down, stopping at the first
+  // available plugin so that more expensive checks are skipped.
+  std::vector<size_t> order(entries.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&entries](size_t a, size_t b) {
+    return entries[a].priority_ > entries[b].priority_;
+  });
+  for (size_t idx : order)
+  {
+    if (!RunProbe(entries[idx])) continue;
+    LOG(INFO) << "Selected plugin " << entries[idx].name_ << " in "
+              << ElapsedMs(start) << "ms";
+    return idx;
+  }
+  LOG(ERROR) << "None of the " << entries.size() << " plugins can run here";
+  return entries.size();
+}
+
 }  // namespace motor
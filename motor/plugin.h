@@ -1,18 +1,39 @@
 #ifndef _MOTOR_PLUGIN_H_
 #define _MOTOR_PLUGIN_H_
 
-#include <cassert>
+#include <cstddef>
 #include <memory>
+#include <string_view>
 #include <type_traits>
+#include <vector>
 
 namespace motor
 {
+struct PluginEntry
+{
+  std::string_view name_;
+  int priority_ = 0;
+  // Cheap check for whether the plugin can run on this machine, must not
+  // construct the plugin.
+  bool (*probe_)() = nullptr;
+};
+
+// Returns the index of the plugin named |name| in |entries|, or the highest
+// priority one that probes successfully if |name| is empty. Returns
+// entries.size() if there is no such plugin. Logs time spent in probes.
+size_t SelectPlugin(const std::vector<PluginEntry>& entries,
+                    std::string_view name);
+
+// Holds every implementation of Base linked into the binary. Implementations
+// register through a static Add instance and are constructed lazily, only the
+// selected one is ever created. Derived::Probe is used as the capability
+// check, Base is expected to provide a default one.
 template <typename Base>
-class SinglePluginRegistry
+class PluginRegistry
 {
  public:
   template <typename Derived>
-  class Set
+  class Add
   {
    private:
     static std::unique_ptr<Base> Create()
@@ -22,26 +43,49 @@ class SinglePluginRegistry
     }
 
    public:
-    Set()
+    // |name| must outlive the registry, i.e. be a string literal.
+    Add(std::string_view name, int priority)
     {
-      assert(create == nullptr && "A plugin has already been registered!");
-      create = Create;
+      PluginEntry entry;
+      entry.name_ = name;
+      entry.priority_ = priority;
+      entry.probe_ = &Derived::Probe;
+      Entries().push_back(entry);
+      Creators().push_back(Create);
     }
   };
 
-  static std::unique_ptr<Base> Create()
+  // Creates the plugin named |name|, or the best available one if |name| is
+  // empty. Returns nullptr if there is no such plugin or it can't run here.
+  static std::unique_ptr<Base> Create(std::string_view name = {})
+  {
+    const size_t idx = SelectPlugin(Entries(), name);
+    if (idx == Entries().size()) return nullptr;
+    return Creators()[idx]();
+  }
+
+  static std::vector<std::string_view> Names()
   {
-    assert(create != nullptr && "No plugin has been registered");
-    return create();
+    std::vector<std::string_view> names;
+    for (const PluginEntry& entry : Entries()) names.push_back(entry.name_);
+    return names;
   }
 
  private:
-  static std::unique_ptr<Base> (*create)();
+  // Function local to be usable from static initializers in other translation
+  // units.
+  static std::vector<PluginEntry>& Entries()
+  {
+    static std::vector<PluginEntry> entries;
+    return entries;
+  }
+  static std::vector<std::unique_ptr<Base> (*)()>& Creators()
+  {
+    static std::vector<std::unique_ptr<Base> (*)()> creators;
+    return creators;
+  }
 };
 
-template <typename T>
-std::unique_ptr<T> (*SinglePluginRegistry<T>::create)() = nullptr;
-
 }  // namespace motor
 
 #endif
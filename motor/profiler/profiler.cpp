@@ -0,0 +1,207 @@
+#include "motor/profiler/profiler.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "glog/logging.h"
+
+namespace motor::profiler
+{
+namespace
+{
+// Trace has a single process, tid 0 holds the frames and threads follow.
+constexpr const int kPid = 1;
+constexpr const size_t kFramesTid = 0;
+
+double ToMicros(Clock::duration duration)
+{
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+std::string Escape(const std::string& str)
+{
+  std::string result;
+  result.reserve(str.size());
+  for (char c : str)
+  {
+    if (c == '"' || c == '\\') result.push_back('\\');
+    result.push_back(c);
+  }
+  return result;
+}
+
+}  // namespace
+
+thread_local Profiler::ThreadBuffer* Profiler::tls_buffer_ = nullptr;
+
+void Profiler::Capture(size_t skip_frames, size_t num_frames, std::string path)
+{
+  CHECK(state_ == State::kIdle) << "A capture is already in progress";
+  CHECK(num_frames > 0) << "Need at least one frame to capture";
+  state_ = State::kPending;
+  skip_frames_ = skip_frames;
+  remaining_frames_ = num_frames;
+  path_ = std::move(path);
+}
+
+void Profiler::Stop()
+{
+  if (state_ == State::kIdle) return;
+  const bool started = state_ == State::kCapturing;
+  state_ = State::kIdle;
+  capturing_.store(false, std::memory_order_release);
+  if (!started)
+  {
+    LOG(WARNING) << "Trace capture stopped before it started";
+    return;
+  }
+  // End of the last frame.
+  frame_marks_.push_back(Clock::now());
+  Write();
+  frame_marks_.clear();
+}
+
+void Profiler::FrameMark()
+{
+  switch (state_)
+  {
+    case State::kIdle:
+      return;
+    case State::kPending:
+      if (skip_frames_ > 0)
+      {
+        --skip_frames_;
+        return;
+      }
+      state_ = State::kCapturing;
+      // Threads notice the new generation once they see capturing_ and reset
+      // their buffers on their own.
+      generation_.fetch_add(1, std::memory_order_relaxed);
+      capturing_.store(true, std::memory_order_release);
+      frame_marks_.push_back(Clock::now());
+      return;
+    case State::kCapturing:
+      if (--remaining_frames_ == 0)
+      {
+        Stop();
+        return;
+      }
+      frame_marks_.push_back(Clock::now());
+      return;
+  }
+}
+
+void Profiler::Record(const char* name, Clock::time_point begin,
+                      Clock::time_point end)
+{
+  if (!capturing_.load(std::memory_order_acquire)) return;
+  ThreadBuffer* buffer = GetThreadBuffer();
+  const uint32_t generation = generation_.load(std::memory_order_relaxed);
+  if (buffer->generation_.load(std::memory_order_relaxed) != generation)
+  {
+    if (buffer->zones_ == nullptr)
+    {
+      buffer->zones_ = std::make_unique<Zone[]>(kCapacity);
+    }
+    buffer->size_.store(0, std::memory_order_relaxed);
+    buffer->dropped_.store(0, std::memory_order_relaxed);
+    buffer->generation_.store(generation, std::memory_order_release);
+  }
+  const size_t size = buffer->size_.load(std::memory_order_relaxed);
+  if (size == kCapacity)
+  {
+    buffer->dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer->zones_[size] = Zone{name, begin, end};
+  buffer->size_.store(size + 1, std::memory_order_release);
+}
+
+void Profiler::SetThreadName(std::string name)
+{
+  ThreadBuffer* buffer = GetThreadBuffer();
+  std::lock_guard<std::mutex> lock(mu_);
+  buffer->name_ = std::move(name);
+}
+
+Profiler::ThreadBuffer* Profiler::GetThreadBuffer()
+{
+  if (tls_buffer_ != nullptr) return tls_buffer_;
+  // Buffers outlive their threads, so that zones of exited threads can still
+  // be written.
+  auto buffer = std::make_unique<ThreadBuffer>();
+  tls_buffer_ = buffer.get();
+  std::lock_guard<std::mutex> lock(mu_);
+  buffers_.push_back(std::move(buffer));
+  return tls_buffer_;
+}
+
+void Profiler::Write()
+{
+  FILE* file = std::fopen(path_.c_str(), "w");
+  if (file == nullptr)
+  {
+    PLOG(ERROR) << "Couldn't open " << path_;
+    return;
+  }
+  const Clock::time_point origin = frame_marks_.front();
+  std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  std::fprintf(file,
+               "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+               "\"tid\":%zu,\"args\":{\"name\":\"Frames\"}}",
+               kPid, kFramesTid);
+  for (size_t i = 0; i + 1 < frame_marks_.size(); ++i)
+  {
+    std::fprintf(file,
+                 ",\n{\"name\":\"Frame\",\"ph\":\"X\",\"pid\":%d,\"tid\":%zu,"
+                 "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"index\":%zu}}",
+                 kPid, kFramesTid, ToMicros(frame_marks_[i] - origin),
+                 ToMicros(frame_marks_[i + 1] - frame_marks_[i]), i);
+  }
+
+  const uint32_t generation = generation_.load(std::memory_order_relaxed);
+  size_t num_zones = 0;
+  size_t num_dropped = 0;
+  std::lock_guard<std::mutex> lock(mu_);
+  for (size_t i = 0; i < buffers_.size(); ++i)
+  {
+    const ThreadBuffer& buffer = *buffers_[i];
+    const size_t tid = i + 1;
+    const std::string name =
+        buffer.name_.empty() ? "Thread " + std::to_string(tid) : buffer.name_;
+    std::fprintf(file,
+                 ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                 "\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+                 kPid, tid, Escape(name).c_str());
+    if (buffer.generation_.load(std::memory_order_acquire) != generation)
+    {
+      continue;
+    }
+    // Zones past this point might still be written by late threads.
+    const size_t size = buffer.size_.load(std::memory_order_acquire);
+    for (size_t j = 0; j < size; ++j)
+    {
+      const Zone& zone = buffer.zones_[j];
+      std::fprintf(file,
+                   ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%zu,"
+                   "\"ts\":%.3f,\"dur\":%.3f}",
+                   zone.name_, kPid, tid, ToMicros(zone.begin_ - origin),
+                   ToMicros(zone.end_ - zone.begin_));
+    }
+    num_zones += size;
+    num_dropped += buffer.dropped_.load(std::memory_order_relaxed);
+  }
+  std::fprintf(file, "\n]}\n");
+  std::fclose(file);
+  LOG(INFO) << "Wrote " << num_zones << " zones over "
+            << frame_marks_.size() - 1 << " frames to " << path_ << ", "
+            << num_dropped << " dropped";
+}
+
+}  // namespace motor::profiler
@@ -0,0 +1,137 @@
+#ifndef _MOTOR_PROFILER_PROFILER_H_
+#define _MOTOR_PROFILER_PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace motor::profiler
+{
+using Clock = std::chrono::steady_clock;
+
+// Captures scoped zones from all threads over a window of frames and writes
+// them as Chrome trace JSON, viewable in chrome://tracing or Perfetto.
+//
+// Each thread records into its own buffer without any synchronization besides
+// a release store, buffers are only appended to during a capture and zones
+// that don't fit are dropped. Outside of a capture a zone costs a relaxed
+// load. Capture, FrameMark and Stop must be called from the same thread.
+class Profiler
+{
+ public:
+  // Zones kept per thread and capture.
+  static constexpr size_t kCapacity = 1 << 16;
+
+  static Profiler& Get()
+  {
+    static Profiler profiler;
+    return profiler;
+  }
+
+  // Records |num_frames| frames, starting after |skip_frames| more frame
+  // marks, then writes them into |path|. Writing happens within the frame mark
+  // that ends the capture.
+  void Capture(size_t skip_frames, size_t num_frames, std::string path);
+  // Ends the capture early, writing what has been recorded so far. No-op if
+  // no capture has started.
+  void Stop();
+  // Marks the start of a frame.
+  void FrameMark();
+
+  bool IsCapturing() const
+  {
+    return capturing_.load(std::memory_order_relaxed);
+  }
+  // Zone |name| must be a string literal.
+  void Record(const char* name, Clock::time_point begin,
+              Clock::time_point end);
+  // Name of the calling thread in the trace.
+  void SetThreadName(std::string name);
+
+ private:
+  struct Zone
+  {
+    const char* name_;
+    Clock::time_point begin_;
+    Clock::time_point end_;
+  };
+  struct ThreadBuffer
+  {
+    // Written by the owning thread only.
+    std::unique_ptr<Zone[]> zones_;
+    std::atomic<size_t> size_{0};
+    std::atomic<size_t> dropped_{0};
+    // Capture the buffer contents belong to, published after size_ is reset.
+    std::atomic<uint32_t> generation_{0};
+    // Guarded by mu_.
+    std::string name_;
+  };
+  enum class State
+  {
+    kIdle,
+    kPending,
+    kCapturing,
+  };
+
+  Profiler() = default;
+  ThreadBuffer* GetThreadBuffer();
+  void Write();
+
+  static thread_local ThreadBuffer* tls_buffer_;
+
+  std::atomic<bool> capturing_{false};
+  std::atomic<uint32_t> generation_{0};
+
+  // Owned by the thread driving the capture.
+  State state_ = State::kIdle;
+  size_t skip_frames_ = 0;
+  size_t remaining_frames_ = 0;
+  std::string path_;
+  std::vector<Clock::time_point> frame_marks_;
+
+  std::mutex mu_;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+};
+
+class ScopedZone
+{
+ public:
+  explicit ScopedZone(const char* name) : name_(name)
+  {
+    if (Profiler::Get().IsCapturing()) begin_ = Clock::now();
+  }
+  ScopedZone(const ScopedZone&) = delete;
+  ScopedZone& operator=(const ScopedZone&) = delete;
+  ~ScopedZone()
+  {
+    if (begin_ == Clock::time_point()) return;
+    Profiler::Get().Record(name_, begin_, Clock::now());
+  }
+
+ private:
+  const char* const name_;
+  Clock::time_point begin_;
+};
+
+}  // namespace motor::profiler
+
+// Build with --define motor_profiler=off to compile the macros out.
+#ifdef MOTOR_DISABLE_PROFILER
+#define MOTOR_PROFILE_SCOPE(name)
+#define MOTOR_PROFILE_FRAME()
+#else
+#define MOTOR_PROFILE_CONCAT_IMPL(a, b) a##b
+#define MOTOR_PROFILE_CONCAT(a, b) MOTOR_PROFILE_CONCAT_IMPL(a, b)
+// Records the enclosing scope as a zone named |name|, a string literal.
+#define MOTOR_PROFILE_SCOPE(name)                            \
+  const ::motor::profiler::ScopedZone MOTOR_PROFILE_CONCAT( \
+      motor_profile_zone_, __LINE__)(name)
+#define MOTOR_PROFILE_FRAME() ::motor::profiler::Profiler::Get().FrameMark()
+#endif
+
+#endif
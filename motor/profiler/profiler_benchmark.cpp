@@ -0,0 +1,71 @@
+// Measures the cost of a profiling zone outside of a capture and while
+// capturing from several threads at once.
+//   bazel run -c opt //motor/profiler:profiler_benchmark
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "motor/profiler/profiler.h"
+
+namespace motor::profiler
+{
+namespace
+{
+constexpr size_t kIdleZones = 10'000'000;
+// Stays within the per thread capacity, so nothing is dropped.
+constexpr size_t kCapturedZones = Profiler::kCapacity / 2;
+
+double NanosPerZone(size_t num_zones)
+{
+  // Keeps the compiler from dropping empty zones, local to avoid sharing a
+  // cache line between threads.
+  volatile size_t sink = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < num_zones; ++i)
+  {
+    MOTOR_PROFILE_SCOPE("zone");
+    sink = i;
+  }
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         num_zones;
+}
+
+void Run()
+{
+  std::printf("%-24s %10.2f ns/zone\n", "idle", NanosPerZone(kIdleZones));
+
+  const std::string path = "/tmp/profiler_benchmark.json";
+  for (size_t num_threads : {1, 4})
+  {
+    Profiler& profiler = Profiler::Get();
+    profiler.Capture(/*skip_frames=*/0, /*num_frames=*/1, path);
+    profiler.FrameMark();
+    std::vector<double> results(num_threads);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+      threads.emplace_back(
+          [&results, i] { results[i] = NanosPerZone(kCapturedZones); });
+    }
+    for (std::thread& thread : threads) thread.join();
+    profiler.Stop();
+
+    double total = 0;
+    for (double result : results) total += result;
+    const std::string label =
+        "capturing, " + std::to_string(num_threads) + " threads";
+    std::printf("%-24s %10.2f ns/zone\n", label.c_str(),
+                total / num_threads);
+  }
+}
+
+}  // namespace
+}  // namespace motor::profiler
+
+int main() { motor::profiler::Run(); }
@@ -0,0 +1,95 @@
+#include "buddy_allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "glog/logging.h"
+
+namespace motor
+{
+namespace
+{
+bool IsPowerOfTwo(uint64_t value) { return value && !(value & (value - 1)); }
+
+int Log2(uint64_t value)
+{
+  int result = 0;
+  while (value >>= 1) ++result;
+  return result;
+}
+}  // namespace
+
+BuddyAllocator::BuddyAllocator(uint64_t size, uint64_t min_block_size)
+    : size_(size),
+      min_block_size_(min_block_size),
+      max_order_(Log2(size / min_block_size)),
+      free_blocks_(max_order_ + 1),
+      allocation_orders_(size / min_block_size, kNotAllocated)
+{
+  CHECK(IsPowerOfTwo(size) && IsPowerOfTwo(min_block_size))
+      << "Sizes must be powers of two";
+  CHECK(min_block_size <= size) << "Min block is bigger than the range";
+  free_blocks_[max_order_].insert(0);
+}
+
+uint64_t BuddyAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+  const uint64_t needed = std::max({size, alignment, min_block_size_});
+  if (needed > size_) return kInvalidOffset;
+  int order = 0;
+  while (BlockSize(order) < needed) ++order;
+
+  int split_order = order;
+  while (split_order <= max_order_ && free_blocks_[split_order].empty())
+  {
+    ++split_order;
+  }
+  if (split_order > max_order_) return kInvalidOffset;
+
+  // Prefer lower offsets, keeps the upper part of the range free for bigger
+  // allocations.
+  const uint64_t offset = *free_blocks_[split_order].begin();
+  free_blocks_[split_order].erase(free_blocks_[split_order].begin());
+  while (split_order > order)
+  {
+    --split_order;
+    free_blocks_[split_order].insert(offset + BlockSize(split_order));
+  }
+
+  allocation_orders_[offset / min_block_size_] = static_cast<int8_t>(order);
+  allocated_ += BlockSize(order);
+  ++num_allocations_;
+  return offset;
+}
+
+void BuddyAllocator::Free(uint64_t offset)
+{
+  int8_t& order_entry = allocation_orders_[offset / min_block_size_];
+  CHECK(order_entry != kNotAllocated) << "Double free at " << offset;
+  int order = order_entry;
+  order_entry = kNotAllocated;
+  allocated_ -= BlockSize(order);
+  --num_allocations_;
+
+  while (order < max_order_)
+  {
+    const uint64_t buddy = offset ^ BlockSize(order);
+    auto it = free_blocks_[order].find(buddy);
+    if (it == free_blocks_[order].end()) break;
+    free_blocks_[order].erase(it);
+    offset = std::min(offset, buddy);
+    ++order;
+  }
+  free_blocks_[order].insert(offset);
+}
+
+uint64_t BuddyAllocator::LargestFreeBlock() const
+{
+  for (int order = max_order_; order >= 0; --order)
+  {
+    if (!free_blocks_[order].empty()) return BlockSize(order);
+  }
+  return 0;
+}
+
+}  // namespace motor
@@ -0,0 +1,52 @@
+#ifndef _MOTOR_RENDER_BUDDY_ALLOCATOR_H_
+#define _MOTOR_RENDER_BUDDY_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+namespace motor
+{
+// Manages offsets within a range of |size| bytes, it doesn't own any memory.
+// Every allocation is rounded up to a power of two multiple of
+// |min_block_size| and placed at an offset aligned to its rounded size, hence
+// any alignment up to the rounded size comes for free.
+class BuddyAllocator
+{
+ public:
+  static constexpr uint64_t kInvalidOffset = ~uint64_t{0};
+
+  // Both |size| and |min_block_size| must be powers of two.
+  BuddyAllocator(uint64_t size, uint64_t min_block_size);
+
+  // Returns kInvalidOffset if there is no free range big enough.
+  uint64_t Allocate(uint64_t size, uint64_t alignment);
+  // |offset| must be a value returned by Allocate.
+  void Free(uint64_t offset);
+
+  uint64_t Size() const { return size_; }
+  // Bytes handed out, including the rounding.
+  uint64_t Allocated() const { return allocated_; }
+  uint64_t LargestFreeBlock() const;
+  size_t NumAllocations() const { return num_allocations_; }
+
+ private:
+  static constexpr int8_t kNotAllocated = -1;
+
+  uint64_t BlockSize(int order) const { return min_block_size_ << order; }
+
+  const uint64_t size_;
+  const uint64_t min_block_size_;
+  const int max_order_;
+  // Offsets of free blocks for each order.
+  std::vector<std::set<uint64_t>> free_blocks_;
+  // Order of the allocation starting at each min block.
+  std::vector<int8_t> allocation_orders_;
+  uint64_t allocated_ = 0;
+  size_t num_allocations_ = 0;
+};
+
+}  // namespace motor
+
+#endif
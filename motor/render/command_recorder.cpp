@@ -0,0 +1,105 @@
+#include "command_recorder.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/jobs/job_system.h"
+#include "motor/render/vulkan_utils.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+ParallelCommandRecorder::ParallelCommandRecorder(const vk::Device& dev,
+                                                 uint32_t queue_family_idx,
+                                                 jobs::JobSystem* job_system)
+    : dev_(dev),
+      job_system_(job_system),
+      pools_(job_system == nullptr ? 1 : job_system->NumThreads())
+{
+  vk::CommandPoolCreateInfo pool_create_info;
+  pool_create_info.setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+      .setQueueFamilyIndex(queue_family_idx)
+      .setPNext(nullptr);
+  for (ThreadPool& pool : pools_)
+  {
+    pool.pool_ = VkSuccuessOrDie(dev_.createCommandPool(pool_create_info),
+                                 "Couldn't create command pool");
+  }
+}
+
+ParallelCommandRecorder::~ParallelCommandRecorder()
+{
+  for (ThreadPool& pool : pools_)
+  {
+    // Destroying the pool frees all of its buffers.
+    dev_.destroyCommandPool(pool.pool_);
+  }
+}
+
+void ParallelCommandRecorder::Reset()
+{
+  for (ThreadPool& pool : pools_)
+  {
+    VkSuccuessOrDie(dev_.resetCommandPool(
+                        pool.pool_, static_cast<vk::CommandPoolResetFlags>(0)),
+                    "Couldn't reset command pool");
+    pool.used_ = 0;
+  }
+}
+
+vk::CommandBuffer ParallelCommandRecorder::NextBuffer(ThreadPool* pool)
+{
+  if (pool->used_ == pool->buffers_.size())
+  {
+    vk::CommandBufferAllocateInfo alloc_info;
+    alloc_info.setCommandBufferCount(1)
+        .setCommandPool(pool->pool_)
+        .setLevel(vk::CommandBufferLevel::eSecondary)
+        .setPNext(nullptr);
+    pool->buffers_.push_back(
+        VkSuccuessOrDie(dev_.allocateCommandBuffers(alloc_info),
+                        "Couldn't allocate command buffers")[0]);
+  }
+  return pool->buffers_[pool->used_++];
+}
+
+void ParallelCommandRecorder::Record(
+    size_t count, const vk::CommandBufferInheritanceInfo& inheritance,
+    const RecordFn& fn, std::vector<vk::CommandBuffer>* secondaries)
+{
+  if (count == 0) return;
+  const size_t num_chunks = std::min(count, pools_.size());
+  const size_t grain = (count + num_chunks - 1) / num_chunks;
+  const size_t first = secondaries->size();
+  secondaries->resize(first + (count + grain - 1) / grain);
+
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit)
+      .setPInheritanceInfo(&inheritance);
+
+  // Chunk i always records into pool i, so no two tasks share a pool.
+  auto record_chunk = [&](size_t begin, size_t end) {
+    const size_t chunk = begin / grain;
+    const vk::CommandBuffer cmd_buffer = NextBuffer(&pools_[chunk]);
+    VkSuccuessOrDie(cmd_buffer.begin(begin_info),
+                    "Couldn't begin secondary command buffer");
+    fn(cmd_buffer, begin, end);
+    VkSuccuessOrDie(cmd_buffer.end(), "Couldn't end secondary command buffer");
+    (*secondaries)[first + chunk] = cmd_buffer;
+  };
+
+  if (job_system_ == nullptr)
+  {
+    for (size_t begin = 0; begin < count; begin += grain)
+    {
+      record_chunk(begin, std::min(count, begin + grain));
+    }
+    return;
+  }
+  job_system_->ParallelFor(count, grain, record_chunk);
+}
+
+}  // namespace motor
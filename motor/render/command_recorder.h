@@ -0,0 +1,63 @@
+#ifndef _MOTOR_RENDER_COMMAND_RECORDER_H_
+#define _MOTOR_RENDER_COMMAND_RECORDER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "motor/jobs/job_system.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+// Records secondary command buffers in parallel. Owns one command pool per
+// recording task, as pools must be externally synchronized, and reuses the
+// command buffers allocated from them. There should be one recorder per frame
+// in flight, so that Reset only ever touches buffers the GPU is done with.
+class ParallelCommandRecorder
+{
+ public:
+  // Records on the calling thread when |job_system| is null.
+  ParallelCommandRecorder(const vk::Device& dev, uint32_t queue_family_idx,
+                          jobs::JobSystem* job_system);
+  ParallelCommandRecorder(const ParallelCommandRecorder&) = delete;
+  ParallelCommandRecorder& operator=(const ParallelCommandRecorder&) = delete;
+  ~ParallelCommandRecorder();
+
+  // Resets all the pools, making their command buffers available again.
+  // Resetting pools is a lot cheaper than freeing and allocating buffers.
+  void Reset();
+
+  // Called with a secondary command buffer that is already begun, and the
+  // range of items to record into it.
+  using RecordFn =
+      std::function<void(const vk::CommandBuffer&, size_t begin, size_t end)>;
+
+  // Splits [0, count) into one chunk per thread and records each chunk into
+  // its own secondary command buffer in parallel. Resulting buffers are
+  // appended to |secondaries| in the order of their chunks, ready to be
+  // passed to vk::CommandBuffer::executeCommands. |inheritance| must outlive
+  // the call.
+  void Record(size_t count, const vk::CommandBufferInheritanceInfo& inheritance,
+              const RecordFn& fn, std::vector<vk::CommandBuffer>* secondaries);
+
+ private:
+  struct ThreadPool
+  {
+    vk::CommandPool pool_;
+    std::vector<vk::CommandBuffer> buffers_;
+    // Number of buffers in buffers_ used since the last Reset.
+    size_t used_ = 0;
+  };
+
+  vk::CommandBuffer NextBuffer(ThreadPool* pool);
+
+  const vk::Device dev_;
+  jobs::JobSystem* const job_system_;
+  std::vector<ThreadPool> pools_;
+};
+
+}  // namespace motor
+
+#endif
@@ -0,0 +1,154 @@
+// Records a large number of draw-like commands into secondary command buffers
+// on 1..N threads and prints the recording time per frame.
+//   bazel run -c opt //motor/render:command_recording_benchmark
+//
+// There are no pipelines yet, so each draw is stood in for by the state
+// setting and transfer commands a draw would typically come with.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/jobs/job_system.h"
+#include "motor/render/command_recorder.h"
+#include "motor/render/device_memory_allocator.h"
+#include "motor/render/vulkan_utils.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+namespace
+{
+constexpr size_t kNumDraws = 100'000;
+constexpr size_t kNumFrames = 50;
+
+struct Context
+{
+  vk::Instance instance_;
+  vk::PhysicalDevice phy_dev_;
+  vk::Device device_;
+  uint32_t queue_family_idx_ = 0;
+};
+
+Context CreateContext()
+{
+  Context ctx;
+  vk::ApplicationInfo app_info;
+  app_info.setApiVersion(VK_API_VERSION_1_1)
+      .setPApplicationName("command_recording_benchmark")
+      .setPEngineName("motor");
+  vk::InstanceCreateInfo inst_info;
+  inst_info.setPApplicationInfo(&app_info);
+  ctx.instance_ = VkSuccuessOrDie(vk::createInstance(inst_info),
+                                  "Couldn't createInstance");
+
+  std::vector<vk::PhysicalDevice> devices =
+      VkSuccuessOrDie(ctx.instance_.enumeratePhysicalDevices(),
+                      "Couldn't enumeratePhysicalDevices");
+  CHECK(!devices.empty()) << "No vulkan device found";
+  ctx.phy_dev_ = devices.front();
+  LOG(INFO) << "Using device: " << ctx.phy_dev_.getProperties().deviceName;
+
+  std::vector<vk::QueueFamilyProperties> families =
+      ctx.phy_dev_.getQueueFamilyProperties();
+  bool found = false;
+  for (uint32_t i = 0; i < families.size() && !found; ++i)
+  {
+    if (families[i].queueFlags & vk::QueueFlagBits::eGraphics)
+    {
+      ctx.queue_family_idx_ = i;
+      found = true;
+    }
+  }
+  CHECK(found) << "No queue with a graphics flag";
+
+  const float queue_prio = 0;
+  vk::DeviceQueueCreateInfo queue_info;
+  queue_info.setQueueFamilyIndex(ctx.queue_family_idx_)
+      .setQueueCount(1)
+      .setPQueuePriorities(&queue_prio);
+  vk::DeviceCreateInfo device_info;
+  device_info.setQueueCreateInfoCount(1).setPQueueCreateInfos(&queue_info);
+  ctx.device_ = VkSuccuessOrDie(ctx.phy_dev_.createDevice(device_info),
+                                "Couldn't create logical device");
+  return ctx;
+}
+
+double MillisPerFrame(const Context& ctx, const vk::Buffer& buffer,
+                      size_t num_threads)
+{
+  jobs::JobSystem job_system(num_threads - 1);
+  ParallelCommandRecorder recorder(ctx.device_, ctx.queue_family_idx_,
+                                   &job_system);
+  const vk::CommandBufferInheritanceInfo inheritance;
+  const vk::Viewport viewport(0, 0, 800, 600, 0, 1);
+  const vk::Rect2D scissor({0, 0}, {800, 600});
+
+  std::vector<vk::CommandBuffer> secondaries;
+  double total_ms = 0;
+  for (size_t frame = 0; frame < kNumFrames; ++frame)
+  {
+    recorder.Reset();
+    secondaries.clear();
+    const auto start = std::chrono::steady_clock::now();
+    recorder.Record(
+        kNumDraws, inheritance,
+        [&](const vk::CommandBuffer& cmd_buffer, size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i)
+          {
+            cmd_buffer.setViewport(0, viewport);
+            cmd_buffer.setScissor(0, scissor);
+            cmd_buffer.fillBuffer(buffer, (i % 64) * 4, 4,
+                                  static_cast<uint32_t>(i));
+          }
+        },
+        &secondaries);
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    total_ms += elapsed.count();
+  }
+  return total_ms / kNumFrames;
+}
+
+void Run()
+{
+  Context ctx = CreateContext();
+  {
+    DeviceMemoryAllocator allocator(ctx.phy_dev_, ctx.device_);
+    vk::BufferCreateInfo buffer_info;
+    buffer_info.setSize(256)
+        .setUsage(vk::BufferUsageFlagBits::eTransferDst)
+        .setSharingMode(vk::SharingMode::eExclusive);
+    vk::Buffer buffer = VkSuccuessOrDie(
+        ctx.device_.createBuffer(buffer_info), "Couldn't create buffer");
+    MemoryAllocation memory = allocator.AllocateForBuffer(
+        buffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    const size_t max_threads =
+        std::max<size_t>(1, std::thread::hardware_concurrency());
+    std::printf("%zu draws per frame\n", kNumDraws);
+    std::printf("%-8s %12s %10s\n", "threads", "ms/frame", "speedup");
+    const double baseline = MillisPerFrame(ctx, buffer, 1);
+    std::printf("%-8d %12.3f %10.2f\n", 1, baseline, 1.);
+    for (size_t threads = 2; threads <= max_threads; threads *= 2)
+    {
+      const double ms = MillisPerFrame(ctx, buffer, threads);
+      std::printf("%-8zu %12.3f %10.2f\n", threads, ms, baseline / ms);
+    }
+
+    ctx.device_.destroyBuffer(buffer);
+    allocator.Free(memory);
+  }
+  ctx.device_.destroy();
+  ctx.instance_.destroy();
+}
+
+}  // namespace
+}  // namespace motor
+
+int main() { motor::Run(); }
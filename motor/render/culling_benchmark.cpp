@@ -0,0 +1,601 @@
+// Draws a scene of 100k objects scattered around a rotating camera, once
+// culled on the CPU and drawn one vkCmdDrawIndexed at a time, once culled by
+// the GpuCuller and drawn indirectly. Prints CPU time spent culling and
+// recording, frame time including the GPU, draw calls and visible objects of
+// both.
+//   bazel run -c opt //motor/render:culling_benchmark -- [num_objects]
+//
+// Runs on any Vulkan 1.1 device, including software ones like lavapipe, where
+// the frame time includes rasterization on the CPU as well.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/render/culling_shaders.h"
+#include "motor/render/device_memory_allocator.h"
+#include "motor/render/frustum_culling.h"
+#include "motor/render/gpu_culler.h"
+#include "motor/render/pipeline_manager.h"
+#include "motor/render/vulkan_utils.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kDefaultObjects = 100000;
+constexpr int kFrames = 20;
+constexpr uint32_t kWidth = 256;
+constexpr uint32_t kHeight = 256;
+constexpr vk::Format kFormat = vk::Format::eR8G8B8A8Unorm;
+// Objects are scattered in a cube of this size around the camera, the far
+// plane is closer than its corners.
+constexpr float kSceneSize = 1000;
+constexpr float kFarPlane = 400;
+
+// Unit cube, every object is drawn as one.
+constexpr std::array<float, 24> kCubeVertices = {
+    -1, -1, -1, 1, -1, -1, 1, 1, -1, -1, 1, -1,
+    -1, -1, 1,  1, -1, 1,  1, 1, 1,  -1, 1, 1,
+};
+constexpr std::array<uint16_t, 36> kCubeIndices = {
+    0, 1, 2, 2, 3, 0, 4, 6, 5, 6, 4, 7, 0, 4, 5, 5, 1, 0,
+    3, 2, 6, 6, 7, 3, 0, 3, 7, 7, 4, 0, 1, 5, 6, 6, 2, 1,
+};
+
+struct Context
+{
+  vk::Instance instance_;
+  vk::PhysicalDevice phy_dev_;
+  vk::Device device_;
+  uint32_t family_idx_ = 0;
+  bool draw_indirect_count_ = false;
+  bool multi_draw_indirect_ = false;
+};
+
+bool HasDeviceExtension(const vk::PhysicalDevice& phy_dev, const char* name)
+{
+  const std::vector<vk::ExtensionProperties> extensions =
+      VkSuccuessOrDie(phy_dev.enumerateDeviceExtensionProperties(),
+                      "Couldn't enumerate device extensions");
+  for (const vk::ExtensionProperties& extension : extensions)
+  {
+    if (std::strcmp(extension.extensionName, name) == 0) return true;
+  }
+  return false;
+}
+
+Context CreateContext()
+{
+  Context ctx;
+  vk::ApplicationInfo app_info;
+  app_info.setApiVersion(VK_API_VERSION_1_1)
+      .setPApplicationName("culling_benchmark")
+      .setPEngineName("motor");
+  vk::InstanceCreateInfo inst_info;
+  inst_info.setPApplicationInfo(&app_info);
+  ctx.instance_ = VkSuccuessOrDie(vk::createInstance(inst_info),
+                                  "Couldn't createInstance");
+
+  std::vector<vk::PhysicalDevice> devices =
+      VkSuccuessOrDie(ctx.instance_.enumeratePhysicalDevices(),
+                      "Couldn't enumeratePhysicalDevices");
+  CHECK(!devices.empty()) << "No vulkan device found";
+  ctx.phy_dev_ = devices.front();
+  LOG(INFO) << "Using device: " << ctx.phy_dev_.getProperties().deviceName;
+
+  std::vector<vk::QueueFamilyProperties> families =
+      ctx.phy_dev_.getQueueFamilyProperties();
+  bool found = false;
+  for (uint32_t i = 0; i < families.size() && !found; ++i)
+  {
+    // Graphics queues can always run compute too.
+    if (families[i].queueFlags & vk::QueueFlagBits::eGraphics)
+    {
+      ctx.family_idx_ = i;
+      found = true;
+    }
+  }
+  CHECK(found) << "No queue with a graphics flag";
+
+  const vk::PhysicalDeviceFeatures supported = ctx.phy_dev_.getFeatures();
+  CHECK(supported.drawIndirectFirstInstance)
+      << "Indirect draws can't select the object";
+  ctx.multi_draw_indirect_ = supported.multiDrawIndirect;
+  vk::PhysicalDeviceFeatures features;
+  features.setDrawIndirectFirstInstance(true).setMultiDrawIndirect(
+      supported.multiDrawIndirect);
+  std::vector<const char*> extensions;
+  ctx.draw_indirect_count_ = HasDeviceExtension(
+      ctx.phy_dev_, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  if (ctx.draw_indirect_count_)
+  {
+    extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  }
+
+  const float queue_prio = 0;
+  vk::DeviceQueueCreateInfo queue_info;
+  queue_info.setQueueFamilyIndex(ctx.family_idx_)
+      .setQueueCount(1)
+      .setPQueuePriorities(&queue_prio);
+  vk::DeviceCreateInfo device_info;
+  device_info.setQueueCreateInfoCount(1)
+      .setPQueueCreateInfos(&queue_info)
+      .setEnabledExtensionCount(extensions.size())
+      .setPpEnabledExtensionNames(extensions.data())
+      .setPEnabledFeatures(&features);
+  ctx.device_ = VkSuccuessOrDie(ctx.phy_dev_.createDevice(device_info),
+                                "Couldn't create logical device");
+  return ctx;
+}
+
+Mat4 Multiply(const Mat4& lhs, const Mat4& rhs)
+{
+  Mat4 result{};
+  for (int col = 0; col < 4; ++col)
+  {
+    for (int row = 0; row < 4; ++row)
+    {
+      for (int k = 0; k < 4; ++k)
+      {
+        result[col * 4 + row] += lhs[k * 4 + row] * rhs[col * 4 + k];
+      }
+    }
+  }
+  return result;
+}
+
+// Looks down -z with y pointing down in clip space, as Vulkan expects.
+Mat4 Perspective(float fov_y, float near, float far)
+{
+  const float f = 1 / std::tan(fov_y / 2);
+  Mat4 m{};
+  m[0] = f;
+  m[5] = -f;
+  m[10] = far / (near - far);
+  m[11] = -1;
+  m[14] = near * far / (near - far);
+  return m;
+}
+
+Mat4 RotationY(float angle)
+{
+  Mat4 m{};
+  m[0] = std::cos(angle);
+  m[2] = -std::sin(angle);
+  m[5] = 1;
+  m[8] = std::sin(angle);
+  m[10] = std::cos(angle);
+  m[15] = 1;
+  return m;
+}
+
+std::vector<CullObject> MakeScene(uint32_t num_objects)
+{
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> position(-kSceneSize / 2,
+                                                 kSceneSize / 2);
+  std::uniform_real_distribution<float> radius(0.5, 2);
+  std::vector<CullObject> objects(num_objects);
+  for (uint32_t i = 0; i < num_objects; ++i)
+  {
+    CullObject& object = objects[i];
+    object.center_ = {position(rng), position(rng), position(rng)};
+    object.radius_ = radius(rng);
+    object.index_count_ = kCubeIndices.size();
+    object.first_instance_ = i;
+  }
+  return objects;
+}
+
+double Micros(Clock::duration duration)
+{
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+double Median(std::vector<double> values)
+{
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+// Everything needed to draw the objects, shared by both paths.
+class Scene
+{
+ public:
+  Scene(const Context& ctx, DeviceMemoryAllocator* allocator,
+        GpuCuller* culler, const std::vector<CullObject>& objects)
+      : dev_(ctx.device_),
+        allocator_(allocator),
+        culler_(culler),
+        objects_(objects),
+        pipelines_(ctx.phy_dev_, ctx.device_, nullptr, "")
+  {
+    std::copy(objects_.begin(), objects_.end(), culler_->Objects(0));
+    CreateTarget();
+    CreatePipeline();
+    vertex_buffer_ = CreateHostBuffer(kCubeVertices.data(),
+                                      sizeof(kCubeVertices),
+                                      vk::BufferUsageFlagBits::eVertexBuffer,
+                                      &vertex_memory_);
+    index_buffer_ = CreateHostBuffer(kCubeIndices.data(),
+                                     sizeof(kCubeIndices),
+                                     vk::BufferUsageFlagBits::eIndexBuffer,
+                                     &index_memory_);
+
+    vk::CommandPoolCreateInfo pool_info;
+    pool_info.setQueueFamilyIndex(ctx.family_idx_);
+    cmd_pool_ = VkSuccuessOrDie(dev_.createCommandPool(pool_info),
+                                "Couldn't create command pool");
+    vk::CommandBufferAllocateInfo cmd_info;
+    cmd_info.setCommandPool(cmd_pool_)
+        .setLevel(vk::CommandBufferLevel::ePrimary)
+        .setCommandBufferCount(1);
+    cmd_buffer_ = VkSuccuessOrDie(dev_.allocateCommandBuffers(cmd_info),
+                                  "Couldn't allocate command buffer")
+                      .front();
+    fence_ = VkSuccuessOrDie(dev_.createFence(vk::FenceCreateInfo()),
+                             "Couldn't create fence");
+    queue_ = dev_.getQueue(ctx.family_idx_, 0);
+  }
+
+  ~Scene()
+  {
+    VkSuccuessOrDie(dev_.waitIdle(), "Couldn't wait for the device");
+    dev_.destroyFence(fence_);
+    dev_.destroyCommandPool(cmd_pool_);
+    dev_.destroyBuffer(vertex_buffer_);
+    allocator_->Free(vertex_memory_);
+    dev_.destroyBuffer(index_buffer_);
+    allocator_->Free(index_memory_);
+    dev_.destroyPipelineLayout(pipeline_layout_);
+    dev_.destroyDescriptorPool(descriptor_pool_);
+    dev_.destroyDescriptorSetLayout(set_layout_);
+    dev_.destroyShaderModule(vertex_shader_);
+    dev_.destroyShaderModule(fragment_shader_);
+    dev_.destroyFramebuffer(framebuffer_);
+    dev_.destroyRenderPass(render_pass_);
+    dev_.destroyImageView(view_);
+    dev_.destroyImage(image_);
+    allocator_->Free(image_memory_);
+  }
+
+  // Draws a frame, returns the number of draw calls.
+  size_t DrawCpuCulled(const Mat4& view_proj, std::vector<uint32_t>* visible)
+  {
+    CullObjects(FrustumFromViewProjection(view_proj), objects_, visible);
+    Begin();
+    BeginPass(view_proj);
+    for (uint32_t object : *visible)
+    {
+      cmd_buffer_.drawIndexed(objects_[object].index_count_, 1,
+                              objects_[object].first_index_,
+                              objects_[object].vertex_offset_,
+                              objects_[object].first_instance_);
+    }
+    End();
+    return visible->size();
+  }
+
+  size_t DrawGpuCulled(const Mat4& view_proj)
+  {
+    Begin();
+    culler_->RecordCull(cmd_buffer_, 0, FrustumFromViewProjection(view_proj),
+                        objects_.size());
+    BeginPass(view_proj);
+    const size_t draw_calls = culler_->RecordDraws(cmd_buffer_, 0);
+    End();
+    return draw_calls;
+  }
+
+  // Submits the recorded frame and waits for it.
+  void Submit()
+  {
+    vk::SubmitInfo submit_info;
+    submit_info.setCommandBufferCount(1).setPCommandBuffers(&cmd_buffer_);
+    VkSuccuessOrDie(queue_.submit(submit_info, fence_), "Couldn't submit");
+    VkSuccuessOrDie(dev_.waitForFences(fence_, true, ~uint64_t{0}),
+                    "Couldn't wait for the frame");
+    VkSuccuessOrDie(dev_.resetFences(fence_), "Couldn't reset fence");
+  }
+
+ private:
+  void CreateTarget()
+  {
+    vk::ImageCreateInfo image_info;
+    image_info.setImageType(vk::ImageType::e2D)
+        .setFormat(kFormat)
+        .setExtent(vk::Extent3D(kWidth, kHeight, 1))
+        .setMipLevels(1)
+        .setArrayLayers(1)
+        .setSamples(vk::SampleCountFlagBits::e1)
+        .setTiling(vk::ImageTiling::eOptimal)
+        .setUsage(vk::ImageUsageFlagBits::eColorAttachment)
+        .setSharingMode(vk::SharingMode::eExclusive)
+        .setInitialLayout(vk::ImageLayout::eUndefined);
+    image_ = VkSuccuessOrDie(dev_.createImage(image_info),
+                             "Couldn't create image");
+    image_memory_ = allocator_->AllocateForImage(
+        image_, vk::MemoryPropertyFlagBits::eDeviceLocal,
+        vk::ImageTiling::eOptimal);
+    vk::ImageViewCreateInfo view_info;
+    view_info.setImage(image_)
+        .setViewType(vk::ImageViewType::e2D)
+        .setFormat(kFormat)
+        .setSubresourceRange(vk::ImageSubresourceRange(
+            vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+    view_ = VkSuccuessOrDie(dev_.createImageView(view_info),
+                            "Couldn't create image view");
+
+    vk::AttachmentDescription attachment;
+    attachment.setFormat(kFormat)
+        .setSamples(vk::SampleCountFlagBits::e1)
+        .setLoadOp(vk::AttachmentLoadOp::eClear)
+        .setStoreOp(vk::AttachmentStoreOp::eStore)
+        .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
+        .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
+        .setInitialLayout(vk::ImageLayout::eUndefined)
+        .setFinalLayout(vk::ImageLayout::eColorAttachmentOptimal);
+    const vk::AttachmentReference color_ref(
+        0, vk::ImageLayout::eColorAttachmentOptimal);
+    vk::SubpassDescription subpass;
+    subpass.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+        .setColorAttachmentCount(1)
+        .setPColorAttachments(&color_ref);
+    vk::RenderPassCreateInfo pass_info;
+    pass_info.setAttachmentCount(1)
+        .setPAttachments(&attachment)
+        .setSubpassCount(1)
+        .setPSubpasses(&subpass);
+    render_pass_ = VkSuccuessOrDie(dev_.createRenderPass(pass_info),
+                                   "Couldn't create render pass");
+
+    vk::FramebufferCreateInfo framebuffer_info;
+    framebuffer_info.setRenderPass(render_pass_)
+        .setAttachmentCount(1)
+        .setPAttachments(&view_)
+        .setWidth(kWidth)
+        .setHeight(kHeight)
+        .setLayers(1);
+    framebuffer_ = VkSuccuessOrDie(dev_.createFramebuffer(framebuffer_info),
+                                   "Couldn't create framebuffer");
+  }
+
+  void CreatePipeline()
+  {
+    vk::DescriptorSetLayoutBinding binding;
+    binding.setBinding(0)
+        .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+        .setDescriptorCount(1)
+        .setStageFlags(vk::ShaderStageFlagBits::eVertex);
+    vk::DescriptorSetLayoutCreateInfo set_layout_info;
+    set_layout_info.setBindingCount(1).setPBindings(&binding);
+    set_layout_ =
+        VkSuccuessOrDie(dev_.createDescriptorSetLayout(set_layout_info),
+                        "Couldn't create descriptor set layout");
+    const vk::DescriptorPoolSize pool_size(vk::DescriptorType::eStorageBuffer,
+                                           1);
+    vk::DescriptorPoolCreateInfo pool_info;
+    pool_info.setMaxSets(1).setPoolSizeCount(1).setPPoolSizes(&pool_size);
+    descriptor_pool_ = VkSuccuessOrDie(dev_.createDescriptorPool(pool_info),
+                                       "Couldn't create descriptor pool");
+    vk::DescriptorSetAllocateInfo set_info;
+    set_info.setDescriptorPool(descriptor_pool_)
+        .setDescriptorSetCount(1)
+        .setPSetLayouts(&set_layout_);
+    descriptor_set_ = VkSuccuessOrDie(dev_.allocateDescriptorSets(set_info),
+                                      "Couldn't allocate descriptor set")
+                          .front();
+    const vk::DescriptorBufferInfo buffer_info(culler_->ObjectBuffer(0), 0,
+                                               VK_WHOLE_SIZE);
+    vk::WriteDescriptorSet write;
+    write.setDstSet(descriptor_set_)
+        .setDstBinding(0)
+        .setDescriptorCount(1)
+        .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+        .setPBufferInfo(&buffer_info);
+    dev_.updateDescriptorSets(write, nullptr);
+
+    const vk::PushConstantRange push_constants(
+        vk::ShaderStageFlagBits::eVertex, 0, sizeof(Mat4));
+    vk::PipelineLayoutCreateInfo layout_info;
+    layout_info.setSetLayoutCount(1)
+        .setPSetLayouts(&set_layout_)
+        .setPushConstantRangeCount(1)
+        .setPPushConstantRanges(&push_constants);
+    pipeline_layout_ = VkSuccuessOrDie(dev_.createPipelineLayout(layout_info),
+                                       "Couldn't create pipeline layout");
+
+    vertex_shader_ = CreateCullDrawVertexShader(dev_);
+    fragment_shader_ = CreateCullDrawFragmentShader(dev_);
+    GraphicsPipelineDesc desc;
+    desc.vertex_shader_ = vertex_shader_;
+    desc.fragment_shader_ = fragment_shader_;
+    desc.layout_ = pipeline_layout_;
+    desc.render_pass_ = render_pass_;
+    desc.vertex_bindings_ = {vk::VertexInputBindingDescription(
+        0, 3 * sizeof(float), vk::VertexInputRate::eVertex)};
+    desc.vertex_attributes_ = {vk::VertexInputAttributeDescription(
+        0, 0, vk::Format::eR32G32B32Sfloat, 0)};
+    desc.cull_mode_ = vk::CullModeFlagBits::eNone;
+    desc.depth_test_ = false;
+    desc.depth_write_ = false;
+    pipeline_ = pipelines_.GetOrCreate(desc);
+    pipelines_.WaitIdle();
+    CHECK(pipeline_.IsReady());
+  }
+
+  vk::Buffer CreateHostBuffer(const void* data, vk::DeviceSize size,
+                              vk::BufferUsageFlags usage,
+                              MemoryAllocation* memory)
+  {
+    vk::BufferCreateInfo buffer_info;
+    buffer_info.setSize(size).setUsage(usage).setSharingMode(
+        vk::SharingMode::eExclusive);
+    const vk::Buffer buffer = VkSuccuessOrDie(
+        dev_.createBuffer(buffer_info), "Couldn't create buffer");
+    *memory = allocator_->AllocateForBuffer(
+        buffer, vk::MemoryPropertyFlagBits::eHostVisible |
+                    vk::MemoryPropertyFlagBits::eHostCoherent);
+    std::memcpy(memory->mapped_, data, size);
+    return buffer;
+  }
+
+  void Begin()
+  {
+    VkSuccuessOrDie(dev_.resetCommandPool(
+                        cmd_pool_, static_cast<vk::CommandPoolResetFlags>(0)),
+                    "Couldn't reset command pool");
+    vk::CommandBufferBeginInfo begin_info;
+    begin_info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    VkSuccuessOrDie(cmd_buffer_.begin(begin_info),
+                    "Couldn't begin command buffer");
+  }
+
+  void BeginPass(const Mat4& view_proj)
+  {
+    const vk::Rect2D area(vk::Offset2D(0, 0), vk::Extent2D(kWidth, kHeight));
+    const vk::ClearValue clear(
+        vk::ClearColorValue(std::array<float, 4>{0, 0, 0, 1}));
+    vk::RenderPassBeginInfo pass_info;
+    pass_info.setRenderPass(render_pass_)
+        .setFramebuffer(framebuffer_)
+        .setRenderArea(area)
+        .setClearValueCount(1)
+        .setPClearValues(&clear);
+    cmd_buffer_.beginRenderPass(pass_info, vk::SubpassContents::eInline);
+    cmd_buffer_.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                             pipeline_.Get());
+    cmd_buffer_.setViewport(0, vk::Viewport(0, 0, kWidth, kHeight, 0, 1));
+    cmd_buffer_.setScissor(0, area);
+    cmd_buffer_.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                   pipeline_layout_, 0, descriptor_set_,
+                                   nullptr);
+    cmd_buffer_.pushConstants(pipeline_layout_,
+                              vk::ShaderStageFlagBits::eVertex, 0,
+                              sizeof(view_proj), view_proj.data());
+    cmd_buffer_.bindVertexBuffers(0, vertex_buffer_, vk::DeviceSize{0});
+    cmd_buffer_.bindIndexBuffer(index_buffer_, 0, vk::IndexType::eUint16);
+  }
+
+  void End()
+  {
+    cmd_buffer_.endRenderPass();
+    VkSuccuessOrDie(cmd_buffer_.end(), "Couldn't end command buffer");
+  }
+
+  const vk::Device dev_;
+  DeviceMemoryAllocator* const allocator_;
+  GpuCuller* const culler_;
+  const std::vector<CullObject>& objects_;
+
+  vk::Image image_;
+  MemoryAllocation image_memory_;
+  vk::ImageView view_;
+  vk::RenderPass render_pass_;
+  vk::Framebuffer framebuffer_;
+
+  vk::DescriptorSetLayout set_layout_;
+  vk::DescriptorPool descriptor_pool_;
+  vk::DescriptorSet descriptor_set_;
+  vk::PipelineLayout pipeline_layout_;
+  vk::ShaderModule vertex_shader_;
+  vk::ShaderModule fragment_shader_;
+  PipelineManager pipelines_;
+  PipelineManager::Handle pipeline_;
+
+  vk::Buffer vertex_buffer_;
+  MemoryAllocation vertex_memory_;
+  vk::Buffer index_buffer_;
+  MemoryAllocation index_memory_;
+
+  vk::CommandPool cmd_pool_;
+  vk::CommandBuffer cmd_buffer_;
+  vk::Fence fence_;
+  vk::Queue queue_;
+};
+
+void PrintRow(const char* name, const std::vector<double>& record_us,
+              const std::vector<double>& frame_us, size_t draw_calls,
+              size_t visible)
+{
+  std::printf("%-4s %10.1f us %10.2f ms %10zu %10zu\n", name,
+              Median(record_us), Median(frame_us) / 1000, draw_calls,
+              visible);
+}
+
+void Run(uint32_t num_objects)
+{
+  Context ctx = CreateContext();
+  {
+    DeviceMemoryAllocator allocator(ctx.phy_dev_, ctx.device_);
+    GpuCuller culler(ctx.phy_dev_, ctx.device_, &allocator,
+                     /*frames_in_flight=*/1, num_objects,
+                     ctx.draw_indirect_count_, ctx.multi_draw_indirect_);
+    const std::vector<CullObject> objects = MakeScene(num_objects);
+    Scene scene(ctx, &allocator, &culler, objects);
+    const Mat4 proj = Perspective(1.f, 0.1f, kFarPlane);
+
+    std::vector<double> cpu_record_us, cpu_frame_us, gpu_record_us,
+        gpu_frame_us;
+    size_t cpu_draw_calls = 0;
+    size_t gpu_draw_calls = 0;
+    size_t cpu_visible = 0;
+    size_t gpu_visible = 0;
+    std::vector<uint32_t> visible;
+    for (int frame = 0; frame < kFrames; ++frame)
+    {
+      const Mat4 view_proj = Multiply(proj, RotationY(frame * 0.3f));
+
+      Clock::time_point start = Clock::now();
+      cpu_draw_calls += scene.DrawCpuCulled(view_proj, &visible);
+      cpu_record_us.push_back(Micros(Clock::now() - start));
+      scene.Submit();
+      cpu_frame_us.push_back(Micros(Clock::now() - start));
+      cpu_visible += visible.size();
+
+      start = Clock::now();
+      gpu_draw_calls += scene.DrawGpuCulled(view_proj);
+      gpu_record_us.push_back(Micros(Clock::now() - start));
+      scene.Submit();
+      gpu_frame_us.push_back(Micros(Clock::now() - start));
+      gpu_visible += culler.VisibleCount(0);
+    }
+
+    std::printf("%u objects, %s, %d frames\n", num_objects,
+                ctx.draw_indirect_count_
+                    ? "draw indirect count"
+                    : ctx.multi_draw_indirect_ ? "multi draw indirect"
+                                               : "single draw indirect",
+                kFrames);
+    std::printf("%-4s %13s %13s %10s %10s\n", "", "cull+record", "frame",
+                "draws/f", "visible/f");
+    PrintRow("cpu", cpu_record_us, cpu_frame_us, cpu_draw_calls / kFrames,
+             cpu_visible / kFrames);
+    PrintRow("gpu", gpu_record_us, gpu_frame_us, gpu_draw_calls / kFrames,
+             gpu_visible / kFrames);
+  }
+  ctx.device_.destroy();
+  ctx.instance_.destroy();
+}
+
+}  // namespace
+}  // namespace motor
+
+int main(int argc, char** argv)
+{
+  motor::Run(argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                      : motor::kDefaultObjects);
+}
@@ -0,0 +1,42 @@
+#include "motor/render/culling_shaders.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include "motor/render/shaders/cull_draw.frag.h"
+#include "motor/render/shaders/cull_draw.vert.h"
+#include "motor/render/shaders/frustum_cull.comp.h"
+#include "motor/render/vulkan_utils.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+namespace
+{
+template <size_t N>
+vk::ShaderModule CreateShaderModule(const vk::Device& dev,
+                                    const uint32_t (&code)[N])
+{
+  vk::ShaderModuleCreateInfo info;
+  info.setCodeSize(sizeof(code)).setPCode(code);
+  return VkSuccuessOrDie(dev.createShaderModule(info),
+                         "Couldn't create shader module");
+}
+}  // namespace
+
+vk::ShaderModule CreateFrustumCullShader(const vk::Device& dev)
+{
+  return CreateShaderModule(dev, kFrustumCullComp);
+}
+
+vk::ShaderModule CreateCullDrawVertexShader(const vk::Device& dev)
+{
+  return CreateShaderModule(dev, kCullDrawVert);
+}
+
+vk::ShaderModule CreateCullDrawFragmentShader(const vk::Device& dev)
+{
+  return CreateShaderModule(dev, kCullDrawFrag);
+}
+
+}  // namespace motor
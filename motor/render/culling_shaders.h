@@ -0,0 +1,21 @@
+#ifndef _MOTOR_RENDER_CULLING_SHADERS_H_
+#define _MOTOR_RENDER_CULLING_SHADERS_H_
+
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+// Shader modules of the sources in motor/render/shaders, which are compiled to
+// SPIR-V by glslang as part of the build.
+
+// Culls CullObjects into VkDrawIndexedIndirectCommands, see GpuCuller.
+vk::ShaderModule CreateFrustumCullShader(const vk::Device& dev);
+
+// Draw a unit mesh at the bounding sphere of the object selected by the
+// instance index, for testing culling.
+vk::ShaderModule CreateCullDrawVertexShader(const vk::Device& dev);
+vk::ShaderModule CreateCullDrawFragmentShader(const vk::Device& dev);
+
+}  // namespace motor
+
+#endif
@@ -0,0 +1,283 @@
+#include "device_memory_allocator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "glog/logging.h"
+#include "motor/render/buddy_allocator.h"
+#include "motor/render/vulkan_utils.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+namespace
+{
+// Smallest sub-allocation, keeps the bookkeeping of the buddy allocator small.
+constexpr const vk::DeviceSize kMinBlockSize = 256;
+
+vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+vk::MemoryRequirements MakeRequirements(vk::DeviceSize size,
+                                        uint32_t memory_type_bits)
+{
+  vk::MemoryRequirements reqs;
+  reqs.size = size;
+  reqs.alignment = 1;
+  reqs.memoryTypeBits = memory_type_bits;
+  return reqs;
+}
+
+vk::DeviceSize NextPowerOfTwo(vk::DeviceSize value)
+{
+  vk::DeviceSize result = 1;
+  while (result < value) result <<= 1;
+  return result;
+}
+}  // namespace
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(const vk::PhysicalDevice& phy_dev,
+                                             const vk::Device& dev,
+                                             vk::DeviceSize block_size)
+    : dev_(dev),
+      mem_props_(phy_dev.getMemoryProperties()),
+      block_size_(block_size),
+      // Offsets in a block are aligned to the rounded allocation size, making
+      // every sub-allocation at least granularity aligned keeps linear and
+      // optimal resources in different pages even if they were to be mixed.
+      min_alignment_(NextPowerOfTwo(
+          std::max(kMinBlockSize,
+                   phy_dev.getProperties().limits.bufferImageGranularity))),
+      pools_(mem_props_.memoryTypeCount * 2)
+{
+  CHECK((block_size & (block_size - 1)) == 0)
+      << "Block size must be a power of two";
+  CHECK(min_alignment_ <= block_size_) << "Block size is too small";
+}
+
+DeviceMemoryAllocator::~DeviceMemoryAllocator()
+{
+  const DeviceMemoryStats stats = GetStats();
+  LOG_IF(WARNING, stats.num_allocations_ != 0)
+      << stats.num_allocations_ << " device memory allocations leaked";
+  for (Pool& pool : pools_)
+  {
+    for (std::unique_ptr<Block>& block : pool.blocks_)
+    {
+      if (block->mapped_ != nullptr) dev_.unmapMemory(block->memory_);
+      dev_.freeMemory(block->memory_);
+    }
+  }
+}
+
+uint32_t DeviceMemoryAllocator::FindMemoryType(
+    uint32_t type_bits, vk::MemoryPropertyFlags props) const
+{
+  for (uint32_t i = 0; i < mem_props_.memoryTypeCount; ++i, type_bits >>= 1)
+  {
+    if ((type_bits & 1) == 0) continue;
+    if ((mem_props_.memoryTypes[i].propertyFlags & props) == props) return i;
+  }
+  LOG(FATAL) << "Couldn't find memory type with properties "
+             << static_cast<unsigned>(props);
+  return 0;
+}
+
+vk::DeviceMemory DeviceMemoryAllocator::AllocateDeviceMemory(
+    vk::DeviceSize size, uint32_t memory_type, void** mapped)
+{
+  vk::MemoryAllocateInfo memory_alloc_info;
+  memory_alloc_info.setAllocationSize(size)
+      .setMemoryTypeIndex(memory_type)
+      .setPNext(nullptr);
+  vk::DeviceMemory memory = VkSuccuessOrDie(
+      dev_.allocateMemory(memory_alloc_info), "Couldn't allocate memory");
+
+  *mapped = nullptr;
+  if (mem_props_.memoryTypes[memory_type].propertyFlags &
+      vk::MemoryPropertyFlagBits::eHostVisible)
+  {
+    *mapped = VkSuccuessOrDie(
+        dev_.mapMemory(memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()),
+        "Couldn't map memory");
+  }
+  return memory;
+}
+
+std::unique_ptr<DeviceMemoryAllocator::Block>
+DeviceMemoryAllocator::CreateBlock(uint32_t memory_type)
+{
+  void* mapped = nullptr;
+  vk::DeviceMemory memory =
+      AllocateDeviceMemory(block_size_, memory_type, &mapped);
+  VLOG(1) << "Allocated new device memory block of type " << memory_type;
+  return std::make_unique<Block>(
+      Block{memory, mapped, BuddyAllocator(block_size_, kMinBlockSize)});
+}
+
+MemoryAllocation DeviceMemoryAllocator::Allocate(
+    const vk::MemoryRequirements& reqs, vk::MemoryPropertyFlags props,
+    bool is_linear)
+{
+  const uint32_t memory_type = FindMemoryType(reqs.memoryTypeBits, props);
+  const vk::DeviceSize alignment = std::max(reqs.alignment, min_alignment_);
+
+  MemoryAllocation allocation;
+  allocation.size_ = reqs.size;
+
+  std::lock_guard<std::mutex> lock(mu_);
+  used_ += reqs.size;
+  if (AlignUp(reqs.size, alignment) > block_size_ / 2)
+  {
+    // Big resources would waste most of a block, give them their own memory.
+    allocation.memory_ =
+        AllocateDeviceMemory(reqs.size, memory_type, &allocation.mapped_);
+    allocation.pool_idx_ = kDedicated;
+    dedicated_bytes_ += reqs.size;
+    ++num_dedicated_;
+    return allocation;
+  }
+
+  allocation.pool_idx_ = memory_type * 2 + (is_linear ? 1 : 0);
+  Pool& pool = pools_[allocation.pool_idx_];
+  vk::DeviceSize offset = BuddyAllocator::kInvalidOffset;
+  size_t block_idx = 0;
+  for (; block_idx < pool.blocks_.size(); ++block_idx)
+  {
+    offset = pool.blocks_[block_idx]->buddy_.Allocate(reqs.size, alignment);
+    if (offset != BuddyAllocator::kInvalidOffset) break;
+  }
+  if (offset == BuddyAllocator::kInvalidOffset)
+  {
+    pool.blocks_.push_back(CreateBlock(memory_type));
+    offset = pool.blocks_.back()->buddy_.Allocate(reqs.size, alignment);
+    CHECK(offset != BuddyAllocator::kInvalidOffset);
+  }
+
+  const Block& block = *pool.blocks_[block_idx];
+  allocation.memory_ = block.memory_;
+  allocation.offset_ = offset;
+  allocation.block_idx_ = block_idx;
+  if (block.mapped_ != nullptr)
+  {
+    allocation.mapped_ = static_cast<char*>(block.mapped_) + offset;
+  }
+  return allocation;
+}
+
+void DeviceMemoryAllocator::Free(const MemoryAllocation& allocation)
+{
+  if (!allocation.memory_) return;
+  std::lock_guard<std::mutex> lock(mu_);
+  used_ -= allocation.size_;
+  if (allocation.pool_idx_ == kDedicated)
+  {
+    if (allocation.mapped_ != nullptr) dev_.unmapMemory(allocation.memory_);
+    dev_.freeMemory(allocation.memory_);
+    dedicated_bytes_ -= allocation.size_;
+    --num_dedicated_;
+    return;
+  }
+  // Blocks are kept around even when they become empty, as they are likely
+  // to be needed again.
+  pools_[allocation.pool_idx_]
+      .blocks_[allocation.block_idx_]
+      ->buddy_.Free(allocation.offset_);
+}
+
+MemoryAllocation DeviceMemoryAllocator::AllocateForImage(
+    const vk::Image& image, vk::MemoryPropertyFlags props,
+    vk::ImageTiling tiling)
+{
+  MemoryAllocation allocation =
+      Allocate(dev_.getImageMemoryRequirements(image), props,
+               tiling == vk::ImageTiling::eLinear);
+  VkSuccuessOrDie(
+      dev_.bindImageMemory(image, allocation.memory_, allocation.offset_),
+      "Couldn't bind image memory");
+  return allocation;
+}
+
+MemoryAllocation DeviceMemoryAllocator::AllocateForBuffer(
+    const vk::Buffer& buffer, vk::MemoryPropertyFlags props)
+{
+  MemoryAllocation allocation = Allocate(
+      dev_.getBufferMemoryRequirements(buffer), props, /*is_linear=*/true);
+  VkSuccuessOrDie(
+      dev_.bindBufferMemory(buffer, allocation.memory_, allocation.offset_),
+      "Couldn't bind buffer memory");
+  return allocation;
+}
+
+DeviceMemoryStats DeviceMemoryAllocator::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  DeviceMemoryStats stats;
+  stats.used_ = used_;
+  stats.reserved_ = dedicated_bytes_;
+  stats.allocated_ = dedicated_bytes_;
+  stats.num_device_allocations_ = num_dedicated_;
+  stats.num_allocations_ = num_dedicated_;
+
+  vk::DeviceSize free_bytes = 0;
+  vk::DeviceSize largest_free = 0;
+  for (const Pool& pool : pools_)
+  {
+    for (const std::unique_ptr<Block>& block : pool.blocks_)
+    {
+      const BuddyAllocator& buddy = block->buddy_;
+      stats.reserved_ += buddy.Size();
+      stats.allocated_ += buddy.Allocated();
+      stats.num_allocations_ += buddy.NumAllocations();
+      ++stats.num_device_allocations_;
+      free_bytes += buddy.Size() - buddy.Allocated();
+      largest_free = std::max(largest_free, buddy.LargestFreeBlock());
+    }
+  }
+  if (free_bytes != 0)
+  {
+    stats.fragmentation_ = 1. - static_cast<double>(largest_free) /
+                                    static_cast<double>(free_bytes);
+  }
+  return stats;
+}
+
+LinearMemoryPool::LinearMemoryPool(DeviceMemoryAllocator* allocator,
+                                   vk::DeviceSize size,
+                                   uint32_t memory_type_bits,
+                                   vk::MemoryPropertyFlags props)
+    : allocator_(allocator),
+      backing_(allocator->Allocate(MakeRequirements(size, memory_type_bits),
+                                   props, /*is_linear=*/true))
+{
+}
+
+LinearMemoryPool::~LinearMemoryPool() { allocator_->Free(backing_); }
+
+MemoryAllocation LinearMemoryPool::Allocate(vk::DeviceSize size,
+                                            vk::DeviceSize alignment)
+{
+  // backing_.offset_ is at least as aligned as any sane |alignment|, as it
+  // is aligned to a power of two no smaller than the allocation.
+  const vk::DeviceSize begin = AlignUp(head_, alignment);
+  MemoryAllocation allocation;
+  if (begin + size > backing_.size_) return allocation;
+  head_ = begin + size;
+  high_water_mark_ = std::max(high_water_mark_, head_);
+
+  allocation.memory_ = backing_.memory_;
+  allocation.offset_ = backing_.offset_ + begin;
+  allocation.size_ = size;
+  if (backing_.mapped_ != nullptr)
+  {
+    allocation.mapped_ = static_cast<char*>(backing_.mapped_) + begin;
+  }
+  return allocation;
+}
+
+}  // namespace motor
@@ -0,0 +1,150 @@
+#ifndef _MOTOR_RENDER_DEVICE_MEMORY_ALLOCATOR_H_
+#define _MOTOR_RENDER_DEVICE_MEMORY_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "motor/render/buddy_allocator.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+struct MemoryAllocation
+{
+  vk::DeviceMemory memory_;
+  vk::DeviceSize offset_ = 0;
+  vk::DeviceSize size_ = 0;
+  // Non-null for host visible memory, points at offset_ within memory_.
+  void* mapped_ = nullptr;
+
+ private:
+  friend class DeviceMemoryAllocator;
+  // Index into DeviceMemoryAllocator pools, kDedicated for allocations that
+  // own their memory.
+  uint32_t pool_idx_ = 0;
+  uint32_t block_idx_ = 0;
+};
+
+struct DeviceMemoryStats
+{
+  // Bytes allocated from the driver.
+  vk::DeviceSize reserved_ = 0;
+  // Bytes requested by the callers.
+  vk::DeviceSize used_ = 0;
+  // Bytes handed out, i.e. used_ plus the rounding of sub-allocations.
+  vk::DeviceSize allocated_ = 0;
+  size_t num_device_allocations_ = 0;
+  size_t num_allocations_ = 0;
+  // 1 - largest free range / total free bytes across all blocks, 0 means all
+  // the free space is contiguous.
+  double fragmentation_ = 0;
+};
+
+// Sub-allocates resources out of large vk::DeviceMemory blocks, so that the
+// number of driver allocations stays small. Blocks are kept per memory type
+// and per tiling, linear and optimal resources never share a block which
+// satisfies bufferImageGranularity without further padding. Blocks are managed
+// by a buddy allocator. Requests bigger than half a block get a dedicated
+// allocation, the buddy allocator would round them up to a whole block and
+// waste more than half of it. Host visible blocks are persistently mapped.
+//
+// Thread safe.
+class DeviceMemoryAllocator
+{
+ public:
+  static constexpr vk::DeviceSize kDefaultBlockSize = 64ull << 20;
+
+  // |block_size| must be a power of two.
+  DeviceMemoryAllocator(const vk::PhysicalDevice& phy_dev,
+                        const vk::Device& dev,
+                        vk::DeviceSize block_size = kDefaultBlockSize);
+  DeviceMemoryAllocator(const DeviceMemoryAllocator&) = delete;
+  DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
+  DeviceMemoryAllocator(DeviceMemoryAllocator&&) = delete;
+  // All allocations must be freed before destruction.
+  ~DeviceMemoryAllocator();
+
+  // |is_linear| should be true for buffers and linearly tiled images.
+  MemoryAllocation Allocate(const vk::MemoryRequirements& reqs,
+                            vk::MemoryPropertyFlags props, bool is_linear);
+  void Free(const MemoryAllocation& allocation);
+
+  // Allocate and bind memory for the given resource.
+  MemoryAllocation AllocateForImage(const vk::Image& image,
+                                    vk::MemoryPropertyFlags props,
+                                    vk::ImageTiling tiling);
+  MemoryAllocation AllocateForBuffer(const vk::Buffer& buffer,
+                                     vk::MemoryPropertyFlags props);
+
+  // Returns index of the first memory type allowed by |type_bits| that has
+  // all of |props|, dies if there is none.
+  uint32_t FindMemoryType(uint32_t type_bits,
+                          vk::MemoryPropertyFlags props) const;
+
+  DeviceMemoryStats GetStats() const;
+
+ private:
+  static constexpr uint32_t kDedicated = ~uint32_t{0};
+
+  struct Block
+  {
+    vk::DeviceMemory memory_;
+    void* mapped_ = nullptr;
+    BuddyAllocator buddy_;
+  };
+  struct Pool
+  {
+    std::vector<std::unique_ptr<Block>> blocks_;
+  };
+
+  // Must be called with mu_ held.
+  std::unique_ptr<Block> CreateBlock(uint32_t memory_type);
+  vk::DeviceMemory AllocateDeviceMemory(vk::DeviceSize size,
+                                        uint32_t memory_type, void** mapped);
+
+  const vk::Device dev_;
+  const vk::PhysicalDeviceMemoryProperties mem_props_;
+  const vk::DeviceSize block_size_;
+  const vk::DeviceSize min_alignment_;
+
+  mutable std::mutex mu_;
+  // Two pools per memory type, even indices are for optimal resources.
+  std::vector<Pool> pools_;
+  vk::DeviceSize dedicated_bytes_ = 0;
+  size_t num_dedicated_ = 0;
+  vk::DeviceSize used_ = 0;
+};
+
+// Bump allocator over a single sub-allocation, meant for transient per-frame
+// data. Reset must only be called once the GPU is done with the memory handed
+// out since the previous Reset, e.g. after waiting on the frame fence.
+class LinearMemoryPool
+{
+ public:
+  LinearMemoryPool(DeviceMemoryAllocator* allocator, vk::DeviceSize size,
+                   uint32_t memory_type_bits, vk::MemoryPropertyFlags props);
+  LinearMemoryPool(const LinearMemoryPool&) = delete;
+  LinearMemoryPool& operator=(const LinearMemoryPool&) = delete;
+  ~LinearMemoryPool();
+
+  // Returns an allocation with a null memory_ if the pool is exhausted.
+  // Returned allocations must not be passed to DeviceMemoryAllocator::Free.
+  MemoryAllocation Allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+  void Reset() { head_ = 0; }
+
+  vk::DeviceSize Used() const { return head_; }
+  vk::DeviceSize HighWaterMark() const { return high_water_mark_; }
+
+ private:
+  DeviceMemoryAllocator* const allocator_;
+  const MemoryAllocation backing_;
+  vk::DeviceSize head_ = 0;
+  vk::DeviceSize high_water_mark_ = 0;
+};
+
+}  // namespace motor
+
+#endif
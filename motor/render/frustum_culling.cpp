@@ -0,0 +1,70 @@
+#include "motor/render/frustum_culling.h"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace motor
+{
+namespace
+{
+float At(const Mat4& m, int row, int col) { return m[col * 4 + row]; }
+
+// |w| * row 3 + |sign| * row |row|, e.g. x <= w becomes w - x >= 0.
+std::array<float, 4> ClipPlane(const Mat4& m, int row, float sign, float w)
+{
+  std::array<float, 4> plane;
+  for (int col = 0; col < 4; ++col)
+  {
+    plane[col] = w * At(m, 3, col) + sign * At(m, row, col);
+  }
+  const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] +
+                                 plane[2] * plane[2]);
+  if (length > 0)
+  {
+    for (float& value : plane) value /= length;
+  }
+  return plane;
+}
+}  // namespace
+
+Frustum FrustumFromViewProjection(const Mat4& view_proj)
+{
+  Frustum frustum;
+  frustum.planes_[0] = ClipPlane(view_proj, 0, 1, 1);
+  frustum.planes_[1] = ClipPlane(view_proj, 0, -1, 1);
+  frustum.planes_[2] = ClipPlane(view_proj, 1, 1, 1);
+  frustum.planes_[3] = ClipPlane(view_proj, 1, -1, 1);
+  // Depth starts at 0 rather than -w, the near plane is just z >= 0.
+  frustum.planes_[4] = ClipPlane(view_proj, 2, 1, 0);
+  frustum.planes_[5] = ClipPlane(view_proj, 2, -1, 1);
+  return frustum;
+}
+
+bool IsVisible(const Frustum& frustum, const CullObject& object)
+{
+  // Same test as the shader, the two only disagree up to rounding on objects
+  // touching a plane.
+  for (const std::array<float, 4>& plane : frustum.planes_)
+  {
+    const float dist = plane[0] * object.center_[0] +
+                       plane[1] * object.center_[1] +
+                       plane[2] * object.center_[2] + plane[3];
+    if (!(dist + object.radius_ >= 0)) return false;
+  }
+  return true;
+}
+
+void CullObjects(const Frustum& frustum, const std::vector<CullObject>& objects,
+                 std::vector<uint32_t>* visible)
+{
+  visible->clear();
+  for (uint32_t i = 0; i < objects.size(); ++i)
+  {
+    if (IsVisible(frustum, objects[i])) visible->push_back(i);
+  }
+}
+
+}  // namespace motor
@@ -0,0 +1,52 @@
+#ifndef _MOTOR_RENDER_FRUSTUM_CULLING_H_
+#define _MOTOR_RENDER_FRUSTUM_CULLING_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace motor
+{
+// Column major, i.e. element (row, col) is at col * 4 + row, as in GLSL.
+using Mat4 = std::array<float, 16>;
+
+// Planes of a view frustum as (a, b, c, d) with a * x + b * y + c * z + d >= 0
+// for points inside. Normals are unit length, so the equations give
+// distances.
+struct Frustum
+{
+  // Left, right, bottom, top, near, far.
+  std::array<std::array<float, 4>, 6> planes_{};
+};
+
+// |view_proj| maps world space to Vulkan clip space, where depth is in
+// [0, w].
+Frustum FrustumFromViewProjection(const Mat4& view_proj);
+
+// An object to cull and the draw to issue if it is visible. The layout matches
+// Object in shaders/frustum_cull.comp, so that the same objects can be culled
+// on either side.
+struct CullObject
+{
+  // Bounding sphere in world space.
+  std::array<float, 3> center_{};
+  float radius_ = 0;
+  // Parameters of the indexed draw, usually first_instance_ identifies the
+  // object for the shaders.
+  uint32_t index_count_ = 0;
+  uint32_t first_index_ = 0;
+  int32_t vertex_offset_ = 0;
+  uint32_t first_instance_ = 0;
+};
+static_assert(sizeof(CullObject) == 32, "Must match the shader layout");
+
+bool IsVisible(const Frustum& frustum, const CullObject& object);
+
+// Replaces |visible| with the indices of the visible objects, in order.
+void CullObjects(const Frustum& frustum, const std::vector<CullObject>& objects,
+                 std::vector<uint32_t>* visible);
+
+}  // namespace motor
+
+#endif
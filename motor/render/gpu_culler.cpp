@@ -0,0 +1,294 @@
+#include "motor/render/gpu_culler.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/render/culling_shaders.h"
+#include "motor/render/device_memory_allocator.h"
+#include "motor/render/frustum_culling.h"
+#include "motor/render/vulkan_utils.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+namespace
+{
+// Must match local_size_x of shaders/frustum_cull.comp.
+constexpr uint32_t kWorkgroupSize = 64;
+constexpr uint32_t kNumBindings = 3;
+constexpr uint32_t kDrawStride = sizeof(vk::DrawIndexedIndirectCommand);
+
+// Push constants of shaders/frustum_cull.comp.
+struct CullParams
+{
+  std::array<std::array<float, 4>, 6> planes_;
+  uint32_t num_objects_ = 0;
+};
+static_assert(sizeof(CullParams) == 100, "Must match the shader layout");
+}  // namespace
+
+GpuCuller::GpuCuller(const vk::PhysicalDevice& phy_dev, const vk::Device& dev,
+                     DeviceMemoryAllocator* allocator, size_t frames_in_flight,
+                     uint32_t max_objects, bool draw_indirect_count,
+                     bool multi_draw_indirect)
+    : dev_(dev),
+      allocator_(allocator),
+      max_objects_(max_objects),
+      draw_indirect_count_(draw_indirect_count),
+      multi_draw_indirect_(multi_draw_indirect)
+{
+  CHECK_GT(max_objects_, 0u);
+  if (draw_indirect_count_ || multi_draw_indirect_)
+  {
+    CHECK_LE(max_objects_,
+             phy_dev.getProperties().limits.maxDrawIndirectCount)
+        << "Too many objects for a single indirect draw";
+  }
+  if (draw_indirect_count_)
+  {
+    // Not exported by the loader, has to be looked up.
+    draw_indexed_indirect_count_ =
+        reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+            dev_.getProcAddr("vkCmdDrawIndexedIndirectCountKHR"));
+    CHECK(draw_indexed_indirect_count_ != nullptr)
+        << VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME << " isn't enabled";
+  }
+  LOG(INFO) << "GPU culling draws with "
+            << (draw_indirect_count_
+                    ? "vkCmdDrawIndexedIndirectCountKHR"
+                    : multi_draw_indirect_ ? "multi draw indirect"
+                                           : "one indirect draw per object");
+
+  std::array<vk::DescriptorSetLayoutBinding, kNumBindings> bindings;
+  for (uint32_t i = 0; i < kNumBindings; ++i)
+  {
+    bindings[i]
+        .setBinding(i)
+        .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+        .setDescriptorCount(1)
+        .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+  }
+  vk::DescriptorSetLayoutCreateInfo set_layout_info;
+  set_layout_info.setBindingCount(bindings.size())
+      .setPBindings(bindings.data());
+  set_layout_ =
+      VkSuccuessOrDie(dev_.createDescriptorSetLayout(set_layout_info),
+                      "Couldn't create descriptor set layout");
+
+  const vk::DescriptorPoolSize pool_size(vk::DescriptorType::eStorageBuffer,
+                                         kNumBindings * frames_in_flight);
+  vk::DescriptorPoolCreateInfo pool_info;
+  pool_info.setMaxSets(frames_in_flight)
+      .setPoolSizeCount(1)
+      .setPPoolSizes(&pool_size);
+  descriptor_pool_ = VkSuccuessOrDie(dev_.createDescriptorPool(pool_info),
+                                     "Couldn't create descriptor pool");
+
+  const vk::PushConstantRange push_constants(
+      vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullParams));
+  vk::PipelineLayoutCreateInfo layout_info;
+  layout_info.setSetLayoutCount(1)
+      .setPSetLayouts(&set_layout_)
+      .setPushConstantRangeCount(1)
+      .setPPushConstantRanges(&push_constants);
+  pipeline_layout_ = VkSuccuessOrDie(dev_.createPipelineLayout(layout_info),
+                                     "Couldn't create pipeline layout");
+
+  // PipelineManager only knows about graphics pipelines, this is the single
+  // compute one.
+  const vk::ShaderModule shader = CreateFrustumCullShader(dev_);
+  vk::PipelineShaderStageCreateInfo stage;
+  stage.setStage(vk::ShaderStageFlagBits::eCompute)
+      .setModule(shader)
+      .setPName("main");
+  vk::ComputePipelineCreateInfo pipeline_info;
+  pipeline_info.setStage(stage).setLayout(pipeline_layout_);
+  pipeline_ = VkSuccuessOrDie(
+      dev_.createComputePipeline(vk::PipelineCache(), pipeline_info),
+      "Couldn't create culling pipeline");
+  dev_.destroyShaderModule(shader);
+
+  const std::vector<vk::DescriptorSetLayout> set_layouts(frames_in_flight,
+                                                         set_layout_);
+  vk::DescriptorSetAllocateInfo set_info;
+  set_info.setDescriptorPool(descriptor_pool_)
+      .setDescriptorSetCount(set_layouts.size())
+      .setPSetLayouts(set_layouts.data());
+  const std::vector<vk::DescriptorSet> sets =
+      VkSuccuessOrDie(dev_.allocateDescriptorSets(set_info),
+                      "Couldn't allocate descriptor sets");
+
+  const vk::MemoryPropertyFlags host_visible =
+      vk::MemoryPropertyFlagBits::eHostVisible |
+      vk::MemoryPropertyFlagBits::eHostCoherent;
+  slots_.resize(frames_in_flight);
+  for (size_t i = 0; i < slots_.size(); ++i)
+  {
+    Slot& slot = slots_[i];
+    // Objects are written by the CPU every frame, so they stay host visible
+    // rather than going through the UploadManager.
+    slot.objects_buffer_ = CreateBuffer(
+        vk::DeviceSize{max_objects_} * sizeof(CullObject),
+        vk::BufferUsageFlagBits::eStorageBuffer, host_visible,
+        &slot.objects_memory_);
+    slot.draws_buffer_ = CreateBuffer(
+        vk::DeviceSize{max_objects_} * kDrawStride,
+        vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eIndirectBuffer |
+            vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, &slot.draws_memory_);
+    slot.count_buffer_ = CreateBuffer(
+        sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eIndirectBuffer |
+            vk::BufferUsageFlagBits::eTransferDst,
+        host_visible, &slot.count_memory_);
+    slot.descriptor_set_ = sets[i];
+
+    const std::array<vk::DescriptorBufferInfo, kNumBindings> buffer_infos = {
+        vk::DescriptorBufferInfo(slot.objects_buffer_, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(slot.draws_buffer_, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(slot.count_buffer_, 0, VK_WHOLE_SIZE),
+    };
+    std::array<vk::WriteDescriptorSet, kNumBindings> writes;
+    for (uint32_t binding = 0; binding < kNumBindings; ++binding)
+    {
+      writes[binding]
+          .setDstSet(slot.descriptor_set_)
+          .setDstBinding(binding)
+          .setDescriptorCount(1)
+          .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+          .setPBufferInfo(&buffer_infos[binding]);
+    }
+    dev_.updateDescriptorSets(writes, nullptr);
+  }
+}
+
+GpuCuller::~GpuCuller()
+{
+  for (Slot& slot : slots_)
+  {
+    dev_.destroyBuffer(slot.objects_buffer_);
+    allocator_->Free(slot.objects_memory_);
+    dev_.destroyBuffer(slot.draws_buffer_);
+    allocator_->Free(slot.draws_memory_);
+    dev_.destroyBuffer(slot.count_buffer_);
+    allocator_->Free(slot.count_memory_);
+  }
+  dev_.destroyPipeline(pipeline_);
+  dev_.destroyPipelineLayout(pipeline_layout_);
+  // Frees the sets as well.
+  dev_.destroyDescriptorPool(descriptor_pool_);
+  dev_.destroyDescriptorSetLayout(set_layout_);
+}
+
+vk::Buffer GpuCuller::CreateBuffer(vk::DeviceSize size,
+                                   vk::BufferUsageFlags usage,
+                                   vk::MemoryPropertyFlags props,
+                                   MemoryAllocation* memory)
+{
+  vk::BufferCreateInfo buffer_info;
+  buffer_info.setSize(size)
+      .setUsage(usage)
+      .setSharingMode(vk::SharingMode::eExclusive);
+  const vk::Buffer buffer = VkSuccuessOrDie(dev_.createBuffer(buffer_info),
+                                            "Couldn't create buffer");
+  *memory = allocator_->AllocateForBuffer(buffer, props);
+  return buffer;
+}
+
+CullObject* GpuCuller::Objects(size_t slot)
+{
+  return static_cast<CullObject*>(slots_[slot].objects_memory_.mapped_);
+}
+
+void GpuCuller::RecordCull(const vk::CommandBuffer& cmd_buffer, size_t slot_idx,
+                           const Frustum& frustum, uint32_t num_objects)
+{
+  CHECK_LE(num_objects, max_objects_);
+  Slot& slot = slots_[slot_idx];
+  slot.num_objects_ = num_objects;
+
+  // Previous draws of the slot are done, as the GPU is done with its frame.
+  cmd_buffer.fillBuffer(slot.count_buffer_, 0, sizeof(uint32_t), 0);
+  if (!draw_indirect_count_ && num_objects > 0)
+  {
+    cmd_buffer.fillBuffer(slot.draws_buffer_, 0,
+                          vk::DeviceSize{num_objects} * kDrawStride, 0);
+  }
+  vk::MemoryBarrier clear_barrier;
+  clear_barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eShaderRead |
+                        vk::AccessFlagBits::eShaderWrite);
+  cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                             vk::PipelineStageFlagBits::eComputeShader,
+                             static_cast<vk::DependencyFlags>(0),
+                             clear_barrier, nullptr, nullptr);
+
+  if (num_objects > 0)
+  {
+    CullParams params;
+    params.planes_ = frustum.planes_;
+    params.num_objects_ = num_objects;
+    cmd_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline_);
+    cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                  pipeline_layout_, 0, slot.descriptor_set_,
+                                  nullptr);
+    cmd_buffer.pushConstants(pipeline_layout_,
+                             vk::ShaderStageFlagBits::eCompute, 0,
+                             sizeof(params), &params);
+    cmd_buffer.dispatch((num_objects + kWorkgroupSize - 1) / kWorkgroupSize,
+                        1, 1);
+  }
+
+  vk::MemoryBarrier draw_barrier;
+  draw_barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite |
+                                vk::AccessFlagBits::eTransferWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead |
+                        vk::AccessFlagBits::eHostRead);
+  cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader |
+                                 vk::PipelineStageFlagBits::eTransfer,
+                             vk::PipelineStageFlagBits::eDrawIndirect |
+                                 vk::PipelineStageFlagBits::eHost,
+                             static_cast<vk::DependencyFlags>(0),
+                             draw_barrier, nullptr, nullptr);
+}
+
+size_t GpuCuller::RecordDraws(const vk::CommandBuffer& cmd_buffer,
+                              size_t slot_idx) const
+{
+  const Slot& slot = slots_[slot_idx];
+  if (slot.num_objects_ == 0) return 0;
+  if (draw_indirect_count_)
+  {
+    draw_indexed_indirect_count_(
+        static_cast<VkCommandBuffer>(cmd_buffer),
+        static_cast<VkBuffer>(slot.draws_buffer_), 0,
+        static_cast<VkBuffer>(slot.count_buffer_), 0, slot.num_objects_,
+        kDrawStride);
+    return 1;
+  }
+  if (multi_draw_indirect_)
+  {
+    cmd_buffer.drawIndexedIndirect(slot.draws_buffer_, 0, slot.num_objects_,
+                                   kDrawStride);
+    return 1;
+  }
+  for (uint32_t i = 0; i < slot.num_objects_; ++i)
+  {
+    cmd_buffer.drawIndexedIndirect(slot.draws_buffer_,
+                                   vk::DeviceSize{i} * kDrawStride, 1,
+                                   kDrawStride);
+  }
+  return slot.num_objects_;
+}
+
+uint32_t GpuCuller::VisibleCount(size_t slot) const
+{
+  return *static_cast<const uint32_t*>(slots_[slot].count_memory_.mapped_);
+}
+
+}  // namespace motor
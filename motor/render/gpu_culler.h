@@ -0,0 +1,103 @@
+#ifndef _MOTOR_RENDER_GPU_CULLER_H_
+#define _MOTOR_RENDER_GPU_CULLER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "motor/render/device_memory_allocator.h"
+#include "motor/render/frustum_culling.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+// GPU driven culling and drawing. Objects live in a storage buffer, a compute
+// pass tests their bounding spheres against the frustum and compacts the
+// draws of the visible ones into an indirect buffer, which is then drawn with
+// a single vkCmdDrawIndexedIndirectCount. The CPU never looks at individual
+// objects after writing them.
+//
+// Without VK_KHR_draw_indirect_count the draw count is unknown to the CPU, so
+// the indirect buffer is cleared every frame and every object gets a draw,
+// those past the visible ones are empty. Without the multiDrawIndirect feature
+// that is one draw call per object, only good as a fallback.
+//
+// All objects of a frame share the vertex and index buffers, and their draws
+// the pipeline, as there is no state change between the draws. The
+// drawIndirectFirstInstance feature must be enabled if first_instance_ is
+// used.
+//
+// Owns one set of buffers per frame in flight. A slot must only be touched
+// once the GPU is done with its previous frame, e.g. after waiting on the
+// frame fence.
+class GpuCuller
+{
+ public:
+  // |draw_indirect_count| and |multi_draw_indirect| tell whether the
+  // extension and the feature are enabled on |dev|.
+  GpuCuller(const vk::PhysicalDevice& phy_dev, const vk::Device& dev,
+            DeviceMemoryAllocator* allocator, size_t frames_in_flight,
+            uint32_t max_objects, bool draw_indirect_count,
+            bool multi_draw_indirect);
+  GpuCuller(const GpuCuller&) = delete;
+  GpuCuller& operator=(const GpuCuller&) = delete;
+  ~GpuCuller();
+
+  // Host visible, mapped storage for |max_objects| objects of |slot|.
+  CullObject* Objects(size_t slot);
+  // The buffer behind Objects, e.g. for vertex shaders to look up the object
+  // of a draw by its instance index.
+  vk::Buffer ObjectBuffer(size_t slot) const
+  {
+    return slots_[slot].objects_buffer_;
+  }
+
+  // Records culling of the first |num_objects| objects of |slot| against
+  // |frustum|, outside of a render pass. Draws of the slot must be recorded
+  // after it, into the same queue.
+  void RecordCull(const vk::CommandBuffer& cmd_buffer, size_t slot,
+                  const Frustum& frustum, uint32_t num_objects);
+  // Records the draws of the visible objects, inside a render pass with the
+  // pipeline, vertex and index buffers bound. Returns the number of draw
+  // calls recorded.
+  size_t RecordDraws(const vk::CommandBuffer& cmd_buffer, size_t slot) const;
+
+  // Number of objects that passed culling in the last frame of |slot|, only
+  // valid once the GPU is done with it.
+  uint32_t VisibleCount(size_t slot) const;
+
+ private:
+  struct Slot
+  {
+    vk::Buffer objects_buffer_;
+    MemoryAllocation objects_memory_;
+    vk::Buffer draws_buffer_;
+    MemoryAllocation draws_memory_;
+    // Host visible, so that VisibleCount can read it back.
+    vk::Buffer count_buffer_;
+    MemoryAllocation count_memory_;
+    vk::DescriptorSet descriptor_set_;
+    uint32_t num_objects_ = 0;
+  };
+
+  vk::Buffer CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage,
+                          vk::MemoryPropertyFlags props,
+                          MemoryAllocation* memory);
+
+  const vk::Device dev_;
+  DeviceMemoryAllocator* const allocator_;
+  const uint32_t max_objects_;
+  const bool draw_indirect_count_;
+  const bool multi_draw_indirect_;
+  PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count_ = nullptr;
+
+  vk::DescriptorSetLayout set_layout_;
+  vk::DescriptorPool descriptor_pool_;
+  vk::PipelineLayout pipeline_layout_;
+  vk::Pipeline pipeline_;
+  std::vector<Slot> slots_;
+};
+
+}  // namespace motor
+
+#endif
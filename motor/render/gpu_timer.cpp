@@ -0,0 +1,129 @@
+#include "gpu_timer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/render/renderer.h"
+#include "motor/render/vulkan_utils.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+GpuTimer::GpuTimer(const vk::PhysicalDevice& phy_dev, const vk::Device& dev,
+                   uint32_t queue_family_idx, size_t frames_in_flight)
+    : dev_(dev)
+{
+  const std::vector<vk::QueueFamilyProperties> queue_family_props =
+      phy_dev.getQueueFamilyProperties();
+  CHECK(queue_family_idx < queue_family_props.size()) << "Invalid queue";
+  valid_bits_ = queue_family_props[queue_family_idx].timestampValidBits;
+  if (!IsSupported())
+  {
+    LOG(INFO) << "Queue doesn't support timestamps, GPU timing is disabled";
+    return;
+  }
+  period_ns_ = phy_dev.getProperties().limits.timestampPeriod;
+  // Timestamps wrap around at valid_bits_, differences are taken modulo.
+  valid_mask_ = valid_bits_ >= 64 ? ~uint64_t{0}
+                                  : (uint64_t{1} << valid_bits_) - 1;
+  LOG(INFO) << "GPU timestamps: " << valid_bits_ << " valid bits, "
+            << period_ns_ << "ns period";
+
+  vk::QueryPoolCreateInfo pool_info;
+  pool_info.setQueryType(vk::QueryType::eTimestamp)
+      .setQueryCount(2 * kMaxScopes)
+      .setPNext(nullptr);
+  slots_.resize(frames_in_flight);
+  for (Slot& slot : slots_)
+  {
+    slot.pool_ = VkSuccuessOrDie(dev_.createQueryPool(pool_info),
+                                 "Couldn't create query pool");
+    slot.names_.reserve(kMaxScopes);
+  }
+  stats_.scopes_.reserve(kMaxScopes);
+}
+
+GpuTimer::~GpuTimer()
+{
+  for (Slot& slot : slots_) dev_.destroyQueryPool(slot.pool_);
+}
+
+void GpuTimer::BeginFrame(size_t slot_idx, uint64_t frame,
+                          const vk::CommandBuffer& cmd_buffer)
+{
+  if (!IsSupported()) return;
+  Slot& slot = slots_[slot_idx];
+  ReadBack(&slot);
+  slot.names_.clear();
+  slot.frame_ = frame;
+  // Queries must be reset before they are written again, there is no host
+  // side reset in Vulkan 1.1.
+  cmd_buffer.resetQueryPool(slot.pool_, 0, 2 * kMaxScopes);
+  current_ = &slot;
+}
+
+uint32_t GpuTimer::Begin(const vk::CommandBuffer& cmd_buffer,
+                         std::string_view name)
+{
+  if (!IsSupported()) return kInvalidScope;
+  DCHECK(current_ != nullptr) << "Scope recorded before BeginFrame";
+  if (current_->names_.size() == kMaxScopes)
+  {
+    VLOG(1) << "Out of GPU timer scopes, dropping " << name;
+    return kInvalidScope;
+  }
+  const uint32_t scope = current_->names_.size();
+  current_->names_.push_back(name);
+  cmd_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+                            current_->pool_, 2 * scope);
+  return scope;
+}
+
+void GpuTimer::End(const vk::CommandBuffer& cmd_buffer, uint32_t scope)
+{
+  if (scope == kInvalidScope) return;
+  cmd_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                            current_->pool_, 2 * scope + 1);
+}
+
+GpuStats GpuTimer::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  return stats_;
+}
+
+void GpuTimer::ReadBack(Slot* slot)
+{
+  const uint32_t num_queries = 2 * slot->names_.size();
+  if (num_queries == 0) return;
+  // Without the wait flag this returns eNotReady rather than blocking, e.g.
+  // if the frame was never submitted.
+  const vk::Result result = dev_.getQueryPoolResults(
+      slot->pool_, 0, num_queries, num_queries * sizeof(uint64_t),
+      timestamps_.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+  if (result != vk::Result::eSuccess)
+  {
+    VLOG(1) << "GPU timestamps of frame " << slot->frame_
+            << " are not available: " << static_cast<int>(result);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mu_);
+  stats_.frame_ = slot->frame_;
+  stats_.scopes_.clear();
+  for (size_t i = 0; i < slot->names_.size(); ++i)
+  {
+    const uint64_t ticks =
+        (timestamps_[2 * i + 1] - timestamps_[2 * i]) & valid_mask_;
+    GpuScopeTime scope;
+    scope.name_ = slot->names_[i];
+    scope.ms_ = ticks * period_ns_ / 1e6;
+    stats_.scopes_.push_back(scope);
+  }
+}
+
+}  // namespace motor
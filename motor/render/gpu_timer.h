@@ -0,0 +1,101 @@
+#ifndef _MOTOR_RENDER_GPU_TIMER_H_
+#define _MOTOR_RENDER_GPU_TIMER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "motor/render/renderer.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+// Measures GPU time of named regions of command buffers with timestamp
+// queries. Owns one query pool per frame in flight, queries of a slot are read
+// back once the slot is reused. As its fence has signaled by then, reading
+// never stalls, results of frame N are available at frame N + frames in
+// flight.
+class GpuTimer
+{
+ public:
+  static constexpr uint32_t kMaxScopes = 64;
+  // Returned by Begin when out of queries, End ignores it.
+  static constexpr uint32_t kInvalidScope = kMaxScopes;
+
+  // Ends a scope when it goes out of scope.
+  class Scope
+  {
+   public:
+    // |name| must outlive the timer, i.e. be a string literal.
+    Scope(GpuTimer* timer, const vk::CommandBuffer& cmd_buffer,
+          std::string_view name)
+        : timer_(timer),
+          cmd_buffer_(cmd_buffer),
+          scope_(timer->Begin(cmd_buffer, name))
+    {
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    ~Scope() { timer_->End(cmd_buffer_, scope_); }
+
+   private:
+    GpuTimer* const timer_;
+    const vk::CommandBuffer cmd_buffer_;
+    const uint32_t scope_;
+  };
+
+  GpuTimer(const vk::PhysicalDevice& phy_dev, const vk::Device& dev,
+           uint32_t queue_family_idx, size_t frames_in_flight);
+  GpuTimer(const GpuTimer&) = delete;
+  GpuTimer& operator=(const GpuTimer&) = delete;
+  ~GpuTimer();
+
+  // False if the queue doesn't support timestamps, everything else is a no-op
+  // in that case.
+  bool IsSupported() const { return valid_bits_ != 0; }
+
+  // Must be called once the GPU is done with frame |slot|, before any scopes
+  // are recorded into |cmd_buffer|. Reads back the previous frame of the slot
+  // and resets its queries.
+  void BeginFrame(size_t slot, uint64_t frame,
+                  const vk::CommandBuffer& cmd_buffer);
+
+  // Scopes can only be recorded into primary command buffers, from the thread
+  // calling BeginFrame. They must be closed before the command buffer ends.
+  uint32_t Begin(const vk::CommandBuffer& cmd_buffer, std::string_view name);
+  void End(const vk::CommandBuffer& cmd_buffer, uint32_t scope);
+
+  // Safe to call from any thread.
+  GpuStats GetStats() const;
+
+ private:
+  struct Slot
+  {
+    vk::QueryPool pool_;
+    uint64_t frame_ = 0;
+    // Names of the scopes recorded into the pool, scope i uses queries 2i and
+    // 2i + 1.
+    std::vector<std::string_view> names_;
+  };
+
+  void ReadBack(Slot* slot);
+
+  const vk::Device dev_;
+  // Nanoseconds per timestamp tick.
+  double period_ns_ = 0;
+  uint32_t valid_bits_ = 0;
+  uint64_t valid_mask_ = 0;
+  std::vector<Slot> slots_;
+  Slot* current_ = nullptr;
+  std::array<uint64_t, 2 * kMaxScopes> timestamps_;
+
+  mutable std::mutex mu_;
+  GpuStats stats_;
+};
+
+}  // namespace motor
+
+#endif
@@ -0,0 +1,116 @@
+#include "latency_tracker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "glog/logging.h"
+
+namespace motor
+{
+namespace
+{
+constexpr const int64_t kBucketWidthNs =
+    std::chrono::nanoseconds(LatencyHistogram::kBucketWidth).count();
+
+size_t BucketOf(int64_t latency_ns)
+{
+  return std::min<size_t>(std::max<int64_t>(latency_ns, 0) / kBucketWidthNs,
+                          LatencyHistogram::kNumBuckets);
+}
+
+double ToMs(int64_t ns) { return static_cast<double>(ns) / 1e6; }
+}  // namespace
+
+const char* LatencyStageName(LatencyStage stage)
+{
+  switch (stage)
+  {
+    case LatencyStage::kUpdate:
+      return "update";
+    case LatencyStage::kSubmit:
+      return "submit";
+    case LatencyStage::kPresent:
+      return "present";
+    case LatencyStage::kNumStages:
+      break;
+  }
+  return "unknown";
+}
+
+void LatencyHistogram::Add(std::chrono::nanoseconds latency)
+{
+  if (count_ == kWindow)
+  {
+    // Evict the oldest sample, which is about to be overwritten.
+    --buckets_[BucketOf(window_[next_])];
+    sum_ns_ -= window_[next_];
+    --count_;
+  }
+  window_[next_] = latency.count();
+  next_ = (next_ + 1) % kWindow;
+  ++buckets_[BucketOf(latency.count())];
+  sum_ns_ += latency.count();
+  ++count_;
+}
+
+double LatencyHistogram::MeanMs() const
+{
+  return count_ == 0 ? 0 : ToMs(sum_ns_) / count_;
+}
+
+double LatencyHistogram::PercentileMs(double p) const
+{
+  if (count_ == 0) return 0;
+  const size_t rank =
+      std::max<size_t>(1, static_cast<size_t>(p * count_ + .5));
+  size_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i)
+  {
+    seen += buckets_[i];
+    if (seen >= rank) return std::min(ToMs((i + 1) * kBucketWidthNs), MaxMs());
+  }
+  return MaxMs();
+}
+
+double LatencyHistogram::MaxMs() const
+{
+  int64_t max_ns = 0;
+  const size_t n = std::min(count_, kWindow);
+  for (size_t i = 0; i < n; ++i) max_ns = std::max(max_ns, window_[i]);
+  return ToMs(max_ns);
+}
+
+void LatencyTracker::Record(LatencyStage stage, Clock::time_point input_time,
+                            Clock::time_point stage_time)
+{
+  if (input_time == Clock::time_point()) return;
+  std::lock_guard<std::mutex> lock(mu_);
+  histograms_[static_cast<size_t>(stage)].Add(stage_time - input_time);
+}
+
+LatencyHistogram LatencyTracker::GetHistogram(LatencyStage stage) const
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  return histograms_[static_cast<size_t>(stage)];
+}
+
+void LatencyTracker::Dump() const
+{
+  for (size_t i = 0; i < static_cast<size_t>(LatencyStage::kNumStages); ++i)
+  {
+    const LatencyStage stage = static_cast<LatencyStage>(i);
+    const LatencyHistogram histogram = GetHistogram(stage);
+    if (histogram.Count() == 0) continue;
+    LOG(INFO) << "Input to " << LatencyStageName(stage) << " latency over "
+              << histogram.Count() << " frames, mean: " << histogram.MeanMs()
+              << "ms p50: " << histogram.PercentileMs(.5)
+              << "ms p95: " << histogram.PercentileMs(.95)
+              << "ms p99: " << histogram.PercentileMs(.99)
+              << "ms max: " << histogram.MaxMs() << "ms";
+  }
+}
+
+}  // namespace motor
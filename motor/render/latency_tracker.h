@@ -0,0 +1,80 @@
+#ifndef _MOTOR_RENDER_LATENCY_TRACKER_H_
+#define _MOTOR_RENDER_LATENCY_TRACKER_H_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace motor
+{
+// Points along the way of an input event to the screen.
+enum class LatencyStage
+{
+  // Simulation has consumed the input and built the render packet.
+  kUpdate = 0,
+  // Command buffers reflecting the input were submitted to the GPU.
+  kSubmit,
+  // Frame was presented, as reported by the display or observed on the CPU
+  // when the display can't tell.
+  kPresent,
+  kNumStages,
+};
+
+const char* LatencyStageName(LatencyStage stage);
+
+// Histogram over the most recent kWindow latencies. Buckets are kBucketWidth
+// wide, anything above the last bucket is accumulated in an overflow bucket.
+class LatencyHistogram
+{
+ public:
+  static constexpr size_t kWindow = 1024;
+  static constexpr std::chrono::microseconds kBucketWidth{250};
+  static constexpr size_t kNumBuckets = 1000;
+
+  void Add(std::chrono::nanoseconds latency);
+
+  size_t Count() const { return count_; }
+  // In milliseconds, zero if there are no samples. Percentiles are rounded up
+  // to the end of the bucket they fall into, capped at the maximum.
+  double MeanMs() const;
+  double PercentileMs(double p) const;
+  double MaxMs() const;
+
+ private:
+  std::array<uint32_t, kNumBuckets + 1> buckets_ = {};
+  std::array<int64_t, kWindow> window_ = {};
+  size_t next_ = 0;
+  size_t count_ = 0;
+  int64_t sum_ns_ = 0;
+};
+
+// Collects input to stage latencies of frames. Input timestamps travel with
+// the frame from the window through the RenderPacket, each stage reports the
+// time it has reached. Recording and querying can happen on different
+// threads.
+class LatencyTracker
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // No-op for frames that don't carry any input, i.e. default constructed
+  // |input_time|.
+  void Record(LatencyStage stage, Clock::time_point input_time,
+              Clock::time_point stage_time);
+
+  // Returns a snapshot of the rolling histogram of |stage|.
+  LatencyHistogram GetHistogram(LatencyStage stage) const;
+  // Logs percentiles of all stages.
+  void Dump() const;
+
+ private:
+  mutable std::mutex mu_;
+  std::array<LatencyHistogram, static_cast<size_t>(LatencyStage::kNumStages)>
+      histograms_;
+};
+
+}  // namespace motor
+
+#endif
@@ -0,0 +1,35 @@
+#include <chrono>
+
+#include "glog/logging.h"
+#include "motor/render/latency_tracker.h"
+#include "motor/render/renderer.h"
+
+namespace motor
+{
+namespace
+{
+// Draws nothing. Lets the engine run on machines without any graphics device,
+// e.g. CI, and isolates simulation costs in benchmarks.
+class NullRenderer : public Renderer
+{
+ public:
+  void Initialize() override { LOG(INFO) << "Initialized null renderer"; }
+
+  void Render(const RenderPacket& packet) override
+  {
+    LatencyTracker* tracker = GetOptions().latency_tracker_;
+    if (tracker == nullptr) return;
+    // Nothing is submitted or presented, the frame is done as soon as it
+    // arrives.
+    const auto now = std::chrono::steady_clock::now();
+    tracker->Record(LatencyStage::kSubmit, packet.input_time_, now);
+    tracker->Record(LatencyStage::kPresent, packet.input_time_, now);
+  }
+};
+
+}  // namespace
+
+// Fallback for when no other renderer can run.
+static RenderPlugin::Add<NullRenderer> x("null", /*priority=*/0);
+
+}  // namespace motor
@@ -0,0 +1,374 @@
+#include "pipeline_manager.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/jobs/job_system.h"
+#include "motor/render/vulkan_utils.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr const uint32_t kCacheMagic = 0x4350544D;  // "MTPC"
+constexpr const uint32_t kCacheVersion = 1;
+
+// Prefix of the on-disk cache. Drivers validate the cache data on their own,
+// but not all of them do it reliably, e.g. across driver updates.
+struct CacheFileHeader
+{
+  uint32_t magic_ = kCacheMagic;
+  uint32_t version_ = kCacheVersion;
+  uint32_t vendor_id_ = 0;
+  uint32_t device_id_ = 0;
+  uint32_t driver_version_ = 0;
+  std::array<uint8_t, VK_UUID_SIZE> cache_uuid_{};
+  uint64_t data_size_ = 0;
+};
+
+CacheFileHeader MakeHeader(const vk::PhysicalDeviceProperties& props)
+{
+  CacheFileHeader header;
+  header.vendor_id_ = props.vendorID;
+  header.device_id_ = props.deviceID;
+  header.driver_version_ = props.driverVersion;
+  std::memcpy(header.cache_uuid_.data(), props.pipelineCacheUUID,
+              VK_UUID_SIZE);
+  return header;
+}
+
+bool IsCompatible(const CacheFileHeader& header,
+                  const CacheFileHeader& expected)
+{
+  return header.magic_ == expected.magic_ &&
+         header.version_ == expected.version_ &&
+         header.vendor_id_ == expected.vendor_id_ &&
+         header.device_id_ == expected.device_id_ &&
+         header.driver_version_ == expected.driver_version_ &&
+         header.cache_uuid_ == expected.cache_uuid_;
+}
+
+double ToMillis(Clock::duration duration)
+{
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+template <typename T>
+void HashCombine(size_t* seed, const T& value)
+{
+  *seed ^= std::hash<T>()(value) + 0x9e3779b9 + (*seed << 6) + (*seed >> 2);
+}
+}  // namespace
+
+bool GraphicsPipelineDesc::operator==(const GraphicsPipelineDesc& other) const
+{
+  return vertex_shader_ == other.vertex_shader_ &&
+         fragment_shader_ == other.fragment_shader_ &&
+         layout_ == other.layout_ && render_pass_ == other.render_pass_ &&
+         subpass_ == other.subpass_ &&
+         vertex_bindings_ == other.vertex_bindings_ &&
+         vertex_attributes_ == other.vertex_attributes_ &&
+         topology_ == other.topology_ && polygon_mode_ == other.polygon_mode_ &&
+         cull_mode_ == other.cull_mode_ && front_face_ == other.front_face_ &&
+         depth_test_ == other.depth_test_ &&
+         depth_write_ == other.depth_write_ &&
+         depth_compare_ == other.depth_compare_ &&
+         alpha_blend_ == other.alpha_blend_;
+}
+
+size_t GraphicsPipelineDescHash::operator()(
+    const GraphicsPipelineDesc& desc) const
+{
+  size_t seed = 0;
+  HashCombine(&seed, static_cast<VkShaderModule>(desc.vertex_shader_));
+  HashCombine(&seed, static_cast<VkShaderModule>(desc.fragment_shader_));
+  HashCombine(&seed, static_cast<VkPipelineLayout>(desc.layout_));
+  HashCombine(&seed, static_cast<VkRenderPass>(desc.render_pass_));
+  HashCombine(&seed, desc.subpass_);
+  for (const vk::VertexInputBindingDescription& binding :
+       desc.vertex_bindings_)
+  {
+    HashCombine(&seed, binding.binding);
+    HashCombine(&seed, binding.stride);
+    HashCombine(&seed, static_cast<int>(binding.inputRate));
+  }
+  for (const vk::VertexInputAttributeDescription& attribute :
+       desc.vertex_attributes_)
+  {
+    HashCombine(&seed, attribute.location);
+    HashCombine(&seed, attribute.binding);
+    HashCombine(&seed, static_cast<int>(attribute.format));
+    HashCombine(&seed, attribute.offset);
+  }
+  HashCombine(&seed, static_cast<int>(desc.topology_));
+  HashCombine(&seed, static_cast<int>(desc.polygon_mode_));
+  HashCombine(&seed, static_cast<VkFlags>(desc.cull_mode_));
+  HashCombine(&seed, static_cast<int>(desc.front_face_));
+  HashCombine(&seed, desc.depth_test_);
+  HashCombine(&seed, desc.depth_write_);
+  HashCombine(&seed, static_cast<int>(desc.depth_compare_));
+  HashCombine(&seed, desc.alpha_blend_);
+  return seed;
+}
+
+PipelineManager::PipelineManager(const vk::PhysicalDevice& phy_dev,
+                                 const vk::Device& dev,
+                                 jobs::JobSystem* job_system,
+                                 std::string cache_path)
+    : dev_(dev),
+      props_(phy_dev.getProperties()),
+      job_system_(job_system),
+      cache_path_(std::move(cache_path))
+{
+  Load();
+}
+
+PipelineManager::~PipelineManager()
+{
+  WaitIdle();
+  Save();
+  const PipelineStats stats = GetStats();
+  LOG(INFO) << (stats.warm_start_ ? "Warm" : "Cold")
+            << " start, created " << stats.num_created_ << " pipelines in "
+            << stats.create_ms_ << "ms, cache load took "
+            << stats.cache_load_ms_ << "ms, dedup hits "
+            << stats.num_dedup_hits_;
+  for (auto& pipeline : pipelines_)
+  {
+    dev_.destroyPipeline(pipeline.second->pipeline_);
+  }
+  dev_.destroyPipelineCache(cache_);
+}
+
+void PipelineManager::Load()
+{
+  const Clock::time_point start = Clock::now();
+  const CacheFileHeader expected = MakeHeader(props_);
+
+  const void* initial_data = nullptr;
+  size_t initial_size = 0;
+  void* mapping = MAP_FAILED;
+  size_t mapping_size = 0;
+
+  const int fd =
+      cache_path_.empty() ? -1 : open(cache_path_.c_str(), O_RDONLY);
+  struct stat file_stat;
+  if (fd >= 0 && fstat(fd, &file_stat) == 0 &&
+      static_cast<size_t>(file_stat.st_size) >= sizeof(CacheFileHeader))
+  {
+    mapping_size = file_stat.st_size;
+    mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  if (mapping != MAP_FAILED)
+  {
+    CacheFileHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    if (IsCompatible(header, expected) &&
+        header.data_size_ == mapping_size - sizeof(header))
+    {
+      initial_data = static_cast<const char*>(mapping) + sizeof(header);
+      initial_size = header.data_size_;
+    }
+    else
+    {
+      LOG(INFO) << "Discarding incompatible pipeline cache " << cache_path_;
+    }
+  }
+
+  vk::PipelineCacheCreateInfo cache_info;
+  cache_info.setInitialDataSize(initial_size)
+      .setPInitialData(initial_data)
+      .setPNext(nullptr);
+  cache_ = VkSuccuessOrDie(dev_.createPipelineCache(cache_info),
+                           "Couldn't create pipeline cache");
+
+  if (mapping != MAP_FAILED) munmap(mapping, mapping_size);
+  if (fd >= 0) close(fd);
+
+  stats_.warm_start_ = initial_size != 0;
+  stats_.cache_load_bytes_ = initial_size;
+  stats_.cache_load_ms_ = ToMillis(Clock::now() - start);
+  LOG(INFO) << "Loaded " << initial_size << " bytes of pipeline cache in "
+            << stats_.cache_load_ms_ << "ms";
+}
+
+bool PipelineManager::Save() const
+{
+  if (cache_path_.empty()) return true;
+  std::vector<uint8_t> data =
+      VkSuccuessOrDie(dev_.getPipelineCacheData(cache_),
+                      "Couldn't get pipeline cache data");
+  CacheFileHeader header = MakeHeader(props_);
+  header.data_size_ = data.size();
+
+  // Write to a temporary file and rename, so that a crash never leaves a
+  // truncated cache behind.
+  const std::string tmp_path = cache_path_ + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    out.close();
+    if (!out)
+    {
+      LOG(WARNING) << "Couldn't write pipeline cache to " << tmp_path;
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), cache_path_.c_str()) != 0)
+  {
+    LOG(WARNING) << "Couldn't rename pipeline cache to " << cache_path_;
+    return false;
+  }
+  VLOG(1) << "Saved " << data.size() << " bytes of pipeline cache";
+  return true;
+}
+
+PipelineManager::Handle PipelineManager::GetOrCreate(
+    const GraphicsPipelineDesc& desc)
+{
+  Entry* entry = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = pipelines_.find(desc);
+    if (it != pipelines_.end())
+    {
+      ++stats_.num_dedup_hits_;
+      return Handle(it->second.get());
+    }
+    entry = pipelines_.emplace(desc, std::make_unique<Entry>())
+                .first->second.get();
+  }
+
+  if (job_system_ == nullptr)
+  {
+    Create(desc, entry);
+  }
+  else
+  {
+    job_system_->Run([this, desc, entry] { Create(desc, entry); }, &pending_);
+  }
+  return Handle(entry);
+}
+
+void PipelineManager::WaitIdle()
+{
+  if (job_system_ != nullptr) job_system_->Wait(pending_);
+}
+
+PipelineStats PipelineManager::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  return stats_;
+}
+
+void PipelineManager::Create(const GraphicsPipelineDesc& desc, Entry* entry)
+{
+  const Clock::time_point start = Clock::now();
+
+  const std::array<vk::PipelineShaderStageCreateInfo, 2> stages = {
+      vk::PipelineShaderStageCreateInfo()
+          .setStage(vk::ShaderStageFlagBits::eVertex)
+          .setModule(desc.vertex_shader_)
+          .setPName("main"),
+      vk::PipelineShaderStageCreateInfo()
+          .setStage(vk::ShaderStageFlagBits::eFragment)
+          .setModule(desc.fragment_shader_)
+          .setPName("main"),
+  };
+
+  vk::PipelineVertexInputStateCreateInfo vertex_input;
+  vertex_input.setVertexBindingDescriptionCount(desc.vertex_bindings_.size())
+      .setPVertexBindingDescriptions(desc.vertex_bindings_.data())
+      .setVertexAttributeDescriptionCount(desc.vertex_attributes_.size())
+      .setPVertexAttributeDescriptions(desc.vertex_attributes_.data());
+
+  vk::PipelineInputAssemblyStateCreateInfo input_assembly;
+  input_assembly.setTopology(desc.topology_);
+
+  vk::PipelineViewportStateCreateInfo viewport_state;
+  viewport_state.setViewportCount(1).setScissorCount(1);
+
+  vk::PipelineRasterizationStateCreateInfo rasterization;
+  rasterization.setPolygonMode(desc.polygon_mode_)
+      .setCullMode(desc.cull_mode_)
+      .setFrontFace(desc.front_face_)
+      .setLineWidth(1.f);
+
+  vk::PipelineMultisampleStateCreateInfo multisample;
+  multisample.setRasterizationSamples(vk::SampleCountFlagBits::e1);
+
+  vk::PipelineDepthStencilStateCreateInfo depth_stencil;
+  depth_stencil.setDepthTestEnable(desc.depth_test_)
+      .setDepthWriteEnable(desc.depth_write_)
+      .setDepthCompareOp(desc.depth_compare_);
+
+  vk::PipelineColorBlendAttachmentState blend_attachment;
+  blend_attachment.setBlendEnable(desc.alpha_blend_)
+      .setSrcColorBlendFactor(vk::BlendFactor::eSrcAlpha)
+      .setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+      .setColorBlendOp(vk::BlendOp::eAdd)
+      .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+      .setDstAlphaBlendFactor(vk::BlendFactor::eZero)
+      .setAlphaBlendOp(vk::BlendOp::eAdd)
+      .setColorWriteMask(
+          vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+          vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+  vk::PipelineColorBlendStateCreateInfo color_blend;
+  color_blend.setAttachmentCount(1).setPAttachments(&blend_attachment);
+
+  const std::array<vk::DynamicState, 2> dynamic_states = {
+      vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+  vk::PipelineDynamicStateCreateInfo dynamic_state;
+  dynamic_state.setDynamicStateCount(dynamic_states.size())
+      .setPDynamicStates(dynamic_states.data());
+
+  vk::GraphicsPipelineCreateInfo pipeline_info;
+  pipeline_info.setStageCount(stages.size())
+      .setPStages(stages.data())
+      .setPVertexInputState(&vertex_input)
+      .setPInputAssemblyState(&input_assembly)
+      .setPViewportState(&viewport_state)
+      .setPRasterizationState(&rasterization)
+      .setPMultisampleState(&multisample)
+      .setPDepthStencilState(&depth_stencil)
+      .setPColorBlendState(&color_blend)
+      .setPDynamicState(&dynamic_state)
+      .setLayout(desc.layout_)
+      .setRenderPass(desc.render_pass_)
+      .setSubpass(desc.subpass_)
+      .setPNext(nullptr);
+
+  // Pipeline caches are internally synchronized, so creations can share it.
+  entry->pipeline_ =
+      VkSuccuessOrDie(dev_.createGraphicsPipeline(cache_, pipeline_info),
+                      "Couldn't create graphics pipeline");
+  entry->ready_.store(true, std::memory_order_release);
+
+  const double elapsed_ms = ToMillis(Clock::now() - start);
+  std::lock_guard<std::mutex> lock(mu_);
+  ++stats_.num_created_;
+  stats_.create_ms_ += elapsed_ms;
+}
+
+}  // namespace motor
@@ -0,0 +1,149 @@
+#ifndef _MOTOR_RENDER_PIPELINE_MANAGER_H_
+#define _MOTOR_RENDER_PIPELINE_MANAGER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "motor/jobs/job_system.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+// Everything that determines a graphics pipeline. Viewport and scissor are
+// always dynamic, so they are not part of the description.
+struct GraphicsPipelineDesc
+{
+  vk::ShaderModule vertex_shader_;
+  vk::ShaderModule fragment_shader_;
+  vk::PipelineLayout layout_;
+  vk::RenderPass render_pass_;
+  uint32_t subpass_ = 0;
+
+  std::vector<vk::VertexInputBindingDescription> vertex_bindings_;
+  std::vector<vk::VertexInputAttributeDescription> vertex_attributes_;
+  vk::PrimitiveTopology topology_ = vk::PrimitiveTopology::eTriangleList;
+
+  vk::PolygonMode polygon_mode_ = vk::PolygonMode::eFill;
+  vk::CullModeFlags cull_mode_ = vk::CullModeFlagBits::eBack;
+  vk::FrontFace front_face_ = vk::FrontFace::eCounterClockwise;
+
+  bool depth_test_ = true;
+  bool depth_write_ = true;
+  vk::CompareOp depth_compare_ = vk::CompareOp::eLess;
+
+  // Standard alpha blending on the single color attachment.
+  bool alpha_blend_ = false;
+
+  bool operator==(const GraphicsPipelineDesc& other) const;
+};
+
+struct GraphicsPipelineDescHash
+{
+  size_t operator()(const GraphicsPipelineDesc& desc) const;
+};
+
+struct PipelineStats
+{
+  // Number of distinct pipelines created.
+  size_t num_created_ = 0;
+  // Number of requests answered with an existing pipeline.
+  size_t num_dedup_hits_ = 0;
+  // Sum of time spent in vkCreateGraphicsPipelines.
+  double create_ms_ = 0;
+  // Time spent reading and validating the on-disk cache.
+  double cache_load_ms_ = 0;
+  size_t cache_load_bytes_ = 0;
+  // Whether creation was seeded with a valid on-disk cache.
+  bool warm_start_ = false;
+};
+
+// Creates graphics pipelines asynchronously on the job system and
+// deduplicates them by their description. All pipelines are created through a
+// single vk::PipelineCache that is persisted to disk. The file stores the
+// driver provided cache data prefixed with a header identifying the device
+// and driver, the cache is discarded if those don't match the current device.
+class PipelineManager
+{
+ public:
+  class Handle
+  {
+   public:
+    Handle() = default;
+
+    // Pipeline creation is asynchronous, callers should skip draws that use
+    // pipelines which are not ready yet.
+    bool IsReady() const
+    {
+      return entry_ != nullptr &&
+             entry_->ready_.load(std::memory_order_acquire);
+    }
+    // Returns a null pipeline until IsReady.
+    vk::Pipeline Get() const
+    {
+      return IsReady() ? entry_->pipeline_ : vk::Pipeline();
+    }
+
+   private:
+    friend class PipelineManager;
+    struct Entry
+    {
+      vk::Pipeline pipeline_;
+      std::atomic<bool> ready_{false};
+    };
+
+    explicit Handle(const Entry* entry) : entry_(entry) {}
+
+    const Entry* entry_ = nullptr;
+  };
+
+  // Creates pipelines on the calling thread if |job_system| is null. An empty
+  // |cache_path| disables persistence.
+  PipelineManager(const vk::PhysicalDevice& phy_dev, const vk::Device& dev,
+                  jobs::JobSystem* job_system, std::string cache_path);
+  PipelineManager(const PipelineManager&) = delete;
+  PipelineManager& operator=(const PipelineManager&) = delete;
+  PipelineManager(PipelineManager&&) = delete;
+  // Waits for pending creations, writes the cache to disk and destroys all the
+  // pipelines.
+  ~PipelineManager();
+
+  // Returns the pipeline for |desc|, scheduling its creation if it hasn't been
+  // requested before. Handles stay valid for the lifetime of the manager.
+  Handle GetOrCreate(const GraphicsPipelineDesc& desc);
+
+  // Blocks until all requested pipelines are created.
+  void WaitIdle();
+  // Writes the cache to disk, returns false on failure.
+  bool Save() const;
+
+  PipelineStats GetStats() const;
+
+ private:
+  using Entry = Handle::Entry;
+
+  void Load();
+  void Create(const GraphicsPipelineDesc& desc, Entry* entry);
+
+  const vk::Device dev_;
+  const vk::PhysicalDeviceProperties props_;
+  jobs::JobSystem* const job_system_;
+  const std::string cache_path_;
+  vk::PipelineCache cache_;
+
+  mutable std::mutex mu_;
+  std::unordered_map<GraphicsPipelineDesc, std::unique_ptr<Entry>,
+                     GraphicsPipelineDescHash>
+      pipelines_;
+  PipelineStats stats_;
+  jobs::Counter pending_;
+};
+
+}  // namespace motor
+
+#endif
@@ -0,0 +1,340 @@
+#include "motor/render/render_queue.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace motor
+{
+namespace
+{
+constexpr int kPassShift = 60;
+constexpr int kBlendedShift = 59;
+constexpr uint64_t kDepthMask = 0x7fffffff;
+constexpr uint64_t kPipelineMask = kMaxPipelines - 1;
+constexpr uint64_t kMaterialMask = kMaxMaterials - 1;
+// Opaque keys up to and including the material, i.e. everything but depth.
+constexpr int kOpaqueStateShift = 31;
+
+// Six passes over the keys rather than eight with bytes, the larger
+// histograms are cheap next to moving the draws.
+constexpr int kRadixBits = 11;
+constexpr size_t kRadixBuckets = 1 << kRadixBits;
+constexpr int kRadixDigits = (64 + kRadixBits - 1) / kRadixBits;
+
+size_t Digit(uint64_t key, int digit)
+{
+  return (key >> (digit * kRadixBits)) & (kRadixBuckets - 1);
+}
+
+// Bits of non-negative floats order the same way as the floats, the sign bit
+// is always clear.
+uint64_t DepthBits(float depth)
+{
+  if (!(depth > 0)) return 0;
+  uint32_t bits;
+  std::memcpy(&bits, &depth, sizeof(bits));
+  return bits;
+}
+
+void CheckKeyFields(uint32_t pass, uint32_t pipeline, uint32_t material)
+{
+  DCHECK_LT(pass, kMaxRenderPasses);
+  DCHECK_LT(pipeline, kMaxPipelines);
+  DCHECK_LT(material, kMaxMaterials);
+}
+
+// Tracks bound state while walking draws in execution order.
+class BindCounter
+{
+ public:
+  explicit BindCounter(DrawListStats* stats) : stats_(stats) {}
+
+  void Draw(uint32_t pass, uint32_t pipeline, uint32_t material,
+            uint32_t mesh)
+  {
+    ++stats_->batches_;
+    if (!bound_ || pass != pass_)
+    {
+      ++stats_->pipeline_binds_;
+      ++stats_->material_binds_;
+      ++stats_->mesh_binds_;
+    }
+    else
+    {
+      stats_->pipeline_binds_ += pipeline != pipeline_;
+      stats_->material_binds_ += material != material_;
+      stats_->mesh_binds_ += mesh != mesh_;
+    }
+    bound_ = true;
+    pass_ = pass;
+    pipeline_ = pipeline;
+    material_ = material;
+    mesh_ = mesh;
+  }
+
+ private:
+  DrawListStats* const stats_;
+  bool bound_ = false;
+  uint32_t pass_ = 0;
+  uint32_t pipeline_ = 0;
+  uint32_t material_ = 0;
+  uint32_t mesh_ = 0;
+};
+
+DrawBatch MakeBatch(const QueuedDraw& draw, uint32_t first_instance)
+{
+  DrawBatch batch;
+  batch.pass_ = SortKeyPass(draw.key_);
+  batch.pipeline_ = SortKeyPipeline(draw.key_);
+  batch.material_ = SortKeyMaterial(draw.key_);
+  batch.mesh_ = draw.mesh_;
+  batch.first_instance_ = first_instance;
+  return batch;
+}
+
+// Open addressing map from mesh to batch index, sized for a run of draws.
+class MeshTable
+{
+ public:
+  void Reset(size_t num_draws)
+  {
+    size_t capacity = 16;
+    shift_ = 64 - 4;
+    while (capacity < num_draws * 2)
+    {
+      capacity *= 2;
+      --shift_;
+    }
+    slots_.assign(capacity, kEmpty);
+  }
+
+  // Returns the slot of |mesh|, which is kEmpty if it isn't in the table.
+  uint64_t* Find(uint32_t mesh)
+  {
+    const size_t mask = slots_.size() - 1;
+    size_t idx = (mesh * 0x9e3779b97f4a7c15ull) >> shift_;
+    while (slots_[idx] != kEmpty && slots_[idx] >> 32 != mesh)
+    {
+      idx = (idx + 1) & mask;
+    }
+    return &slots_[idx];
+  }
+
+  static uint64_t Slot(uint32_t mesh, uint32_t batch)
+  {
+    return uint64_t{mesh} << 32 | batch;
+  }
+
+  static constexpr uint64_t kEmpty = ~uint64_t{0};
+
+ private:
+  std::vector<uint64_t> slots_;
+  int shift_ = 0;
+};
+
+// Groups a run of opaque draws with the same state by mesh, batches are
+// ordered by their first, i.e. nearest, draw.
+void BatchOpaqueRun(const QueuedDraw* begin, const QueuedDraw* end,
+                    MeshTable* table, DrawList* list)
+{
+  if (end - begin == 1)
+  {
+    list->batches_.push_back(MakeBatch(*begin, list->instances_.size()));
+    list->batches_.back().instance_count_ = 1;
+    list->instances_.push_back(begin->instance_);
+    return;
+  }
+
+  const size_t first_batch = list->batches_.size();
+  table->Reset(end - begin);
+  for (const QueuedDraw* draw = begin; draw != end; ++draw)
+  {
+    uint64_t* slot = table->Find(draw->mesh_);
+    if (*slot == MeshTable::kEmpty)
+    {
+      *slot = MeshTable::Slot(draw->mesh_, list->batches_.size());
+      list->batches_.push_back(MakeBatch(*draw, 0));
+    }
+    ++list->batches_[static_cast<uint32_t>(*slot)].instance_count_;
+  }
+  // Counts become offsets, then are rebuilt while placing the instances.
+  uint32_t offset = list->instances_.size();
+  for (size_t i = first_batch; i < list->batches_.size(); ++i)
+  {
+    DrawBatch& batch = list->batches_[i];
+    batch.first_instance_ = offset;
+    offset += batch.instance_count_;
+    batch.instance_count_ = 0;
+  }
+  list->instances_.resize(offset);
+  for (const QueuedDraw* draw = begin; draw != end; ++draw)
+  {
+    DrawBatch& batch =
+        list->batches_[static_cast<uint32_t>(*table->Find(draw->mesh_))];
+    list->instances_[batch.first_instance_ + batch.instance_count_++] =
+        draw->instance_;
+  }
+}
+}  // namespace
+
+uint64_t MakeOpaqueSortKey(uint32_t pass, uint32_t pipeline, uint32_t material,
+                           float depth)
+{
+  CheckKeyFields(pass, pipeline, material);
+  return uint64_t{pass} << kPassShift | (pipeline & kPipelineMask) << 47 |
+         (material & kMaterialMask) << 31 | DepthBits(depth);
+}
+
+uint64_t MakeBlendedSortKey(uint32_t pass, uint32_t pipeline,
+                            uint32_t material, float depth)
+{
+  CheckKeyFields(pass, pipeline, material);
+  return uint64_t{pass} << kPassShift | uint64_t{1} << kBlendedShift |
+         (~DepthBits(depth) & kDepthMask) << 28 |
+         (pipeline & kPipelineMask) << 16 | (material & kMaterialMask);
+}
+
+uint32_t SortKeyPass(uint64_t key) { return key >> kPassShift; }
+
+bool SortKeyIsBlended(uint64_t key) { return (key >> kBlendedShift) & 1; }
+
+uint32_t SortKeyPipeline(uint64_t key)
+{
+  return (SortKeyIsBlended(key) ? key >> 16 : key >> 47) & kPipelineMask;
+}
+
+uint32_t SortKeyMaterial(uint64_t key)
+{
+  return (SortKeyIsBlended(key) ? key : key >> 31) & kMaterialMask;
+}
+
+void RadixSortDraws(const std::vector<QueuedDraw>& draws,
+                    std::vector<QueuedDraw>* sorted,
+                    std::vector<QueuedDraw>* scratch)
+{
+  const size_t count = draws.size();
+  sorted->resize(count);
+  scratch->resize(count);
+  if (count == 0) return;
+
+  std::array<std::array<uint32_t, kRadixBuckets>, kRadixDigits> histograms{};
+  for (const QueuedDraw& draw : draws)
+  {
+    for (int digit = 0; digit < kRadixDigits; ++digit)
+    {
+      ++histograms[digit][Digit(draw.key_, digit)];
+    }
+  }
+  std::array<int, kRadixDigits> digits;
+  int num_digits = 0;
+  for (int digit = 0; digit < kRadixDigits; ++digit)
+  {
+    if (histograms[digit][Digit(draws.front().key_, digit)] != count)
+    {
+      digits[num_digits++] = digit;
+    }
+  }
+  if (num_digits == 0)
+  {
+    std::copy(draws.begin(), draws.end(), sorted->begin());
+    return;
+  }
+
+  // Ping-pongs between the buffers, starting with the one that makes the last
+  // pass end up in |sorted|.
+  QueuedDraw* dst = num_digits % 2 == 1 ? sorted->data() : scratch->data();
+  QueuedDraw* other = num_digits % 2 == 1 ? scratch->data() : sorted->data();
+  const QueuedDraw* src = draws.data();
+  for (int i = 0; i < num_digits; ++i)
+  {
+    const int digit = digits[i];
+    std::array<uint32_t, kRadixBuckets>& offsets = histograms[digit];
+    uint32_t sum = 0;
+    for (uint32_t& offset : offsets)
+    {
+      const uint32_t bucket_count = offset;
+      offset = sum;
+      sum += bucket_count;
+    }
+    for (size_t j = 0; j < count; ++j)
+    {
+      dst[offsets[Digit(src[j].key_, digit)]++] = src[j];
+    }
+    src = dst;
+    std::swap(dst, other);
+  }
+}
+
+void BuildDrawList(const RenderQueue& queue, DrawList* list)
+{
+  RadixSortDraws(queue.Draws(), &list->sorted_, &list->scratch_);
+  list->batches_.clear();
+  list->instances_.clear();
+  list->instances_.reserve(list->sorted_.size());
+
+  MeshTable table;
+  const QueuedDraw* draws = list->sorted_.data();
+  const size_t count = list->sorted_.size();
+  size_t begin = 0;
+  while (begin < count)
+  {
+    const uint64_t key = draws[begin].key_;
+    size_t end = begin + 1;
+    if (!SortKeyIsBlended(key))
+    {
+      const uint64_t state = key >> kOpaqueStateShift;
+      while (end < count && draws[end].key_ >> kOpaqueStateShift == state)
+      {
+        ++end;
+      }
+      BatchOpaqueRun(draws + begin, draws + end, &table, list);
+      begin = end;
+      continue;
+    }
+
+    list->batches_.push_back(MakeBatch(draws[begin], list->instances_.size()));
+    DrawBatch& batch = list->batches_.back();
+    const uint64_t state_mask = ~(kDepthMask << 28);
+    for (end = begin; end < count; ++end)
+    {
+      const QueuedDraw& draw = draws[end];
+      if ((draw.key_ & state_mask) != (key & state_mask) ||
+          draw.mesh_ != batch.mesh_)
+      {
+        break;
+      }
+      list->instances_.push_back(draw.instance_);
+      ++batch.instance_count_;
+    }
+    begin = end;
+  }
+
+  list->stats_ = DrawListStats();
+  list->stats_.draws_ = count;
+  BindCounter binds(&list->stats_);
+  for (const DrawBatch& batch : list->batches_)
+  {
+    binds.Draw(batch.pass_, batch.pipeline_, batch.material_, batch.mesh_);
+  }
+}
+
+DrawListStats UnsortedDrawStats(const RenderQueue& queue)
+{
+  DrawListStats stats;
+  stats.draws_ = queue.Size();
+  BindCounter binds(&stats);
+  for (const QueuedDraw& draw : queue.Draws())
+  {
+    binds.Draw(SortKeyPass(draw.key_), SortKeyPipeline(draw.key_),
+               SortKeyMaterial(draw.key_), draw.mesh_);
+  }
+  return stats;
+}
+
+}  // namespace motor
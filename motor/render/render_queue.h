@@ -0,0 +1,120 @@
+#ifndef _MOTOR_RENDER_RENDER_QUEUE_H_
+#define _MOTOR_RENDER_RENDER_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace motor
+{
+// Draws are ordered by 64-bit keys, most significant bits first:
+//   pass      4 bits, passes are rendered in increasing order
+//   blended   1 bit
+//   opaque:   pipeline 12 bits, material 16 bits, depth 31 bits
+//   blended:  depth 31 bits (inverted), pipeline 12 bits, material 16 bits
+// Opaque draws are grouped by state, then sorted front to back within equal
+// state so that early depth rejection still works. Blended draws must be drawn
+// back to front, state only breaks ties.
+constexpr uint32_t kMaxRenderPasses = 1 << 4;
+constexpr uint32_t kMaxPipelines = 1 << 12;
+constexpr uint32_t kMaxMaterials = 1 << 16;
+
+// |depth| is the view space distance, negative values are clamped to 0.
+uint64_t MakeOpaqueSortKey(uint32_t pass, uint32_t pipeline, uint32_t material,
+                           float depth);
+uint64_t MakeBlendedSortKey(uint32_t pass, uint32_t pipeline,
+                            uint32_t material, float depth);
+
+uint32_t SortKeyPass(uint64_t key);
+bool SortKeyIsBlended(uint64_t key);
+uint32_t SortKeyPipeline(uint64_t key);
+uint32_t SortKeyMaterial(uint64_t key);
+
+struct QueuedDraw
+{
+  uint64_t key_ = 0;
+  uint32_t mesh_ = 0;
+  // Identifies the per instance data of the draw, e.g. an index into the
+  // transforms of the frame.
+  uint32_t instance_ = 0;
+};
+
+// Draws submitted for a frame, in any order. Not thread safe, the simulation
+// fills one per frame and hands it to the renderer in the RenderPacket.
+class RenderQueue
+{
+ public:
+  void Submit(uint64_t key, uint32_t mesh, uint32_t instance)
+  {
+    draws_.push_back({key, mesh, instance});
+  }
+  // Keeps the capacity, queues are meant to be reused across frames.
+  void Clear() { draws_.clear(); }
+
+  size_t Size() const { return draws_.size(); }
+  const std::vector<QueuedDraw>& Draws() const { return draws_; }
+
+ private:
+  std::vector<QueuedDraw> draws_;
+};
+
+// One instanced draw call, drawing the same mesh with the same state once per
+// instance.
+struct DrawBatch
+{
+  uint32_t pass_ = 0;
+  uint32_t pipeline_ = 0;
+  uint32_t material_ = 0;
+  uint32_t mesh_ = 0;
+  // Range of DrawList::instances_.
+  uint32_t first_instance_ = 0;
+  uint32_t instance_count_ = 0;
+};
+
+struct DrawListStats
+{
+  // Submitted draws.
+  size_t draws_ = 0;
+  // Emitted draw calls, one per batch.
+  size_t batches_ = 0;
+  // Binds needed when executing the batches in order. Bound state is assumed
+  // to be lost when the pass changes.
+  size_t pipeline_binds_ = 0;
+  size_t material_binds_ = 0;
+  size_t mesh_binds_ = 0;
+};
+
+struct DrawList
+{
+  std::vector<DrawBatch> batches_;
+  // Instance ids of the batches, ordered by batch and within a batch in draw
+  // order, e.g. front to back for opaque draws.
+  std::vector<uint32_t> instances_;
+  DrawListStats stats_;
+
+  // Reused across calls to BuildDrawList.
+  std::vector<QueuedDraw> sorted_;
+  std::vector<QueuedDraw> scratch_;
+};
+
+// Sorts |draws| by key into |sorted|, keeping the submission order of equal
+// keys. LSD radix sort on 11 bit digits, digits that are the same for all
+// keys are skipped. |scratch| only holds intermediate results.
+void RadixSortDraws(const std::vector<QueuedDraw>& draws,
+                    std::vector<QueuedDraw>* sorted,
+                    std::vector<QueuedDraw>* scratch);
+
+// Radix sorts the draws of |queue| by key and merges them into instanced
+// batches. Opaque draws of the same mesh with the same pass, pipeline and
+// material become one batch, batches are ordered by their nearest instance.
+// Blended draws are only merged with the ones right next to them, as anything
+// else would change the blending order.
+void BuildDrawList(const RenderQueue& queue, DrawList* list);
+
+// Stats of executing the draws one by one in submission order, for
+// comparison.
+DrawListStats UnsortedDrawStats(const RenderQueue& queue);
+
+}  // namespace motor
+
+#endif
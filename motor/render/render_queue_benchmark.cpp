@@ -0,0 +1,149 @@
+// Submits a synthetic frame of 100k draws, mostly opaque with a few blended
+// ones, and times sorting and batching them. Prints draw calls and state
+// changes of the resulting draw list against executing the draws as
+// submitted.
+//   bazel run -c opt //motor/render:render_queue_benchmark -- [num_draws]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "motor/render/render_queue.h"
+
+namespace motor
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kDefaultDraws = 100000;
+constexpr int kIterations = 50;
+constexpr uint32_t kOpaquePipelines = 16;
+constexpr uint32_t kOpaqueMaterials = 512;
+constexpr uint32_t kOpaqueMeshes = 2000;
+constexpr uint32_t kBlendedPipelines = 4;
+constexpr uint32_t kBlendedMaterials = 32;
+constexpr uint32_t kBlendedMeshes = 100;
+// Fraction of the draws that are blended, e.g. particles and glass.
+constexpr double kBlendedFraction = 0.1;
+
+struct Object
+{
+  uint32_t mesh_ = 0;
+  bool blended_ = false;
+  float depth_ = 0;
+};
+
+// Meshes are picked with a power law, a few of them, e.g. foliage and props,
+// make up most of the scene. Each mesh always uses the same material.
+std::vector<Object> MakeScene(size_t num_draws)
+{
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> unit(0, 1);
+  std::vector<Object> objects(num_draws);
+  for (Object& object : objects)
+  {
+    object.blended_ = unit(rng) < kBlendedFraction;
+    const uint32_t num_meshes =
+        object.blended_ ? kBlendedMeshes : kOpaqueMeshes;
+    object.mesh_ = std::min<uint32_t>(
+        num_meshes - 1, num_meshes * std::pow(unit(rng), 3.f));
+    object.depth_ = 1 + 999 * unit(rng);
+  }
+  return objects;
+}
+
+void Submit(const std::vector<Object>& objects, RenderQueue* queue)
+{
+  queue->Clear();
+  for (uint32_t i = 0; i < objects.size(); ++i)
+  {
+    const Object& object = objects[i];
+    if (object.blended_)
+    {
+      const uint32_t material = object.mesh_ % kBlendedMaterials;
+      queue->Submit(
+          MakeBlendedSortKey(/*pass=*/1, material % kBlendedPipelines,
+                             material, object.depth_),
+          kOpaqueMeshes + object.mesh_, i);
+    }
+    else
+    {
+      const uint32_t material = object.mesh_ % kOpaqueMaterials;
+      queue->Submit(MakeOpaqueSortKey(/*pass=*/0, material % kOpaquePipelines,
+                                      material, object.depth_),
+                    object.mesh_, i);
+    }
+  }
+}
+
+double Micros(Clock::duration duration)
+{
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// Runs |fn| kIterations times, returns the median in microseconds.
+template <typename Fn>
+double Time(Fn fn)
+{
+  std::vector<double> times;
+  for (int i = 0; i < kIterations; ++i)
+  {
+    const Clock::time_point start = Clock::now();
+    fn();
+    times.push_back(Micros(Clock::now() - start));
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+void PrintStats(const char* name, const DrawListStats& stats)
+{
+  std::printf("%-10s %7zu draws %7zu draw calls %7zu pipeline binds %7zu "
+              "material binds %7zu mesh binds\n",
+              name, stats.draws_, stats.batches_, stats.pipeline_binds_,
+              stats.material_binds_, stats.mesh_binds_);
+}
+
+void Run(size_t num_draws)
+{
+  const std::vector<Object> objects = MakeScene(num_draws);
+  RenderQueue queue;
+  DrawList list;
+
+  const double submit_us = Time([&] { Submit(objects, &queue); });
+  const double radix_us = Time([&] {
+    RadixSortDraws(queue.Draws(), &list.sorted_, &list.scratch_);
+  });
+  std::vector<QueuedDraw> copy;
+  const double std_sort_us = Time([&] {
+    copy = queue.Draws();
+    std::stable_sort(copy.begin(), copy.end(),
+                     [](const QueuedDraw& lhs, const QueuedDraw& rhs) {
+                       return lhs.key_ < rhs.key_;
+                     });
+  });
+  const double build_us = Time([&] { BuildDrawList(queue, &list); });
+
+  std::printf("Submit %9.1f us\n", submit_us);
+  std::printf("Sort   %9.1f us radix, %9.1f us std::stable_sort\n", radix_us,
+              std_sort_us);
+  std::printf("Sort and batch %9.1f us\n", build_us);
+  PrintStats("submitted", UnsortedDrawStats(queue));
+  PrintStats("batched", list.stats_);
+}
+
+}  // namespace
+}  // namespace motor
+
+int main(int argc, char** argv)
+{
+  motor::Run(argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                      : motor::kDefaultDraws);
+}
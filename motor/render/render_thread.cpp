@@ -0,0 +1,57 @@
+#include "render_thread.h"
+
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "glog/logging.h"
+#include "motor/profiler/profiler.h"
+
+namespace motor
+{
+RenderThread::RenderThread(Renderer* renderer)
+    : renderer_(renderer), thread_(&RenderThread::ThreadMain, this)
+{
+}
+
+RenderThread::~RenderThread()
+{
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+  LOG(INFO) << "Render thread stopped";
+}
+
+void RenderThread::Submit(RenderPacket* packet)
+{
+  std::swap(packets_.Back(), *packet);
+  packets_.Publish();
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    has_packet_ = true;
+  }
+  cv_.notify_one();
+}
+
+void RenderThread::ThreadMain()
+{
+  LOG(INFO) << "Render thread started";
+  profiler::Profiler::Get().SetThreadName("Render");
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this] { return has_packet_ || stopping_; });
+      if (stopping_) return;
+      has_packet_ = false;
+    }
+    if (!packets_.Acquire()) continue;
+    MOTOR_PROFILE_SCOPE("Renderer::Render");
+    renderer_->Render(packets_.Front());
+  }
+}
+
+}  // namespace motor
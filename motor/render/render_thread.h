@@ -0,0 +1,50 @@
+#ifndef _MOTOR_RENDER_RENDER_THREAD_H_
+#define _MOTOR_RENDER_RENDER_THREAD_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "motor/render/renderer.h"
+#include "motor/render/triple_buffer.h"
+
+namespace motor
+{
+// Runs Renderer::Render on a dedicated thread. Simulation thread hands over
+// RenderPackets through a triple buffer, so it never waits for the GPU or for
+// present; if it produces packets faster than they can be rendered, the render
+// thread skips to the most recent one.
+class RenderThread
+{
+ public:
+  // |renderer| must be initialized and outlive the RenderThread.
+  explicit RenderThread(Renderer* renderer);
+  RenderThread(const RenderThread&) = delete;
+  RenderThread& operator=(const RenderThread&) = delete;
+  RenderThread(RenderThread&&) = delete;
+  // Finishes the frame in progress, if any, and joins the thread.
+  ~RenderThread();
+
+  // Takes over the contents of |packet| without copying them. |packet| is
+  // left with the contents of an older packet, so that its buffers, e.g. the
+  // draws, are reused by the next frame.
+  void Submit(RenderPacket* packet);
+
+ private:
+  void ThreadMain();
+
+  Renderer* const renderer_;
+  TripleBuffer<RenderPacket> packets_;
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool has_packet_ = false;
+  bool stopping_ = false;
+
+  // Declared last so that everything above is initialized before it starts.
+  std::thread thread_;
+};
+
+}  // namespace motor
+
+#endif
@@ -0,0 +1,9 @@
+#include "renderer.h"
+
+#include <utility>
+
+namespace motor
+{
+void Renderer::SetOptions(RendererOptions opts) { opts_ = std::move(opts); }
+
+}  // namespace motor
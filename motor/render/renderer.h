@@ -1,19 +1,138 @@
 #ifndef _MOTOR_RENDER_RENDERER_H_
 #define _MOTOR_RENDER_RENDERER_H_
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "motor/assets/asset_streamer.h"
+#include "motor/jobs/job_system.h"
 #include "motor/plugin.h"
+#include "motor/render/frustum_culling.h"
+#include "motor/render/latency_tracker.h"
+#include "motor/render/render_queue.h"
 
 namespace motor
 {
+struct RendererOptions
+{
+  // Name of the renderer plugin to use, e.g. "vulkan" or "null". The highest
+  // priority plugin that can run is used when empty. --renderer_backend takes
+  // precedence when set.
+  std::string backend_;
+
+  // Number of frames the CPU is allowed to record ahead of the GPU. Each frame
+  // in flight owns its own command buffers and synchronization primitives.
+  size_t frames_in_flight_ = 2;
+
+  // Used to record command buffers in parallel, everything is recorded on the
+  // rendering thread if null.
+  jobs::JobSystem* job_system_ = nullptr;
+
+  // Receives submit and present latencies of frames carrying input, nothing is
+  // recorded if null.
+  LatencyTracker* latency_tracker_ = nullptr;
+
+  // File used to persist compiled pipelines across runs, nothing is persisted
+  // when empty.
+  std::string pipeline_cache_path_;
+
+  // Renders into images owned by the renderer instead of a window surface,
+  // nothing is presented. Works without a display, e.g. with software
+  // implementations like lavapipe. When unset, the engine renders offscreen
+  // only if the window can't provide a surface.
+  std::optional<bool> offscreen_;
+  // Size of the offscreen render targets. Also used for the swapchain when the
+  // window surface leaves the size to it.
+  uint32_t width_ = 800;
+  uint32_t height_ = 600;
+
+  // Culls RenderPacket::cull_objects_ in a compute pass and draws the visible
+  // ones indirectly, see GpuCuller. Needs the drawIndirectFirstInstance
+  // feature. Renderers that can't cull on the GPU ignore the objects.
+  bool gpu_culling_ = false;
+  // Most objects a packet can carry when gpu_culling_ is set.
+  uint32_t max_cull_objects_ = 1 << 16;
+};
+
+// Immutable snapshot of everything the renderer needs to produce a frame. It is
+// built by the simulation thread, renderer must not reach back into the
+// simulation state as it might be running on a different thread.
+struct RenderPacket
+{
+  uint64_t frame_ = 0;
+  // In [0, 1), the fraction of a fixed simulation step that has elapsed since
+  // the last step, used to interpolate between the previous and current
+  // simulation states.
+  double alpha_ = 0;
+  // Earliest input reflected in this frame, default constructed if the frame
+  // doesn't carry any new input.
+  std::chrono::steady_clock::time_point input_time_;
+  // Draws of the frame, in submission order. BuildDrawList sorts and batches
+  // them, renderers don't draw them until meshes and materials are uploaded.
+  RenderQueue draws_;
+  // Bounding spheres to cull and draw with RendererOptions::gpu_culling_.
+  // Until meshes are uploaded, each object is drawn as a cube around its
+  // sphere and its draw parameters are ignored.
+  std::vector<CullObject> cull_objects_;
+  // Maps world space to clip space for culling and drawing cull_objects_, see
+  // FrustumFromViewProjection.
+  Mat4 view_proj_{};
+};
+
+struct GpuScopeTime
+{
+  std::string_view name_;
+  double ms_ = 0;
+};
+
+// GPU times of a single frame. Timestamps are read back without stalling,
+// hence these lag a few frames behind the one being rendered.
+struct GpuStats
+{
+  // RenderPacket::frame_ the times belong to.
+  uint64_t frame_ = 0;
+  // In the order the scopes were opened, nested scopes follow their parents.
+  std::vector<GpuScopeTime> scopes_;
+};
+
 class Renderer
 {
  public:
   virtual ~Renderer() = default;
 
-  virtual void Render() = 0;
+  // Implementations that can't run everywhere, e.g. need a suitable device,
+  // should hide this with a cheap check.
+  static bool Probe() { return true; }
+
+  void SetOptions(RendererOptions opts);
+  virtual void Initialize() = 0;
+
+  // Initialize is called on the thread that created the window, whereas Render
+  // might be called from a dedicated render thread.
+  virtual void Render(const RenderPacket& packet) = 0;
+
+  // Latest available GPU times, empty if the renderer or the device doesn't
+  // support timing. Safe to call from any thread.
+  virtual GpuStats GetGpuStats() const { return GpuStats(); }
+
+  // Copies the data of a loaded asset into GPU memory, where it stays until
+  // the renderer holds the last handle to the asset. Safe to call from any
+  // thread, the copy happens during one of the following frames.
+  virtual void UploadAsset(const assets::AssetHandle& /*asset*/) {}
+
+ protected:
+  const RendererOptions& GetOptions() const { return opts_; }
+
+ private:
+  RendererOptions opts_;
 };
 
-using RenderPlugin = SinglePluginRegistry<Renderer>;
+using RenderPlugin = PluginRegistry<Renderer>;
 
 }  // namespace motor
 #endif
@@ -0,0 +1,31 @@
+#version 450
+// Draws a unit mesh scaled and moved to the bounding sphere of the object,
+// which is picked by the first instance of the draw.
+
+// CullObject in motor/render/frustum_culling.h.
+struct Object
+{
+  vec4 sphere;  // Center in xyz, radius in w.
+  uint index_count;
+  uint first_index;
+  int vertex_offset;
+  uint first_instance;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects
+{
+  Object objects[];
+};
+
+layout(push_constant) uniform Params
+{
+  mat4 view_proj;
+};
+
+layout(location = 0) in vec3 position;
+
+void main()
+{
+  const vec4 sphere = objects[gl_InstanceIndex].sphere;
+  gl_Position = view_proj * vec4(sphere.xyz + sphere.w * position, 1);
+}
@@ -0,0 +1,52 @@
+#ifndef _MOTOR_RENDER_TRIPLE_BUFFER_H_
+#define _MOTOR_RENDER_TRIPLE_BUFFER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace motor
+{
+// Lock-free single-producer single-consumer triple buffer. The producer always
+// has a slot to write into and the consumer always sees the most recently
+// published value, neither side ever waits for the other. Values that are
+// published faster than they are consumed are dropped.
+template <typename T>
+class TripleBuffer
+{
+ public:
+  TripleBuffer() = default;
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  // Producer side. Returns the slot to be filled before calling Publish.
+  T& Back() { return slots_[back_]; }
+  void Publish()
+  {
+    back_ = middle_.exchange(back_ | kDirty, std::memory_order_acq_rel) &
+            kIndexMask;
+  }
+
+  // Consumer side. Returns true if a new value was published since the last
+  // call, in which case Front refers to it.
+  bool Acquire()
+  {
+    if ((middle_.load(std::memory_order_relaxed) & kDirty) == 0) return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+  const T& Front() const { return slots_[front_]; }
+
+ private:
+  static constexpr uint8_t kDirty = 0x4;
+  static constexpr uint8_t kIndexMask = 0x3;
+
+  std::array<T, 3> slots_;
+  uint8_t back_ = 0;
+  std::atomic<uint8_t> middle_{1};
+  uint8_t front_ = 2;
+};
+
+}  // namespace motor
+
+#endif
@@ -0,0 +1,175 @@
+// Streams data into a device local buffer through the UploadManager with
+// various upload sizes and prints the throughput. Contiguous uploads are
+// coalesced into few copy regions, scattered ones can't be.
+//   bazel run -c opt //motor/render:upload_benchmark
+//
+// Uses a transfer-only queue family if the device has one.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/render/device_memory_allocator.h"
+#include "motor/render/upload_manager.h"
+#include "motor/render/vulkan_utils.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+namespace
+{
+constexpr vk::DeviceSize kBytesPerRun = 64ull << 20;
+// Uploads are flushed every this many bytes, as if once per frame.
+constexpr vk::DeviceSize kBytesPerFlush = 4ull << 20;
+
+struct Context
+{
+  vk::Instance instance_;
+  vk::PhysicalDevice phy_dev_;
+  vk::Device device_;
+  uint32_t graphics_family_idx_ = 0;
+  uint32_t transfer_family_idx_ = 0;
+};
+
+Context CreateContext()
+{
+  Context ctx;
+  vk::ApplicationInfo app_info;
+  app_info.setApiVersion(VK_API_VERSION_1_1)
+      .setPApplicationName("upload_benchmark")
+      .setPEngineName("motor");
+  vk::InstanceCreateInfo inst_info;
+  inst_info.setPApplicationInfo(&app_info);
+  ctx.instance_ = VkSuccuessOrDie(vk::createInstance(inst_info),
+                                  "Couldn't createInstance");
+
+  std::vector<vk::PhysicalDevice> devices =
+      VkSuccuessOrDie(ctx.instance_.enumeratePhysicalDevices(),
+                      "Couldn't enumeratePhysicalDevices");
+  CHECK(!devices.empty()) << "No vulkan device found";
+  ctx.phy_dev_ = devices.front();
+  LOG(INFO) << "Using device: " << ctx.phy_dev_.getProperties().deviceName;
+
+  std::vector<vk::QueueFamilyProperties> families =
+      ctx.phy_dev_.getQueueFamilyProperties();
+  bool found = false;
+  for (uint32_t i = 0; i < families.size() && !found; ++i)
+  {
+    if (families[i].queueFlags & vk::QueueFlagBits::eGraphics)
+    {
+      ctx.graphics_family_idx_ = i;
+      found = true;
+    }
+  }
+  CHECK(found) << "No queue with a graphics flag";
+  ctx.transfer_family_idx_ = ctx.graphics_family_idx_;
+  for (uint32_t i = 0; i < families.size(); ++i)
+  {
+    if (families[i].queueFlags == vk::QueueFlagBits::eTransfer)
+    {
+      ctx.transfer_family_idx_ = i;
+    }
+  }
+
+  const float queue_prio = 0;
+  std::vector<vk::DeviceQueueCreateInfo> queue_infos(1);
+  queue_infos[0]
+      .setQueueFamilyIndex(ctx.graphics_family_idx_)
+      .setQueueCount(1)
+      .setPQueuePriorities(&queue_prio);
+  if (ctx.transfer_family_idx_ != ctx.graphics_family_idx_)
+  {
+    queue_infos.push_back(queue_infos[0]);
+    queue_infos[1].setQueueFamilyIndex(ctx.transfer_family_idx_);
+  }
+  vk::DeviceCreateInfo device_info;
+  device_info.setQueueCreateInfoCount(queue_infos.size())
+      .setPQueueCreateInfos(queue_infos.data());
+  ctx.device_ = VkSuccuessOrDie(ctx.phy_dev_.createDevice(device_info),
+                                "Couldn't create logical device");
+  return ctx;
+}
+
+void RunOne(const Context& ctx, DeviceMemoryAllocator* allocator,
+            const vk::Buffer& dst, vk::DeviceSize upload_size,
+            bool scattered)
+{
+  const std::vector<char> data(upload_size, 'm');
+  // Scattered uploads leave a gap of upload_size after each upload.
+  const vk::DeviceSize stride = scattered ? 2 * upload_size : upload_size;
+  UploadManager uploads(ctx.device_, allocator,
+                        ctx.device_.getQueue(ctx.transfer_family_idx_, 0),
+                        ctx.transfer_family_idx_, ctx.graphics_family_idx_);
+
+  const auto start = std::chrono::steady_clock::now();
+  vk::DeviceSize unflushed = 0;
+  for (vk::DeviceSize offset = 0; offset < kBytesPerRun * stride / upload_size;
+       offset += stride)
+  {
+    uploads.Upload(dst, offset, data.data(), upload_size);
+    unflushed += upload_size;
+    if (unflushed >= kBytesPerFlush)
+    {
+      uploads.Flush(nullptr);
+      unflushed = 0;
+    }
+  }
+  uploads.Flush(nullptr);
+  uploads.WaitIdle();
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  const UploadStats stats = uploads.GetStats();
+  std::printf("%-10llu %-10s %10.1f %10llu %10llu %8llu %8llu\n",
+              static_cast<unsigned long long>(upload_size),
+              scattered ? "scattered" : "contiguous",
+              stats.bytes_ / elapsed.count() / 1e6,
+              static_cast<unsigned long long>(stats.uploads_),
+              static_cast<unsigned long long>(stats.regions_),
+              static_cast<unsigned long long>(stats.submits_),
+              static_cast<unsigned long long>(stats.ring_stalls_));
+}
+
+void Run()
+{
+  Context ctx = CreateContext();
+  {
+    DeviceMemoryAllocator allocator(ctx.phy_dev_, ctx.device_);
+    vk::BufferCreateInfo buffer_info;
+    // Large enough for the scattered uploads.
+    buffer_info.setSize(2 * kBytesPerRun)
+        .setUsage(vk::BufferUsageFlagBits::eTransferDst)
+        .setSharingMode(vk::SharingMode::eExclusive);
+    vk::Buffer buffer = VkSuccuessOrDie(
+        ctx.device_.createBuffer(buffer_info), "Couldn't create buffer");
+    MemoryAllocation memory = allocator.AllocateForBuffer(
+        buffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    std::printf("%llu MiB per run, %s transfer queue\n",
+                static_cast<unsigned long long>(kBytesPerRun >> 20),
+                ctx.transfer_family_idx_ != ctx.graphics_family_idx_
+                    ? "dedicated"
+                    : "no dedicated");
+    std::printf("%-10s %-10s %10s %10s %10s %8s %8s\n", "bytes", "layout",
+                "MB/s", "uploads", "regions", "submits", "stalls");
+    for (vk::DeviceSize upload_size : {64ull, 1ull << 10, 64ull << 10,
+                                       1ull << 20})
+    {
+      RunOne(ctx, &allocator, buffer, upload_size, /*scattered=*/false);
+      RunOne(ctx, &allocator, buffer, upload_size, /*scattered=*/true);
+    }
+
+    ctx.device_.destroyBuffer(buffer);
+    allocator.Free(memory);
+  }
+  ctx.device_.destroy();
+  ctx.instance_.destroy();
+}
+
+}  // namespace
+}  // namespace motor
+
+int main() { motor::Run(); }
@@ -0,0 +1,338 @@
+#include "motor/render/upload_manager.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "glog/logging.h"
+#include "motor/render/device_memory_allocator.h"
+#include "motor/render/vulkan_utils.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+namespace
+{
+bool CopyBefore(const vk::Buffer& lhs_dst, const vk::BufferCopy& lhs,
+                const vk::Buffer& rhs_dst, const vk::BufferCopy& rhs)
+{
+  const VkBuffer lhs_handle = lhs_dst;
+  const VkBuffer rhs_handle = rhs_dst;
+  if (lhs_handle != rhs_handle)
+  {
+    return std::less<VkBuffer>()(lhs_handle, rhs_handle);
+  }
+  return lhs.dstOffset < rhs.dstOffset;
+}
+
+// Whether |next| continues |prev| both in the ring and in the destination.
+bool IsContiguous(const vk::BufferCopy& prev, const vk::BufferCopy& next)
+{
+  return prev.srcOffset + prev.size == next.srcOffset &&
+         prev.dstOffset + prev.size == next.dstOffset;
+}
+}  // namespace
+
+UploadManager::UploadManager(const vk::Device& dev,
+                             DeviceMemoryAllocator* allocator,
+                             const vk::Queue& transfer_queue,
+                             uint32_t transfer_family_idx,
+                             uint32_t graphics_family_idx,
+                             vk::DeviceSize ring_size)
+    : dev_(dev),
+      allocator_(allocator),
+      queue_(transfer_queue),
+      transfer_family_idx_(transfer_family_idx),
+      graphics_family_idx_(graphics_family_idx),
+      ring_size_(ring_size)
+{
+  vk::BufferCreateInfo buffer_info;
+  buffer_info.setSize(ring_size_)
+      .setUsage(vk::BufferUsageFlagBits::eTransferSrc)
+      .setSharingMode(vk::SharingMode::eExclusive);
+  ring_buffer_ = VkSuccuessOrDie(dev_.createBuffer(buffer_info),
+                                 "Couldn't create staging buffer");
+  // Coherent, so that writes don't need to be flushed before submission.
+  ring_memory_ = allocator_->AllocateForBuffer(
+      ring_buffer_, vk::MemoryPropertyFlagBits::eHostVisible |
+                        vk::MemoryPropertyFlagBits::eHostCoherent);
+  CHECK(ring_memory_.mapped_ != nullptr) << "Staging memory isn't mapped";
+  LOG(INFO) << "Uploads through a " << (ring_size_ >> 20) << "MiB ring on "
+            << (IsDedicated() ? "a dedicated transfer" : "the graphics")
+            << " queue";
+}
+
+UploadManager::~UploadManager()
+{
+  WaitIdle();
+  for (const Batch& batch : free_batches_)
+  {
+    dev_.destroyFence(batch.fence_);
+    dev_.freeCommandBuffers(batch.cmd_pool_, batch.cmd_buffer_);
+    dev_.destroyCommandPool(batch.cmd_pool_);
+  }
+  dev_.destroyBuffer(ring_buffer_);
+  allocator_->Free(ring_memory_);
+}
+
+void UploadManager::Upload(const vk::Buffer& dst, vk::DeviceSize dst_offset,
+                           const void* data, vk::DeviceSize size)
+{
+  const char* bytes = static_cast<const char*>(data);
+  std::lock_guard<std::mutex> lock(mu_);
+  ++stats_.uploads_;
+  stats_.bytes_ += size;
+  while (size > 0)
+  {
+    // Leaves room for other uploads to be in flight.
+    const vk::DeviceSize chunk = std::min(size, ring_size_ / 4);
+    const vk::DeviceSize offset = AllocateRing(chunk);
+    std::memcpy(static_cast<char*>(ring_memory_.mapped_) + offset, bytes,
+                chunk);
+    const vk::BufferCopy region(offset, dst_offset, chunk);
+    if (!pending_.empty() && pending_.back().dst_ == dst &&
+        IsContiguous(pending_.back().region_, region))
+    {
+      pending_.back().region_.size += chunk;
+    }
+    else
+    {
+      pending_.push_back({dst, region});
+    }
+    bytes += chunk;
+    dst_offset += chunk;
+    size -= chunk;
+  }
+}
+
+bool UploadManager::Flush(const vk::Semaphore& signal)
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  if (pending_.empty() && !unsignaled_) return false;
+  // Even without pending copies, signaling covers the earlier submissions.
+  Submit(signal);
+  unsignaled_ = false;
+  acquires_.insert(acquires_.end(), releases_.begin(), releases_.end());
+  releases_.clear();
+  return true;
+}
+
+void UploadManager::RecordAcquire(const vk::CommandBuffer& cmd_buffer)
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  if (acquires_.empty()) return;
+  cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                             kDstStages, static_cast<vk::DependencyFlags>(0),
+                             nullptr, acquires_, nullptr);
+  acquires_.clear();
+}
+
+void UploadManager::WaitIdle()
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  while (!in_flight_.empty()) Retire(/*wait=*/true);
+}
+
+UploadStats UploadManager::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  return stats_;
+}
+
+vk::DeviceSize UploadManager::AllocateRing(vk::DeviceSize size)
+{
+  vk::DeviceSize offset;
+  if (TryAllocateRing(size, &offset)) return offset;
+  Retire(/*wait=*/false);
+  if (TryAllocateRing(size, &offset)) return offset;
+
+  // Staged copies might be holding on to the space, submit them so that it
+  // can be reclaimed. Next Flush signals for them.
+  if (!pending_.empty())
+  {
+    Submit(nullptr);
+    unsignaled_ = true;
+  }
+  while (!TryAllocateRing(size, &offset))
+  {
+    CHECK(!in_flight_.empty()) << "Upload of " << size
+                               << " bytes doesn't fit into the ring";
+    ++stats_.ring_stalls_;
+    Retire(/*wait=*/true);
+  }
+  return offset;
+}
+
+bool UploadManager::TryAllocateRing(vk::DeviceSize size,
+                                    vk::DeviceSize* offset)
+{
+  if (head_ >= tail_)
+  {
+    if (ring_size_ - head_ >= size)
+    {
+      *offset = head_;
+      head_ += size;
+      return true;
+    }
+    // Wrap around, the bytes left at the end are skipped.
+    if (size < tail_)
+    {
+      *offset = 0;
+      head_ = size;
+      return true;
+    }
+    return false;
+  }
+  if (tail_ - head_ > size)
+  {
+    *offset = head_;
+    head_ += size;
+    return true;
+  }
+  return false;
+}
+
+void UploadManager::Retire(bool wait)
+{
+  while (!in_flight_.empty())
+  {
+    Batch& batch = in_flight_.front();
+    if (wait)
+    {
+      VkSuccuessOrDie(
+          dev_.waitForFences(batch.fence_, /*waitAll=*/true,
+                             std::numeric_limits<uint64_t>::max()),
+          "Couldn't wait for upload fence");
+      wait = false;
+    }
+    else if (dev_.getFenceStatus(batch.fence_) != vk::Result::eSuccess)
+    {
+      break;
+    }
+    tail_ = batch.ring_end_;
+    free_batches_.push_back(batch);
+    in_flight_.pop_front();
+  }
+  if (in_flight_.empty() && pending_.empty()) head_ = tail_ = 0;
+}
+
+UploadManager::Batch UploadManager::AcquireBatch()
+{
+  if (!free_batches_.empty())
+  {
+    Batch batch = free_batches_.back();
+    free_batches_.pop_back();
+    VkSuccuessOrDie(dev_.resetFences(batch.fence_),
+                    "Couldn't reset upload fence");
+    VkSuccuessOrDie(
+        dev_.resetCommandPool(batch.cmd_pool_,
+                              static_cast<vk::CommandPoolResetFlags>(0)),
+        "Couldn't reset command pool");
+    return batch;
+  }
+
+  Batch batch;
+  vk::CommandPoolCreateInfo pool_info;
+  pool_info.setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+      .setQueueFamilyIndex(transfer_family_idx_);
+  batch.cmd_pool_ = VkSuccuessOrDie(dev_.createCommandPool(pool_info),
+                                    "Couldn't create command pool");
+  vk::CommandBufferAllocateInfo alloc_info;
+  alloc_info.setCommandPool(batch.cmd_pool_)
+      .setLevel(vk::CommandBufferLevel::ePrimary)
+      .setCommandBufferCount(1);
+  batch.cmd_buffer_ =
+      VkSuccuessOrDie(dev_.allocateCommandBuffers(alloc_info),
+                      "Couldn't allocate command buffers")[0];
+  batch.fence_ = VkSuccuessOrDie(dev_.createFence(vk::FenceCreateInfo()),
+                                 "Couldn't create fence");
+  return batch;
+}
+
+void UploadManager::Submit(const vk::Semaphore& signal)
+{
+  Batch batch = AcquireBatch();
+  const vk::CommandBuffer& cmd_buffer = batch.cmd_buffer_;
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  VkSuccuessOrDie(cmd_buffer.begin(begin_info),
+                  "Couldn't start command buffer");
+
+  // Group copies by destination, each gets a single copy command. Sorting by
+  // offset also merges uploads that were contiguous but not issued in order.
+  std::sort(pending_.begin(), pending_.end(),
+            [](const PendingCopy& lhs, const PendingCopy& rhs) {
+              return CopyBefore(lhs.dst_, lhs.region_, rhs.dst_, rhs.region_);
+            });
+  std::vector<vk::BufferMemoryBarrier> releases;
+  for (size_t begin = 0, end = 0; begin < pending_.size(); begin = end)
+  {
+    const vk::Buffer& dst = pending_[begin].dst_;
+    regions_.clear();
+    regions_.push_back(pending_[begin].region_);
+    for (end = begin + 1; end < pending_.size() && pending_[end].dst_ == dst;
+         ++end)
+    {
+      const vk::BufferCopy& region = pending_[end].region_;
+      if (IsContiguous(regions_.back(), region))
+      {
+        regions_.back().size += region.size;
+      }
+      else
+      {
+        regions_.push_back(region);
+      }
+    }
+    cmd_buffer.copyBuffer(ring_buffer_, dst, regions_);
+    ++stats_.copy_commands_;
+    stats_.regions_ += regions_.size();
+
+    if (!IsDedicated()) continue;
+    // Regions are sorted by destination offset.
+    const vk::DeviceSize dst_begin = regions_.front().dstOffset;
+    vk::DeviceSize dst_end = 0;
+    for (const vk::BufferCopy& region : regions_)
+    {
+      dst_end = std::max(dst_end, region.dstOffset + region.size);
+    }
+    vk::BufferMemoryBarrier barrier;
+    barrier.setSrcQueueFamilyIndex(transfer_family_idx_)
+        .setDstQueueFamilyIndex(graphics_family_idx_)
+        .setBuffer(dst)
+        .setOffset(dst_begin)
+        .setSize(dst_end - dst_begin);
+    releases.push_back(barrier);
+    releases.back().setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    releases_.push_back(barrier);
+    releases_.back().setDstAccessMask(kDstAccess);
+  }
+  if (!releases.empty())
+  {
+    cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                               vk::PipelineStageFlagBits::eBottomOfPipe,
+                               static_cast<vk::DependencyFlags>(0), nullptr,
+                               releases, nullptr);
+  }
+  VkSuccuessOrDie(cmd_buffer.end(), "Couldn't end command buffer");
+
+  vk::SubmitInfo submit_info;
+  submit_info.setCommandBufferCount(1).setPCommandBuffers(&cmd_buffer);
+  if (signal)
+  {
+    submit_info.setSignalSemaphoreCount(1).setPSignalSemaphores(&signal);
+  }
+  VkSuccuessOrDie(queue_.submit({submit_info}, batch.fence_),
+                  "Couldn't submit uploads");
+  ++stats_.submits_;
+
+  batch.ring_end_ = head_;
+  in_flight_.push_back(batch);
+  pending_.clear();
+}
+
+}  // namespace motor
@@ -0,0 +1,156 @@
+#ifndef _MOTOR_RENDER_UPLOAD_MANAGER_H_
+#define _MOTOR_RENDER_UPLOAD_MANAGER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "motor/render/device_memory_allocator.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+struct UploadStats
+{
+  uint64_t bytes_ = 0;
+  // Calls to Upload, and the copy regions they were coalesced into.
+  uint64_t uploads_ = 0;
+  uint64_t regions_ = 0;
+  uint64_t copy_commands_ = 0;
+  uint64_t submits_ = 0;
+  // Times Upload had to wait for the GPU to free up ring space.
+  uint64_t ring_stalls_ = 0;
+};
+
+// Streams data into device local buffers through a persistently mapped
+// staging ring. Uploads are memcpy'd into the ring right away and copied on
+// the GPU on the next Flush, which batches them into a single submission with
+// one vkCmdCopyBuffer per destination. Ring space is reclaimed once the fence
+// of the submission that read it has signaled.
+//
+// Copies are submitted to |transfer_queue|. If that belongs to a different
+// family than graphics, e.g. a dedicated DMA queue, ownership of the written
+// ranges is released to the graphics family, which has to acquire it with
+// RecordAcquire. Destination buffers must use exclusive sharing and their
+// written ranges must not be in use by the GPU.
+//
+// Flush and RecordAcquire must be called from the thread submitting graphics
+// work. Upload submits by itself when the ring fills up, hence it can only be
+// called from other threads if nothing else submits to |transfer_queue|, e.g.
+// with a dedicated transfer family. It copies into the ring under a lock.
+class UploadManager
+{
+ public:
+  static constexpr vk::DeviceSize kDefaultRingSize = 32ull << 20;
+  // Stages and accesses of the graphics queue that can consume uploads.
+  static inline const vk::PipelineStageFlags kDstStages =
+      vk::PipelineStageFlagBits::eTransfer |
+      vk::PipelineStageFlagBits::eVertexInput |
+      vk::PipelineStageFlagBits::eVertexShader |
+      vk::PipelineStageFlagBits::eFragmentShader |
+      vk::PipelineStageFlagBits::eComputeShader |
+      vk::PipelineStageFlagBits::eDrawIndirect;
+  static inline const vk::AccessFlags kDstAccess =
+      vk::AccessFlagBits::eTransferRead |
+      vk::AccessFlagBits::eVertexAttributeRead |
+      vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eUniformRead |
+      vk::AccessFlagBits::eShaderRead |
+      vk::AccessFlagBits::eIndirectCommandRead;
+
+  UploadManager(const vk::Device& dev, DeviceMemoryAllocator* allocator,
+                const vk::Queue& transfer_queue, uint32_t transfer_family_idx,
+                uint32_t graphics_family_idx,
+                vk::DeviceSize ring_size = kDefaultRingSize);
+  UploadManager(const UploadManager&) = delete;
+  UploadManager& operator=(const UploadManager&) = delete;
+  // Waits for submitted uploads, pending ones are dropped.
+  ~UploadManager();
+
+  // Stages |size| bytes to be written into |dst| at |dst_offset|. Blocks if
+  // the ring is full until the GPU is done with earlier uploads, uploads
+  // larger than the ring are split.
+  void Upload(const vk::Buffer& dst, vk::DeviceSize dst_offset,
+              const void* data, vk::DeviceSize size);
+
+  // Submits all staged uploads and returns true if there were any, in which
+  // case |signal| is signaled once they complete. Graphics work consuming the
+  // uploads must wait on it at kDstStages, it can be null if nothing on the
+  // GPU waits for the uploads.
+  bool Flush(const vk::Semaphore& signal);
+  // Records acquire barriers for the ranges written up to the last Flush,
+  // no-op unless a dedicated transfer family is used. Must be recorded into a
+  // command buffer that waits on the semaphore passed to that Flush.
+  void RecordAcquire(const vk::CommandBuffer& cmd_buffer);
+  // Blocks until all submitted uploads complete.
+  void WaitIdle();
+
+  bool IsDedicated() const
+  {
+    return transfer_family_idx_ != graphics_family_idx_;
+  }
+  UploadStats GetStats() const;
+
+ private:
+  struct PendingCopy
+  {
+    vk::Buffer dst_;
+    vk::BufferCopy region_;
+  };
+  // A submission and the ring space it reads, recycled once its fence has
+  // signaled.
+  struct Batch
+  {
+    vk::CommandPool cmd_pool_;
+    vk::CommandBuffer cmd_buffer_;
+    vk::Fence fence_;
+    // Ring is free up to here once the batch completes.
+    vk::DeviceSize ring_end_ = 0;
+  };
+
+  // All of the following must be called with mu_ held.
+  // Returns the ring offset of |size| free bytes, stalling if needed.
+  vk::DeviceSize AllocateRing(vk::DeviceSize size);
+  // Returns whether there is space for |size| bytes and sets |offset|.
+  bool TryAllocateRing(vk::DeviceSize size, vk::DeviceSize* offset);
+  // Reclaims completed batches, waiting for the oldest one if |wait|.
+  void Retire(bool wait);
+  Batch AcquireBatch();
+  // Records and submits pending_, signaling |signal| if it is not null.
+  void Submit(const vk::Semaphore& signal);
+
+  const vk::Device dev_;
+  DeviceMemoryAllocator* const allocator_;
+  const vk::Queue queue_;
+  const uint32_t transfer_family_idx_;
+  const uint32_t graphics_family_idx_;
+  const vk::DeviceSize ring_size_;
+  vk::Buffer ring_buffer_;
+  MemoryAllocation ring_memory_;
+
+  mutable std::mutex mu_;
+  // Bytes in [tail_, head_) are in use, wrapping around ring_size_. head_ ==
+  // tail_ means the ring is empty, allocation never lets head_ catch up with
+  // tail_ from behind.
+  vk::DeviceSize head_ = 0;
+  vk::DeviceSize tail_ = 0;
+  std::vector<PendingCopy> pending_;
+  std::deque<Batch> in_flight_;
+  std::vector<Batch> free_batches_;
+  // Acquire side of the ownership transfers submitted since the last Flush,
+  // and of the ones covered by a Flush but not yet recorded.
+  std::vector<vk::BufferMemoryBarrier> releases_;
+  std::vector<vk::BufferMemoryBarrier> acquires_;
+  // Scratch space for Submit.
+  std::vector<vk::BufferCopy> regions_;
+  // Whether uploads were submitted without a semaphore to wait on, because
+  // the ring filled up.
+  bool unsignaled_ = false;
+  UploadStats stats_;
+};
+
+}  // namespace motor
+
+#endif
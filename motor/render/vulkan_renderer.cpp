@@ -1,12 +1,32 @@
 #include <bits/stdint-uintn.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstddef>
+#include <cstring>
+#include <deque>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include "glog/logging.h"
+#include "motor/assets/asset_streamer.h"
+#include "motor/jobs/job_system.h"
+#include "motor/render/command_recorder.h"
+#include "motor/render/culling_shaders.h"
+#include "motor/render/device_memory_allocator.h"
+#include "motor/render/frustum_culling.h"
+#include "motor/render/gpu_culler.h"
+#include "motor/render/gpu_timer.h"
+#include "motor/render/latency_tracker.h"
+#include "motor/render/pipeline_manager.h"
 #include "motor/render/renderer.h"
+#include "motor/render/upload_manager.h"
+#include "motor/render/vulkan_utils.h"
 #include "vulkan/vulkan.hpp"
 // NOLINT
 #include "GLFW/glfw3.h"
@@ -15,28 +35,32 @@ namespace motor
 {
 namespace
 {
-template <typename T>
-T VkSuccuessOrDie(vk::ResultValue<T> res_and_val, const char* desc)
-{
-  CHECK(res_and_val.result == vk::Result::eSuccess)
-      << "VK error: " << desc << '-' << static_cast<int>(res_and_val.result);
-  return res_and_val.value;
-}
-void VkSuccuessOrDie(vk::Result res, const char* desc)
-{
-  CHECK(res == vk::Result::eSuccess)
-      << "VK error: " << desc << '-' << static_cast<int>(res);
-}
+using Clock = std::chrono::steady_clock;
+
+// Presents whose display times haven't been reported yet are tracked in a ring
+// of this size, older ones are forgotten.
+constexpr const size_t kMaxPendingPresents = 16;
+
+// Unit cube, GPU culled objects are drawn as one scaled to their bounding
+// sphere.
+constexpr std::array<float, 24> kCubeVertices = {
+    -1, -1, -1, 1, -1, -1, 1, 1, -1, -1, 1, -1,
+    -1, -1, 1,  1, -1, 1,  1, 1, 1,  -1, 1, 1,
+};
+constexpr std::array<uint16_t, 36> kCubeIndices = {
+    0, 1, 2, 2, 3, 0, 4, 6, 5, 6, 4, 7, 0, 4, 5, 5, 1, 0,
+    3, 2, 6, 6, 7, 3, 0, 3, 7, 7, 4, 0, 1, 5, 6, 6, 2, 1,
+};
 
 struct DepthBuffer
 {
   vk::Format format_;
   vk::Image image_;
-  vk::DeviceMemory memory_;
+  MemoryAllocation memory_;
   vk::ImageView view_;
 };
 
-vk::Instance CreateInstance()
+vk::Instance CreateInstance(bool offscreen)
 {
   // TODO(kadircet): Some of the following should come from an options struct.
   vk::ApplicationInfo app_info;
@@ -47,14 +71,19 @@ vk::Instance CreateInstance()
       .setPEngineName("WUHU")
       .setPNext(nullptr);
 
-  const std::vector<const char*> extensions = {
-      VK_KHR_SURFACE_EXTENSION_NAME,
+  std::vector<const char*> extensions;
+  // Surface extensions might not be available without a display.
+  if (!offscreen)
+  {
+    extensions = {
+        VK_KHR_SURFACE_EXTENSION_NAME,
 #ifdef VK_USE_PLATFORM_WIN32_KHR
-      VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
+        VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
 #else
-      VK_KHR_XCB_SURFACE_EXTENSION_NAME,
+        VK_KHR_XCB_SURFACE_EXTENSION_NAME,
 #endif
-  };
+    };
+  }
   vk::InstanceCreateInfo vk_inst_info;
   vk_inst_info.setPApplicationInfo(&app_info)
       .setEnabledLayerCount(0)
@@ -68,6 +97,36 @@ vk::Instance CreateInstance()
                          "Couldn't createInstance");
 }
 
+// Whether there's any device with a graphics queue. Uses a bare instance
+// without any extensions, which is much cheaper than a full initialization.
+bool HasGraphicsDevice()
+{
+  vk::ApplicationInfo app_info;
+  app_info.setApiVersion(VK_API_VERSION_1_1);
+  vk::InstanceCreateInfo vk_inst_info;
+  vk_inst_info.setPApplicationInfo(&app_info);
+  vk::ResultValue<vk::Instance> vk_inst = vk::createInstance(vk_inst_info);
+  if (vk_inst.result != vk::Result::eSuccess) return false;
+
+  bool found = false;
+  auto devices = vk_inst.value.enumeratePhysicalDevices();
+  if (devices.result == vk::Result::eSuccess)
+  {
+    for (const vk::PhysicalDevice& phy_dev : devices.value)
+    {
+      for (const auto& family_prop : phy_dev.getQueueFamilyProperties())
+      {
+        if (family_prop.queueFlags & vk::QueueFlagBits::eGraphics)
+        {
+          found = true;
+        }
+      }
+    }
+  }
+  vk_inst.value.destroy();
+  return found;
+}
+
 vk::PhysicalDevice SelectPhyiscalDevice(const vk::Instance& vk_inst)
 {
   std::vector<vk::PhysicalDevice> devices = VkSuccuessOrDie(
@@ -102,6 +161,37 @@ size_t GetGraphicsQueueIdx(const vk::PhysicalDevice& phy_dev)
   return result;
 }
 
+// Prefers a transfer-only family, i.e. a DMA engine that can copy while the
+// graphics queue renders, then any non-graphics family with transfers. Falls
+// back to |graphics_idx|, graphics queues implicitly support transfers.
+size_t GetTransferQueueIdx(const vk::PhysicalDevice& phy_dev,
+                           size_t graphics_idx)
+{
+  const std::vector<vk::QueueFamilyProperties> queue_family_props =
+      phy_dev.getQueueFamilyProperties();
+  size_t result = graphics_idx;
+  bool transfer_only = false;
+  for (size_t i = 0; i < queue_family_props.size(); ++i)
+  {
+    const vk::QueueFlags flags = queue_family_props[i].queueFlags;
+    if (!(flags & vk::QueueFlagBits::eTransfer) ||
+        (flags & vk::QueueFlagBits::eGraphics))
+    {
+      continue;
+    }
+    if (!(flags & vk::QueueFlagBits::eCompute))
+    {
+      result = i;
+      transfer_only = true;
+    }
+    else if (!transfer_only)
+    {
+      result = i;
+    }
+  }
+  return result;
+}
+
 size_t GetPresentQueueIdx(const vk::PhysicalDevice& phy_dev,
                           const vk::SurfaceKHR& surface)
 {
@@ -132,28 +222,51 @@ vk::SurfaceKHR CreateSurface(const vk::Instance& inst)
   return vk_surface;
 }
 
+bool HasDeviceExtension(const vk::PhysicalDevice& phy_dev, const char* name)
+{
+  const std::vector<vk::ExtensionProperties> extensions =
+      VkSuccuessOrDie(phy_dev.enumerateDeviceExtensionProperties(),
+                      "Couldn't enumerate device extensions");
+  for (const vk::ExtensionProperties& extension : extensions)
+  {
+    if (std::strcmp(extension.extensionName, name) == 0) return true;
+  }
+  return false;
+}
+
+// Creates a single queue in each of the distinct |queue_family_idxs|.
 vk::Device CreateDevice(const vk::PhysicalDevice& phy_dev,
-                        size_t queue_family_idx)
+                        std::vector<size_t> queue_family_idxs,
+                        const std::vector<const char*>& extensions,
+                        const vk::PhysicalDeviceFeatures& features)
 {
-  vk::DeviceQueueCreateInfo queue_create_info;
-  // Currently we support only a single queue, therefore this is not important.
+  std::sort(queue_family_idxs.begin(), queue_family_idxs.end());
+  queue_family_idxs.erase(
+      std::unique(queue_family_idxs.begin(), queue_family_idxs.end()),
+      queue_family_idxs.end());
+  // There's one queue per family, therefore this is not important.
   const float queue_prios = {.0};
-  queue_create_info.setPQueuePriorities(&queue_prios)
-      .setQueueCount(1)
-      .setQueueFamilyIndex(queue_family_idx)
-      .setFlags(static_cast<vk::DeviceQueueCreateFlags>(0))
-      .setPNext(nullptr);
+  std::vector<vk::DeviceQueueCreateInfo> queue_create_infos;
+  for (size_t queue_family_idx : queue_family_idxs)
+  {
+    vk::DeviceQueueCreateInfo queue_create_info;
+    queue_create_info.setPQueuePriorities(&queue_prios)
+        .setQueueCount(1)
+        .setQueueFamilyIndex(queue_family_idx)
+        .setFlags(static_cast<vk::DeviceQueueCreateFlags>(0))
+        .setPNext(nullptr);
+    queue_create_infos.push_back(queue_create_info);
+  }
 
-  const std::vector<const char*> extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
   vk::DeviceCreateInfo create_info;
-  create_info.setPQueueCreateInfos(&queue_create_info)
-      .setQueueCreateInfoCount(1)
+  create_info.setPQueueCreateInfos(queue_create_infos.data())
+      .setQueueCreateInfoCount(queue_create_infos.size())
       .setEnabledExtensionCount(extensions.size())
       .setPpEnabledExtensionNames(extensions.data())
       // Layers are deprecated.
       .setEnabledLayerCount(0)
       .setPpEnabledLayerNames(nullptr)
-      .setPEnabledFeatures(nullptr)
+      .setPEnabledFeatures(&features)
       .setPNext(nullptr);
 
   return VkSuccuessOrDie(phy_dev.createDevice(create_info),
@@ -183,10 +296,12 @@ std::vector<vk::CommandBuffer> AllocateCommandBuffers(
                          "Couldn't allocate command buffers");
 }
 
+// |extent| is used when the surface leaves the size to the swapchain, it is
+// overwritten with the chosen size.
 vk::SwapchainKHR CreateSwapChain(const vk::PhysicalDevice& phy_dev,
                                  const vk::SurfaceKHR& vk_surface,
                                  const vk::Device& vk_device,
-                                 vk::Format* format)
+                                 vk::Format* format, vk::Extent2D* extent)
 {
   std::vector<vk::SurfaceFormatKHR> formats = VkSuccuessOrDie(
       phy_dev.getSurfaceFormatsKHR(vk_surface), "Couldn't get surface formats");
@@ -205,21 +320,25 @@ vk::SwapchainKHR CreateSwapChain(const vk::PhysicalDevice& phy_dev,
       VkSuccuessOrDie(phy_dev.getSurfacePresentModesKHR(vk_surface),
                       "Couldn't get present modes");
 
-  vk::Extent2D swap_chain_extend;
-  // TODO(kadircet): Use values coming from user instead.
-  if (surf_caps.currentExtent.height == 0xFFFFFFFF)
+  if (surf_caps.currentExtent.width == 0xFFFFFFFF)
+  {
+    extent->setWidth(std::clamp(extent->width, surf_caps.minImageExtent.width,
+                                surf_caps.maxImageExtent.width))
+        .setHeight(std::clamp(extent->height, surf_caps.minImageExtent.height,
+                              surf_caps.maxImageExtent.height));
+    LOG(INFO) << "Current extent unknown, using " << extent->width << "x"
+              << extent->height;
+  }
+  else
   {
-    LOG(INFO) << "Current extent unknown setting to 800x600";
-    surf_caps.currentExtent.setHeight(600);
-    surf_caps.currentExtent.setWidth(800);
+    *extent = surf_caps.currentExtent;
   }
-  swap_chain_extend = surf_caps.currentExtent;
 
   vk::SwapchainCreateInfoKHR swapchain_info;
   swapchain_info.setSurface(vk_surface)
       .setImageFormat(formats[0].format)
       .setMinImageCount(surf_caps.minImageCount)
-      .setImageExtent(swap_chain_extend)
+      .setImageExtent(*extent)
       // FIFO is supported by all devices.
       .setPresentMode(vk::PresentModeKHR::eFifo)
       .setPreTransform(surf_caps.currentTransform)
@@ -228,7 +347,9 @@ vk::SwapchainKHR CreateSwapChain(const vk::PhysicalDevice& phy_dev,
       .setOldSwapchain(nullptr)
       .setClipped(true)
       .setImageColorSpace(vk::ColorSpaceKHR::eSrgbNonlinear)
-      .setImageUsage(vk::ImageUsageFlagBits::eColorAttachment)
+      // Frames are currently cleared with a transfer command.
+      .setImageUsage(vk::ImageUsageFlagBits::eColorAttachment |
+                     vk::ImageUsageFlagBits::eTransferDst)
       .setImageSharingMode(vk::SharingMode::eExclusive)
       .setQueueFamilyIndexCount(0)
       .setPQueueFamilyIndices(nullptr)
@@ -262,7 +383,9 @@ std::vector<vk::ImageView> CreateImageViews(
 }
 
 DepthBuffer CreateDepthBuffer(const vk::PhysicalDevice& phy_dev,
-                              const vk::Device& dev)
+                              const vk::Device& dev,
+                              DeviceMemoryAllocator* allocator,
+                              const vk::Extent2D& extent)
 {
   DepthBuffer depth_buffer;
   depth_buffer.format_ = vk::Format::eD16Unorm;
@@ -288,7 +411,7 @@ DepthBuffer CreateDepthBuffer(const vk::PhysicalDevice& phy_dev,
   vk::ImageCreateInfo image_create_info;
   image_create_info.setImageType(vk::ImageType::e2D)
       .setArrayLayers(1)
-      .setExtent(vk::Extent3D(800, 600, 1))
+      .setExtent(vk::Extent3D(extent.width, extent.height, 1))
       .setFlags(static_cast<vk::ImageCreateFlags>(0))
       .setFormat(depth_buffer.format_)
       .setInitialLayout(vk::ImageLayout::eUndefined)
@@ -303,34 +426,8 @@ DepthBuffer CreateDepthBuffer(const vk::PhysicalDevice& phy_dev,
   depth_buffer.image_ = VkSuccuessOrDie(dev.createImage(image_create_info),
                                         "Couldn't create depth buffer");
 
-  vk::MemoryRequirements mem_reqs =
-      dev.getImageMemoryRequirements(depth_buffer.image_);
-  size_t type_bits = mem_reqs.memoryTypeBits;
-
-  int memory_type_id = -1;
-  vk::PhysicalDeviceMemoryProperties mem_props = phy_dev.getMemoryProperties();
-  for (int i = 0; i < mem_props.memoryTypeCount; ++i, type_bits >>= 1)
-  {
-    if ((type_bits & 1) == 0) continue;
-    if (mem_props.memoryTypes[i].propertyFlags &
-        vk::MemoryPropertyFlagBits::eDeviceLocal)
-    {
-      memory_type_id = i;
-      break;
-    }
-  }
-  CHECK(memory_type_id != -1) << "Couldn't find device local memory";
-
-  vk::MemoryAllocateInfo memory_alloc_info;
-  memory_alloc_info.setAllocationSize(mem_reqs.size)
-      .setMemoryTypeIndex(memory_type_id)
-      .setPNext(nullptr);
-  depth_buffer.memory_ = VkSuccuessOrDie(dev.allocateMemory(memory_alloc_info),
-                                         "Couldn't allocate memory");
-
-  VkSuccuessOrDie(
-      dev.bindImageMemory(depth_buffer.image_, depth_buffer.memory_, 0),
-      "Couldn't bind memory");
+  depth_buffer.memory_ = allocator->AllocateForImage(
+      depth_buffer.image_, vk::MemoryPropertyFlagBits::eDeviceLocal, tiling);
 
   vk::ImageViewCreateInfo view_create_info;
   view_create_info.setImage(depth_buffer.image_)
@@ -349,122 +446,931 @@ DepthBuffer CreateDepthBuffer(const vk::PhysicalDevice& phy_dev,
   return depth_buffer;
 }
 
-class VulkanRenderer : public Renderer
+// Color targets used in place of swapchain images when rendering offscreen.
+std::vector<vk::Image> CreateOffscreenImages(
+    const vk::Device& dev, DeviceMemoryAllocator* allocator,
+    const vk::Format& format, const vk::Extent2D& extent, size_t count,
+    std::vector<MemoryAllocation>* memory)
 {
- public:
-  VulkanRenderer()
+  vk::ImageCreateInfo image_create_info;
+  image_create_info.setImageType(vk::ImageType::e2D)
+      .setArrayLayers(1)
+      .setExtent(vk::Extent3D(extent.width, extent.height, 1))
+      .setFlags(static_cast<vk::ImageCreateFlags>(0))
+      .setFormat(format)
+      .setInitialLayout(vk::ImageLayout::eUndefined)
+      .setMipLevels(1)
+      .setPQueueFamilyIndices(nullptr)
+      .setQueueFamilyIndexCount(0)
+      .setSamples(vk::SampleCountFlagBits::e1)
+      .setSharingMode(vk::SharingMode::eExclusive)
+      // Same usage as swapchain images, plus being able to read them back.
+      .setUsage(vk::ImageUsageFlagBits::eColorAttachment |
+                vk::ImageUsageFlagBits::eTransferDst |
+                vk::ImageUsageFlagBits::eTransferSrc)
+      .setTiling(vk::ImageTiling::eOptimal)
+      .setPNext(nullptr);
+
+  std::vector<vk::Image> images;
+  for (size_t i = 0; i < count; ++i)
   {
-    vk_instance_ = CreateInstance();
-    vk_surface_ = CreateSurface(vk_instance_);
-    phy_dev_ = SelectPhyiscalDevice(vk_instance_);
-    queue_graphics_family_idx_ = GetGraphicsQueueIdx(phy_dev_);
-    queue_present_family_idx_ = GetPresentQueueIdx(phy_dev_, vk_surface_);
-    CHECK(queue_graphics_family_idx_ == queue_present_family_idx_)
-        << "Different family indices for present and graphics are not "
-           "supported yet.";
+    images.push_back(VkSuccuessOrDie(dev.createImage(image_create_info),
+                                     "Couldn't create offscreen image"));
+    memory->push_back(allocator->AllocateForImage(
+        images.back(), vk::MemoryPropertyFlagBits::eDeviceLocal,
+        vk::ImageTiling::eOptimal));
+  }
+  return images;
+}
 
-    vk_device_ = CreateDevice(phy_dev_, queue_graphics_family_idx_);
-    vk_cmd_pool_ = CreateCommandPool(vk_device_, queue_graphics_family_idx_);
+// Draws into an image that has been cleared with a transfer, leaving it as a
+// color attachment.
+vk::RenderPass CreateDrawRenderPass(const vk::Device& dev,
+                                   const vk::Format& format)
+{
+  vk::AttachmentDescription attachment;
+  attachment.setFormat(format)
+      .setSamples(vk::SampleCountFlagBits::e1)
+      .setLoadOp(vk::AttachmentLoadOp::eLoad)
+      .setStoreOp(vk::AttachmentStoreOp::eStore)
+      .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
+      .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
+      .setInitialLayout(vk::ImageLayout::eTransferDstOptimal)
+      .setFinalLayout(vk::ImageLayout::eColorAttachmentOptimal);
+  const vk::AttachmentReference color_ref(
+      0, vk::ImageLayout::eColorAttachmentOptimal);
+  vk::SubpassDescription subpass;
+  subpass.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+      .setColorAttachmentCount(1)
+      .setPColorAttachments(&color_ref);
+  // Orders the draws after the clear.
+  vk::SubpassDependency dependency;
+  dependency.setSrcSubpass(VK_SUBPASS_EXTERNAL)
+      .setDstSubpass(0)
+      .setSrcStageMask(vk::PipelineStageFlagBits::eTransfer)
+      .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+      .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentRead |
+                        vk::AccessFlagBits::eColorAttachmentWrite);
+  vk::RenderPassCreateInfo pass_info;
+  pass_info.setAttachmentCount(1)
+      .setPAttachments(&attachment)
+      .setSubpassCount(1)
+      .setPSubpasses(&subpass)
+      .setDependencyCount(1)
+      .setPDependencies(&dependency);
+  return VkSuccuessOrDie(dev.createRenderPass(pass_info),
+                         "Couldn't create render pass");
+}
 
-    vk_swapchain_ =
-        CreateSwapChain(phy_dev_, vk_surface_, vk_device_, &vk_format_);
+std::vector<vk::Framebuffer> CreateFramebuffers(
+    const vk::Device& dev, const vk::RenderPass& render_pass,
+    const std::vector<vk::ImageView>& views, const vk::Extent2D& extent)
+{
+  std::vector<vk::Framebuffer> framebuffers;
+  for (const vk::ImageView& view : views)
+  {
+    vk::FramebufferCreateInfo framebuffer_info;
+    framebuffer_info.setRenderPass(render_pass)
+        .setAttachmentCount(1)
+        .setPAttachments(&view)
+        .setWidth(extent.width)
+        .setHeight(extent.height)
+        .setLayers(1);
+    framebuffers.push_back(
+        VkSuccuessOrDie(dev.createFramebuffer(framebuffer_info),
+                        "Couldn't create framebuffer"));
+  }
+  return framebuffers;
+}
 
-    vk_images_ = VkSuccuessOrDie(
-        vk_device_.getSwapchainImagesKHR(vk_swapchain_), "Couldn't get images");
+// Resources for drawing the objects culled by a GpuCuller, only created with
+// RendererOptions::gpu_culling_.
+struct CullDrawResources
+{
+  vk::RenderPass render_pass_;
+  // One per swapchain or offscreen image.
+  std::vector<vk::Framebuffer> framebuffers_;
+  vk::DescriptorSetLayout set_layout_;
+  vk::DescriptorPool descriptor_pool_;
+  // One per frame in flight, binding the objects of the culler's slot.
+  std::vector<vk::DescriptorSet> descriptor_sets_;
+  vk::PipelineLayout pipeline_layout_;
+  vk::ShaderModule vertex_shader_;
+  vk::ShaderModule fragment_shader_;
+  PipelineManager::Handle pipeline_;
+  vk::Buffer vertex_buffer_;
+  MemoryAllocation vertex_memory_;
+  vk::Buffer index_buffer_;
+  MemoryAllocation index_memory_;
+};
 
-    vk_image_views_ = CreateImageViews(vk_device_, vk_images_, vk_format_);
-    depth_buffer_ = CreateDepthBuffer(phy_dev_, vk_device_);
+// Resources that are owned by a single frame in flight. A frame is only
+// reused once its fence has been signaled, so CPU can record the next frame
+// while the GPU is still executing the previous ones.
+struct FrameResources
+{
+  // Input carried by the frame last submitted from this slot, only tracked
+  // when rendering offscreen.
+  std::chrono::steady_clock::time_point input_time_;
+  vk::CommandPool cmd_pool_;
+  vk::CommandBuffer cmd_buffer_;
+  // Secondary command buffers executed by cmd_buffer_.
+  std::unique_ptr<ParallelCommandRecorder> recorder_;
+  std::vector<vk::CommandBuffer> secondaries_;
+  vk::Semaphore image_available_;
+  vk::Semaphore render_finished_;
+  // Signaled by the uploads the frame waits on.
+  vk::Semaphore uploads_done_;
+  vk::Fence in_flight_;
+};
 
-    cmd_buffers_ =
-        AllocateCommandBuffers(vk_device_, vk_cmd_pool_, vk_images_.size());
+FrameResources CreateFrameResources(const vk::Device& vk_dev,
+                                    size_t queue_family_idx,
+                                    jobs::JobSystem* job_system)
+{
+  FrameResources frame;
+  frame.cmd_pool_ = CreateCommandPool(vk_dev, queue_family_idx);
+  frame.cmd_buffer_ = AllocateCommandBuffers(vk_dev, frame.cmd_pool_, 1)[0];
+  frame.recorder_ = std::make_unique<ParallelCommandRecorder>(
+      vk_dev, queue_family_idx, job_system);
 
-    vk::ClearColorValue color;
-    color.setFloat32({.0, .0, 1., .0});
+  vk::SemaphoreCreateInfo semaphore_info;
+  frame.image_available_ = VkSuccuessOrDie(
+      vk_dev.createSemaphore(semaphore_info), "Couldn't create semaphore");
+  frame.render_finished_ = VkSuccuessOrDie(
+      vk_dev.createSemaphore(semaphore_info), "Couldn't create semaphore");
+  frame.uploads_done_ = VkSuccuessOrDie(vk_dev.createSemaphore(semaphore_info),
+                                        "Couldn't create semaphore");
 
-    vk::ImageSubresourceRange image_range;
-    image_range.setAspectMask(vk::ImageAspectFlagBits::eColor)
-        .setLevelCount(1)
-        .setLayerCount(1);
+  // Created signaled so that the first wait on each frame doesn't block.
+  vk::FenceCreateInfo fence_info;
+  fence_info.setFlags(vk::FenceCreateFlagBits::eSignaled);
+  frame.in_flight_ =
+      VkSuccuessOrDie(vk_dev.createFence(fence_info), "Couldn't create fence");
+  return frame;
+}
 
-    vk::CommandBufferBeginInfo cmd_buf_begin_info;
-    cmd_buf_begin_info.setFlags(
-        vk::CommandBufferUsageFlagBits::eSimultaneousUse);
+void DestroyFrameResources(const vk::Device& vk_dev, FrameResources* frame)
+{
+  vk_dev.destroyFence(frame->in_flight_);
+  vk_dev.destroySemaphore(frame->uploads_done_);
+  vk_dev.destroySemaphore(frame->render_finished_);
+  vk_dev.destroySemaphore(frame->image_available_);
+  frame->recorder_.reset();
+  vk_dev.freeCommandBuffers(frame->cmd_pool_, frame->cmd_buffer_);
+  vk_dev.destroyCommandPool(frame->cmd_pool_);
+}
+
+void TransitionImageLayout(const vk::CommandBuffer& cmd_buffer,
+                           const vk::Image& image, vk::ImageLayout old_layout,
+                           vk::ImageLayout new_layout,
+                           vk::AccessFlags src_access,
+                           vk::AccessFlags dst_access,
+                           vk::PipelineStageFlags src_stage,
+                           vk::PipelineStageFlags dst_stage)
+{
+  vk::ImageMemoryBarrier barrier;
+  barrier.setOldLayout(old_layout)
+      .setNewLayout(new_layout)
+      .setSrcAccessMask(src_access)
+      .setDstAccessMask(dst_access)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setImage(image)
+      .setSubresourceRange(vk::ImageSubresourceRange(
+          vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+  cmd_buffer.pipelineBarrier(src_stage, dst_stage,
+                             static_cast<vk::DependencyFlags>(0), nullptr,
+                             nullptr, barrier);
+}
 
-    for (size_t i = 0; i < cmd_buffers_.size(); ++i)
+class VulkanRenderer : public Renderer
+{
+ public:
+  static bool Probe() { return HasGraphicsDevice(); }
+
+  void Initialize() override
+  {
+    const RendererOptions& opts = GetOptions();
+    const size_t frames_in_flight = opts.frames_in_flight_;
+    CHECK(frames_in_flight > 0) << "Need at least one frame in flight";
+    offscreen_ = opts.offscreen_.value_or(false);
+
+    vk_instance_ = CreateInstance(offscreen_);
+    phy_dev_ = SelectPhyiscalDevice(vk_instance_);
+    queue_graphics_family_idx_ = GetGraphicsQueueIdx(phy_dev_);
+    queue_transfer_family_idx_ =
+        GetTransferQueueIdx(phy_dev_, queue_graphics_family_idx_);
+    if (!offscreen_)
+    {
+      vk_surface_ = CreateSurface(vk_instance_);
+      queue_present_family_idx_ = GetPresentQueueIdx(phy_dev_, vk_surface_);
+      CHECK(queue_graphics_family_idx_ == queue_present_family_idx_)
+          << "Different family indices for present and graphics are not "
+             "supported yet.";
+    }
+
+    std::vector<const char*> device_extensions;
+    vk::PhysicalDeviceFeatures features;
+    bool draw_indirect_count = false;
+    bool multi_draw_indirect = false;
+    if (opts.gpu_culling_)
+    {
+      // Draws find their object through their first instance.
+      CHECK(phy_dev_.getFeatures().drawIndirectFirstInstance)
+          << "GPU culling needs drawIndirectFirstInstance";
+      multi_draw_indirect = phy_dev_.getFeatures().multiDrawIndirect;
+      features.setDrawIndirectFirstInstance(true).setMultiDrawIndirect(
+          multi_draw_indirect);
+      draw_indirect_count = HasDeviceExtension(
+          phy_dev_, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+      if (draw_indirect_count)
+      {
+        device_extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+      }
+    }
+    if (!offscreen_)
+    {
+      device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+      // Reports when frames actually hit the display, used for input latency.
+      display_timing_ =
+          opts.latency_tracker_ != nullptr &&
+          HasDeviceExtension(phy_dev_, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+      if (display_timing_)
+      {
+        device_extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+      }
+    }
+    vk_device_ = CreateDevice(
+        phy_dev_, {queue_graphics_family_idx_, queue_transfer_family_idx_},
+        device_extensions, features);
+    if (display_timing_)
     {
-      auto& cmd_buffer = cmd_buffers_[i];
-      VkSuccuessOrDie(cmd_buffer.begin(cmd_buf_begin_info),
-                      "Couldn't start command buffer");
-      cmd_buffer.clearColorImage(vk_images_[i], vk::ImageLayout::eGeneral,
-                                 &color, 1, &image_range);
+      // Not exported by the loader, has to be looked up.
+      get_past_presentation_timing_ =
+          reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>(
+              vk_device_.getProcAddr("vkGetPastPresentationTimingGOOGLE"));
+      display_timing_ = get_past_presentation_timing_ != nullptr;
+    }
+    LOG(INFO) << "Present times from "
+              << (display_timing_ ? "VK_GOOGLE_display_timing" : "the CPU");
+    allocator_ = std::make_unique<DeviceMemoryAllocator>(phy_dev_, vk_device_);
+    gpu_timer_ = std::make_unique<GpuTimer>(
+        phy_dev_, vk_device_, queue_graphics_family_idx_, frames_in_flight);
 
-      VkSuccuessOrDie(cmd_buffer.end(), "Couldn't end command buffer");
+    if (offscreen_)
+    {
+      // One target per frame in flight, so frames never wait on each other.
+      vk_format_ = vk::Format::eR8G8B8A8Unorm;
+      extent_ = vk::Extent2D(opts.width_, opts.height_);
+      vk_images_ =
+          CreateOffscreenImages(vk_device_, allocator_.get(), vk_format_,
+                                extent_, frames_in_flight, &offscreen_memory_);
+    }
+    else
+    {
+      extent_ = vk::Extent2D(opts.width_, opts.height_);
+      vk_swapchain_ = CreateSwapChain(phy_dev_, vk_surface_, vk_device_,
+                                      &vk_format_, &extent_);
+      vk_images_ =
+          VkSuccuessOrDie(vk_device_.getSwapchainImagesKHR(vk_swapchain_),
+                          "Couldn't get images");
+    }
+    images_in_flight_.assign(vk_images_.size(), nullptr);
+
+    vk_image_views_ = CreateImageViews(vk_device_, vk_images_, vk_format_);
+    pipelines_ = std::make_unique<PipelineManager>(
+        phy_dev_, vk_device_, opts.job_system_, opts.pipeline_cache_path_);
+    depth_buffer_ =
+        CreateDepthBuffer(phy_dev_, vk_device_, allocator_.get(), extent_);
+
+    LOG(INFO) << "Frames in flight: " << frames_in_flight
+              << (offscreen_ ? ", rendering offscreen" : "");
+    for (size_t i = 0; i < frames_in_flight; ++i)
+    {
+      frames_.push_back(CreateFrameResources(
+          vk_device_, queue_graphics_family_idx_, GetOptions().job_system_));
     }
 
     vk_queue_ = vk_device_.getQueue(queue_graphics_family_idx_, 0);
+    uploads_ = std::make_unique<UploadManager>(
+        vk_device_, allocator_.get(),
+        vk_device_.getQueue(queue_transfer_family_idx_, 0),
+        queue_transfer_family_idx_, queue_graphics_family_idx_);
+    if (opts.gpu_culling_)
+    {
+      culler_ = std::make_unique<GpuCuller>(
+          phy_dev_, vk_device_, allocator_.get(), frames_in_flight,
+          opts.max_cull_objects_, draw_indirect_count, multi_draw_indirect);
+      CreateCullDrawResources();
+    }
   }
 
-  void Render() override
+  void Render(const RenderPacket& packet) override
   {
+    const size_t frame_slot = frame_idx_;
+    FrameResources& frame = frames_[frame_slot];
+    frame_idx_ = (frame_idx_ + 1) % frames_.size();
+
+    // Wait until the GPU is done with the resources of this frame slot.
+    VkSuccuessOrDie(
+        vk_device_.waitForFences(frame.in_flight_, /*waitAll=*/true,
+                                 std::numeric_limits<uint64_t>::max()),
+        "Couldn't wait for frame fence");
+    UpdateGpuAssets(packet.frame_);
+
+    if (offscreen_)
+    {
+      // Without a display, GPU completion is the closest thing to a present.
+      // It is only observed once the slot is reused, so this is an upper
+      // bound.
+      RecordLatency(LatencyStage::kPresent, frame.input_time_, Clock::now());
+      frame.input_time_ = packet.input_time_;
+      RenderOffscreen(&frame, frame_slot, packet);
+      RecordLatency(LatencyStage::kSubmit, packet.input_time_, Clock::now());
+      return;
+    }
+
     uint32_t next_image_idx =
         VkSuccuessOrDie(vk_device_.acquireNextImageKHR(
                             vk_swapchain_, std::numeric_limits<uint64_t>::max(),
-                            nullptr, nullptr),
+                            frame.image_available_, nullptr),
                         "Couldn't acquire next image");
+
+    // Swapchain might hand out an image that is still used by another frame
+    // in flight, if there are less images than frames in flight.
+    vk::Fence& image_fence = images_in_flight_[next_image_idx];
+    if (image_fence && image_fence != frame.in_flight_)
+    {
+      VkSuccuessOrDie(
+          vk_device_.waitForFences(image_fence, /*waitAll=*/true,
+                                   std::numeric_limits<uint64_t>::max()),
+          "Couldn't wait for image fence");
+    }
+    image_fence = frame.in_flight_;
+
+    const bool has_uploads = uploads_->Flush(frame.uploads_done_);
+    RecordCommandBuffer(&frame, frame_slot, packet, next_image_idx);
+
+    VkSuccuessOrDie(vk_device_.resetFences(frame.in_flight_),
+                    "Couldn't reset frame fence");
+    const std::array<vk::Semaphore, 2> wait_semaphores = {
+        frame.image_available_, frame.uploads_done_};
+    const std::array<vk::PipelineStageFlags, 2> wait_stages = {
+        vk::PipelineStageFlagBits::eTransfer, UploadManager::kDstStages};
     vk::SubmitInfo submit_info;
-    submit_info.setPNext(nullptr).setCommandBufferCount(1).setPCommandBuffers(
-        &cmd_buffers_[next_image_idx]);
-    VkSuccuessOrDie(vk_queue_.submit({submit_info}, nullptr),
+    submit_info.setWaitSemaphoreCount(has_uploads ? 2 : 1)
+        .setPWaitSemaphores(wait_semaphores.data())
+        .setPWaitDstStageMask(wait_stages.data())
+        .setCommandBufferCount(1)
+        .setPCommandBuffers(&frame.cmd_buffer_)
+        .setSignalSemaphoreCount(1)
+        .setPSignalSemaphores(&frame.render_finished_)
+        .setPNext(nullptr);
+    VkSuccuessOrDie(vk_queue_.submit({submit_info}, frame.in_flight_),
                     "Couldn't submit to the queue");
+    RecordLatency(LatencyStage::kSubmit, packet.input_time_, Clock::now());
 
     vk::PresentInfoKHR present_info;
-    present_info.setSwapchainCount(1)
+    present_info.setWaitSemaphoreCount(1)
+        .setPWaitSemaphores(&frame.render_finished_)
+        .setSwapchainCount(1)
         .setPSwapchains(&vk_swapchain_)
         .setPImageIndices(&next_image_idx);
+    const uint32_t present_id = static_cast<uint32_t>(packet.frame_);
+    const vk::PresentTimeGOOGLE present_time(present_id,
+                                             /*desiredPresentTime=*/0);
+    vk::PresentTimesInfoGOOGLE present_times;
+    present_times.setSwapchainCount(1).setPTimes(&present_time);
+    if (display_timing_)
+    {
+      present_info.setPNext(&present_times);
+      pending_presents_[present_id % kMaxPendingPresents] = {
+          present_id, packet.input_time_};
+    }
     VkSuccuessOrDie(vk_queue_.presentKHR(present_info), "Couldn't present");
+
+    if (display_timing_)
+    {
+      CollectPresentTimes();
+    }
+    else
+    {
+      RecordLatency(LatencyStage::kPresent, packet.input_time_, Clock::now());
+    }
+  }
+
+  GpuStats GetGpuStats() const override
+  {
+    return gpu_timer_ != nullptr ? gpu_timer_->GetStats() : GpuStats();
+  }
+
+  void UploadAsset(const assets::AssetHandle& asset) override
+  {
+    std::lock_guard<std::mutex> lock(assets_mu_);
+    queued_assets_.push_back(asset);
   }
 
   ~VulkanRenderer() final
   {
-    vk_device_.freeCommandBuffers(vk_cmd_pool_, cmd_buffers_);
+    // Make sure none of the resources are in use before destroying them.
+    vk_device_.waitIdle();
+
+    for (FrameResources& frame : frames_)
+    {
+      DestroyFrameResources(vk_device_, &frame);
+    }
+    // Persists the pipeline cache.
+    pipelines_.reset();
+    if (culler_ != nullptr)
+    {
+      DestroyCullDrawResources();
+      culler_.reset();
+    }
+    gpu_timer_.reset();
+    for (GpuAsset& gpu_asset : gpu_assets_) DestroyGpuAsset(&gpu_asset);
+    for (GpuAsset& gpu_asset : retired_assets_) DestroyGpuAsset(&gpu_asset);
+    const UploadStats upload_stats = uploads_->GetStats();
+    LOG(INFO) << "Uploaded " << upload_stats.bytes_ << " bytes in "
+              << upload_stats.uploads_ << " uploads, "
+              << upload_stats.regions_ << " copy regions, "
+              << upload_stats.submits_ << " submits, "
+              << upload_stats.ring_stalls_ << " ring stalls";
+    uploads_.reset();
 
     vk_device_.destroyImageView(depth_buffer_.view_);
     vk_device_.destroyImage(depth_buffer_.image_);
-    vk_device_.freeMemory(depth_buffer_.memory_);
+    allocator_->Free(depth_buffer_.memory_);
 
     for (vk::ImageView& img_view : vk_image_views_)
     {
       vk_device_.destroyImageView(img_view);
     }
-    // This also destroys all of the vk_image_ handles
-    vk_device_.destroySwapchainKHR(vk_swapchain_);
+    if (offscreen_)
+    {
+      for (size_t i = 0; i < vk_images_.size(); ++i)
+      {
+        vk_device_.destroyImage(vk_images_[i]);
+        allocator_->Free(offscreen_memory_[i]);
+      }
+    }
+    else
+    {
+      // This also destroys all of the vk_image_ handles
+      vk_device_.destroySwapchainKHR(vk_swapchain_);
+    }
 
-    vk_device_.destroyCommandPool(vk_cmd_pool_);
+    const DeviceMemoryStats mem_stats = allocator_->GetStats();
+    LOG(INFO) << "Device memory reserved: " << mem_stats.reserved_
+              << " used: " << mem_stats.used_
+              << " device allocations: " << mem_stats.num_device_allocations_;
+    allocator_.reset();
 
-    vk_device_.waitIdle();
     vk_device_.destroy();
 
-    vk_instance_.destroy(vk_surface_);
+    if (vk_surface_) vk_instance_.destroy(vk_surface_);
     vk_instance_.destroy();
   }
 
  private:
+  struct PendingPresent
+  {
+    uint32_t present_id_ = 0;
+    Clock::time_point input_time_;
+  };
+
+  // Device local copy of an asset.
+  struct GpuAsset
+  {
+    assets::AssetHandle asset_;
+    vk::Buffer buffer_;
+    MemoryAllocation memory_;
+    // Frame in which the asset stopped being referenced outside the renderer.
+    uint64_t retire_frame_ = 0;
+  };
+
+  // Must be called once the fence of |frame|'s slot has signaled. Starts
+  // uploads of newly queued assets and frees the ones nobody else references
+  // anymore, once no frame in flight can be using them.
+  void UpdateGpuAssets(uint64_t frame)
+  {
+    std::vector<assets::AssetHandle> queued;
+    {
+      std::lock_guard<std::mutex> lock(assets_mu_);
+      queued.swap(queued_assets_);
+    }
+    for (assets::AssetHandle& asset : queued)
+    {
+      if (asset.State() != assets::AssetState::kLoaded) continue;
+      const assets::ByteSpan data = asset.Data();
+      if (data.empty()) continue;
+      vk::BufferCreateInfo buffer_info;
+      buffer_info.setSize(data.size())
+          .setUsage(vk::BufferUsageFlagBits::eVertexBuffer |
+                    vk::BufferUsageFlagBits::eIndexBuffer |
+                    vk::BufferUsageFlagBits::eStorageBuffer |
+                    vk::BufferUsageFlagBits::eTransferDst)
+          .setSharingMode(vk::SharingMode::eExclusive);
+      GpuAsset gpu_asset;
+      gpu_asset.buffer_ = VkSuccuessOrDie(vk_device_.createBuffer(buffer_info),
+                                          "Couldn't create asset buffer");
+      gpu_asset.memory_ = allocator_->AllocateForBuffer(
+          gpu_asset.buffer_, vk::MemoryPropertyFlagBits::eDeviceLocal);
+      uploads_->Upload(gpu_asset.buffer_, /*dst_offset=*/0, data.data(),
+                       data.size());
+      gpu_asset.asset_ = std::move(asset);
+      gpu_assets_.push_back(std::move(gpu_asset));
+    }
+
+    for (size_t i = 0; i < gpu_assets_.size();)
+    {
+      if (gpu_assets_[i].asset_.UseCount() > 1)
+      {
+        ++i;
+        continue;
+      }
+      gpu_assets_[i].asset_ = assets::AssetHandle();
+      gpu_assets_[i].retire_frame_ = frame;
+      retired_assets_.push_back(std::move(gpu_assets_[i]));
+      gpu_assets_[i] = std::move(gpu_assets_.back());
+      gpu_assets_.pop_back();
+    }
+    // Frames up to retire_frame_ are done once the slot of retire_frame_ is
+    // reused.
+    while (!retired_assets_.empty() &&
+           retired_assets_.front().retire_frame_ + frames_.size() <= frame)
+    {
+      DestroyGpuAsset(&retired_assets_.front());
+      retired_assets_.pop_front();
+    }
+  }
+
+  void DestroyGpuAsset(GpuAsset* gpu_asset)
+  {
+    vk_device_.destroyBuffer(gpu_asset->buffer_);
+    allocator_->Free(gpu_asset->memory_);
+  }
+
+  // The cube is uploaded like assets, the first frame waits for it.
+  void CreateCullDrawResources()
+  {
+    CullDrawResources& res = cull_draw_;
+    res.render_pass_ = CreateDrawRenderPass(vk_device_, vk_format_);
+    res.framebuffers_ = CreateFramebuffers(vk_device_, res.render_pass_,
+                                           vk_image_views_, extent_);
+
+    vk::DescriptorSetLayoutBinding binding;
+    binding.setBinding(0)
+        .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+        .setDescriptorCount(1)
+        .setStageFlags(vk::ShaderStageFlagBits::eVertex);
+    vk::DescriptorSetLayoutCreateInfo set_layout_info;
+    set_layout_info.setBindingCount(1).setPBindings(&binding);
+    res.set_layout_ =
+        VkSuccuessOrDie(vk_device_.createDescriptorSetLayout(set_layout_info),
+                        "Couldn't create descriptor set layout");
+    const vk::DescriptorPoolSize pool_size(vk::DescriptorType::eStorageBuffer,
+                                           frames_.size());
+    vk::DescriptorPoolCreateInfo pool_info;
+    pool_info.setMaxSets(frames_.size())
+        .setPoolSizeCount(1)
+        .setPPoolSizes(&pool_size);
+    res.descriptor_pool_ =
+        VkSuccuessOrDie(vk_device_.createDescriptorPool(pool_info),
+                        "Couldn't create descriptor pool");
+    const std::vector<vk::DescriptorSetLayout> set_layouts(frames_.size(),
+                                                           res.set_layout_);
+    vk::DescriptorSetAllocateInfo set_info;
+    set_info.setDescriptorPool(res.descriptor_pool_)
+        .setDescriptorSetCount(set_layouts.size())
+        .setPSetLayouts(set_layouts.data());
+    res.descriptor_sets_ =
+        VkSuccuessOrDie(vk_device_.allocateDescriptorSets(set_info),
+                        "Couldn't allocate descriptor sets");
+    for (size_t slot = 0; slot < frames_.size(); ++slot)
+    {
+      const vk::DescriptorBufferInfo buffer_info(culler_->ObjectBuffer(slot),
+                                                 0, VK_WHOLE_SIZE);
+      vk::WriteDescriptorSet write;
+      write.setDstSet(res.descriptor_sets_[slot])
+          .setDstBinding(0)
+          .setDescriptorCount(1)
+          .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+          .setPBufferInfo(&buffer_info);
+      vk_device_.updateDescriptorSets(write, nullptr);
+    }
+
+    const vk::PushConstantRange push_constants(
+        vk::ShaderStageFlagBits::eVertex, 0, sizeof(Mat4));
+    vk::PipelineLayoutCreateInfo layout_info;
+    layout_info.setSetLayoutCount(1)
+        .setPSetLayouts(&res.set_layout_)
+        .setPushConstantRangeCount(1)
+        .setPPushConstantRanges(&push_constants);
+    res.pipeline_layout_ =
+        VkSuccuessOrDie(vk_device_.createPipelineLayout(layout_info),
+                        "Couldn't create pipeline layout");
+
+    res.vertex_shader_ = CreateCullDrawVertexShader(vk_device_);
+    res.fragment_shader_ = CreateCullDrawFragmentShader(vk_device_);
+    GraphicsPipelineDesc desc;
+    desc.vertex_shader_ = res.vertex_shader_;
+    desc.fragment_shader_ = res.fragment_shader_;
+    desc.layout_ = res.pipeline_layout_;
+    desc.render_pass_ = res.render_pass_;
+    desc.vertex_bindings_ = {vk::VertexInputBindingDescription(
+        0, 3 * sizeof(float), vk::VertexInputRate::eVertex)};
+    desc.vertex_attributes_ = {vk::VertexInputAttributeDescription(
+        0, 0, vk::Format::eR32G32B32Sfloat, 0)};
+    // Cubes are drawn without depth, so their back faces must not show up.
+    desc.cull_mode_ = vk::CullModeFlagBits::eBack;
+    desc.depth_test_ = false;
+    desc.depth_write_ = false;
+    res.pipeline_ = pipelines_->GetOrCreate(desc);
+
+    res.vertex_buffer_ = CreateDeviceBuffer(
+        kCubeVertices.data(), sizeof(kCubeVertices),
+        vk::BufferUsageFlagBits::eVertexBuffer, &res.vertex_memory_);
+    res.index_buffer_ = CreateDeviceBuffer(
+        kCubeIndices.data(), sizeof(kCubeIndices),
+        vk::BufferUsageFlagBits::eIndexBuffer, &res.index_memory_);
+  }
+
+  // Must be called once the pipelines are destroyed, shader modules might be
+  // in use until then.
+  void DestroyCullDrawResources()
+  {
+    CullDrawResources& res = cull_draw_;
+    vk_device_.destroyBuffer(res.vertex_buffer_);
+    allocator_->Free(res.vertex_memory_);
+    vk_device_.destroyBuffer(res.index_buffer_);
+    allocator_->Free(res.index_memory_);
+    vk_device_.destroyShaderModule(res.vertex_shader_);
+    vk_device_.destroyShaderModule(res.fragment_shader_);
+    vk_device_.destroyPipelineLayout(res.pipeline_layout_);
+    // Frees the sets as well.
+    vk_device_.destroyDescriptorPool(res.descriptor_pool_);
+    vk_device_.destroyDescriptorSetLayout(res.set_layout_);
+    for (vk::Framebuffer& framebuffer : res.framebuffers_)
+    {
+      vk_device_.destroyFramebuffer(framebuffer);
+    }
+    vk_device_.destroyRenderPass(res.render_pass_);
+  }
+
+  vk::Buffer CreateDeviceBuffer(const void* data, vk::DeviceSize size,
+                                vk::BufferUsageFlags usage,
+                                MemoryAllocation* memory)
+  {
+    vk::BufferCreateInfo buffer_info;
+    buffer_info.setSize(size)
+        .setUsage(usage | vk::BufferUsageFlagBits::eTransferDst)
+        .setSharingMode(vk::SharingMode::eExclusive);
+    const vk::Buffer buffer = VkSuccuessOrDie(
+        vk_device_.createBuffer(buffer_info), "Couldn't create buffer");
+    *memory = allocator_->AllocateForBuffer(
+        buffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    uploads_->Upload(buffer, /*dst_offset=*/0, data, size);
+    return buffer;
+  }
+
+  // Culls the objects of |packet| and draws the visible ones into the image,
+  // which must have been cleared. It is left as a color attachment. Returns
+  // false without recording anything while the pipeline is being created.
+  bool RecordCulledDraws(const vk::CommandBuffer& cmd_buffer,
+                         size_t frame_slot, const RenderPacket& packet,
+                         size_t image_idx)
+  {
+    const CullDrawResources& res = cull_draw_;
+    if (!res.pipeline_.IsReady()) return false;
+
+    // The GPU is done with the slot, so the objects of its last frame can be
+    // overwritten. Every object is drawn as the cube and is looked up by its
+    // first instance in the vertex shader.
+    const uint32_t num_objects = packet.cull_objects_.size();
+    CHECK_LE(num_objects, GetOptions().max_cull_objects_)
+        << "Too many objects to cull";
+    CullObject* objects = culler_->Objects(frame_slot);
+    for (uint32_t i = 0; i < num_objects; ++i)
+    {
+      objects[i] = packet.cull_objects_[i];
+      objects[i].index_count_ = kCubeIndices.size();
+      objects[i].first_index_ = 0;
+      objects[i].vertex_offset_ = 0;
+      objects[i].first_instance_ = i;
+    }
+    {
+      GpuTimer::Scope cull_scope(gpu_timer_.get(), cmd_buffer, "Cull");
+      culler_->RecordCull(cmd_buffer, frame_slot,
+                          FrustumFromViewProjection(packet.view_proj_),
+                          num_objects);
+    }
+
+    GpuTimer::Scope draw_scope(gpu_timer_.get(), cmd_buffer, "Draw");
+    const vk::Rect2D area(vk::Offset2D(0, 0), extent_);
+    vk::RenderPassBeginInfo pass_info;
+    pass_info.setRenderPass(res.render_pass_)
+        .setFramebuffer(res.framebuffers_[image_idx])
+        .setRenderArea(area);
+    cmd_buffer.beginRenderPass(pass_info, vk::SubpassContents::eInline);
+    cmd_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                            res.pipeline_.Get());
+    cmd_buffer.setViewport(
+        0, vk::Viewport(0, 0, extent_.width, extent_.height, 0, 1));
+    cmd_buffer.setScissor(0, area);
+    cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                  res.pipeline_layout_, 0,
+                                  res.descriptor_sets_[frame_slot], nullptr);
+    cmd_buffer.pushConstants(res.pipeline_layout_,
+                             vk::ShaderStageFlagBits::eVertex, 0,
+                             sizeof(packet.view_proj_),
+                             packet.view_proj_.data());
+    cmd_buffer.bindVertexBuffers(0, res.vertex_buffer_, vk::DeviceSize{0});
+    cmd_buffer.bindIndexBuffer(res.index_buffer_, 0, vk::IndexType::eUint16);
+    const size_t draw_calls = culler_->RecordDraws(cmd_buffer, frame_slot);
+    cmd_buffer.endRenderPass();
+    VLOG(2) << "Frame " << packet.frame_ << ": culled " << num_objects
+            << " objects, " << draw_calls << " draw calls";
+    return true;
+  }
+
+  void RecordLatency(LatencyStage stage, Clock::time_point input_time,
+                     Clock::time_point stage_time)
+  {
+    LatencyTracker* tracker = GetOptions().latency_tracker_;
+    if (tracker != nullptr) tracker->Record(stage, input_time, stage_time);
+  }
+
+  // Display times are reported asynchronously, a few frames after present.
+  void CollectPresentTimes()
+  {
+    std::array<VkPastPresentationTimingGOOGLE, kMaxPendingPresents> timings;
+    uint32_t count = timings.size();
+    const VkResult result = get_past_presentation_timing_(
+        static_cast<VkDevice>(vk_device_),
+        static_cast<VkSwapchainKHR>(vk_swapchain_), &count, timings.data());
+    if (result != VK_SUCCESS && result != VK_INCOMPLETE)
+    {
+      LOG(WARNING) << "Couldn't get past presentation timings: " << result;
+      return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      PendingPresent& pending =
+          pending_presents_[timings[i].presentID % kMaxPendingPresents];
+      if (pending.present_id_ != timings[i].presentID) continue;
+      // Reported in the CLOCK_MONOTONIC domain, same as steady_clock.
+      RecordLatency(LatencyStage::kPresent, pending.input_time_,
+                    Clock::time_point(std::chrono::nanoseconds(
+                        timings[i].actualPresentTime)));
+      pending.input_time_ = Clock::time_point();
+    }
+  }
+
+  // Offscreen targets are owned by the frame slots, hence there is nothing to
+  // acquire and the submission doesn't need to be ordered against a present.
+  void RenderOffscreen(FrameResources* frame, size_t frame_slot,
+                       const RenderPacket& packet)
+  {
+    const bool has_uploads = uploads_->Flush(frame->uploads_done_);
+    RecordCommandBuffer(frame, frame_slot, packet, /*image_idx=*/frame_slot);
+
+    VkSuccuessOrDie(vk_device_.resetFences(frame->in_flight_),
+                    "Couldn't reset frame fence");
+    const vk::PipelineStageFlags wait_stage = UploadManager::kDstStages;
+    vk::SubmitInfo submit_info;
+    if (has_uploads)
+    {
+      submit_info.setWaitSemaphoreCount(1)
+          .setPWaitSemaphores(&frame->uploads_done_)
+          .setPWaitDstStageMask(&wait_stage);
+    }
+    submit_info.setCommandBufferCount(1)
+        .setPCommandBuffers(&frame->cmd_buffer_)
+        .setPNext(nullptr);
+    VkSuccuessOrDie(vk_queue_.submit({submit_info}, frame->in_flight_),
+                    "Couldn't submit to the queue");
+  }
+
+  // Re-records the per frame command buffers, resetting whole pools is
+  // cheaper than resetting individual command buffers.
+  void RecordCommandBuffer(FrameResources* frame, size_t frame_slot,
+                           const RenderPacket& packet, size_t image_idx)
+  {
+    VkSuccuessOrDie(vk_device_.resetCommandPool(
+                        frame->cmd_pool_,
+                        static_cast<vk::CommandPoolResetFlags>(0)),
+                    "Couldn't reset command pool");
+    frame->recorder_->Reset();
+    frame->secondaries_.clear();
+
+    const vk::Image& image = vk_images_[image_idx];
+    // Clearing the image and the GPU culled objects are the only work recorded
+    // per frame, draws of the packet are skipped as meshes and materials have
+    // no GPU resources to bind.
+    const vk::CommandBufferInheritanceInfo inheritance;
+    frame->recorder_->Record(
+        /*count=*/1, inheritance,
+        [&image](const vk::CommandBuffer& cmd_buffer, size_t /*begin*/,
+                 size_t /*end*/) {
+          vk::ClearColorValue color;
+          color.setFloat32({.0, .0, 1., .0});
+          vk::ImageSubresourceRange image_range;
+          image_range.setAspectMask(vk::ImageAspectFlagBits::eColor)
+              .setLevelCount(1)
+              .setLayerCount(1);
+          cmd_buffer.clearColorImage(image,
+                                     vk::ImageLayout::eTransferDstOptimal,
+                                     &color, 1, &image_range);
+        },
+        &frame->secondaries_);
+
+    vk::CommandBufferBeginInfo cmd_buf_begin_info;
+    cmd_buf_begin_info.setFlags(
+        vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    const vk::CommandBuffer& cmd_buffer = frame->cmd_buffer_;
+    VkSuccuessOrDie(cmd_buffer.begin(cmd_buf_begin_info),
+                    "Couldn't start command buffer");
+    gpu_timer_->BeginFrame(frame_slot, packet.frame_, cmd_buffer);
+    uploads_->RecordAcquire(cmd_buffer);
+
+    {
+      GpuTimer::Scope frame_scope(gpu_timer_.get(), cmd_buffer, "Frame");
+      TransitionImageLayout(cmd_buffer, image, vk::ImageLayout::eUndefined,
+                            vk::ImageLayout::eTransferDstOptimal, {},
+                            vk::AccessFlagBits::eTransferWrite,
+                            vk::PipelineStageFlagBits::eTransfer,
+                            vk::PipelineStageFlagBits::eTransfer);
+
+      {
+        GpuTimer::Scope clear_scope(gpu_timer_.get(), cmd_buffer, "Clear");
+        cmd_buffer.executeCommands(frame->secondaries_);
+      }
+      const bool drawn =
+          culler_ != nullptr &&
+          RecordCulledDraws(cmd_buffer, frame_slot, packet, image_idx);
+
+      // Offscreen targets are left ready to be copied out.
+      TransitionImageLayout(
+          cmd_buffer, image,
+          drawn ? vk::ImageLayout::eColorAttachmentOptimal
+                : vk::ImageLayout::eTransferDstOptimal,
+          offscreen_ ? vk::ImageLayout::eTransferSrcOptimal
+                     : vk::ImageLayout::ePresentSrcKHR,
+          drawn ? vk::AccessFlags(vk::AccessFlagBits::eColorAttachmentWrite)
+                : vk::AccessFlags(vk::AccessFlagBits::eTransferWrite),
+          {},
+          drawn ? vk::PipelineStageFlags(
+                      vk::PipelineStageFlagBits::eColorAttachmentOutput)
+                : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTransfer),
+          vk::PipelineStageFlagBits::eBottomOfPipe);
+    }
+
+    VkSuccuessOrDie(cmd_buffer.end(), "Couldn't end command buffer");
+  }
+
   vk::Queue vk_queue_;
-  std::vector<vk::CommandBuffer> cmd_buffers_;
+  std::vector<FrameResources> frames_;
+  size_t frame_idx_ = 0;
+  // Fence of the frame that last rendered into each swapchain image.
+  std::vector<vk::Fence> images_in_flight_;
   DepthBuffer depth_buffer_;
+  std::unique_ptr<DeviceMemoryAllocator> allocator_;
+  std::unique_ptr<PipelineManager> pipelines_;
+  std::unique_ptr<GpuTimer> gpu_timer_;
+  std::unique_ptr<UploadManager> uploads_;
+  // Only created with RendererOptions::gpu_culling_.
+  std::unique_ptr<GpuCuller> culler_;
+  CullDrawResources cull_draw_;
+  std::mutex assets_mu_;
+  // Handed over through UploadAsset, guarded by assets_mu_.
+  std::vector<assets::AssetHandle> queued_assets_;
+  std::vector<GpuAsset> gpu_assets_;
+  // Ordered by retire_frame_.
+  std::deque<GpuAsset> retired_assets_;
   std::vector<vk::ImageView> vk_image_views_;
   std::vector<vk::Image> vk_images_;
+  // Backing memory of vk_images_ when rendering offscreen.
+  std::vector<MemoryAllocation> offscreen_memory_;
+  bool offscreen_ = false;
+  // Whether VK_GOOGLE_display_timing is used for present times.
+  bool display_timing_ = false;
+  PFN_vkGetPastPresentationTimingGOOGLE get_past_presentation_timing_ =
+      nullptr;
+  std::array<PendingPresent, kMaxPendingPresents> pending_presents_;
+  vk::Extent2D extent_;
   vk::Format vk_format_;
   vk::SwapchainKHR vk_swapchain_;
-  vk::CommandPool vk_cmd_pool_;
   vk::Device vk_device_;
   size_t queue_present_family_idx_;
   size_t queue_graphics_family_idx_;
+  size_t queue_transfer_family_idx_;
   vk::PhysicalDevice phy_dev_;
   vk::SurfaceKHR vk_surface_;
   vk::Instance vk_instance_;
 };
 
-RenderPlugin::Set<VulkanRenderer> x;
+RenderPlugin::Add<VulkanRenderer> x("vulkan", /*priority=*/100);
 }  // namespace
 }  // namespace motor
@@ -0,0 +1,24 @@
+#ifndef _MOTOR_RENDER_VULKAN_UTILS_H_
+#define _MOTOR_RENDER_VULKAN_UTILS_H_
+
+#include "glog/logging.h"
+#include "vulkan/vulkan.hpp"
+
+namespace motor
+{
+template <typename T>
+T VkSuccuessOrDie(vk::ResultValue<T> res_and_val, const char* desc)
+{
+  CHECK(res_and_val.result == vk::Result::eSuccess)
+      << "VK error: " << desc << '-' << static_cast<int>(res_and_val.result);
+  return res_and_val.value;
+}
+inline void VkSuccuessOrDie(vk::Result res, const char* desc)
+{
+  CHECK(res == vk::Result::eSuccess)
+      << "VK error: " << desc << '-' << static_cast<int>(res);
+}
+
+}  // namespace motor
+
+#endif
@@ -1,7 +1,26 @@
 #include "window.h"
 
+#include <memory>
+#include <utility>
+
+#include "event_queue.h"
+
 namespace motor
 {
-void Window::SetOptions(WindowOptions opts) { opts_ = std::move(opts); }
+void Window::SetOptions(WindowOptions opts)
+{
+  opts_ = std::move(opts);
+  queue_.reset();
+  if (opts_.event_queue_capacity_ != 0)
+  {
+    queue_ = std::make_unique<EventQueue>(opts_.event_queue_capacity_);
+  }
+}
+
+size_t Window::DispatchQueuedEvents()
+{
+  if (queue_ == nullptr) return 0;
+  return queue_->Drain(dispatcher_);
+}
 
 }  // namespace motor
@@ -6,14 +6,23 @@
 #include <memory>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #include "event.h"
+#include "event_queue.h"
+#include "motor/input/device.h"
+#include "motor/input/input.h"
 #include "plugin.h"
 
 namespace motor
 {
 struct WindowOptions
 {
+  // Name of the window plugin to use, e.g. "glfw", "headless" or "replay". The
+  // highest priority plugin that can run is used when empty. --window_backend
+  // takes precedence when set.
+  std::string backend_;
+
   std::string title_;
 
   // Denotes number of pixels in frame buffer.
@@ -21,6 +30,23 @@ struct WindowOptions
   size_t height_ = 0;
 
   bool is_full_screen_ = false;
+
+  // When non-zero, events emitted by the window are queued rather than
+  // dispatched from within the window callbacks, and delivered once per frame
+  // by DispatchQueuedEvents.
+  size_t event_queue_capacity_ = 0;
+
+  // When non-empty, the input event stream is recorded into this file.
+  std::string input_record_path_;
+  // Log played back by the replay window. Frames are replayed as fast as
+  // possible unless input_replay_real_time_ is set, in which case they are
+  // paced to the timestamps they were recorded with.
+  std::string input_replay_path_;
+  bool input_replay_real_time_ = false;
+
+  // When non-zero, gamepads are sampled at this rate on a dedicated thread
+  // rather than once per frame, presses shorter than a frame are kept.
+  size_t input_poll_rate_hz_ = 0;
 };
 
 class Window
@@ -28,27 +54,76 @@ class Window
  public:
   virtual ~Window() = default;
 
+  // Implementations that can't run everywhere, e.g. need a display, should
+  // hide this with a cheap check.
+  static bool Probe() { return true; }
+
   template <typename T>
   void RegisterEventHandler(Event::Handler<T> handler)
   {
-    dispatcher_.Set<T>(std::move(handler));
+    dispatcher_.Subscribe<T>(std::move(handler));
   }
 
   void SetOptions(WindowOptions opts);
   virtual void CreateWindow() = 0;
+  // Whether renderers can create a surface to present into this window,
+  // otherwise they must render offscreen.
+  virtual bool CanCreateSurface() const { return false; }
 
   virtual void Update() = 0;
 
+  // Delivers events queued since the last call and returns their count. No-op
+  // unless queueing was enabled through WindowOptions.
+  size_t DispatchQueuedEvents();
+  // Returns nullptr if events are dispatched synchronously.
+  const EventQueue* GetEventQueue() const { return queue_.get(); }
+
+  // State of all input devices as of the last Update.
+  const input::InputState& GetInputState() const { return input_state_; }
+  // Devices announced as connected through DeviceConfigChange.
+  const input::DeviceSet& GetConnectedDevices() const { return devices_; }
+
  protected:
   const EventDispatcher& GetDispatcher() const { return dispatcher_; }
   const WindowOptions& GetOptions() const { return opts_; }
+  input::InputState* MutableInputState() { return &input_state_; }
+
+  // Implementations must announce devices through this, so that they're
+  // tracked in GetConnectedDevices.
+  void EmitDeviceChange(const input::DeviceConfigChange& change)
+  {
+    devices_.Apply(change);
+    Emit(change);
+  }
+
+  // Implementations should call this at the end of Update, once the input
+  // state is up to date.
+  void BroadcastInputState() const
+  {
+    input::InputStateBroadcast broadcast;
+    broadcast.state_ = &input_state_;
+    Emit(broadcast);
+  }
+
+  // Queues the event if queueing is enabled, dispatches it immediately
+  // otherwise. Events that don't fit into a full queue are dispatched
+  // immediately as well, they are accounted in EventQueueStats::overflows_.
+  template <typename T>
+  void Emit(T&& event) const
+  {
+    if (queue_ != nullptr && queue_->Push(std::forward<T>(event))) return;
+    dispatcher_.Dispatch(event);
+  }
 
  private:
   EventDispatcher dispatcher_;
   WindowOptions opts_;
+  std::unique_ptr<EventQueue> queue_;
+  input::InputState input_state_;
+  input::DeviceSet devices_;
 };
 
-using WindowPlugin = SinglePluginRegistry<Window>;
+using WindowPlugin = PluginRegistry<Window>;
 
 }  // namespace motor
 #endif
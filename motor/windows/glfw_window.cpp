@@ -1,5 +1,11 @@
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "GLFW/glfw3.h"
@@ -7,6 +13,7 @@
 #include "motor/event.h"
 #include "motor/input/device.h"
 #include "motor/input/input.h"
+#include "motor/input/input_poller.h"
 #include "motor/window.h"
 
 namespace motor
@@ -22,38 +29,64 @@ void GlfwErrorHandler(int /*err_code*/, const char* err_desc)
   LOG(FATAL) << "Couldn't initialize GLFWwindow: " << err_desc;
 }
 
-void AppendGamepadStates(input::InputStateBroadcast* broadcast)
+static_assert(GLFW_KEY_LAST < input::kNumKeys);
+static_assert(GLFW_GAMEPAD_AXIS_LAST < input::kNumAxes);
+static_assert(kFirstJoystickId + GLFW_JOYSTICK_LAST < input::kMaxDevices);
+
+static_assert(GLFW_GAMEPAD_BUTTON_LAST < 32);
+
+// Returns false if the device isn't a gamepad.
+bool SampleGamepad(size_t device_id, input::GamepadSample* sample)
 {
   GLFWgamepadstate gamepad_state;
-  for (size_t joystick_id = GLFW_JOYSTICK_1; joystick_id <= GLFW_JOYSTICK_LAST;
-       ++joystick_id)
+  // TODO(kadircet): Support joysticks without a gamepad mapping.
+  if (!glfwGetGamepadState(device_id - kFirstJoystickId, &gamepad_state))
   {
-    // TODO(kadircet): Support joysticks without a gamepad mapping.
-    if (!glfwGetGamepadState(joystick_id, &gamepad_state)) continue;
-
-    for (int key_id = GLFW_GAMEPAD_BUTTON_A; key_id <= GLFW_GAMEPAD_BUTTON_LAST;
-         ++key_id)
-    {
-      input::KeyInput& key_inp = broadcast->keys_.emplace_back();
-      key_inp.device_id_ = joystick_id;
-      key_inp.id_ = key_id;
-      key_inp.is_down_ = gamepad_state.buttons[key_id] == GLFW_PRESS;
-    }
+    return false;
+  }
 
-    for (int axis_id = GLFW_GAMEPAD_AXIS_LEFT_X;
-         axis_id <= GLFW_GAMEPAD_AXIS_LAST; ++axis_id)
+  sample->device_id_ = device_id;
+  sample->buttons_ = 0;
+  for (int key_id = GLFW_GAMEPAD_BUTTON_A; key_id <= GLFW_GAMEPAD_BUTTON_LAST;
+       ++key_id)
+  {
+    if (gamepad_state.buttons[key_id] == GLFW_PRESS)
     {
-      input::AxisInput& axis_inp = broadcast->axes_.emplace_back();
-      axis_inp.device_id_ = joystick_id;
-      axis_inp.id_ = axis_id;
-      axis_inp.value_ = gamepad_state.axes[axis_id];
+      sample->buttons_ |= uint32_t{1} << key_id;
     }
   }
+  for (int axis_id = GLFW_GAMEPAD_AXIS_LEFT_X;
+       axis_id <= GLFW_GAMEPAD_AXIS_LAST; ++axis_id)
+  {
+    sample->axes_[axis_id] = gamepad_state.axes[axis_id];
+  }
+  return true;
+}
+
+// Calls |fn| for the connected joysticks, without probing all the slots.
+template <typename Fn>
+void ForEachJoystick(const input::DeviceSet& devices, Fn&& fn)
+{
+  devices.ForEach([&fn](size_t device_id) {
+    if (device_id >= kFirstJoystickId) fn(device_id);
+  });
 }
 
 class GLFWWindow : public Window
 {
  public:
+  // glfwInit is too expensive for a probe, it connects to the display server.
+  // Only X11 is built on Linux, so checking for a display is enough.
+  static bool Probe()
+  {
+#if defined(__linux__)
+    const char* display = std::getenv("DISPLAY");
+    return display != nullptr && display[0] != '\0';
+#else
+    return true;
+#endif
+  }
+
   GLFWWindow()
   {
     glfwSetErrorCallback(GlfwErrorHandler);
@@ -80,18 +113,69 @@ class GLFWWindow : public Window
     // TODO(kadircet): This is to enable surface creation in vulkan_renderer,
     // get rid of this hack at some point...
     glfwSetMonitorUserPointer(glfwGetPrimaryMonitor(), handle_);
+
+#if defined(__APPLE__)
+    // Gamepads are delivered through the main run loop, so they can't be read
+    // from another thread.
+    LOG_IF(WARNING, opts.input_poll_rate_hz_ != 0)
+        << "Polling gamepads on a thread is unsupported on macOS, sampling "
+           "them once per frame";
+#else
+    if (opts.input_poll_rate_hz_ != 0)
+    {
+      LOG(INFO) << "Polling gamepads at " << opts.input_poll_rate_hz_ << "Hz";
+      poller_ = std::make_unique<input::InputPoller>(
+          std::chrono::nanoseconds(1'000'000'000 / opts.input_poll_rate_hz_),
+          [this](std::chrono::steady_clock::time_point now) {
+            PollGamepads(now);
+          });
+    }
+#endif
   }
 
+  bool CanCreateSurface() const override { return true; }
+
   ~GLFWWindow() final
   {
+    poller_.reset();
+    LOG_IF(WARNING, samples_.Dropped() != 0)
+        << samples_.Dropped() << " gamepad samples dropped";
     glfwDestroyWindow(handle_);
     glfwTerminate();
   }
 
   void Update() override
   {
-    key_inputs_.clear();
-    glfwPollEvents();
+    input::InputState* state = MutableInputState();
+    state->BeginFrame();
+    if (poller_ != nullptr)
+    {
+      {
+        std::lock_guard<std::mutex> lock(glfw_mu_);
+        // Key and mouse button callbacks write into the state while polling.
+        glfwPollEvents();
+      }
+      const size_t num_samples = samples_.Drain(
+          [state](const input::GamepadSample& sample) {
+            input::ApplySample(sample, state);
+          });
+      VLOG(3) << "Applied " << num_samples << " gamepad samples";
+      // Samples of a disconnected gamepad predate the disconnect, they must
+      // not bring back the keys it releases.
+      ApplyJoystickChanges();
+    }
+    else
+    {
+      glfwPollEvents();
+      ApplyJoystickChanges();
+      input::GamepadSample sample;
+      ForEachJoystick(GetConnectedDevices(), [&sample, state](size_t id) {
+        if (SampleGamepad(id, &sample)) input::ApplySample(sample, state);
+      });
+    }
+    input::CursorPosition cursor;
+    glfwGetCursorPos(handle_, &cursor.x_, &cursor.y_);
+    state->SetCursor(cursor);
     BroadcastInputState();
   }
 
@@ -99,7 +183,85 @@ class GLFWWindow : public Window
   // Unfortunately we can't use a unique_ptr here, because glfw headers only
   // forward declares GLFWwindow.
   GLFWwindow* handle_;
-  std::vector<input::KeyInput> key_inputs_;
+
+  // Joystick connection changes reported by the callback, which can run on
+  // either thread, e.g. GLFW reports a joystick as disconnected when reading
+  // its state fails while polling. They are only queued there and emitted by
+  // Update, so the device set and event handlers stay on the main thread.
+  std::mutex joystick_mu_;
+  std::vector<input::DeviceConfigChange> joystick_changes_;
+  // Swapped with joystick_changes_, to reuse both allocations.
+  std::vector<input::DeviceConfigChange> applied_joystick_changes_;
+
+  // Everything below is only used when polling on a dedicated thread, which
+  // isn't supported on macOS. GLFW expects joystick functions to be called
+  // from the main thread, but on Linux and Windows it doesn't touch joystick
+  // state outside of these calls, so serializing all the calls is enough.
+  std::mutex glfw_mu_;
+  // Copy of GetConnectedDevices for the polling thread.
+  std::atomic<input::DeviceSet> poll_devices_{input::DeviceSet()};
+  // Last pushed sample per device and the devices that were polled, only
+  // accessed by the polling thread.
+  std::array<input::GamepadSample, input::kMaxDevices> last_samples_;
+  input::DeviceSet polled_devices_;
+  input::GamepadSampleRing samples_;
+  // Declared last so that it stops before the rest is destroyed.
+  std::unique_ptr<input::InputPoller> poller_;
+
+  // Runs on the polling thread. Only pushes samples that differ from the
+  // previous one of the same device, so idle gamepads don't fill the ring.
+  void PollGamepads(std::chrono::steady_clock::time_point now)
+  {
+    const input::DeviceSet devices =
+        poll_devices_.load(std::memory_order_acquire);
+    // A reconnected gamepad starts from a reset state, its first sample has to
+    // be pushed even if it matches the one before the disconnect.
+    polled_devices_.ForEach([this, &devices](size_t device_id) {
+      if (!devices.IsConnected(device_id))
+      {
+        last_samples_[device_id] = input::GamepadSample();
+      }
+    });
+    polled_devices_ = devices;
+    std::lock_guard<std::mutex> lock(glfw_mu_);
+    ForEachJoystick(devices, [this, now](size_t device_id) {
+      input::GamepadSample sample;
+      if (!SampleGamepad(device_id, &sample)) return;
+      input::GamepadSample& last = last_samples_[device_id];
+      if (sample.buttons_ == last.buttons_ && sample.axes_ == last.axes_)
+      {
+        return;
+      }
+      sample.timestamp_ = now;
+      last = sample;
+      samples_.Push(sample);
+    });
+  }
+
+  void EmitJoystickChange(const input::DeviceConfigChange& change)
+  {
+    EmitDeviceChange(change);
+    poll_devices_.store(GetConnectedDevices(), std::memory_order_release);
+  }
+
+  // Emits the queued joystick changes and resets the state of disconnected
+  // gamepads. Runs after the samples of the frame are applied.
+  void ApplyJoystickChanges()
+  {
+    {
+      std::lock_guard<std::mutex> lock(joystick_mu_);
+      joystick_changes_.swap(applied_joystick_changes_);
+    }
+    for (const input::DeviceConfigChange& change : applied_joystick_changes_)
+    {
+      if (change.status_ == input::DeviceConfigChange::DISCONNECTED)
+      {
+        MutableInputState()->ResetDevice(change.device_id_);
+      }
+      EmitJoystickChange(change);
+    }
+    applied_joystick_changes_.clear();
+  }
 
   void InitializeInputs()
   {
@@ -110,38 +272,28 @@ class GLFWWindow : public Window
     for (size_t device_type : {kKeyboardId, kMouseId})
     {
       config_event.device_id_ = device_type;
-      GetDispatcher().Dispatch(config_event);
+      EmitDeviceChange(config_event);
     }
     glfwSetKeyCallback(handle_, KeyCallback);
     glfwSetMouseButtonCallback(handle_, MouseButtonCallback);
 
     // Check for connected joysticks, since we won't receive a callback if it is
     // already registered.
-    for (size_t i = GLFW_JOYSTICK_1; i < GLFW_JOYSTICK_LAST; ++i)
+    for (size_t i = GLFW_JOYSTICK_1; i <= GLFW_JOYSTICK_LAST; ++i)
     {
       if (!glfwJoystickPresent(i)) continue;
       config_event.device_id_ = kFirstJoystickId + i;
-      GetDispatcher().Dispatch(config_event);
+      EmitJoystickChange(config_event);
     }
     glfwSetJoystickCallback(JoystickCallback);
   }
 
-  void BroadcastInputState()
-  {
-    input::InputStateBroadcast broadcast;
-    broadcast.keys_ = std::move(key_inputs_);
-    AppendGamepadStates(&broadcast);
-    glfwGetCursorPos(handle_, &broadcast.cursor_.x_, &broadcast.cursor_.y_);
-
-    GetDispatcher().Dispatch(broadcast);
-  }
-
   static void CloseCallback(GLFWwindow* window)
   {
     LOG(INFO) << "Received close callback";
     auto* glfw_window =
         static_cast<GLFWWindow*>(glfwGetWindowUserPointer(window));
-    glfw_window->GetDispatcher().Dispatch(WindowClose());
+    glfw_window->Emit(WindowClose());
   }
 
   static void KeyCallback(GLFWwindow* window, int key, int scancode, int action,
@@ -154,8 +306,10 @@ class GLFWWindow : public Window
 
     auto* glfw_window =
         static_cast<GLFWWindow*>(glfwGetWindowUserPointer(window));
-    glfw_window->key_inputs_.push_back(
-        {kKeyboardId, key, action == GLFW_PRESS});
+    input::InputState* state = glfw_window->MutableInputState();
+    // GLFW doesn't expose OS event times, this is when the event got pumped.
+    state->MarkInput(std::chrono::steady_clock::now());
+    state->SetKey(kKeyboardId, key, action == GLFW_PRESS);
   }
 
   static void MouseButtonCallback(GLFWwindow* window, int button, int action,
@@ -166,8 +320,9 @@ class GLFWWindow : public Window
 
     auto* glfw_window =
         static_cast<GLFWWindow*>(glfwGetWindowUserPointer(window));
-    glfw_window->key_inputs_.push_back(
-        {kMouseId, button, action == GLFW_PRESS});
+    input::InputState* state = glfw_window->MutableInputState();
+    state->MarkInput(std::chrono::steady_clock::now());
+    state->SetKey(kMouseId, button, action == GLFW_PRESS);
   }
 
   static void JoystickCallback(int joystic_id, int event)
@@ -182,13 +337,16 @@ class GLFWWindow : public Window
                                ? input::DeviceConfigChange::CONNECTED
                                : input::DeviceConfigChange::DISCONNECTED;
     config_event.device_id_ = kFirstJoystickId + joystic_id;
-    glfw_window->GetDispatcher().Dispatch(config_event);
+    // Runs within glfwPollEvents or, when reading a joystick fails, within
+    // PollGamepads on the polling thread. Either way glfw_mu_ is already held
+    // if polling.
+    std::lock_guard<std::mutex> lock(glfw_window->joystick_mu_);
+    glfw_window->joystick_changes_.push_back(config_event);
   }
 };
 
 }  // namespace
 
-// Sets GLFWWindow as the window manager when linked in.
-static WindowPlugin::Set<GLFWWindow> x;
+static WindowPlugin::Add<GLFWWindow> x("glfw", /*priority=*/100);
 
 }  // namespace motor
@@ -0,0 +1,46 @@
+#include <cstddef>
+
+#include "glog/logging.h"
+#include "motor/input/device.h"
+#include "motor/input/input.h"
+#include "motor/window.h"
+
+namespace motor
+{
+namespace
+{
+constexpr const size_t kKeyboardId = 0;
+
+// A window without a display connection, for running the engine on machines
+// without one, e.g. benchmarks and CI. There is no surface to present to, the
+// engine runs the renderer offscreen. It never closes on its own, loop should
+// be bounded through LoopOptions::max_frames_.
+class HeadlessWindow : public Window
+{
+ public:
+  void CreateWindow() override
+  {
+    const WindowOptions& opts = GetOptions();
+    LOG(INFO) << "Created headless window " << opts.width_ << 'x'
+              << opts.height_;
+
+    input::DeviceConfigChange config_event;
+    config_event.status_ = input::DeviceConfigChange::CONNECTED;
+    config_event.device_id_ = kKeyboardId;
+    EmitDeviceChange(config_event);
+  }
+
+  void Update() override
+  {
+    // There are no inputs, but consumers still expect a state every frame.
+    MutableInputState()->BeginFrame();
+    BroadcastInputState();
+  }
+};
+
+}  // namespace
+
+// Fallback for when there's no display.
+static WindowPlugin::Add<HeadlessWindow> x("headless", /*priority=*/0);
+
+}  // namespace motor
@@ -0,0 +1,102 @@
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "glog/logging.h"
+#include "motor/event.h"
+#include "motor/input/device.h"
+#include "motor/input/input.h"
+#include "motor/input/input_log.h"
+#include "motor/window.h"
+
+namespace motor
+{
+namespace
+{
+// Plays back an input log recorded through WindowOptions::input_record_path_,
+// one recorded frame per Update. Closes itself at the end of the log. Like the
+// headless window there is no surface, the renderer runs offscreen.
+class ReplayWindow : public Window
+{
+ public:
+  void CreateWindow() override
+  {
+    const WindowOptions& opts = GetOptions();
+    CHECK(!opts.input_replay_path_.empty()) << "No input log to replay";
+    reader_ = std::make_unique<input::InputLogReader>(opts.input_replay_path_);
+    LOG(INFO) << "Replaying input from " << opts.input_replay_path_;
+    start_ = std::chrono::steady_clock::now();
+    // Devices connected at the start of the recording come before the first
+    // frame.
+    ReadUntilFrame();
+  }
+
+  void Update() override
+  {
+    if (done_) return;
+    input::InputState* state = MutableInputState();
+    state->BeginFrame();
+    if (has_frame_)
+    {
+      state->ReplaceCurrent(next_frame_);
+      if (GetOptions().input_replay_real_time_)
+      {
+        std::this_thread::sleep_until(start_ + next_timestamp_);
+      }
+      BroadcastInputState();
+      // Edges only last for a single frame.
+      for (input::DeviceInputState& device : next_frame_.devices_)
+      {
+        device.pressed_ = input::KeyBits();
+        device.released_ = input::KeyBits();
+      }
+    }
+    ReadUntilFrame();
+    if (!has_frame_)
+    {
+      LOG(INFO) << "Reached the end of input log";
+      done_ = true;
+      Emit(WindowClose());
+    }
+  }
+
+ private:
+  // Emits device config changes until the next frame is decoded into
+  // next_frame_.
+  void ReadUntilFrame()
+  {
+    input::DeviceConfigChange change;
+    while (true)
+    {
+      switch (reader_->Next(&change, &next_frame_, &next_timestamp_))
+      {
+        case input::InputLogReader::Record::kDeviceConfigChange:
+          EmitDeviceChange(change);
+          break;
+        case input::InputLogReader::Record::kFrame:
+          has_frame_ = true;
+          return;
+        case input::InputLogReader::Record::kEnd:
+          has_frame_ = false;
+          return;
+      }
+    }
+  }
+
+  std::unique_ptr<input::InputLogReader> reader_;
+  // Decoded one frame ahead, so that the end of the log is known before it is
+  // reached.
+  input::InputFrame next_frame_;
+  std::chrono::microseconds next_timestamp_{0};
+  std::chrono::steady_clock::time_point start_;
+  bool has_frame_ = false;
+  bool done_ = false;
+};
+
+}  // namespace
+
+// Needs a log to replay, hence never preferred over the headless window unless
+// requested by name.
+static WindowPlugin::Add<ReplayWindow> x("replay", /*priority=*/-100);
+
+}  // namespace motor
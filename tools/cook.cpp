@@ -0,0 +1,102 @@
+// Packs every file under a directory into an archive, entries are named by
+// their path relative to the directory, e.g. "meshes/tree.bin".
+//   bazel run //tools:cook -- [--nocompress] input_dir output.pak
+// Archives are loaded by the engine through --asset_archives.
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "motor/assets/archive_writer.h"
+
+DEFINE_bool(compress, true,
+            "Compress entries with LZ4 where it saves enough. Uncompressed "
+            "entries are handed out without copying.");
+
+namespace motor::tools
+{
+namespace
+{
+// Adds files under |dir|/|prefix| recursively, returns false if a directory
+// can't be listed.
+bool AddDirectory(const std::string& dir, const std::string& prefix,
+                  assets::ArchiveWriter* writer)
+{
+  const std::string path = prefix.empty() ? dir : dir + '/' + prefix;
+  DIR* d = opendir(path.c_str());
+  if (d == nullptr)
+  {
+    PLOG(ERROR) << "Couldn't list " << path;
+    return false;
+  }
+  bool ok = true;
+  while (const dirent* entry = readdir(d))
+  {
+    const std::string name = entry->d_name;
+    if (name == "." || name == "..") continue;
+    const std::string relative = prefix.empty() ? name : prefix + '/' + name;
+    const std::string file_path = dir + '/' + relative;
+    struct stat st;
+    if (stat(file_path.c_str(), &st) != 0)
+    {
+      PLOG(WARNING) << "Skipping " << file_path;
+      continue;
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+      ok = AddDirectory(dir, relative, writer) && ok;
+    }
+    else if (S_ISREG(st.st_mode))
+    {
+      writer->AddFile(relative, file_path);
+    }
+  }
+  closedir(d);
+  return ok;
+}
+
+// bazel run changes into the runfiles, relative paths are meant to be
+// relative to where it was invoked from.
+std::string ResolveArg(const char* arg)
+{
+  const char* cwd = std::getenv("BUILD_WORKING_DIRECTORY");
+  if (arg[0] == '/' || cwd == nullptr) return arg;
+  return std::string(cwd) + '/' + arg;
+}
+
+int Run(int argc, char** argv)
+{
+  if (argc != 3)
+  {
+    std::fprintf(stderr, "Usage: %s [--nocompress] input_dir output.pak\n",
+                 argv[0]);
+    return 1;
+  }
+  const std::string input = ResolveArg(argv[1]);
+  const std::string output = ResolveArg(argv[2]);
+  assets::ArchiveWriter writer(FLAGS_compress);
+  if (!AddDirectory(input, "", &writer)) return 1;
+  assets::ArchiveWriterStats stats;
+  if (!writer.Write(output, &stats)) return 1;
+  std::printf("Cooked %llu files, %llu compressed, %.1f MB into %s, %.1f MB "
+              "of blobs, %.1f MB on disk\n",
+              static_cast<unsigned long long>(stats.entries_),
+              static_cast<unsigned long long>(stats.compressed_entries_),
+              stats.bytes_ / 1e6, output.c_str(), stats.stored_bytes_ / 1e6,
+              stats.archive_bytes_ / 1e6);
+  return 0;
+}
+
+}  // namespace
+}  // namespace motor::tools
+
+int main(int argc, char** argv)
+{
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+  return motor::tools::Run(argc, argv);
+}
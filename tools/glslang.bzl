@@ -0,0 +1,41 @@
+"""Exposes the host's glslangValidator as @glslang//:glslangValidator.
+
+The Vulkan loader is already taken from the host, the shader compiler comes
+from the same SDK instead of an unpinned source fetch.
+"""
+
+def _host_glslang_impl(repository_ctx):
+    name = "glslangValidator"
+    if repository_ctx.os.name.lower().startswith("windows"):
+        name += ".exe"
+
+    # $VULKAN_SDK wins over $PATH, so builds use the SDK they link against.
+    tool = None
+    sdk = repository_ctx.os.environ.get("VULKAN_SDK")
+    if sdk:
+        path = repository_ctx.path(sdk + "/bin/" + name)
+        if path.exists:
+            tool = path
+    if tool == None:
+        tool = repository_ctx.which(name)
+    if tool == None:
+        fail("Couldn't find %s, install the Vulkan SDK and set VULKAN_SDK " %
+             name + "or add it to PATH")
+
+    result = repository_ctx.execute([tool, "--version"])
+    if result.return_code != 0:
+        fail("Couldn't run %s: %s" % (tool, result.stderr))
+
+    repository_ctx.symlink(tool, "glslangValidator")
+    repository_ctx.file("BUILD", "\n".join([
+        'package(default_visibility = ["//visibility:public"])',
+        "",
+        'exports_files(["glslangValidator"])',
+        "",
+    ]))
+
+host_glslang = repository_rule(
+    implementation = _host_glslang_impl,
+    environ = ["PATH", "VULKAN_SDK"],
+    local = True,
+)